@@ -8,7 +8,7 @@
 #include <strsafe.h>
 #include <codecvt>
 
-void startup(LPCSTR lpApplicationName, LPSTR lpComand)
+DWORD startup(LPCSTR lpApplicationName, LPSTR lpComand)
 {
 	// additional information
 	STARTUPINFOA si;
@@ -20,67 +20,58 @@ void startup(LPCSTR lpApplicationName, LPSTR lpComand)
 	ZeroMemory(&pi, sizeof(pi));
 
 	// start the program up
-	CreateProcessA
+	if (!CreateProcessA
 	(
 		lpApplicationName,   // the path
 		lpComand,                // Command line
 		NULL,                   // Process handle not inheritable
 		NULL,                   // Thread handle not inheritable
 		FALSE,                  // Set handle inheritance to FALSE
-		CREATE_NEW_CONSOLE,     // Opens file in a separate console
+		0,                      // Share this console, the converter prints the batch summary
 		NULL,           // Use parent's environment block
 		NULL,           // Use parent's starting directory 
 		&si,            // Pointer to STARTUPINFO structure
 		&pi           // Pointer to PROCESS_INFORMATION structure
-	);
+	))
+	{
+		printf("CreateProcess failed (%d)\n", GetLastError());
+		return (DWORD)-1;
+	}
+
+	// wait for the whole batch and hand its exit code back
+	DWORD exitCode = 0;
+	WaitForSingleObject(pi.hProcess, INFINITE);
+	GetExitCodeProcess(pi.hProcess, &exitCode);
+
 	// Close process and thread handles. 
 	CloseHandle(pi.hProcess);
 	CloseHandle(pi.hThread);
+	return exitCode;
 }
 
 int _tmain(int argc, TCHAR** argv)
 {
-	if (argc != 2)
+	if (argc < 2)
 	{
-		_tprintf(TEXT("\nUsage: %s <directory name>\n"), argv[0]);
+		_tprintf(TEXT("\nUsage: %s <directory name> [-j <workers>]\n"), argv[0]);
 		return (-1);
 	}
 
-	TCHAR szDir[MAX_PATH];
-	size_t length_of_arg;
-	DWORD dwError = 0;
-
-	//FindFile .
-	StringCchCopy(szDir, MAX_PATH, argv[1]);
-	StringCchCat(szDir, MAX_PATH, TEXT("\\*"));
-
-	WIN32_FIND_DATA FindFileData;
-	HANDLE hFind = FindFirstFile(szDir, &FindFileData);
-	if (hFind == INVALID_HANDLE_VALUE) {
-		printf("FindFirstFile failed (%d)\n", GetLastError());
+	DWORD dwAttrib = GetFileAttributes(argv[1]);
+	if (dwAttrib == INVALID_FILE_ATTRIBUTES || !(dwAttrib & FILE_ATTRIBUTE_DIRECTORY)) {
+		_tprintf(TEXT("%s is not a directory\n"), argv[1]);
 		return -1;
 	}
 
+	// all files are converted by one FBXConverter process running its in-process batch mode
 	std::wstring wExePath = std::wstring(argv[0]);
-	std::wstring wFbxConverter = wExePath.substr(0, wExePath.rfind(_T("\\"))) +std::wstring(_T("\\")) + _T("FBXConverter.exe ");
-	do {
-		if (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-			_tprintf(TEXT("  %s   <DIR>\n"), FindFileData.cFileName);
-		else
-		{
-			_tprintf(TEXT("  %s \n"), FindFileData.cFileName);
-			std::wstring wfilename = std::wstring(argv[1]) + std::wstring(_T("\\")) + FindFileData.cFileName;
-			std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> conv;
-			std::string filename = conv.to_bytes(wfilename);
-			std::string fbxConverter = conv.to_bytes(wFbxConverter);
+	std::wstring wFbxConverter = wExePath.substr(0, wExePath.rfind(_T("\\")) + 1) + _T("FBXConverter.exe");
+	std::wstring wCommand = _T("\"") + wFbxConverter + _T("\" --batch \"") + std::wstring(argv[1]) + _T("\"");
+	for (int i = 2; i < argc; ++i)
+		wCommand += std::wstring(_T(" ")) + argv[i];
 
-			std::string command = "start " + fbxConverter + std::string(" ") + filename + std::string(" "); 
-			std::system(command.c_str());
-		}
-	} while (FindNextFile(hFind, &FindFileData) != 0);
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> conv;
+	std::string command = conv.to_bytes(wCommand);
 
-	FindClose(hFind);
-	dwError = GetLastError();
-	return dwError;
+	return (int)startup(NULL, &command[0]);
 }
-
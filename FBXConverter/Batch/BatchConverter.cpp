@@ -0,0 +1,387 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "BatchConverter.h"
+#include "../FBX/FbxBinaryParser.h"
+#include "../Common/parallel.h"
+#include "ConversionCache.h"
+#include "../Common/geometrystore.h"
+#include "../Common/scenefile.h"
+#ifndef NO_FBXSDK
+#include "../FBX/FbxParser.h"
+#endif
+#include <assert.h>
+#include <algorithm>
+#include <ctype.h>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static uint64_t Nanos(std::chrono::steady_clock::time_point start)
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+SceneParser* CreateParser(bool native)
+{
+#ifdef NO_FBXSDK
+	(void)native;
+	return new FbxBinaryParser();
+#else
+	if (native)
+		return new FbxBinaryParser();
+	return new FbxParser();
+#endif
+}
+
+SceneParser* CreateParser(const std::string& inFile, bool native)
+{
+	if (SceneParser::IsSceneFile(inFile))
+		return new SceneFileParser();
+	return CreateParser(native);
+}
+
+int ConvertFile(SceneParser* parser, const std::string& inFile, const std::string& outFile,
+	MeshArena::Stats* pArenaStats, const uint8_t* pInput, size_t inputSize)
+{
+	assert(parser);
+	int status = SceneParser::E_FAILLOADSCENE;
+	PROFILE_SCOPE_DETAIL(STAGE_NONE, "ConvertFile", &inFile);
+
+	//write new files instead of truncating the old ones, which may be hardlinks into a cache
+	const ExportOptions& options = parser->GetExportOptions();
+	std::error_code ec;
+	for (const std::string& output : ConversionCache::OutputFiles(outFile, options))
+		fs::remove(output, ec);
+
+	parser->SetInput(pInput, inputSize);
+	try
+	{
+		if (parser->LoadScene(inFile.c_str()))
+		{
+			//baking, LODs and BVHs need the whole extracted scene
+			if (options.stream && !options.bakeTransforms && options.lodRatios.empty() && !options.bvh &&
+				!SceneParser::IsGLTF(outFile) && !SceneParser::IsSceneFile(outFile))
+				status = parser->StreamOBJ(outFile.c_str());
+			else
+			{
+				parser->ExtractContent();
+				status = parser->Export(outFile.c_str());
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("Error: %s failed: %s\n", inFile.c_str(), e.what());
+		status = SceneParser::E_FAILLOADSCENE;
+	}
+	MeshArena::Stats arena = parser->GetArenaStats();
+	PROFILE_COUNT(COUNTER_ALLOCATIONS, arena.allocations);
+	PROFILE_COUNT(COUNTER_ALLOCATED_BYTES, arena.bytesUsed);
+	if (pArenaStats)
+		*pArenaStats = arena;
+	parser->Clear();
+	parser->SetInput(NULL, 0);
+	return status;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+BatchConverter::BatchConverter(unsigned int numWorkers, bool native)
+	:_numWorkers(numWorkers), _native(native), _outExtension(".obj"), _seconds(0.0), _pCache(NULL), _pStore(NULL), _pWriter(NULL),
+	_nextRead(0), _prefetchedBytes(0), _prefetchedFiles(0), _readersLeft(0),
+	_readNanos(0), _readBlockedNanos(0), _bytesRead(0), _convertNanos(0), _inputWaitNanos(0)
+{
+	if (_numWorkers == 0)
+		_numWorkers = std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::vector<std::string> BatchConverter::CollectFiles(const char* pDirectory)
+{
+	std::vector<std::string> files;
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(pDirectory, ec))
+	{
+		if (!entry.is_regular_file(ec))
+			continue;
+		std::string ext = entry.path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if (ext == ".fbx")
+			files.push_back(entry.path().string());
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+int BatchConverter::Run(const std::vector<std::string>& files)
+{
+	_results.clear();
+	_results.resize(files.size());
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		_results[i].inFile = files[i];
+		_results[i].outFile = fs::path(files[i]).replace_extension(_outExtension).string();
+	}
+	_inputs.clear();
+	_inputs.resize(files.size());
+	_ready.clear();
+	_nextRead = 0;
+	_prefetchedBytes = 0;
+	_prefetchedFiles = 0;
+	_readNanos = _readBlockedNanos = _bytesRead = _convertNanos = _inputWaitNanos = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned int numThreads = (unsigned int)std::min<size_t>(_numWorkers, files.size());
+	unsigned int numReaders = (unsigned int)std::min<size_t>(std::max(_pipeline.numReaders, 1u), files.size());
+	_readersLeft = numReaders;
+	{
+		//every worker and writer thread can hold one buffer being filled or written and
+		//one more in flight
+		AsyncWriter writer(_pipeline.numWriters, 2 * (size_t)numThreads + 2 * _pipeline.numWriters);
+		_pWriter = &writer;
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < numReaders; ++i)
+			threads.emplace_back(&BatchConverter::Reader, this, i);
+		for (unsigned int i = 0; i < numThreads; ++i)
+			threads.emplace_back(&BatchConverter::Worker, this, i);
+		for (std::thread& t : threads)
+			t.join();
+		writer.Close();
+		_pWriter = NULL;
+		_stats.write = writer.GetStats();
+	}
+	if (_pCache)
+		_pCache->Evict();
+	_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	_inputs.clear();
+
+	_stats.readers = numReaders;
+	_stats.workers = numThreads;
+	_stats.seconds = _seconds;
+	_stats.readSeconds = _readNanos * 1e-9;
+	_stats.readBlockedSeconds = _readBlockedNanos * 1e-9;
+	_stats.bytesRead = _bytesRead;
+	_stats.convertSeconds = _convertNanos * 1e-9;
+	_stats.inputWaitSeconds = _inputWaitNanos * 1e-9;
+
+	int failed = 0;
+	for (const BatchItem& item : _results)
+		if (item.status != SceneParser::E_NOERROR)
+			++failed;
+	return failed;
+}
+
+void BatchConverter::Reader(unsigned int index)
+{
+	Profiler::SetThreadName("reader " + std::to_string(index + 1));
+
+	//enough files ahead to keep every worker busy while the next ones are read
+	const size_t maxFiles = 2 * (size_t)_numWorkers + _pipeline.numReaders;
+	for (size_t i = _nextRead++; i < _results.size(); i = _nextRead++)
+	{
+		BatchItem& item = _results[i];
+		Prefetched& input = _inputs[i];
+		std::error_code ec;
+		uint64_t bytes = fs::file_size(item.inFile, ec);
+		if (ec)
+			bytes = 0;	//queued unread, the conversion reports the error
+		{
+			//a file larger than the limit still goes alone
+			auto start = std::chrono::steady_clock::now();
+			std::unique_lock<std::mutex> lock(_inputMutex);
+			_inputRoom.wait(lock, [&]() {
+				return _prefetchedFiles == 0 ||
+					(_prefetchedBytes + bytes <= _pipeline.prefetchBytes && _prefetchedFiles < maxFiles);
+			});
+			_readBlockedNanos += Nanos(start);
+			_prefetchedBytes += bytes;
+			++_prefetchedFiles;
+			input.reserved = bytes;
+		}
+		if (bytes > 0)
+		{
+			PROFILE_SCOPE_DETAIL(STAGE_NONE, "ReadInput", &item.inFile);
+			auto start = std::chrono::steady_clock::now();
+			input.ok = ReadWholeFile(item.inFile.c_str(), input.data, input.size);
+			_readNanos += Nanos(start);
+			if (input.ok)
+				_bytesRead += input.size;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_inputMutex);
+			_ready.push_back(i);
+		}
+		_inputReady.notify_one();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_inputMutex);
+		--_readersLeft;
+	}
+	_inputReady.notify_all();
+}
+
+void BatchConverter::Worker(unsigned int index)
+{
+	Profiler::SetThreadName("worker " + std::to_string(index + 1));
+
+	//one parser per worker, for the SDK its manager is created on the first LoadScene and reused for every file
+	std::unique_ptr<SceneParser> parser(CreateParser(_native));
+	ExportOptions options = _options;
+	options.interactive = false;
+	parser->SetExportOptions(options);
+	parser->SetGeometryStore(_pStore);
+
+	//share the cores with the other workers in the loops nested inside a conversion
+	ParallelThreadLimit() = std::max(1u, std::thread::hardware_concurrency() / _numWorkers);
+	AsyncWriter::Current() = _pWriter;
+	for (;;)
+	{
+		size_t i;
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::unique_lock<std::mutex> lock(_inputMutex);
+			_inputReady.wait(lock, [&]() { return !_ready.empty() || _readersLeft == 0; });
+			_inputWaitNanos += Nanos(start);
+			if (_ready.empty())
+				break;
+			i = _ready.front();
+			_ready.pop_front();
+		}
+		Convert(parser.get(), i);
+	}
+	AsyncWriter::Current() = nullptr;
+}
+
+void BatchConverter::Convert(SceneParser* parser, size_t i)
+{
+	BatchItem& item = _results[i];
+	Prefetched& input = _inputs[i];
+	if (Profiler::Enabled())
+		item.profile = std::make_shared<ProfileStats>();
+	Profiler::CurrentStats() = item.profile.get();
+	auto start = std::chrono::steady_clock::now();
+	const uint8_t* pInput = input.ok ? input.data.get() : NULL;
+
+	//the outputs of this file complete together, on a writer thread
+	_pWriter->BeginGroup();
+	std::string key;
+	if (_pCache)
+	{
+		PROFILE_SCOPE_DETAIL(STAGE_CACHE, "CacheRestore", &item.inFile);
+		key = _pCache->Key(item.inFile, item.outFile, _options, _native, _pStore ? _pStore->Directory() : std::string(),
+			pInput, input.size);
+		item.cached = _pCache->Restore(key, item.outFile, _options);
+	}
+	if (item.cached)
+		item.status = SceneParser::E_NOERROR;
+	else
+		item.status = ConvertFile(parser, item.inFile, item.outFile, &item.arena, pInput, input.size);
+	_convertNanos += Nanos(start);
+
+	input.data.reset();
+	{
+		std::lock_guard<std::mutex> lock(_inputMutex);
+		_prefetchedBytes -= input.reserved;
+		--_prefetchedFiles;
+	}
+	_inputRoom.notify_all();
+	Profiler::CurrentStats() = nullptr;
+
+	_pWriter->EndGroup([this, &item, key, start](bool ok) {
+		if (!ok && item.status == SceneParser::E_NOERROR)
+			item.status = SceneParser::E_FAILOPENFILE;
+		if (_pCache && !item.cached && item.status == SceneParser::E_NOERROR)
+		{
+			Profiler::CurrentStats() = item.profile.get();
+			{
+				PROFILE_SCOPE_DETAIL(STAGE_CACHE, "CacheStore", &item.inFile);
+				_pCache->Store(key, item.outFile, _options);
+			}
+			Profiler::CurrentStats() = nullptr;
+		}
+		item.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	});
+}
+
+void BatchConverter::PrintSummary(FILE* fp) const
+{
+	int failed = 0;
+	size_t peakArena = 0, reservedArena = 0;
+	fprintf(fp, "\n################ batch summary ################\n");
+	for (const BatchItem& item : _results)
+	{
+		const char* status = item.cached ? "cached" : "ok";
+		switch (item.status)
+		{
+		case SceneParser::E_NOERROR: break;
+		case SceneParser::E_NO_MESH: status = "FAILED (no mesh)"; break;
+		case SceneParser::E_FAILOPENFILE: status = "FAILED (cannot write output)"; break;
+		default: status = "FAILED (cannot load scene)"; break;
+		}
+		if (item.status != SceneParser::E_NOERROR)
+			++failed;
+		fprintf(fp, "  %-8.3f %8.2f MB  %s  %s\n", item.seconds, item.arena.bytesUsed / 1048576.0, status, item.inFile.c_str());
+		peakArena = std::max(peakArena, item.arena.bytesUsed);
+		reservedArena = std::max(reservedArena, item.arena.bytesReserved);
+	}
+	double rate = _seconds > 0.0 ? _results.size() / _seconds : 0.0;
+	fprintf(fp, "%zu files, %d failed, %u workers, %.3f s, %.2f files/s\n",
+		_results.size(), failed, _numWorkers, _seconds, rate);
+
+	//share of each stage's thread time spent working; the busiest stage limits the batch
+	const PipelineStats& s = _stats;
+	auto busy = [&](double seconds, unsigned int threads) { return threads > 0 && s.seconds > 0.0 ? 100.0 * seconds / (threads * s.seconds) : 0.0; };
+	auto rateMB = [&](uint64_t bytes) { return s.seconds > 0.0 ? bytes / 1048576.0 / s.seconds : 0.0; };
+	double convertBusy = busy(std::max(0.0, s.convertSeconds - s.write.waitSeconds), s.workers);
+	double readBusy = busy(s.readSeconds, s.readers), writeBusy = busy(s.write.busySeconds, s.write.threads);
+	fprintf(fp, "read:    %u threads %5.1f%% busy, %.2f MB/s, %.3f s blocked on the %.0f MB prefetch limit\n",
+		s.readers, readBusy, rateMB(s.bytesRead), s.readBlockedSeconds, _pipeline.prefetchBytes / 1048576.0);
+	fprintf(fp, "convert: %u threads %5.1f%% busy, %.3f s waiting for input, %.3f s for write buffers\n",
+		s.workers, convertBusy, s.inputWaitSeconds, s.write.waitSeconds);
+	fprintf(fp, "write:   %u threads %5.1f%% busy, %.2f MB/s, %zu files, %zu failed\n",
+		s.write.threads, writeBusy, rateMB(s.write.bytes), s.write.files, s.write.failed);
+	const char* bottleneck = convertBusy >= readBusy && convertBusy >= writeBusy ? "convert" : readBusy >= writeBusy ? "read" : "write";
+	fprintf(fp, "busiest stage: %s\n", bottleneck);
+	if (_pCache)
+	{
+		ConversionCache::Stats cache = _pCache->GetStats();
+		fprintf(fp, "cache: %zu hits, %zu misses, %zu stored, %zu evicted, %.2f MB\n",
+			cache.hits, cache.misses, cache.stores, cache.evicted, cache.bytes / 1048576.0);
+	}
+	if (_pStore)
+		_pStore->PrintReport(fp);
+	fprintf(fp, "scene arena: largest file %.2f MB, largest worker reservation %.2f MB\n",
+		peakArena / 1048576.0, reservedArena / 1048576.0);
+}
+
+void BatchConverter::PrintStats(FILE* fp) const
+{
+	for (const BatchItem& item : _results)
+		if (item.profile)
+			item.profile->WriteJSON(fp, item.inFile, item.status, item.seconds);
+}
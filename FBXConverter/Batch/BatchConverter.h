@@ -0,0 +1,174 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include "../Common/fileio.h"
+#include "../Common/scene.h"
+#include "../Common/profile.h"
+
+class ConversionCache;
+class GeometryStore;
+
+//FbxBinaryParser if native is set or the FBX SDK is not built in (NO_FBXSDK), FbxParser otherwise
+SceneParser* CreateParser(bool native);
+
+//SceneFileParser for a .scene file, CreateParser(native) for anything else
+SceneParser* CreateParser(const std::string& inFile, bool native);
+
+//convert one fbx or .scene file to obj, glb, gltf or .scene (by the output extension) with an existing parser, returns one of the SceneParser error codes;
+//pArenaStats receives the parser's arena statistics before the scene is cleared;
+//pInput holds the bytes of inFile when they are already read (see SceneParser::SetInput);
+//stage times and counters go to the caller's Profiler::CurrentStats()
+int ConvertFile(SceneParser* parser, const std::string& inFile, const std::string& outFile,
+	MeshArena::Stats* pArenaStats = nullptr, const uint8_t* pInput = nullptr, size_t inputSize = 0);
+
+struct BatchItem
+{
+	std::string inFile;
+	std::string outFile;
+	int status = -1;		//SceneParser error code, E_NOERROR on success
+	double seconds = 0.0;	//wall time spent on this file
+	MeshArena::Stats arena;	//scene arena of the worker right after this file
+	bool cached = false;	//restored from the conversion cache
+	std::shared_ptr<ProfileStats> profile;	//stage times and counters, when profiling is enabled
+};
+
+//threads and memory of the batch pipeline stages besides the conversion workers
+struct PipelineOptions
+{
+	unsigned int numReaders = 2;
+	unsigned int numWriters = 2;
+	uint64_t prefetchBytes = 256ull << 20;	//input read ahead at most, one file always fits
+};
+
+//where the time of the batch pipeline went, summed over the threads of each stage
+struct PipelineStats
+{
+	unsigned int readers = 0;
+	unsigned int workers = 0;
+	double seconds = 0.0;			//wall time of the batch
+	double readSeconds = 0.0;		//reading input files
+	double readBlockedSeconds = 0.0;	//readers waiting for room under the prefetch limit
+	uint64_t bytesRead = 0;
+	double convertSeconds = 0.0;	//converting, waits for write buffers included
+	double inputWaitSeconds = 0.0;	//workers waiting for a prefetched file
+	AsyncWriter::Stats write;
+};
+
+//Converts a list of fbx files inside one process as a three stage pipeline:
+//
+//    readers   read whole input files ahead into aligned buffers, in list order, up to
+//              PipelineOptions::prefetchBytes (the conversions hold the rest back)
+//    workers   convert the files in the order they arrive; every worker owns one parser
+//              (for FbxParser, one FbxManager) that is cleared and reused between files,
+//              and the importers reading a mapped file parse the prefetched bytes
+//    writers   an AsyncWriter writes the output files from a bounded pool of large buffers,
+//              so a worker only waits for the disk when every buffer is in flight
+//
+//A file is done, and stored in the cache, once its last output file is closed.
+class BatchConverter
+{
+public:
+	BatchConverter(unsigned int numWorkers = 0, bool native = false);
+
+	//all *.fbx files (case insensitive) found directly in a directory, sorted by name
+	static std::vector<std::string> CollectFiles(const char* pDirectory);
+
+	//blocks until every file is converted, returns the number of failed files
+	int Run(const std::vector<std::string>& files);
+
+	void PrintSummary(FILE* fp) const;
+
+	//one line of JSON stats per file (ProfileStats::WriteJSON), empty unless profiling is enabled
+	void PrintStats(FILE* fp) const;
+
+	void SetExportOptions(const ExportOptions& options) { _options = options; }
+
+	//restore unchanged conversions from a cache and store new ones, NULL for none
+	void SetCache(ConversionCache* pCache) { _pCache = pCache; }
+
+	//store identical meshes of all glTF outputs once and reference them, NULL for none
+	void SetGeometryStore(GeometryStore* pStore) { _pStore = pStore; }
+
+	//extension of the output files written next to the inputs, ".obj", ".glb", ".gltf" or ".scene"
+	void SetOutputExtension(const std::string& extension) { _outExtension = extension; }
+
+	void SetPipeline(const PipelineOptions& pipeline) { _pipeline = pipeline; }
+
+	const std::vector<BatchItem>& Results() const { return _results; }
+	unsigned int NumWorkers() const { return _numWorkers; }
+	double Seconds() const { return _seconds; }
+	const PipelineStats& GetPipelineStats() const { return _stats; }
+
+private:
+	//an input file read ahead
+	struct Prefetched
+	{
+		AlignedBuffer data;
+		size_t size = 0;
+		uint64_t reserved = 0;		//counted against the prefetch limit
+		bool ok = false;
+	};
+
+	void Reader(unsigned int index);
+	void Worker(unsigned int index);
+	void Convert(SceneParser* parser, size_t i);
+
+	unsigned int _numWorkers;
+	bool _native;
+	std::string _outExtension;
+	std::vector<BatchItem> _results;
+	double _seconds;
+	ExportOptions _options;
+	ConversionCache* _pCache;
+	GeometryStore* _pStore;
+	PipelineOptions _pipeline;
+	PipelineStats _stats;
+	AsyncWriter* _pWriter;
+
+	//read stage: files are read in list order and queued for the workers as they complete
+	std::vector<Prefetched> _inputs;
+	std::atomic<size_t> _nextRead;
+	std::mutex _inputMutex;
+	std::condition_variable _inputReady;	//a file was queued or the last reader finished
+	std::condition_variable _inputRoom;		//a worker released a prefetched file
+	std::deque<size_t> _ready;
+	uint64_t _prefetchedBytes;
+	size_t _prefetchedFiles;
+	unsigned int _readersLeft;
+	std::atomic<uint64_t> _readNanos;
+	std::atomic<uint64_t> _readBlockedNanos;
+	std::atomic<uint64_t> _bytesRead;
+	std::atomic<uint64_t> _convertNanos;
+	std::atomic<uint64_t> _inputWaitNanos;
+};
@@ -0,0 +1,342 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "ConversionCache.h"
+#include "../Common/hash.h"
+#include "../Common/mappedfile.h"
+#include "../Common/textwriter.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <random>
+#include <stdio.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	//an entry is evicted down to this fraction of the limit, so eviction does not run on every store
+	const double EVICT_TARGET = 0.9;
+
+	//a lock file older than this was left behind by a crashed process
+	const auto STALE_LOCK = std::chrono::minutes(10);
+
+	std::string RandomSuffix()
+	{
+		std::random_device rd;
+		uint64_t r = ((uint64_t)rd() << 32) ^ rd();
+		char buf[24];
+		snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)r);
+		return buf;
+	}
+
+	bool LinkOrCopy(const fs::path& from, const fs::path& to)
+	{
+		std::error_code ec;
+		fs::remove(to, ec);
+		fs::create_hard_link(from, to, ec);
+		if (ec)
+		{
+			ec.clear();
+			fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+		}
+		return !ec;
+	}
+
+	//name of a file inside an entry: "out" plus the output's extension
+	fs::path EntryFile(const fs::path& entry, const std::string& output)
+	{
+		return entry / ("out" + fs::path(output).extension().string());
+	}
+}
+
+ConversionCache::ConversionCache(const std::string& directory, uint64_t maxBytes)
+	:_directory(directory), _maxBytes(maxBytes)
+{
+	fs::path dir(directory);
+	_objects = (dir / "objects").string();
+	_index = (dir / "index").string();
+	_evicting = (dir / "index.evicting").string();
+	_lock = (dir / "lock").string();
+}
+
+bool ConversionCache::Open()
+{
+	std::error_code ec;
+	fs::create_directories(_objects, ec);
+	return fs::is_directory(_objects, ec);
+}
+
+std::vector<std::string> ConversionCache::OutputFiles(const std::string& outFile, const ExportOptions& options)
+{
+	std::vector<std::string> files;
+	for (size_t level = 0; level <= options.lodRatios.size(); ++level)
+	{
+		const std::string file = level == 0 ? outFile : SceneParser::LodFileName(outFile, level);
+		files.push_back(file);
+		if (SceneParser::IsSceneFile(file))
+			continue;	//materials are inside
+		if (!SceneParser::IsGLTF(file))
+			files.push_back(fs::path(file).replace_extension(".mtl").string());
+		else if (!SceneParser::IsGLB(file))
+			files.push_back(fs::path(file).replace_extension(".bin").string());	//absent with a geometry store
+	}
+	if (options.bvh)
+		files.push_back(SceneParser::BvhFileName(outFile));
+	return files;
+}
+
+std::string ConversionCache::Key(const std::string& inFile, const std::string& outFile,
+	const ExportOptions& options, bool native, const std::string& storeDir,
+	const uint8_t* pInput, size_t inputSize) const
+{
+	MappedFile file;
+	if (!(pInput ? file.Attach(pInput, inputSize) : file.Open(inFile.c_str())))
+		return std::string();
+	const uint64_t content = Hash64(file.Data(), file.Size());
+
+	//everything besides the input bytes that changes the written files
+	char eps[32];
+	*std::to_chars(eps, eps + sizeof(eps) - 1, options.weldEpsilon).ptr = 0;
+	std::error_code ec;
+	std::string store;
+	if (!storeDir.empty() && SceneParser::IsGLTF(outFile))
+		store = fs::relative(fs::absolute(storeDir, ec), fs::absolute(outFile, ec).parent_path(), ec).generic_string();
+	char crease[32];
+	*std::to_chars(crease, crease + sizeof(crease) - 1, options.creaseAngle).ptr = 0;
+	std::string simplify;
+	for (float value : { options.simplifyRatio, options.simplifyError })
+	{
+		char text[32];
+		*std::to_chars(text, text + sizeof(text) - 1, value).ptr = 0;
+		simplify += text;
+		simplify += ',';
+	}
+	for (float ratio : options.lodRatios)
+	{
+		char text[32];
+		*std::to_chars(text, text + sizeof(text) - 1, ratio).ptr = 0;
+		simplify += text;
+		simplify += ';';
+	}
+	char settings[2048];
+	int len = snprintf(settings, sizeof(settings), "%s|native=%d|precision=%d,%d,%d|weld=%d,%s|optimize=%d,%d|compact=%d|expand=%d|store=%s|crease=%s|bake=%d|simplify=%s|tangents=%d|bvh=%d|name=%s",
+		FBXCONVERTER_CACHE_VERSION, native ? 1 : 0,
+		options.positionPrecision, options.normalPrecision, options.uvPrecision,
+		options.weld ? 1 : 0, eps, options.optimize ? 1 : 0, options.optimizeOverdraw ? 1 : 0, options.compact ? 1 : 0,
+		options.expandInstances ? 1 : 0, store.c_str(), crease, options.bakeTransforms ? 1 : 0, simplify.c_str(), options.tangents ? 1 : 0, options.bvh ? 1 : 0,
+		fs::path(outFile).filename().string().c_str());
+	const uint64_t variant = Hash64(settings, std::min<size_t>(len, sizeof(settings) - 1), content);
+
+	char key[40];
+	snprintf(key, sizeof(key), "%016llx%016llx", (unsigned long long)content, (unsigned long long)variant);
+	return key;
+}
+
+bool ConversionCache::Restore(const std::string& key, const std::string& outFile, const ExportOptions& options)
+{
+	std::error_code ec;
+	const fs::path entry = fs::path(_objects) / key;
+	bool hit = !key.empty() && fs::is_regular_file(EntryFile(entry, outFile), ec);
+
+	uint64_t bytes = 0;
+	for (const std::string& output : OutputFiles(outFile, options))
+	{
+		if (!hit)
+			break;
+		const fs::path cached = EntryFile(entry, output);
+		if (!fs::exists(cached, ec))
+		{
+			fs::remove(output, ec);	//no .mtl for this result, drop a stale one
+			continue;
+		}
+		hit = LinkOrCopy(cached, output);
+		bytes += fs::file_size(cached, ec);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!hit)
+	{
+		++_stats.misses;
+		return false;
+	}
+	++_stats.hits;
+	AppendIndex(key, bytes);
+	return true;
+}
+
+bool ConversionCache::Store(const std::string& key, const std::string& outFile, const ExportOptions& options)
+{
+	std::error_code ec;
+	const fs::path entry = fs::path(_objects) / key;
+	if (key.empty() || !fs::is_regular_file(outFile, ec))
+		return false;
+	if (fs::exists(entry, ec))
+		return true;
+
+	//fill a private directory, then publish it with one rename
+	const fs::path tmp = fs::path(_objects) / (key + ".tmp." + RandomSuffix());
+	if (!fs::create_directory(tmp, ec))
+		return false;
+	uint64_t bytes = 0;
+	bool ok = true;
+	for (const std::string& output : OutputFiles(outFile, options))
+	{
+		if (!fs::exists(output, ec))
+			continue;
+		ok = ok && LinkOrCopy(output, EntryFile(tmp, output));
+		bytes += fs::file_size(output, ec);
+	}
+	if (ok)
+		fs::rename(tmp, entry, ec);
+	if (!ok || ec)
+	{
+		//failed, or another worker published the same key first
+		fs::remove_all(tmp, ec);
+		return ok && fs::exists(entry, ec);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_stats.stores;
+	AppendIndex(key, bytes);
+	return true;
+}
+
+void ConversionCache::AppendIndex(const std::string& key, uint64_t bytes)
+{
+	//one short write per line in append mode, so lines of concurrent processes do not mix
+	char line[96];
+	int len = snprintf(line, sizeof(line), "%s %llu %lld\n", key.c_str(),
+		(unsigned long long)bytes, (long long)std::time(nullptr));
+	FILE* fp = OpenFile(_index.c_str(), "a");
+	if (!fp)
+		return;
+	fwrite(line, 1, len, fp);
+	fclose(fp);
+}
+
+void ConversionCache::ReadIndexTimes(const std::string& file, std::map<std::string, int64_t>& times)
+{
+	FILE* fp = OpenFile(file.c_str(), "r");
+	if (!fp)
+		return;
+	char key[64];
+	unsigned long long bytes;
+	long long t;
+	while (fscanf(fp, "%63s %llu %lld", key, &bytes, &t) == 3)
+	{
+		int64_t& last = times[key];
+		last = std::max<int64_t>(last, t);
+	}
+	fclose(fp);
+}
+
+void ConversionCache::Evict()
+{
+	std::error_code ec;
+	FILE* lock = OpenFile(_lock.c_str(), "wx");
+	if (!lock && fs::exists(_lock, ec) &&
+		fs::file_time_type::clock::now() - fs::last_write_time(_lock, ec) > STALE_LOCK)
+	{
+		fs::remove(_lock, ec);
+		lock = OpenFile(_lock.c_str(), "wx");
+	}
+	if (!lock)
+		return;	//another process is evicting
+	fclose(lock);
+
+	//the directories are the truth, the index only says when an entry was last used;
+	//entries missing from it were just stored by someone else and count as recent
+	struct Entry
+	{
+		std::string key;
+		uint64_t bytes;
+		int64_t time;
+	};
+	//stores keep appending while this runs, so the index is never rewritten in place:
+	//it is moved aside and the entries left are appended to the fresh one stores create.
+	//A snapshot already there was left by a crashed evictor and is merged in instead
+	if (!fs::exists(_evicting, ec))
+		fs::rename(_index, _evicting, ec);
+	std::map<std::string, int64_t> times;
+	ReadIndexTimes(_evicting, times);
+	ReadIndexTimes(_index, times);
+	const int64_t now = (int64_t)std::time(nullptr);
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+	for (const fs::directory_entry& dir : fs::directory_iterator(_objects, ec))
+	{
+		std::string key = dir.path().filename().string();
+		if (!dir.is_directory(ec) || key.find(".tmp.") != std::string::npos)
+			continue;
+		Entry e = { key, 0, now };
+		for (const fs::directory_entry& file : fs::directory_iterator(dir.path(), ec))
+			e.bytes += file.file_size(ec);
+		auto t = times.find(key);
+		if (t != times.end())
+			e.time = t->second;
+		total += e.bytes;
+		entries.push_back(e);
+	}
+
+	size_t evicted = 0;
+	if (total > _maxBytes)
+	{
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+		const uint64_t target = (uint64_t)(_maxBytes * EVICT_TARGET);
+		size_t keep = 0;
+		for (; keep < entries.size() && total > target; ++keep, ++evicted)
+		{
+			fs::remove_all(fs::path(_objects) / entries[keep].key, ec);
+			total -= entries[keep].bytes;
+		}
+		entries.erase(entries.begin(), entries.begin() + keep);
+	}
+
+	//compact the index to the entries left, one write per line like AppendIndex
+	FILE* fp = OpenFile(_index.c_str(), "a");
+	if (fp)
+	{
+		for (const Entry& e : entries)
+		{
+			fprintf(fp, "%s %llu %lld\n", e.key.c_str(), (unsigned long long)e.bytes, (long long)e.time);
+			fflush(fp);
+		}
+		if (fclose(fp) == 0)
+			fs::remove(_evicting, ec);
+	}
+	fs::remove(_lock, ec);
+
+	std::lock_guard<std::mutex> guard(_mutex);
+	_stats.evicted += evicted;
+	_stats.bytes = total;
+}
+
+ConversionCache::Stats ConversionCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
@@ -0,0 +1,107 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//ConversionCache.h
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../Common/scene.h"
+
+//Bump whenever the converter output changes for the same input and options,
+//so entries written by older builds are no longer hit.
+#define FBXCONVERTER_CACHE_VERSION "FBXConverter-cache-4"
+
+//Content-addressed store of conversion results, shared by runs and processes.
+//
+//    <dir>/objects/<key>/out.obj, out.mtl (or out.glb, out.gltf + out.bin)   one entry per key
+//    <dir>/index                                        "<key> <bytes> <time>" lines, append only
+//    <dir>/index.evicting                               the index an evictor is compacting
+//    <dir>/lock                                         held while evicting
+//
+//The key hashes the input bytes, the converter version, the export options and the
+//output file name (the obj refers to its .mtl by name), plus the path from the output to
+//the geometry store its buffers live in. Store files are not cached, they are never deleted. Entries are published by
+//renaming a finished temporary directory, so readers never see a partial entry;
+//results are restored by hardlink, or by copy across file systems.
+class ConversionCache
+{
+public:
+	static const uint64_t DEFAULT_MAX_BYTES = 10ull << 30;
+
+	struct Stats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t stores = 0;
+		size_t evicted = 0;
+		uint64_t bytes = 0;		//cache size after the last eviction pass
+	};
+
+	ConversionCache(const std::string& directory, uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+	//create the cache directories, false if that fails
+	bool Open();
+
+	//cache key of converting inFile to outFile, empty if the input cannot be read;
+	//storeDir is the geometry store glTF outputs reference, empty for none; pInput holds
+	//the bytes of inFile when they are already read
+	std::string Key(const std::string& inFile, const std::string& outFile,
+		const ExportOptions& options, bool native, const std::string& storeDir = std::string(),
+		const uint8_t* pInput = nullptr, size_t inputSize = 0) const;
+
+	//link or copy a cached result to the OutputFiles of outFile, false on a miss
+	bool Restore(const std::string& key, const std::string& outFile, const ExportOptions& options);
+
+	//add the files written for outFile under key
+	bool Store(const std::string& key, const std::string& outFile, const ExportOptions& options);
+
+	//drop least recently used entries until the cache fits its size;
+	//skipped when another process is evicting
+	void Evict();
+
+	Stats GetStats() const;
+
+	//files a conversion to outFile writes: the output itself and, for obj, its .mtl, for gltf its .bin;
+	//then the same for each LOD file (SceneParser::LodFileName) and the .bvh when the options ask for them
+	static std::vector<std::string> OutputFiles(const std::string& outFile, const ExportOptions& options);
+
+private:
+	void AppendIndex(const std::string& key, uint64_t bytes);
+	static void ReadIndexTimes(const std::string& file, std::map<std::string, int64_t>& times);
+
+	std::string _directory;
+	std::string _objects;
+	std::string _index;
+	std::string _evicting;
+	std::string _lock;
+	uint64_t _maxBytes;
+
+	mutable std::mutex _mutex;
+	Stats _stats;
+};
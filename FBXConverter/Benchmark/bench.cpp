@@ -0,0 +1,623 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//bench.cpp
+//Pipeline microbenchmarks on generated meshes. Every benchmark runs a few times and
+//reports the best time with the heap allocations, arena usage and peak resident memory
+//of one run, as JSON on stdout (progress goes to stderr) so results of two commits can
+//be compared with a script.
+
+#include "generators.h"
+#include "../Common/bvh.h"
+#include "../Common/compactmesh.h"
+#include "../Common/normals.h"
+#include "../Common/parallel.h"
+#include "../Common/scenefile.h"
+#include "../Common/simplify.h"
+#include "../Common/tangents.h"
+#include "../Common/transform.h"
+#include "../FBX/FbxBinaryParser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////
+//heap allocation counters, arena blocks are reported separately from MeshArena::Stats
+namespace
+{
+	std::atomic<size_t> g_allocations(0);
+	std::atomic<size_t> g_allocBytes(0);
+}
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	//peak resident set since the last ResetPeakMemory, in KB
+	void ResetPeakMemory()
+	{
+#ifdef __linux__
+		if (FILE* f = fopen("/proc/self/clear_refs", "w"))
+		{
+			fputs("5", f);
+			fclose(f);
+		}
+#endif
+	}
+
+	long PeakMemoryKB()
+	{
+#ifdef __linux__
+		if (FILE* f = fopen("/proc/self/status", "r"))
+		{
+			char line[256];
+			long kb = -1;
+			while (fgets(line, sizeof(line), f))
+				if (strncmp(line, "VmHWM:", 6) == 0)
+					kb = atol(line + 6);
+			fclose(f);
+			if (kb >= 0)
+				return kb;
+		}
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+#else
+		return 0;
+#endif
+	}
+
+	struct Result
+	{
+		std::string name;
+		std::string shape;
+		uint64_t size = 0;			//requested size
+		uint64_t faces = 0;			//polygons processed per run, materials for write_materials
+		uint64_t triangles = 0;
+		uint64_t bytes = 0;			//bytes written per run
+		double seconds = 0.0;		//best run
+		double meanSeconds = 0.0;
+		size_t allocations = 0;		//heap allocations of one run
+		size_t allocBytes = 0;
+		size_t arenaBytes = 0;		//arena bytes used by one run
+		long peakMemoryKB = 0;		//peak resident set of the benchmark, inputs included
+	};
+
+	struct Settings
+	{
+		std::vector<uint64_t> sizes = { 1000, 10000, 100000, 1000000 };
+		std::string filter;
+		std::string label;
+		fs::path sinkDir;
+		int repeat = 3;
+	};
+
+	//time func over the repetitions; setup and teardown run untimed around each one
+	void Measure(const Settings& settings, Result& result, const std::function<void()>& func,
+		const std::function<void()>& teardown = nullptr)
+	{
+		double total = 0.0;
+		for (int r = 0; r < settings.repeat; ++r)
+		{
+			const size_t allocations = g_allocations.load(), allocBytes = g_allocBytes.load();
+			auto start = std::chrono::steady_clock::now();
+			func();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			result.allocations = g_allocations.load() - allocations;
+			result.allocBytes = g_allocBytes.load() - allocBytes;
+			if (r == 0 || seconds < result.seconds)
+				result.seconds = seconds;
+			total += seconds;
+			if (teardown)
+				teardown();
+		}
+		result.meanSeconds = total / settings.repeat;
+	}
+
+	uint64_t FileSize(const fs::path& path)
+	{
+		std::error_code ec;
+		uint64_t size = fs::file_size(path, ec);
+		return ec ? 0 : size;
+	}
+
+	//OBJ plus material library
+	uint64_t OutputSize(const fs::path& obj)
+	{
+		fs::path mtl = obj;
+		return FileSize(obj) + FileSize(mtl.replace_extension(".mtl"));
+	}
+
+	void RemoveOutput(const fs::path& path)
+	{
+		std::error_code ec;
+		fs::remove(path, ec);
+		fs::path mtl = path;
+		fs::remove(mtl.replace_extension(".mtl"), ec);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////
+	//benchmarks
+
+	void BenchTriMesh(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		result.faces = pMesh->nFaces;
+		Measure(settings, result, [&]() {
+			TriMesh triMesh(pMesh.get());
+			result.triangles = triMesh.numTris;
+			result.bytes = (size_t)triMesh.numVert * 2 * sizeof(Vector3d) + (size_t)triMesh.numUV * sizeof(Vector2d) +
+				(size_t)triMesh.numTris * 3 * (2 * sizeof(uint32_t) + sizeof(Vector3d) + sizeof(Vector2d));
+		});
+	}
+
+	//the same mesh in the compact layout; bytes is what it keeps, compare alloc_bytes with trimesh
+	void BenchCompactMesh(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		result.faces = pMesh->nFaces;
+		Measure(settings, result, [&]() {
+			CompactMesh compact(pMesh.get());
+			result.triangles = compact.numTris;
+			result.bytes = compact.MemoryBytes();
+		});
+	}
+
+	//normals of one mesh generated with the default crease angle, as for a file without them
+	void BenchNormals(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		result.faces = pMesh->nFaces;
+		Measure(settings, result, [&]() {
+			GenerateNormals(pMesh.get(), nullptr, ExportOptions().creaseAngle);
+		});
+	}
+
+	//tangents of one triangulated mesh
+	void BenchTangents(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		TriMesh triMesh(pMesh.get());
+		pMesh.reset();
+		result.faces = result.triangles = triMesh.numTris;
+		Measure(settings, result, [&]() {
+			GenerateTangents(&triMesh);
+		});
+	}
+
+	//quadric simplification of one mesh to a quarter of its triangles
+	void BenchSimplify(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		TriMesh triMesh(pMesh.get());
+		pMesh.reset();
+		result.faces = triMesh.numTris;
+		Measure(settings, result, [&]() {
+			std::unique_ptr<TriMesh> simplified(SimplifyTriMesh(&triMesh, triMesh.numTris / 4, SimplifyOptions()));
+			result.triangles = simplified->numTris;
+		});
+	}
+
+	//bounds of one mesh
+	void BenchBounds(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		TriMesh triMesh(pMesh.get());
+		pMesh.reset();
+		result.faces = result.triangles = triMesh.numTris;
+		Measure(settings, result, [&]() {
+			Bounds bounds = ComputeBounds(triMesh.P.get(), triMesh.numVert);
+			result.bytes = bounds.Empty() ? 0 : sizeof(Bounds);
+		});
+	}
+
+	//BVH of one mesh
+	void BenchBvh(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		TriMesh triMesh(pMesh.get());
+		pMesh.reset();
+		result.faces = result.triangles = triMesh.numTris;
+		Measure(settings, result, [&]() {
+			Bvh bvh;
+			BuildBvh(&triMesh, bvh);
+			result.bytes = bvh.nodes.size() * sizeof(BvhNode) + bvh.triangles.size() * sizeof(uint32_t);
+		});
+	}
+
+	//world transform baked into one mesh: rotation, non-uniform scale and translation
+	void BenchTransform(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(shape, (uint32_t)size, 1, nullptr));
+		TriMesh triMesh(pMesh.get());
+		pMesh.reset();
+		result.faces = result.triangles = triMesh.numTris;
+		Eigen::Affine3d affine = Eigen::Translation3d(1.0, 2.0, 3.0) * Eigen::AngleAxisd(0.5, Eigen::Vector3d(1.0, 1.0, 0.0).normalized()) *
+			Eigen::Scaling(2.0, 1.0, 0.5);
+		const Eigen::Matrix4d world = affine.matrix().transpose();	//row vector layout
+		Measure(settings, result, [&]() {
+			std::unique_ptr<TriMesh> transformed(TransformTriMesh(&triMesh, world));
+			result.bytes = (size_t)transformed->numVert * 2 * sizeof(Vector3d) + (size_t)transformed->numTris * 3 * sizeof(Vector3d);
+		});
+	}
+
+	//one mesh of the given size, written with the scene exporters
+	void BenchExport(const Settings& settings, MeshShape shape, uint64_t size, const ExportOptions& options,
+		const char* extension, Result& result)
+	{
+		SceneSpec spec;
+		spec.shape = shape;
+		spec.faces = (uint32_t)size;
+		spec.facesPerMesh = (uint32_t)size;
+		SyntheticScene scene(spec);
+		scene.SetExportOptions(options);
+		scene.ExtractContent();
+		scene.CountGeometry(result.faces, result.triangles);
+		fs::path out = settings.sinkDir / (std::string("fbxconverter_bench") + extension);
+		Measure(settings, result, [&]() {
+			scene.Export(out.string().c_str());
+		});
+		result.bytes = OutputSize(out);
+		RemoveOutput(out);
+	}
+
+	//one mesh written to a .scene once, then mapped, verified and extracted
+	void BenchLoadScene(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		SceneSpec spec;
+		spec.shape = shape;
+		spec.faces = (uint32_t)size;
+		spec.facesPerMesh = (uint32_t)size;
+		fs::path out = settings.sinkDir / "fbxconverter_bench.scene";
+		{
+			SyntheticScene scene(spec);
+			scene.ExtractContent();
+			scene.CountGeometry(result.faces, result.triangles);
+			scene.Export(out.string().c_str());
+		}
+		SceneFileParser parser;
+		Measure(settings, result, [&]() {
+			parser.LoadScene(out.string().c_str());
+			parser.ExtractContent();
+		}, [&]() {
+			parser.Clear();
+		});
+		result.bytes = OutputSize(out);
+		RemoveOutput(out);
+	}
+
+	//a generated FBX file written once, then mapped, decoded and triangulated by the built-in reader
+	void BenchLoadFbx(const Settings& settings, const SceneSpec& spec, uint32_t version, bool compress, Result& result)
+	{
+		fs::path out = settings.sinkDir / "fbxconverter_bench.fbx";
+		{
+			SyntheticScene scene(spec);
+			scene.ExtractContent();
+			scene.CountGeometry(result.faces, result.triangles);
+			const std::vector<uint8_t> fbx = scene.WriteFbx(version, compress);
+			FILE* f = fopen(out.string().c_str(), "wb");
+			if (!f || fwrite(fbx.data(), 1, fbx.size(), f) != fbx.size())
+			{
+				if (f)
+					fclose(f);
+				throw std::runtime_error("cannot write " + out.string());
+			}
+			fclose(f);
+		}
+		FbxBinaryParser parser;
+		Measure(settings, result, [&]() {
+			parser.LoadScene(out.string().c_str());
+			parser.ExtractContent();
+			result.arenaBytes = parser.GetArenaStats().bytesUsed;
+		}, [&]() {
+			parser.Clear();
+		});
+		result.bytes = FileSize(out);
+		RemoveOutput(out);
+	}
+
+	SceneSpec OneMeshScene(MeshShape shape, uint64_t size)
+	{
+		SceneSpec spec;
+		spec.shape = shape;
+		spec.faces = (uint32_t)size;
+		spec.facesPerMesh = (uint32_t)size;
+		return spec;
+	}
+
+	SceneSpec SmallMeshScene(MeshShape shape, uint64_t size)
+	{
+		SceneSpec spec;
+		spec.shape = shape;
+		spec.faces = (uint32_t)size;
+		spec.facesPerMesh = 64;
+		spec.numMaterials = (uint32_t)std::max<uint64_t>(1, size / spec.facesPerMesh / 8);
+		return spec;
+	}
+
+	//node tree, small meshes and shared materials, extracted into the arena and cleared
+	//as a batch worker does between files
+	void BenchHierarchy(const Settings& settings, MeshShape shape, uint64_t size, Result& result)
+	{
+		SyntheticScene scene(SmallMeshScene(shape, size));
+		Measure(settings, result, [&]() {
+			scene.ExtractContent();
+			result.arenaBytes = scene.GetArenaStats().bytesUsed;
+		}, [&]() {
+			scene.CountGeometry(result.faces, result.triangles);
+			scene.Clear();
+		});
+	}
+
+	void BenchSceneExport(const Settings& settings, MeshShape shape, uint64_t size, bool stream, bool compact, Result& result)
+	{
+		SyntheticScene scene(SmallMeshScene(shape, size));
+		ExportOptions options;
+		options.compact = compact;
+		scene.SetExportOptions(options);
+		fs::path out = settings.sinkDir / "fbxconverter_bench_scene.obj";
+		scene.ExtractContent();
+		scene.CountGeometry(result.faces, result.triangles);
+		if (stream)
+		{
+			scene.Clear();
+			Measure(settings, result, [&]() {
+				scene.StreamOBJ(out.string().c_str());
+			}, [&]() {
+				scene.Clear();
+			});
+		}
+		else
+		{
+			Measure(settings, result, [&]() {
+				scene.ExportOBJ(out.string().c_str());
+			});
+		}
+		result.bytes = OutputSize(out);
+		RemoveOutput(out);
+	}
+
+	//material library of one material per 16 faces, behind an obj of a single mesh
+	void BenchMaterials(const Settings& settings, uint64_t size, Result& result)
+	{
+		SceneSpec spec;
+		spec.faces = (uint32_t)size;
+		spec.facesPerMesh = 16;
+		spec.numMaterials = (uint32_t)std::max<uint64_t>(1, size / 16);
+		SyntheticScene scene(spec);
+		scene.ExtractContent();
+		fs::path out = settings.sinkDir / "fbxconverter_bench_materials.obj";
+		Measure(settings, result, [&]() {
+			scene.ExportMaterials(out.string().c_str());
+		});
+		result.faces = spec.numMaterials;
+		result.bytes = FileSize(fs::path(out).replace_extension(".mtl"));
+		RemoveOutput(out);
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////
+	//JSON output
+
+	void WriteString(FILE* f, const std::string& s)
+	{
+		fputc('"', f);
+		for (char c : s)
+		{
+			if (c == '"' || c == '\\')
+				fputc('\\', f);
+			fputc(c, f);
+		}
+		fputc('"', f);
+	}
+
+	void WriteResult(FILE* f, const Result& r, bool last)
+	{
+		const double seconds = r.seconds > 0.0 ? r.seconds : 1e-9;
+		fprintf(f, "    {\"name\": ");
+		WriteString(f, r.name);
+		fprintf(f, ", \"shape\": ");
+		WriteString(f, r.shape);
+		fprintf(f, ", \"size\": %llu, \"faces\": %llu, \"triangles\": %llu, \"bytes\": %llu,"
+			" \"seconds\": %.6f, \"mean_seconds\": %.6f, \"faces_per_s\": %.0f, \"triangles_per_s\": %.0f, \"mb_per_s\": %.2f,"
+			" \"allocations\": %zu, \"alloc_bytes\": %zu, \"arena_bytes\": %zu, \"peak_rss_kb\": %ld}%s\n",
+			(unsigned long long)r.size, (unsigned long long)r.faces, (unsigned long long)r.triangles,
+			(unsigned long long)r.bytes, r.seconds, r.meanSeconds, r.faces / seconds, r.triangles / seconds, r.bytes / 1e6 / seconds,
+			r.allocations, r.allocBytes, r.arenaBytes, r.peakMemoryKB, last ? "" : ",");
+	}
+
+	void PrintUsage()
+	{
+		fprintf(stderr,
+			"fbxconverter_bench [options]\n"
+			"  --sizes <n,n,...>   face counts to run (default 1000,10000,100000,1000000)\n"
+			"  --full              sizes 1000 to 50000000\n"
+			"  --filter <text>     only benchmarks whose name contains text\n"
+			"  --repeat <n>        runs per benchmark, the best one is reported (default 3)\n"
+			"  --threads <n>       threads of the parallel loops, 0 for all cores\n"
+			"  --out <directory>   where output files are written (default /dev/shm or the temp directory)\n"
+			"  --label <text>      recorded in the JSON, e.g. the commit\n");
+	}
+
+	std::vector<uint64_t> ParseSizes(const char* text)
+	{
+		std::vector<uint64_t> sizes;
+		for (const char* p = text; *p; )
+		{
+			char* end;
+			uint64_t n = strtoull(p, &end, 10);
+			if (end == p)
+				break;
+			if (*end == 'K' || *end == 'k')
+				n *= 1000, ++end;
+			else if (*end == 'M' || *end == 'm')
+				n *= 1000000, ++end;
+			if (n > 0)
+				sizes.push_back(n);
+			p = *end == ',' ? end + 1 : end;
+		}
+		return sizes;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Settings settings;
+	settings.sinkDir = fs::exists("/dev/shm") ? fs::path("/dev/shm") : fs::temp_directory_path();
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if (arg == "--sizes" && i + 1 < argc)
+			settings.sizes = ParseSizes(argv[++i]);
+		else if (arg == "--full")
+			settings.sizes = { 1000, 10000, 100000, 1000000, 10000000, 50000000 };
+		else if (arg == "--filter" && i + 1 < argc)
+			settings.filter = argv[++i];
+		else if (arg == "--repeat" && i + 1 < argc)
+			settings.repeat = std::max(1, atoi(argv[++i]));
+		else if (arg == "--threads" && i + 1 < argc)
+			ParallelThreadLimit() = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--out" && i + 1 < argc)
+			settings.sinkDir = argv[++i];
+		else if (arg == "--label" && i + 1 < argc)
+			settings.label = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	ExportOptions plain, welded;
+	welded.weld = true;
+	const MeshShape shapes[] = { SHAPE_GRID, SHAPE_MIXED, SHAPE_FAN };
+
+	struct Benchmark
+	{
+		std::string name;
+		MeshShape shape;
+		std::function<void(uint64_t, Result&)> run;
+	};
+	std::vector<Benchmark> benchmarks;
+	for (MeshShape shape : shapes)
+	{
+		benchmarks.push_back({ "trimesh", shape, [&, shape](uint64_t n, Result& r) { BenchTriMesh(settings, shape, n, r); } });
+		benchmarks.push_back({ "compact_mesh", shape, [&, shape](uint64_t n, Result& r) { BenchCompactMesh(settings, shape, n, r); } });
+		benchmarks.push_back({ "export_obj", shape, [&, shape](uint64_t n, Result& r) { BenchExport(settings, shape, n, plain, ".obj", r); } });
+	}
+	benchmarks.push_back({ "export_obj_weld", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchExport(settings, SHAPE_GRID, n, welded, ".obj", r); } });
+	benchmarks.push_back({ "export_glb", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchExport(settings, SHAPE_GRID, n, plain, ".glb", r); } });
+	benchmarks.push_back({ "export_scene", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchExport(settings, SHAPE_GRID, n, plain, ".scene", r); } });
+	benchmarks.push_back({ "load_scene", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchLoadScene(settings, SHAPE_GRID, n, r); } });
+	benchmarks.push_back({ "load_fbx", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchLoadFbx(settings, OneMeshScene(SHAPE_GRID, n), 7500, true, r); } });
+	benchmarks.push_back({ "load_fbx_raw", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchLoadFbx(settings, OneMeshScene(SHAPE_GRID, n), 7400, false, r); } });
+	for (MeshShape shape : { SHAPE_GRID, SHAPE_MIXED })
+		benchmarks.push_back({ "normals", shape, [&, shape](uint64_t n, Result& r) { BenchNormals(settings, shape, n, r); } });
+	benchmarks.push_back({ "tangents", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchTangents(settings, SHAPE_GRID, n, r); } });
+	benchmarks.push_back({ "simplify", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchSimplify(settings, SHAPE_GRID, n, r); } });
+	benchmarks.push_back({ "transform", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchTransform(settings, SHAPE_GRID, n, r); } });
+	benchmarks.push_back({ "bounds", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchBounds(settings, SHAPE_GRID, n, r); } });
+	benchmarks.push_back({ "bvh", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchBvh(settings, SHAPE_GRID, n, r); } });
+	benchmarks.push_back({ "write_materials", SHAPE_GRID, [&](uint64_t n, Result& r) { BenchMaterials(settings, n, r); } });
+	for (MeshShape shape : { SHAPE_GRID, SHAPE_MIXED })
+	{
+		benchmarks.push_back({ "scene_extract", shape, [&, shape](uint64_t n, Result& r) { BenchHierarchy(settings, shape, n, r); } });
+		benchmarks.push_back({ "scene_load_fbx", shape, [&, shape](uint64_t n, Result& r) { BenchLoadFbx(settings, SmallMeshScene(shape, n), 7500, true, r); } });
+		benchmarks.push_back({ "scene_export_obj", shape, [&, shape](uint64_t n, Result& r) { BenchSceneExport(settings, shape, n, false, false, r); } });
+		benchmarks.push_back({ "scene_stream_obj", shape, [&, shape](uint64_t n, Result& r) { BenchSceneExport(settings, shape, n, true, false, r); } });
+		benchmarks.push_back({ "scene_stream_obj_compact", shape, [&, shape](uint64_t n, Result& r) { BenchSceneExport(settings, shape, n, true, true, r); } });
+	}
+
+	std::vector<Result> results;
+	for (const Benchmark& bench : benchmarks)
+	{
+		std::string fullName = bench.name + "/" + ShapeName(bench.shape);
+		if (!settings.filter.empty() && fullName.find(settings.filter) == std::string::npos)
+			continue;
+		for (uint64_t size : settings.sizes)
+		{
+			Result result;
+			result.name = bench.name;
+			result.shape = ShapeName(bench.shape);
+			result.size = size;
+			fprintf(stderr, "%s/%llu ... ", fullName.c_str(), (unsigned long long)size);
+			fflush(stderr);
+
+			ResetPeakMemory();
+			try
+			{
+				bench.run(size, result);
+			}
+			catch (const std::exception& e)
+			{
+				fprintf(stderr, "failed: %s\n", e.what());
+				continue;
+			}
+			result.peakMemoryKB = PeakMemoryKB();
+			fprintf(stderr, "%.3f s\n", result.seconds);
+			results.push_back(result);
+		}
+	}
+
+	printf("{\n  \"label\": ");
+	WriteString(stdout, settings.label);
+	printf(",\n  \"threads\": %u,\n  \"repeat\": %d,\n  \"results\": [\n",
+		ParallelThreadLimit() ? ParallelThreadLimit() : std::thread::hardware_concurrency(), settings.repeat);
+	for (size_t i = 0; i < results.size(); ++i)
+		WriteResult(stdout, results[i], i + 1 == results.size());
+	printf("  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,290 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//fbxwriter.cpp
+
+#include "fbxwriter.h"
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+
+static const char FBX_BINARY_MAGIC[] = "Kaydara FBX Binary  ";	//followed by 0x00 0x1a 0x00
+
+FbxWriter::FbxWriter(uint32_t version, bool compress)
+	:_version(version), _compress(compress)
+{
+	_data.assign(FBX_BINARY_MAGIC, FBX_BINARY_MAGIC + sizeof(FBX_BINARY_MAGIC));
+	_data.push_back(0x1a);
+	_data.push_back(0x00);
+	Append(version);
+}
+
+template <typename T>
+void FbxWriter::Append(T value)
+{
+	const size_t pos = _data.size();
+	_data.resize(pos + sizeof(T));
+	memcpy(_data.data() + pos, &value, sizeof(T));
+}
+
+//field 0 is the end offset, 1 the number of properties, 2 the property list length
+void FbxWriter::PutHeaderField(size_t offset, int field, uint64_t value)
+{
+	if (_version >= 7500)
+		memcpy(_data.data() + offset + field * 8, &value, 8);
+	else
+	{
+		const uint32_t narrow = (uint32_t)value;
+		memcpy(_data.data() + offset + field * 4, &narrow, 4);
+	}
+}
+
+void FbxWriter::EndProperties(OpenRecord& rec)
+{
+	if (rec.hasChildren)
+		return;
+	PutHeaderField(rec.header, 2, _data.size() - rec.props);
+	rec.hasChildren = true;
+}
+
+FbxWriter& FbxWriter::Begin(const char* name)
+{
+	if (!_open.empty())
+		EndProperties(_open.back());
+	OpenRecord rec;
+	rec.header = _data.size();
+	const size_t nameLen = strlen(name);
+	_data.resize(_data.size() + HeaderSize() - 1, 0);
+	_data.push_back((uint8_t)nameLen);
+	_data.insert(_data.end(), name, name + nameLen);
+	rec.props = _data.size();
+	rec.numProps = 0;
+	rec.hasChildren = false;
+	_open.push_back(rec);
+	return *this;
+}
+
+void FbxWriter::End()
+{
+	OpenRecord rec = _open.back();
+	_open.pop_back();
+	//as the SDK: nested records, and records without properties, end with a null record
+	const bool nested = rec.hasChildren;
+	if (!nested)
+		PutHeaderField(rec.header, 2, _data.size() - rec.props);
+	if (nested || rec.numProps == 0)
+		_data.resize(_data.size() + HeaderSize(), 0);
+	PutHeaderField(rec.header, 1, rec.numProps);
+	PutHeaderField(rec.header, 0, _data.size());
+}
+
+FbxWriter& FbxWriter::Int(int32_t value)
+{
+	_data.push_back('I');
+	Append(value);
+	++_open.back().numProps;
+	return *this;
+}
+
+FbxWriter& FbxWriter::Long(int64_t value)
+{
+	_data.push_back('L');
+	Append(value);
+	++_open.back().numProps;
+	return *this;
+}
+
+FbxWriter& FbxWriter::Double(double value)
+{
+	_data.push_back('D');
+	Append(value);
+	++_open.back().numProps;
+	return *this;
+}
+
+FbxWriter& FbxWriter::String(const std::string& value)
+{
+	_data.push_back('S');
+	Append((uint32_t)value.size());
+	_data.insert(_data.end(), value.begin(), value.end());
+	++_open.back().numProps;
+	return *this;
+}
+
+void FbxWriter::AppendArray(char type, const void* data, uint32_t count, size_t elementSize)
+{
+	const uLong bytes = (uLong)(count * elementSize);
+	_data.push_back((uint8_t)type);
+	Append(count);
+	if (!_compress)
+	{
+		Append((uint32_t)0);
+		Append((uint32_t)bytes);
+		_data.insert(_data.end(), (const uint8_t*)data, (const uint8_t*)data + bytes);
+	}
+	else
+	{
+		uLongf compressedLength = compressBound(bytes);
+		std::vector<uint8_t> compressed(compressedLength);
+		if (compress(compressed.data(), &compressedLength, (const Bytef*)data, bytes) != Z_OK)
+			throw std::runtime_error("cannot deflate array");
+		Append((uint32_t)1);
+		Append((uint32_t)compressedLength);
+		_data.insert(_data.end(), compressed.begin(), compressed.begin() + compressedLength);
+	}
+	++_open.back().numProps;
+}
+
+FbxWriter& FbxWriter::Array(const std::vector<int32_t>& values)
+{
+	AppendArray('i', values.data(), (uint32_t)values.size(), sizeof(int32_t));
+	return *this;
+}
+
+FbxWriter& FbxWriter::Array(const std::vector<double>& values)
+{
+	AppendArray('d', values.data(), (uint32_t)values.size(), sizeof(double));
+	return *this;
+}
+
+void FbxWriter::P(const char* name, const char* type, const double* values, int n)
+{
+	Begin("P").String(name).String(type).String("").String("A");
+	for (int i = 0; i < n; ++i)
+		Double(values[i]);
+	End();
+}
+
+//"Name\x00\x01Class"
+static std::string ObjectName(const std::string& name, const char* className)
+{
+	return name + std::string("\0\1", 2) + className;
+}
+
+void FbxWriter::Model(int64_t id, const std::string& name, const Vector3d& translation)
+{
+	Begin("Model").Long(id).String(ObjectName(name, "Model")).String("Mesh");
+	Begin("Version").Int(232).End();
+	Begin("Properties70");
+	P("Lcl Translation", "Lcl Translation", translation.data(), 3);
+	End();
+	End();
+}
+
+void FbxWriter::Material(int64_t id, const std::string& name, const Vector3d& diffuse)
+{
+	Begin("Material").Long(id).String(ObjectName(name, "Material")).String("");
+	Begin("Version").Int(102).End();
+	Begin("ShadingModel").String("phong").End();
+	Begin("Properties70");
+	P("DiffuseColor", "Color", diffuse.data(), 3);
+	End();
+	End();
+}
+
+void FbxWriter::Geometry(int64_t id, const std::string& name, const PolyMesh* pMesh, const std::vector<int32_t>& materialIds)
+{
+	std::vector<double> vertices((size_t)pMesh->nVertices * 3);
+	for (uint32_t v = 0; v < pMesh->nVertices; ++v)
+		std::copy_n(pMesh->Verts[v].data(), 3, &vertices[(size_t)v * 3]);
+
+	//polygon ends are stored as ~index
+	std::vector<int32_t> polygonVertexIndex;
+	for (uint32_t f = 0, c = 0; f < pMesh->nFaces; ++f)
+	{
+		for (uint32_t k = 0; k < pMesh->FaceIndices[f]; ++k, ++c)
+			polygonVertexIndex.push_back((int32_t)pMesh->VertsIndices[c]);
+		polygonVertexIndex.back() = ~polygonVertexIndex.back();
+	}
+	const size_t numCorners = polygonVertexIndex.size();
+
+	std::vector<double> normals(numCorners * 3);
+	std::vector<int32_t> uvIndex(numCorners);
+	std::vector<double> uvs;
+	for (size_t c = 0; c < numCorners; ++c)
+	{
+		std::copy_n(pMesh->Normals[c].data(), 3, &normals[c * 3]);
+		const uint32_t i = pMesh->UVIndices[c];
+		uvIndex[c] = (int32_t)i;
+		if (uvs.size() < (size_t)i * 2 + 2)
+			uvs.resize((size_t)i * 2 + 2, 0.0);
+		std::copy_n(pMesh->UVs[c].data(), 2, &uvs[(size_t)i * 2]);
+	}
+
+	Begin("Geometry").Long(id).String(ObjectName(name, "Geometry")).String("Mesh");
+	Begin("Vertices").Array(vertices).End();
+	Begin("PolygonVertexIndex").Array(polygonVertexIndex).End();
+	Begin("GeometryVersion").Int(124).End();
+
+	Begin("LayerElementNormal").Int(0);
+	Begin("Version").Int(101).End();
+	Begin("MappingInformationType").String("ByPolygonVertex").End();
+	Begin("ReferenceInformationType").String("Direct").End();
+	Begin("Normals").Array(normals).End();
+	End();
+
+	Begin("LayerElementUV").Int(0);
+	Begin("Version").Int(101).End();
+	Begin("MappingInformationType").String("ByPolygonVertex").End();
+	Begin("ReferenceInformationType").String("IndexToDirect").End();
+	Begin("UV").Array(uvs).End();
+	Begin("UVIndex").Array(uvIndex).End();
+	End();
+
+	std::vector<const char*> layerElements = { "LayerElementNormal", "LayerElementUV" };
+	if (!materialIds.empty())
+	{
+		Begin("LayerElementMaterial").Int(0);
+		Begin("Version").Int(101).End();
+		Begin("MappingInformationType").String(materialIds.size() > 1 ? "ByPolygon" : "AllSame").End();
+		Begin("ReferenceInformationType").String("IndexToDirect").End();
+		Begin("Materials").Array(materialIds).End();
+		End();
+		layerElements.push_back("LayerElementMaterial");
+	}
+
+	Begin("Layer").Int(0);
+	Begin("Version").Int(100).End();
+	for (const char* type : layerElements)
+	{
+		Begin("LayerElement");
+		Begin("Type").String(type).End();
+		Begin("TypedIndex").Int(0).End();
+		End();
+	}
+	End();
+	End();
+}
+
+void FbxWriter::Connect(int64_t child, int64_t parent)
+{
+	Begin("C").String("OO").Long(child).Long(parent).End();
+}
+
+std::vector<uint8_t> FbxWriter::Finish()
+{
+	_data.resize(_data.size() + HeaderSize(), 0);
+	return std::move(_data);
+}
@@ -0,0 +1,89 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//fbxwriter.h
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../Common/polymesh.h"
+
+//Binary FBX writer for the tests and benchmarks: just the records FbxBinaryParser reads,
+//with 32 bit record headers before version 7500 and 64 bit ones from it on. The footer
+//the SDK appends after the closing null record is left out.
+class FbxWriter
+{
+public:
+	//arrays are deflated when compress is set and stored raw otherwise
+	FbxWriter(uint32_t version, bool compress);
+
+	//a record: Begin, its properties, its nested records, End
+	FbxWriter& Begin(const char* name);
+	void End();
+
+	FbxWriter& Int(int32_t value);
+	FbxWriter& Long(int64_t value);
+	FbxWriter& Double(double value);
+	FbxWriter& String(const std::string& value);
+	FbxWriter& Array(const std::vector<int32_t>& values);
+	FbxWriter& Array(const std::vector<double>& values);
+
+	//Properties70 entry of n doubles: P "name", "type", "", "A", values
+	void P(const char* name, const char* type, const double* values, int n);
+
+	//scene objects, inside Objects; the ids connect them in Connections
+	void Model(int64_t id, const std::string& name, const Vector3d& translation);
+	void Material(int64_t id, const std::string& name, const Vector3d& diffuse);
+	//per corner normals, uvs indexed by UVIndices, and per polygon material ids: one for all
+	//polygons, one per polygon, or none
+	void Geometry(int64_t id, const std::string& name, const PolyMesh* pMesh, const std::vector<int32_t>& materialIds);
+
+	//inside Connections: object child is connected to parent, 0 for the root
+	void Connect(int64_t child, int64_t parent);
+
+	//the file: header, top level records and the null record closing them
+	std::vector<uint8_t> Finish();
+
+private:
+	struct OpenRecord
+	{
+		size_t header;		//offset of the record header
+		size_t props;		//offset of the first property
+		uint64_t numProps;
+		bool hasChildren;
+	};
+
+	template <typename T> void Append(T value);
+	void AppendArray(char type, const void* data, uint32_t count, size_t elementSize);
+	void PutHeaderField(size_t offset, int field, uint64_t value);
+	void EndProperties(OpenRecord& rec);
+	size_t HeaderSize() const { return _version >= 7500 ? 25 : 13; }
+
+	uint32_t _version;
+	bool _compress;
+	std::vector<uint8_t> _data;
+	std::vector<OpenRecord> _open;
+};
@@ -0,0 +1,350 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "generators.h"
+#include "fbxwriter.h"
+#include "../Common/compactmesh.h"
+#include "../Common/objwriter.h"
+#include "../Common/parallel.h"
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+	//Numerical Recipes LCG, enough to jitter coordinates and pick polygon sizes
+	struct Random
+	{
+		uint32_t state;
+		explicit Random(uint32_t seed) : state(seed * 2654435761u + 1) {}
+		uint32_t Next() { state = state * 1664525u + 1013904223u; return state >> 8; }
+		double Unit() { return Next() * (1.0 / 16777216.0); }
+	};
+
+	Vector3d MaterialColor(uint32_t i)
+	{
+		return Vector3d(0.2 + 0.6 * (i % 7) / 6.0, 0.5, 0.8 - 0.6 * (i % 5) / 4.0);
+	}
+
+	template <typename T>
+	T* NewObject(MeshArena* pArena)
+	{
+		return pArena ? pArena->New<T>() : new T;
+	}
+
+	void AllocateMesh(PolyMesh* m, uint32_t numVerts, uint32_t numFaces, uint32_t numCorners, MeshArena* pArena)
+	{
+		m->nVertices = numVerts;
+		m->nFaces = numFaces;
+		m->Verts = MakeMeshArray<Vector3d>(numVerts, pArena);
+		m->FaceIndices = MakeMeshArray<uint32_t>(numFaces, pArena);
+		m->VertsIndices = MakeMeshArray<uint32_t>(numCorners, pArena);
+		m->Normals = MakeMeshArray<Vector3d>(numCorners, pArena);
+		m->UVs = MakeMeshArray<Vector2d>(numCorners, pArena);
+		m->UVIndices = MakeMeshArray<uint32_t>(numCorners, pArena);
+	}
+
+	//one uv per vertex, as the importers produce for a single uv set
+	void SetCorner(PolyMesh* m, uint32_t c, uint32_t v, const Vector3d& normal, const Vector2d& uv)
+	{
+		m->VertsIndices[c] = v;
+		m->Normals[c] = normal;
+		m->UVs[c] = uv;
+		m->UVIndices[c] = v;
+	}
+
+	void GenerateGrid(PolyMesh* m, uint32_t faces, Random& rnd, MeshArena* pArena)
+	{
+		const uint32_t w = std::max<uint32_t>(1, (uint32_t)ceil(sqrt((double)faces)));
+		const uint32_t h = (faces + w - 1) / w;
+		AllocateMesh(m, (w + 1) * (h + 1), faces, 4 * faces, pArena);
+
+		for (uint32_t r = 0, v = 0; r <= h; ++r)
+			for (uint32_t c = 0; c <= w; ++c, ++v)
+				m->Verts[v] = Vector3d(c + 0.1 * rnd.Unit(), r + 0.1 * rnd.Unit(), 0.05 * rnd.Unit());
+
+		const Vector3d up(0.0, 0.0, 1.0);
+		for (uint32_t f = 0; f < faces; ++f)
+		{
+			const uint32_t r = f / w, c = f % w;
+			const uint32_t corners[4] = { r * (w + 1) + c, r * (w + 1) + c + 1, (r + 1) * (w + 1) + c + 1, (r + 1) * (w + 1) + c };
+			m->FaceIndices[f] = 4;
+			for (uint32_t k = 0; k < 4; ++k)
+			{
+				const uint32_t v = corners[k];
+				SetCorner(m, 4 * f + k, v, up, Vector2d((double)(v % (w + 1)) / w, (double)(v / (w + 1)) / h));
+			}
+		}
+	}
+
+	//each polygon shares an edge with the previous one, 40% triangles, 40% quads, 20% 5-8 gons
+	void GenerateMixed(PolyMesh* m, uint32_t faces, Random& rnd, MeshArena* pArena)
+	{
+		std::vector<uint8_t> sizes(faces);
+		uint32_t numCorners = 0;
+		for (uint32_t f = 0; f < faces; ++f)
+		{
+			const uint32_t pick = rnd.Next() % 10;
+			sizes[f] = (uint8_t)(pick < 4 ? 3 : pick < 8 ? 4 : 5 + rnd.Next() % 4);
+			numCorners += sizes[f];
+		}
+		const uint32_t numVerts = 2 + numCorners - 2 * faces;
+		AllocateMesh(m, numVerts, faces, numCorners, pArena);
+
+		for (uint32_t v = 0; v < numVerts; ++v)
+		{
+			const double t = 0.05 * v;
+			m->Verts[v] = Vector3d(0.01 * v, cos(t) + 0.01 * rnd.Unit(), sin(t) + 0.01 * rnd.Unit());
+		}
+
+		uint32_t e0 = 0, e1 = 1, next = 2, c = 0;
+		for (uint32_t f = 0; f < faces; ++f)
+		{
+			m->FaceIndices[f] = sizes[f];
+			for (uint32_t k = 0; k < sizes[f]; ++k)
+			{
+				const uint32_t v = k == 0 ? e0 : k == 1 ? e1 : next++;
+				const Vector3d& p = m->Verts[v];
+				SetCorner(m, c++, v, Vector3d(0.0, p.y(), p.z()).normalized(), Vector2d(p.x(), 0.5 + 0.5 * p.y()));
+			}
+			e0 = e1;
+			e1 = next - 1;
+		}
+	}
+
+	//disc polygons of FAN_SIDES corners laid out along x, size counts the triangles
+	void GenerateFan(PolyMesh* m, uint32_t triangles, Random& rnd, MeshArena* pArena)
+	{
+		const uint32_t faces = std::max<uint32_t>(1, triangles / (FAN_SIDES - 2));
+		AllocateMesh(m, faces * FAN_SIDES, faces, faces * FAN_SIDES, pArena);
+
+		const double step = 2.0 * M_PI / FAN_SIDES;
+		const Vector3d up(0.0, 0.0, 1.0);
+		for (uint32_t f = 0, v = 0; f < faces; ++f)
+		{
+			m->FaceIndices[f] = FAN_SIDES;
+			for (uint32_t k = 0; k < FAN_SIDES; ++k, ++v)
+			{
+				const double r = 1.0 + 0.01 * rnd.Unit();
+				m->Verts[v] = Vector3d(3.0 * f + r * cos(k * step), r * sin(k * step), 0.0);
+				SetCorner(m, v, v, up, Vector2d(0.5 + 0.5 * cos(k * step), 0.5 + 0.5 * sin(k * step)));
+			}
+		}
+	}
+}
+
+const char* ShapeName(MeshShape shape)
+{
+	switch (shape)
+	{
+	case SHAPE_GRID: return "grid";
+	case SHAPE_MIXED: return "mixed";
+	case SHAPE_FAN: return "fan";
+	}
+	return "unknown";
+}
+
+PolyMesh* GenerateMesh(MeshShape shape, uint32_t size, uint32_t seed, MeshArena* pArena)
+{
+	PolyMesh* m = NewObject<PolyMesh>(pArena);
+	Random rnd(seed);
+	size = std::max<uint32_t>(size, 1);
+	switch (shape)
+	{
+	case SHAPE_GRID: GenerateGrid(m, size, rnd, pArena); break;
+	case SHAPE_MIXED: GenerateMixed(m, size, rnd, pArena); break;
+	case SHAPE_FAN: GenerateFan(m, size, rnd, pArena); break;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%s_%u", ShapeName(shape), seed);
+	m->name = name;
+	return m;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+SyntheticScene::SyntheticScene(const SceneSpec& spec)
+	:_spec(spec)
+{
+	_spec.facesPerMesh = std::max<uint32_t>(_spec.facesPerMesh, 1);
+	_spec.numMaterials = std::max<uint32_t>(_spec.numMaterials, 1);
+}
+
+bool SyntheticScene::LoadScene(const char* /*pFilename*/)
+{
+	return true;
+}
+
+size_t SyntheticScene::NumMeshes() const
+{
+	return std::max<size_t>(1, (_spec.faces + (size_t)_spec.facesPerMesh - 1) / _spec.facesPerMesh);
+}
+
+void SyntheticScene::CountGeometry(uint64_t& faces, uint64_t& triangles) const
+{
+	faces = triangles = 0;
+	for (size_t i = 0; i < Meshes.size(); ++i)
+	{
+		faces += Meshes[i]->nFaces;
+		triangles += TriMeshes[i]->numTris;
+	}
+}
+
+uint32_t SyntheticScene::MeshFaces(size_t i) const
+{
+	const size_t first = i * _spec.facesPerMesh;
+	return (uint32_t)std::min<size_t>(_spec.facesPerMesh, _spec.faces > first ? _spec.faces - first : 1);
+}
+
+std::string SyntheticScene::MaterialName(size_t i) const
+{
+	return "material_" + std::to_string(i % _spec.numMaterials);
+}
+
+//node tree and materials, walked serially as the importers do
+void SyntheticScene::BuildNodes(size_t numMeshes)
+{
+	MeshNode* pRootMeshNode = _arena.New<MeshNode>(nullptr, "RootNode");
+	Nodes.push_back(pRootMeshNode);
+	_meshNodes.resize(numMeshes);
+	for (size_t i = 0; i < numMeshes; ++i)
+	{
+		MeshNode* pParent = i == 0 ? pRootMeshNode : _meshNodes[(i - 1) / 4];
+		MeshNode* pNode = _arena.New<MeshNode>(pParent, "node_" + std::to_string(i));
+		Eigen::Matrix4d transform = Eigen::Matrix4d::Identity();
+		transform(3, 0) = (double)(i % 4);
+		transform(3, 1) = (double)(i / 4 % 4);
+		pNode->setTransform(transform);
+		pParent->_children.push_back(pNode);
+		_meshNodes[i] = pNode;
+	}
+
+	for (uint32_t i = 0; i < std::min<size_t>(_spec.numMaterials, numMeshes); ++i)
+	{
+		Material* pMaterial = _arena.New<Material>();
+		pMaterial->index = i;
+		pMaterial->materialName = MaterialName(i);
+		pMaterial->Kd = MaterialColor(i);
+		pMaterial->Ns = (float)(i % 100);
+		pMaterial->Tr = i % 10 == 0 ? 0.5f : 1.0f;
+		if (i % 3 == 0)
+			pMaterial->map_Kd = "textures/" + pMaterial->materialName + ".png";
+		AddMaterial(pMaterial);
+	}
+}
+
+void SyntheticScene::ExtractContent()
+{
+	const size_t numMeshes = NumMeshes();
+	BuildNodes(numMeshes);
+
+	std::vector<PolyMesh*> meshes(numMeshes);
+	std::vector<TriMesh*> triMeshes(numMeshes);
+	ParallelForEach(numMeshes, [&](size_t i) {
+		meshes[i] = GenerateMesh(_spec.shape, MeshFaces(i), (uint32_t)i, _geometryArena);
+		meshes[i]->name = _meshNodes[i]->_name;
+		triMeshes[i] = NewGeometry<TriMesh>(meshes[i], _geometryArena);
+		triMeshes[i]->matname = MaterialName(i);
+	});
+
+	for (size_t i = 0; i < numMeshes; ++i)
+		AddMesh(meshes[i], triMeshes[i], _meshNodes[i]);
+}
+
+void SyntheticScene::Clear()
+{
+	SceneParser::Clear();
+	_meshNodes.clear();
+}
+
+std::vector<uint8_t> SyntheticScene::WriteFbx(uint32_t version, bool compress) const
+{
+	//ids: model 3i + 1, geometry 3i + 2, material m 3n + 1 + m for n meshes
+	const size_t numMeshes = NumMeshes();
+	const uint32_t numMaterials = (uint32_t)std::min<size_t>(_spec.numMaterials, numMeshes);
+	auto materialId = [&](size_t i) { return (int64_t)(3 * numMeshes + 1 + i % _spec.numMaterials); };
+
+	FbxWriter w(version, compress);
+	w.Begin("FBXHeaderExtension");
+	w.Begin("FBXVersion").Int((int32_t)version).End();
+	w.End();
+
+	w.Begin("Objects");
+	for (size_t i = 0; i < numMeshes; ++i)
+	{
+		const std::string name = "node_" + std::to_string(i);
+		std::unique_ptr<PolyMesh> pMesh(GenerateMesh(_spec.shape, MeshFaces(i), (uint32_t)i, nullptr));
+		w.Model((int64_t)(3 * i + 1), name, Vector3d((double)(i % 4), (double)(i / 4 % 4), 0.0));
+		w.Geometry((int64_t)(3 * i + 2), name, pMesh.get(), std::vector<int32_t>(1, 0));
+	}
+	for (uint32_t i = 0; i < numMaterials; ++i)
+		w.Material(materialId(i), MaterialName(i), MaterialColor(i));
+	w.End();
+
+	w.Begin("Connections");
+	for (size_t i = 0; i < numMeshes; ++i)
+	{
+		w.Connect((int64_t)(3 * i + 1), i == 0 ? 0 : (int64_t)(3 * ((i - 1) / 4) + 1));
+		w.Connect((int64_t)(3 * i + 2), (int64_t)(3 * i + 1));
+		w.Connect(materialId(i), (int64_t)(3 * i + 1));
+	}
+	w.End();
+	return w.Finish();
+}
+
+int SyntheticScene::ExportMaterials(const char* pFilename)
+{
+	ObjWriter writer(_options);
+	if (!writer.Open(pFilename, Materials.size() > 0))
+		return E_FAILOPENFILE;
+	if (!writer.Close(Materials))
+		return E_FAILOPENFILE;
+	return E_NOERROR;
+}
+
+size_t SyntheticScene::BeginStream()
+{
+	const size_t numMeshes = NumMeshes();
+	BuildNodes(numMeshes);
+	return numMeshes;
+}
+
+TriMesh* SyntheticScene::StreamMesh(size_t i)
+{
+	std::unique_ptr<PolyMesh> pMesh(GenerateMesh(_spec.shape, MeshFaces(i), (uint32_t)i, nullptr));
+	pMesh->name = _meshNodes[i]->_name;
+	TriMesh* pTriMesh = NewGeometry<TriMesh>(pMesh.get(), _geometryArena);
+	pTriMesh->matname = MaterialName(i);
+	return pTriMesh;
+}
+
+CompactMesh* SyntheticScene::StreamCompactMesh(size_t i)
+{
+	std::unique_ptr<PolyMesh> pMesh(GenerateMesh(_spec.shape, MeshFaces(i), (uint32_t)i, nullptr));
+	pMesh->name = _meshNodes[i]->_name;
+	CompactMesh* pCompact = new CompactMesh(pMesh.get());
+	pCompact->matname = MaterialName(i);
+	return pCompact;
+}
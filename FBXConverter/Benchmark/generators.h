@@ -0,0 +1,96 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//generators.h
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../Common/scene.h"
+
+//Procedural inputs for the benchmarks. Every generator is deterministic, so two runs
+//(or two commits) measure the same geometry.
+enum MeshShape
+{
+	SHAPE_GRID,		//regular grid of quads, shared vertices
+	SHAPE_MIXED,	//strip of triangles, quads and 5 to 8 sided polygons sharing an edge
+	SHAPE_FAN,		//disc polygons of FAN_SIDES corners, long fans when triangulated
+};
+
+const uint32_t FAN_SIDES = 1024;
+
+const char* ShapeName(MeshShape shape);
+
+//a polygon mesh of about the given number of faces with per-corner normals and uvs,
+//from the arena when given and from the heap otherwise; for SHAPE_FAN size counts the
+//triangles, so that sizes compare across shapes
+PolyMesh* GenerateMesh(MeshShape shape, uint32_t size, uint32_t seed, MeshArena* pArena);
+
+//many-small-mesh scene: a node tree (four children per node) holding one small mesh
+//per node and sharing a set of materials, standing in for an extracted FBX file
+struct SceneSpec
+{
+	MeshShape shape = SHAPE_GRID;
+	uint32_t faces = 0;				//total over all meshes
+	uint32_t facesPerMesh = 64;
+	uint32_t numMaterials = 1;
+};
+
+class SyntheticScene : public SceneParser
+{
+public:
+	explicit SyntheticScene(const SceneSpec& spec);
+
+	bool LoadScene(const char* pFilename) override;
+	void ExtractContent() override;
+	void Clear() override;
+
+	//only the material library, through the OBJ writer (obj header plus .mtl)
+	int ExportMaterials(const char* pFilename);
+
+	size_t NumMeshes() const;
+
+	//polygons and triangles of the extracted meshes
+	void CountGeometry(uint64_t& faces, uint64_t& triangles) const;
+
+	//the scene ExtractContent builds as a binary FBX file for the importer benchmarks: the
+	//same node tree and materials, a model and geometry per mesh; version 7400 writes 32 bit
+	//record headers and 7500 64 bit ones, arrays are deflated when compress is set
+	std::vector<uint8_t> WriteFbx(uint32_t version, bool compress) const;
+
+protected:
+	size_t BeginStream() override;
+	TriMesh* StreamMesh(size_t i) override;
+	CompactMesh* StreamCompactMesh(size_t i) override;
+
+private:
+	void BuildNodes(size_t numMeshes);
+	std::string MaterialName(size_t i) const;
+	uint32_t MeshFaces(size_t i) const;
+
+	SceneSpec _spec;
+	std::vector<MeshNode*> _meshNodes;	//node of mesh i
+};
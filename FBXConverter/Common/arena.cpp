@@ -0,0 +1,251 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "arena.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace
+{
+	const size_t BLOCK_ALIGNMENT = 64;
+
+	uint8_t* AlignedAlloc(size_t size)
+	{
+#ifdef _WIN32
+		return static_cast<uint8_t*>(_aligned_malloc(size, BLOCK_ALIGNMENT));
+#else
+		size = (size + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+		return static_cast<uint8_t*>(aligned_alloc(BLOCK_ALIGNMENT, size));
+#endif
+	}
+
+	void AlignedFree(void* p)
+	{
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+}
+
+namespace
+{
+	std::atomic<uint64_t> g_nextArenaId(1);
+
+	//lanes of the arenas the thread allocated from last, replaced round robin
+	struct LaneCache
+	{
+		static const int SIZE = 4;
+		uint64_t ids[SIZE] = {};
+		void* lanes[SIZE] = {};
+		int next = 0;
+	};
+	thread_local LaneCache t_lanes;
+}
+
+MeshArena::MeshArena(size_t blockSize)
+	:_blockSize(std::max<size_t>(blockSize, 4096)), _laneSize(std::min(size_t(LANE_SIZE), std::max<size_t>(blockSize, 4096) / 4)),
+	_id(g_nextArenaId++), _current(0), _offset(0), _nextDestructor(0)
+{
+}
+
+MeshArena::~MeshArena()
+{
+	Release();
+}
+
+uint8_t* MeshArena::NewBlock(size_t size)
+{
+	uint8_t* data = AlignedAlloc(size);
+	if (!data)
+		throw std::bad_alloc();
+	_stats.bytesReserved += size;
+	++_stats.blocks;
+	return data;
+}
+
+MeshArena::Lane& MeshArena::LocalLane()
+{
+	LaneCache& cache = t_lanes;
+	for (int i = 0; i < LaneCache::SIZE; ++i)
+		if (cache.ids[i] == _id)
+			return *static_cast<Lane*>(cache.lanes[i]);
+
+	//first allocation of the thread, or its cache entry was replaced
+	std::lock_guard<std::mutex> lock(_mutex);
+	const std::thread::id self = std::this_thread::get_id();
+	size_t i = std::find(_laneOwners.begin(), _laneOwners.end(), self) - _laneOwners.begin();
+	if (i == _lanes.size())
+	{
+		_lanes.emplace_back(new Lane());
+		_laneOwners.push_back(self);
+	}
+	cache.ids[cache.next] = _id;
+	cache.lanes[cache.next] = _lanes[i].get();
+	cache.next = (cache.next + 1) % LaneCache::SIZE;
+	return *_lanes[i];
+}
+
+void* MeshArena::Allocate(size_t bytes, size_t alignment)
+{
+	assert(alignment && (alignment & (alignment - 1)) == 0 && alignment <= BLOCK_ALIGNMENT);
+	bytes = std::max<size_t>(bytes, 1);
+	Lane& lane = LocalLane();
+	lane.allocations.fetch_add(1, std::memory_order_relaxed);
+
+	//up to a sixteenth of a lane from the lane, so a new lane wastes little of the old one
+	if (bytes <= _laneSize / 16)
+	{
+		uint8_t* start = (uint8_t*)(((uintptr_t)lane.pos + alignment - 1) & ~(uintptr_t)(alignment - 1));
+		if (!lane.pos || start + bytes > lane.end)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			lane.pos = static_cast<uint8_t*>(AllocateShared(_laneSize, BLOCK_ALIGNMENT, nullptr));
+			lane.end = lane.pos + _laneSize;
+			start = lane.pos;
+		}
+		lane.bytesUsed.fetch_add(start + bytes - lane.pos, std::memory_order_relaxed);
+		lane.pos = start + bytes;
+		return start;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	return AllocateShared(bytes, alignment, &lane);
+}
+
+void* MeshArena::AllocateShared(size_t bytes, size_t alignment, Lane* pLane)
+{
+	if (bytes > _blockSize / 2)
+	{
+		Block block = { NewBlock(bytes), bytes };
+		_large.push_back(block);
+		if (pLane)
+			pLane->bytesUsed.fetch_add(bytes, std::memory_order_relaxed);
+		return block.data;
+	}
+
+	size_t start = (_offset + alignment - 1) & ~(alignment - 1);
+	if (_current >= _blocks.size() || start + bytes > _blocks[_current].size)
+	{
+		//move on to the next kept block, or add one
+		if (_current < _blocks.size())
+			++_current;
+		if (_current == _blocks.size())
+		{
+			Block block = { NewBlock(_blockSize), _blockSize };
+			_blocks.push_back(block);
+		}
+		_offset = 0;
+		start = 0;
+	}
+	if (pLane)
+		pLane->bytesUsed.fetch_add(start + bytes - _offset, std::memory_order_relaxed);
+	_offset = start + bytes;
+	return _blocks[_current].data + start;
+}
+
+void MeshArena::AddDestructor(void* object, void (*destroy)(void*))
+{
+	Destructor* entry = static_cast<Destructor*>(Allocate(sizeof(Destructor), alignof(Destructor)));
+	Lane& lane = LocalLane();
+	entry->object = object;
+	entry->destroy = destroy;
+	entry->order = _nextDestructor.fetch_add(1, std::memory_order_relaxed);
+	entry->next = lane.destructors;
+	lane.destructors = entry;
+}
+
+void MeshArena::RunDestructors()
+{
+	//most recent first over all lanes; objects may refer to each other, so no lock is held
+	//while they are destroyed
+	std::vector<Destructor*> entries;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (std::unique_ptr<Lane>& lane : _lanes)
+		{
+			for (Destructor* entry = lane->destructors; entry; entry = entry->next)
+				entries.push_back(entry);
+			lane->destructors = nullptr;
+		}
+	}
+	std::sort(entries.begin(), entries.end(), [](const Destructor* a, const Destructor* b) { return a->order > b->order; });
+	for (Destructor* entry : entries)
+		entry->destroy(entry->object);
+}
+
+size_t MeshArena::BytesUsed() const
+{
+	size_t bytes = 0;
+	for (const std::unique_ptr<Lane>& lane : _lanes)
+		bytes += lane->bytesUsed.load(std::memory_order_relaxed);
+	return bytes;
+}
+
+void MeshArena::Reset()
+{
+	RunDestructors();
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const Block& block : _large)
+	{
+		AlignedFree(block.data);
+		_stats.bytesReserved -= block.size;
+		--_stats.blocks;
+	}
+	_large.clear();
+	_current = 0;
+	_offset = 0;
+	_stats.peakBytesUsed = std::max(_stats.peakBytesUsed, BytesUsed());
+	for (std::unique_ptr<Lane>& lane : _lanes)
+	{
+		lane->pos = lane->end = nullptr;
+		lane->allocations = 0;
+		lane->bytesUsed = 0;
+	}
+	++_stats.resets;
+}
+
+void MeshArena::Release()
+{
+	Reset();
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const Block& block : _blocks)
+		AlignedFree(block.data);
+	_blocks.clear();
+	_stats.bytesReserved = 0;
+	_stats.blocks = 0;
+}
+
+MeshArena::Stats MeshArena::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Stats stats = _stats;
+	for (const std::unique_ptr<Lane>& lane : _lanes)
+		stats.allocations += lane->allocations.load(std::memory_order_relaxed);
+	stats.bytesUsed = BytesUsed();
+	stats.peakBytesUsed = std::max(stats.peakBytesUsed, stats.bytesUsed);
+	return stats;
+}
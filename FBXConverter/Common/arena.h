@@ -0,0 +1,179 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//arena.h
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//Scene-scoped bump allocator. Buffers and objects of one scene are carved out of large
+//aligned blocks and released together by Reset(), which keeps the standard blocks for
+//the next scene. Allocation is thread safe, extraction workers share one arena: every
+//thread bumps through its own lane of a block without locking and takes the lock only to
+//get a new lane or for an allocation too large for one. Reset and Release must not run
+//concurrently with allocations.
+class MeshArena
+{
+public:
+	struct Stats
+	{
+		size_t allocations = 0;		//calls since the last Reset
+		size_t bytesUsed = 0;		//bytes handed out since the last Reset, padding included
+		size_t peakBytesUsed = 0;	//largest bytesUsed seen before any Reset
+		size_t bytesReserved = 0;	//bytes held in blocks right now
+		size_t blocks = 0;			//blocks held right now
+		size_t resets = 0;
+	};
+
+	static const size_t DEFAULT_BLOCK_SIZE = 4 << 20;
+	static const size_t LANE_SIZE = 256 << 10;	//at most, a quarter block for small blocks
+
+	explicit MeshArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+	~MeshArena();
+
+	void* Allocate(size_t bytes, size_t alignment = 64);
+
+	//n default-initialized elements, never destroyed individually
+	template <typename T>
+	T* AllocateArray(size_t n)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena arrays are never destroyed");
+		T* p = static_cast<T*>(Allocate(sizeof(T) * n, alignof(T) > 64 ? alignof(T) : 64));
+		for (size_t i = 0; i < n; ++i)
+			new (p + i) T;
+		return p;
+	}
+
+	//construct an object in the arena, its destructor runs on Reset/Release
+	template <typename T, typename... Args>
+	T* New(Args&&... args)
+	{
+		void* p = Allocate(sizeof(T), alignof(T));
+		T* object = new (p) T(std::forward<Args>(args)...);
+		if (!std::is_trivially_destructible<T>::value)
+			AddDestructor(object, [](void* o) { static_cast<T*>(o)->~T(); });
+		return object;
+	}
+
+	//run the destructors in reverse order, free the oversized blocks and rewind the rest
+	void Reset();
+
+	//run the destructors and free every block
+	void Release();
+
+	Stats GetStats() const;
+
+private:
+	MeshArena(const MeshArena&) = delete;
+	MeshArena& operator=(const MeshArena&) = delete;
+
+	struct Block
+	{
+		uint8_t* data;
+		size_t size;
+	};
+
+	struct Destructor
+	{
+		void* object;
+		void (*destroy)(void*);
+		Destructor* next;
+		uint64_t order;				//arena wide construction order
+	};
+
+	//part of a block one thread allocates from, counters written by that thread only
+	struct alignas(64) Lane
+	{
+		uint8_t* pos = nullptr;
+		uint8_t* end = nullptr;
+		Destructor* destructors = nullptr;	//most recent first
+		std::atomic<size_t> allocations{ 0 };
+		std::atomic<size_t> bytesUsed{ 0 };
+	};
+
+	Lane& LocalLane();
+	void* AllocateShared(size_t bytes, size_t alignment, Lane* pLane);	//under the lock, counted in pLane if set
+	void AddDestructor(void* object, void (*destroy)(void*));
+	void RunDestructors();
+	uint8_t* NewBlock(size_t size);
+	size_t BytesUsed() const;
+
+	mutable std::mutex _mutex;
+	const size_t _blockSize;
+	const size_t _laneSize;
+	const uint64_t _id;				//never reused, identifies the arena to the lane caches of the threads
+	std::vector<Block> _blocks;		//standard blocks, _current is being filled
+	std::vector<Block> _large;		//dedicated blocks of allocations above half a block
+	size_t _current;
+	size_t _offset;					//first free byte of the current block
+	std::vector<std::unique_ptr<Lane> > _lanes;
+	std::vector<std::thread::id> _laneOwners;
+	std::atomic<uint64_t> _nextDestructor;
+	Stats _stats;					//blocks, reservation, resets and the peak; the lanes count the rest
+};
+
+//Deleter of the mesh buffers: heap arrays are deleted, arena arrays are left to the arena.
+template <typename T>
+struct MeshArrayDeleter
+{
+	bool inArena = false;
+	void operator()(T* p) const
+	{
+		if (!inArena)
+			delete[] p;
+	}
+};
+
+template <typename T>
+using MeshArray = std::unique_ptr<T[], MeshArrayDeleter<T> >;
+
+//n elements from the arena, or from the heap when there is none
+template <typename T>
+MeshArray<T> MakeMeshArray(size_t n, MeshArena* pArena)
+{
+	if (!pArena)
+		return MeshArray<T>(new T[n]);
+	MeshArrayDeleter<T> deleter;
+	deleter.inArena = true;
+	return MeshArray<T>(pArena->AllocateArray<T>(n), deleter);
+}
+
+//elements owned elsewhere (e.g. a mapped file) that outlive the array, never deleted
+template <typename T>
+MeshArray<T> MeshArrayView(const T* p)
+{
+	MeshArrayDeleter<T> deleter;
+	deleter.inArena = true;
+	return MeshArray<T>(const_cast<T*>(p), deleter);
+}
@@ -0,0 +1,679 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//bvh.cpp
+
+#include "bvh.h"
+#include "parallel.h"
+#include "profile.h"
+#include "scene.h"
+#include "textwriter.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVH_SSE2
+#endif
+
+static_assert(sizeof(Vector3d) == 3 * sizeof(double), "ComputeBounds reads positions as packed doubles");
+static_assert(sizeof(BvhNode) == 32 && sizeof(BvhMeshRecord) == 64 && sizeof(BvhSceneNode) == 48 &&
+	sizeof(BvhFileHeader) == 96, "BVH file records are fixed size");
+
+void Bounds::Add(const Bounds& b)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		min[k] = std::min(min[k], b.min[k]);
+		max[k] = std::max(max[k], b.max[k]);
+	}
+}
+
+float Bounds::HalfArea() const
+{
+	if (Empty())
+		return 0.0f;
+	const float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+namespace
+{
+	const int NUM_BINS = 16;
+	const uint32_t MAX_LEAF_TRIS = 8;
+	const float TRAVERSAL_COST = 1.0f;		//relative to one triangle test
+	const size_t BOUNDS_GRAIN = 1 << 16;	//positions per ComputeBounds chunk
+	const size_t BIN_GRAIN = 1 << 15;		//triangles per binning chunk
+	const uint32_t SUBTREE_TRIS = 1 << 16;	//smaller ranges become independent subtrees
+	const size_t FILE_ALIGNMENT = 32;
+
+	//largest float <= v and smallest float >= v
+	inline float RoundDown(double v)
+	{
+		float f = (float)v;
+		return (double)f > v ? nextafterf(f, -FLT_MAX) : f;
+	}
+
+	inline float RoundUp(double v)
+	{
+		float f = (float)v;
+		return (double)f < v ? nextafterf(f, FLT_MAX) : f;
+	}
+
+	//min/max of n packed xyz doubles
+	void BoundsKernel(const double* p, size_t n, double lo[3], double hi[3])
+	{
+		size_t i = 0;
+#ifdef BVH_SSE2
+		if (n >= 2)
+		{
+			//two vertices are three registers: (x0 y0) (z0 x1) (y1 z1)
+			__m128d min0 = _mm_loadu_pd(p), min1 = _mm_loadu_pd(p + 2), min2 = _mm_loadu_pd(p + 4);
+			__m128d max0 = min0, max1 = min1, max2 = min2;
+			for (i = 2; i + 2 <= n; i += 2)
+			{
+				const double* q = p + i * 3;
+				const __m128d a = _mm_loadu_pd(q), b = _mm_loadu_pd(q + 2), c = _mm_loadu_pd(q + 4);
+				min0 = _mm_min_pd(min0, a); max0 = _mm_max_pd(max0, a);
+				min1 = _mm_min_pd(min1, b); max1 = _mm_max_pd(max1, b);
+				min2 = _mm_min_pd(min2, c); max2 = _mm_max_pd(max2, c);
+			}
+			double l[6], h[6];
+			_mm_storeu_pd(l, min0); _mm_storeu_pd(l + 2, min1); _mm_storeu_pd(l + 4, min2);
+			_mm_storeu_pd(h, max0); _mm_storeu_pd(h + 2, max1); _mm_storeu_pd(h + 4, max2);
+			for (int k = 0; k < 3; ++k)
+			{
+				lo[k] = std::min(lo[k], std::min(l[k], l[k + 3]));
+				hi[k] = std::max(hi[k], std::max(h[k], h[k + 3]));
+			}
+		}
+#endif
+		for (; i < n; ++i)
+			for (int k = 0; k < 3; ++k)
+			{
+				lo[k] = std::min(lo[k], p[i * 3 + k]);
+				hi[k] = std::max(hi[k], p[i * 3 + k]);
+			}
+	}
+
+	struct Bin
+	{
+		Bounds bounds;
+		uint32_t count = 0;
+	};
+
+	struct Split
+	{
+		int axis = -1;
+		int numBins = 0;		//one per triangle for small nodes, NUM_BINS at most
+		float scale = 0.0f;		//bins per unit along axis
+		int bin = 0;			//the left side takes bins 0..bin
+		float cost = FLT_MAX;	//SAH cost relative to the node's half area
+	};
+
+	//triangle bounds moved along with the triangle number, so binning and partitioning
+	//walk memory in order
+	struct PrimRef
+	{
+		uint32_t tri;
+		Bounds bounds;
+		float zero = 0.0f;		//fourth lane when max is loaded as four floats
+	};
+
+	struct Subtree
+	{
+		uint32_t node;
+		uint32_t begin, end;
+	};
+
+	class BvhBuilder
+	{
+	public:
+		explicit BvhBuilder(PrimRef* prims)
+			:_prims(prims)
+		{
+		}
+
+		//build [begin, end) of the triangle list below nodes[root]; ranges under
+		//SUBTREE_TRIS go to pSubtrees instead when given
+		void Build(std::vector<BvhNode>& nodes, uint32_t root, uint32_t begin, uint32_t end,
+			std::vector<Subtree>* pSubtrees);
+
+	private:
+		void RangeBounds(uint32_t begin, uint32_t end, Bounds& bounds, Bounds& centroids) const;
+		Split FindSplit(uint32_t begin, uint32_t end, const Bounds& centroids) const;
+
+		//twice the centroid of a triangle along an axis
+		static float Centroid(const PrimRef& prim, int axis) { return prim.bounds.min[axis] + prim.bounds.max[axis]; }
+
+		static int BinIndex(float c, float lo, float scale, int numBins)
+		{
+			int b = (int)((c - lo) * scale);
+			return std::min(std::max(b, 0), numBins - 1);
+		}
+
+		PrimRef* _prims;
+	};
+
+	void BvhBuilder::RangeBounds(uint32_t begin, uint32_t end, Bounds& bounds, Bounds& centroids) const
+	{
+		auto accumulate = [this](size_t first, size_t last, Bounds& b, Bounds& c) {
+			for (size_t i = first; i < last; ++i)
+			{
+				const Bounds& t = _prims[i].bounds;
+				b.Add(t);
+				for (int k = 0; k < 3; ++k)
+				{
+					const float m = t.min[k] + t.max[k];
+					c.min[k] = std::min(c.min[k], m);
+					c.max[k] = std::max(c.max[k], m);
+				}
+			}
+		};
+		const size_t numChunks = ParallelChunks(end - begin, BIN_GRAIN);
+		if (numChunks == 1)
+		{
+			accumulate(begin, end, bounds, centroids);
+			return;
+		}
+		std::vector<Bounds> chunkBounds(numChunks), chunkCentroids(numChunks);
+		ParallelForChunks(end - begin, BIN_GRAIN, [&](size_t chunk, size_t first, size_t last) {
+			accumulate(begin + first, begin + last, chunkBounds[chunk], chunkCentroids[chunk]);
+		});
+		for (size_t chunk = 0; chunk < numChunks; ++chunk)
+		{
+			bounds.Add(chunkBounds[chunk]);
+			centroids.Add(chunkCentroids[chunk]);
+		}
+	}
+
+	Split BvhBuilder::FindSplit(uint32_t begin, uint32_t end, const Bounds& centroids) const
+	{
+		//the bins of every axis are NUM_BINS apart, small nodes use the first few
+		const int numBins = (int)std::min<uint32_t>(NUM_BINS, end - begin);
+		float scale[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const float extent = centroids.max[k] - centroids.min[k];
+			scale[k] = extent > 0.0f ? numBins / extent : 0.0f;
+		}
+
+		//all three axes in one pass, per chunk bins merged afterwards
+		auto binRange = [&](size_t first, size_t last, Bin* bins) {
+#ifdef BVH_SSE2
+			//min and max as one register each, the fourth lane is ignored
+			__m128 binMin[3 * NUM_BINS], binMax[3 * NUM_BINS];
+			for (int k = 0; k < 3; ++k)
+				for (int b = k * NUM_BINS; b < k * NUM_BINS + numBins; ++b)
+				{
+					binMin[b] = _mm_set1_ps(FLT_MAX);
+					binMax[b] = _mm_set1_ps(-FLT_MAX);
+				}
+			const __m128 lo = _mm_setr_ps(centroids.min[0], centroids.min[1], centroids.min[2], 0.0f);
+			const __m128 binScale = _mm_setr_ps(scale[0], scale[1], scale[2], 0.0f);
+			for (size_t i = first; i < last; ++i)
+			{
+				const PrimRef& prim = _prims[i];
+				const __m128 pmin = _mm_loadu_ps(prim.bounds.min), pmax = _mm_loadu_ps(prim.bounds.max);
+				alignas(16) int32_t index[4];
+				_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(_mm_add_ps(pmin, pmax), lo), binScale)));
+				for (int k = 0; k < 3; ++k)
+				{
+					if (scale[k] == 0.0f)
+						continue;
+					const int b = k * NUM_BINS + std::min(std::max(index[k], 0), numBins - 1);
+					binMin[b] = _mm_min_ps(binMin[b], pmin);
+					binMax[b] = _mm_max_ps(binMax[b], pmax);
+					++bins[b].count;
+				}
+			}
+			for (int k = 0; k < 3; ++k)
+				for (int b = k * NUM_BINS; b < k * NUM_BINS + numBins && scale[k] != 0.0f; ++b)
+				{
+					alignas(16) float l[4], h[4];
+					_mm_store_ps(l, binMin[b]);
+					_mm_store_ps(h, binMax[b]);
+					memcpy(bins[b].bounds.min, l, sizeof(bins[b].bounds.min));
+					memcpy(bins[b].bounds.max, h, sizeof(bins[b].bounds.max));
+				}
+#else
+			for (size_t i = first; i < last; ++i)
+			{
+				const PrimRef& prim = _prims[i];
+				for (int k = 0; k < 3; ++k)
+				{
+					if (scale[k] == 0.0f)
+						continue;
+					Bin& bin = bins[k * NUM_BINS + BinIndex(Centroid(prim, k), centroids.min[k], scale[k], numBins)];
+					bin.bounds.Add(prim.bounds);
+					++bin.count;
+				}
+			}
+#endif
+		};
+		Bin localBins[3 * NUM_BINS];
+		const Bin* chunkBins = localBins;
+		const size_t numChunks = ParallelChunks(end - begin, BIN_GRAIN);
+		std::vector<Bin> allBins;
+		if (numChunks == 1)
+			binRange(begin, end, localBins);
+		else
+		{
+			allBins.resize(numChunks * 3 * NUM_BINS);
+			ParallelForChunks(end - begin, BIN_GRAIN, [&](size_t chunk, size_t first, size_t last) {
+				binRange(begin + first, begin + last, &allBins[chunk * 3 * NUM_BINS]);
+			});
+			for (size_t chunk = 1; chunk < numChunks; ++chunk)
+				for (int b = 0; b < 3 * NUM_BINS; ++b)
+				{
+					allBins[b].bounds.Add(allBins[chunk * 3 * NUM_BINS + b].bounds);
+					allBins[b].count += allBins[chunk * 3 * NUM_BINS + b].count;
+				}
+			chunkBins = allBins.data();
+		}
+
+		Split best;
+		for (int k = 0; k < 3; ++k)
+		{
+			if (scale[k] == 0.0f)
+				continue;
+			const Bin* bins = &chunkBins[k * NUM_BINS];
+			//right sides from the top, then sweep the left side up
+			float rightCost[NUM_BINS];
+			Bounds right;
+			uint32_t rightCount = 0;
+			for (int b = numBins - 1; b > 0; --b)
+			{
+				right.Add(bins[b].bounds);
+				rightCount += bins[b].count;
+				rightCost[b - 1] = rightCount * right.HalfArea();
+			}
+			Bounds left;
+			uint32_t leftCount = 0;
+			for (int b = 0; b < numBins - 1; ++b)
+			{
+				left.Add(bins[b].bounds);
+				leftCount += bins[b].count;
+				if (leftCount == 0 || leftCount == end - begin)
+					continue;
+				const float cost = leftCount * left.HalfArea() + rightCost[b];
+				if (cost < best.cost)
+				{
+					best.axis = k;
+					best.numBins = numBins;
+					best.scale = scale[k];
+					best.bin = b;
+					best.cost = cost;
+				}
+			}
+		}
+		return best;
+	}
+
+	void BvhBuilder::Build(std::vector<BvhNode>& nodes, uint32_t root, uint32_t begin, uint32_t end,
+		std::vector<Subtree>* pSubtrees)
+	{
+		std::vector<Subtree> stack(1, Subtree{ root, begin, end });
+		while (!stack.empty())
+		{
+			const Subtree task = stack.back();
+			stack.pop_back();
+			const uint32_t count = task.end - task.begin;
+			Bounds bounds, centroids;
+			RangeBounds(task.begin, task.end, bounds, centroids);
+			BvhNode& node = nodes[task.node];
+			memcpy(node.min, bounds.min, sizeof(node.min));
+			memcpy(node.max, bounds.max, sizeof(node.max));
+			node.offset = task.begin;
+			node.count = count;
+			if (count <= 1)
+				continue;
+
+			uint32_t mid;
+			const Split split = FindSplit(task.begin, task.end, centroids);
+			if (split.axis >= 0)
+			{
+				const float area = bounds.HalfArea();
+				if (count <= MAX_LEAF_TRIS && (area <= 0.0f || TRAVERSAL_COST + split.cost / area >= count))
+					continue;
+				const int axis = split.axis;
+				const float lo = centroids.min[axis];
+				mid = (uint32_t)(std::partition(_prims + task.begin, _prims + task.end, [&](const PrimRef& prim) {
+					return BinIndex(Centroid(prim, axis), lo, split.scale, split.numBins) <= split.bin;
+				}) - _prims);
+			}
+			else if (count <= MAX_LEAF_TRIS)
+				continue;
+			else
+				mid = task.begin + count / 2;	//every centroid in one point, any split will do
+
+			const uint32_t children = (uint32_t)nodes.size();
+			nodes.resize(nodes.size() + 2);
+			nodes[task.node].offset = children;
+			nodes[task.node].count = 0;
+			const Subtree left = { children, task.begin, mid }, right = { children + 1, mid, task.end };
+			for (const Subtree& child : { right, left })
+			{
+				if (pSubtrees && child.end - child.begin < SUBTREE_TRIS)
+					pSubtrees->push_back(child);
+				else
+					stack.push_back(child);
+			}
+		}
+	}
+}
+
+Bounds ComputeBounds(const Vector3d* p, size_t n)
+{
+	Bounds bounds;
+	if (n == 0)
+		return bounds;
+	const size_t numChunks = ParallelChunks(n, BOUNDS_GRAIN);
+	std::vector<double> chunkMin(numChunks * 3, HUGE_VAL), chunkMax(numChunks * 3, -HUGE_VAL);
+	ParallelForChunks(n, BOUNDS_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+		BoundsKernel(p[begin].data(), end - begin, &chunkMin[chunk * 3], &chunkMax[chunk * 3]);
+	});
+	for (int k = 0; k < 3; ++k)
+	{
+		double lo = HUGE_VAL, hi = -HUGE_VAL;
+		for (size_t chunk = 0; chunk < numChunks; ++chunk)
+		{
+			lo = std::min(lo, chunkMin[chunk * 3 + k]);
+			hi = std::max(hi, chunkMax[chunk * 3 + k]);
+		}
+		bounds.min[k] = RoundDown(lo);
+		bounds.max[k] = RoundUp(hi);
+	}
+	return bounds;
+}
+
+void BuildBvh(const TriMesh* m, Bvh& bvh)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_BVH, "BuildBvh", &m->name);
+	bvh.nodes.clear();
+	bvh.triangles.resize(m->numTris);
+	if (m->numTris == 0)
+		return;
+
+	std::vector<PrimRef> prims(m->numTris);
+	ParallelFor(m->numTris, BIN_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t)
+		{
+			const Vector3d& a = m->P[m->triIndex[t * 3]];
+			const Vector3d& b = m->P[m->triIndex[t * 3 + 1]];
+			const Vector3d& c = m->P[m->triIndex[t * 3 + 2]];
+			for (int k = 0; k < 3; ++k)
+			{
+				prims[t].bounds.min[k] = RoundDown(std::min(std::min(a[k], b[k]), c[k]));
+				prims[t].bounds.max[k] = RoundUp(std::max(std::max(a[k], b[k]), c[k]));
+			}
+			prims[t].tri = (uint32_t)t;
+		}
+	});
+
+	BvhBuilder builder(prims.data());
+	bvh.nodes.resize(1);
+	//top levels with parallel binning, then the subtrees one per thread
+	std::vector<Subtree> subtrees;
+	builder.Build(bvh.nodes, 0, 0, m->numTris, m->numTris < SUBTREE_TRIS ? nullptr : &subtrees);
+	std::vector<std::vector<BvhNode> > built(subtrees.size());
+	ParallelForEach(subtrees.size(), [&](size_t i) {
+		built[i].resize(1);
+		builder.Build(built[i], 0, subtrees[i].begin, subtrees[i].end, nullptr);
+	});
+	//a subtree's root takes the place reserved for it, the rest is appended
+	for (size_t i = 0; i < subtrees.size(); ++i)
+	{
+		const uint32_t base = (uint32_t)bvh.nodes.size() - 1;
+		for (BvhNode& node : built[i])
+			if (node.count == 0)
+				node.offset += base;
+		bvh.nodes[subtrees[i].node] = built[i][0];
+		bvh.nodes.insert(bvh.nodes.end(), built[i].begin() + 1, built[i].end());
+	}
+	ParallelFor(m->numTris, BIN_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			bvh.triangles[i] = prims[i].tri;
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//.bvh file
+
+namespace
+{
+	inline uint64_t Align(uint64_t offset)
+	{
+		return (offset + FILE_ALIGNMENT - 1) & ~(uint64_t)(FILE_ALIGNMENT - 1);
+	}
+
+	//the 8 corners of b through a row-vector transform
+	Bounds TransformBounds(const Bounds& b, const Eigen::Matrix4d& m)
+	{
+		Bounds result;
+		if (b.Empty())
+			return result;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const Eigen::RowVector4d p(corner & 1 ? b.max[0] : b.min[0], corner & 2 ? b.max[1] : b.min[1],
+				corner & 4 ? b.max[2] : b.min[2], 1.0);
+			const Eigen::RowVector4d q = p * m;
+			for (int k = 0; k < 3; ++k)
+			{
+				result.min[k] = std::min(result.min[k], RoundDown(q[k]));
+				result.max[k] = std::max(result.max[k], RoundUp(q[k]));
+			}
+		}
+		return result;
+	}
+
+	struct SceneTables
+	{
+		std::vector<BvhSceneNode> nodes;
+		std::vector<uint32_t> meshRefs;
+		std::string names;
+	};
+
+	uint32_t AddName(std::string& names, const std::string& name)
+	{
+		const uint32_t offset = (uint32_t)names.size();
+		names += name;
+		return offset;
+	}
+
+	//depth-first, returns the world bounds of the subtree
+	Bounds AddSceneNode(SceneTables& tables, const MeshNode* pNode, uint32_t parent, const Eigen::Matrix4d& parentWorld,
+		const std::map<const TriMesh*, uint32_t>& meshIndex, const std::vector<BvhMeshInput>& meshes)
+	{
+		const Eigen::Matrix4d world = pNode->_transform * parentWorld;
+		const uint32_t self = (uint32_t)tables.nodes.size();
+		BvhSceneNode record = {};
+		record.parent = parent;
+		record.nameOffset = AddName(tables.names, pNode->_name);
+		record.nameLength = (uint32_t)pNode->_name.size();
+		record.firstMeshRef = (uint32_t)tables.meshRefs.size();
+		Bounds bounds;
+		for (const TriMesh* m : pNode->_TriMeshes)
+		{
+			auto found = meshIndex.find(m);
+			if (found == meshIndex.end())
+				continue;
+			tables.meshRefs.push_back(found->second);
+			bounds.Add(TransformBounds(meshes[found->second].bounds, world));
+		}
+		record.numMeshRefs = (uint32_t)tables.meshRefs.size() - record.firstMeshRef;
+		tables.nodes.push_back(record);
+
+		for (const MeshNode* pChild : pNode->_children)
+			bounds.Add(AddSceneNode(tables, pChild, self, world, meshIndex, meshes));
+		memcpy(tables.nodes[self].min, bounds.min, sizeof(bounds.min));
+		memcpy(tables.nodes[self].max, bounds.max, sizeof(bounds.max));
+		return bounds;
+	}
+
+	bool WritePadded(OutputFile& file, const void* data, size_t bytes, uint64_t& offset)
+	{
+		static const uint8_t zeros[FILE_ALIGNMENT] = {};
+		if (!file.Write(data, bytes))
+			return false;
+		offset += bytes;
+		const size_t pad = (size_t)(Align(offset) - offset);
+		offset += pad;
+		return file.Write(zeros, pad);
+	}
+}
+
+bool WriteBvhFile(const char* pFilename, const std::vector<BvhMeshInput>& meshes, const std::vector<MeshNode*>& roots)
+{
+	SceneTables tables;
+	std::map<const TriMesh*, uint32_t> meshIndex;
+	for (size_t i = 0; i < meshes.size(); ++i)
+		meshIndex.emplace(meshes[i].mesh, (uint32_t)i);
+	for (const MeshNode* pRoot : roots)
+		AddSceneNode(tables, pRoot, UINT32_MAX, Eigen::Matrix4d::Identity(), meshIndex, meshes);
+
+	//every offset follows from the counts
+	BvhFileHeader header = {};
+	memcpy(header.magic, "FBXCBVH", 8);
+	header.version = BVH_FILE_VERSION;
+	header.numMeshes = (uint32_t)meshes.size();
+	header.numSceneNodes = (uint32_t)tables.nodes.size();
+	header.numMeshRefs = (uint32_t)tables.meshRefs.size();
+	header.meshesOffset = Align(sizeof(BvhFileHeader));
+	header.sceneNodesOffset = Align(header.meshesOffset + meshes.size() * sizeof(BvhMeshRecord));
+	header.meshRefsOffset = Align(header.sceneNodesOffset + tables.nodes.size() * sizeof(BvhSceneNode));
+	uint64_t offset = Align(header.meshRefsOffset + tables.meshRefs.size() * sizeof(uint32_t));
+	std::vector<BvhMeshRecord> records(meshes.size());
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		BvhMeshRecord& r = records[i];
+		const Bvh& bvh = *meshes[i].bvh;
+		r.numNodes = (uint32_t)bvh.nodes.size();
+		r.numTris = (uint32_t)bvh.triangles.size();
+		r.nodesOffset = offset;
+		offset = Align(offset + bvh.nodes.size() * sizeof(BvhNode));
+		r.trianglesOffset = offset;
+		offset = Align(offset + bvh.triangles.size() * sizeof(uint32_t));
+		r.nameOffset = AddName(tables.names, meshes[i].mesh->name);
+		r.nameLength = (uint32_t)meshes[i].mesh->name.size();
+		memcpy(r.min, meshes[i].bounds.min, sizeof(r.min));
+		memcpy(r.max, meshes[i].bounds.max, sizeof(r.max));
+	}
+	header.namesOffset = offset;
+	header.fileSize = Align(offset + tables.names.size());
+
+	OutputFile file;
+	if (!file.Open(pFilename))
+		return false;
+	offset = 0;
+	bool ok = WritePadded(file, &header, sizeof(header), offset) &&
+		WritePadded(file, records.data(), records.size() * sizeof(BvhMeshRecord), offset) &&
+		WritePadded(file, tables.nodes.data(), tables.nodes.size() * sizeof(BvhSceneNode), offset) &&
+		WritePadded(file, tables.meshRefs.data(), tables.meshRefs.size() * sizeof(uint32_t), offset);
+	for (size_t i = 0; i < meshes.size() && ok; ++i)
+	{
+		const Bvh& bvh = *meshes[i].bvh;
+		ok = WritePadded(file, bvh.nodes.data(), bvh.nodes.size() * sizeof(BvhNode), offset) &&
+			WritePadded(file, bvh.triangles.data(), bvh.triangles.size() * sizeof(uint32_t), offset);
+	}
+	ok = ok && WritePadded(file, tables.names.data(), tables.names.size(), offset);
+	ok = file.Close() && ok && offset == header.fileSize;
+	if (ok)
+		PROFILE_COUNT(COUNTER_BYTES_WRITTEN, offset);
+	return ok;
+}
+
+static bool InFile(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize)
+{
+	return offset % FILE_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / size;
+}
+
+bool BvhFile::Open(const char* pFilename)
+{
+	if (!_file.Open(pFilename))
+		return false;
+	const uint64_t fileSize = _file.Size();
+	const BvhFileHeader* h = Header();
+	bool ok = fileSize >= sizeof(BvhFileHeader) && memcmp(h->magic, "FBXCBVH", 8) == 0 &&
+		h->version == BVH_FILE_VERSION && h->fileSize == fileSize &&
+		InFile(h->meshesOffset, h->numMeshes, sizeof(BvhMeshRecord), fileSize) &&
+		InFile(h->sceneNodesOffset, h->numSceneNodes, sizeof(BvhSceneNode), fileSize) &&
+		InFile(h->meshRefsOffset, h->numMeshRefs, sizeof(uint32_t), fileSize) &&
+		InFile(h->namesOffset, 0, 1, fileSize);
+	const uint64_t namesSize = ok ? fileSize - h->namesOffset : 0;
+	for (uint32_t i = 0; ok && i < h->numMeshes; ++i)
+	{
+		const BvhMeshRecord& r = Mesh(i);
+		ok = InFile(r.nodesOffset, r.numNodes, sizeof(BvhNode), fileSize) &&
+			InFile(r.trianglesOffset, r.numTris, sizeof(uint32_t), fileSize) &&
+			(uint64_t)r.nameOffset + r.nameLength <= namesSize;
+	}
+	for (uint32_t i = 0; ok && i < h->numSceneNodes; ++i)
+	{
+		const BvhSceneNode& n = SceneNode(i);
+		ok = (uint64_t)n.firstMeshRef + n.numMeshRefs <= h->numMeshRefs &&
+			(uint64_t)n.nameOffset + n.nameLength <= namesSize;
+	}
+	if (!ok)
+		_file.Close();
+	return ok;
+}
+
+const BvhMeshRecord& BvhFile::Mesh(uint32_t i) const
+{
+	return ((const BvhMeshRecord*)(_file.Data() + Header()->meshesOffset))[i];
+}
+
+const BvhNode* BvhFile::Nodes(uint32_t mesh) const
+{
+	return (const BvhNode*)(_file.Data() + Mesh(mesh).nodesOffset);
+}
+
+const uint32_t* BvhFile::Triangles(uint32_t mesh) const
+{
+	return (const uint32_t*)(_file.Data() + Mesh(mesh).trianglesOffset);
+}
+
+std::string BvhFile::MeshName(uint32_t mesh) const
+{
+	const BvhMeshRecord& r = Mesh(mesh);
+	return std::string((const char*)_file.Data() + Header()->namesOffset + r.nameOffset, r.nameLength);
+}
+
+const BvhSceneNode& BvhFile::SceneNode(uint32_t i) const
+{
+	return ((const BvhSceneNode*)(_file.Data() + Header()->sceneNodesOffset))[i];
+}
+
+const uint32_t* BvhFile::MeshRefs() const
+{
+	return (const uint32_t*)(_file.Data() + Header()->meshRefsOffset);
+}
+
+std::string BvhFile::SceneNodeName(uint32_t i) const
+{
+	const BvhSceneNode& n = SceneNode(i);
+	return std::string((const char*)_file.Data() + Header()->namesOffset + n.nameOffset, n.nameLength);
+}
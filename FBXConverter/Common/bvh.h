@@ -0,0 +1,162 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//bvh.h
+
+#pragma once
+
+#include <float.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+#include "polymesh.h"
+
+class MeshNode;
+
+//axis aligned box, empty while min > max
+struct Bounds
+{
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	bool Empty() const { return min[0] > max[0]; }
+	void Add(const Bounds& b);
+	float HalfArea() const;	//half the surface area, 0 when empty
+};
+
+//bounds of n positions: SSE2 min/max (two vertices per step) in chunks on all cores,
+//rounded outward to float so the box contains every double position
+Bounds ComputeBounds(const Vector3d* p, size_t n);
+
+//32 bytes, the root at 0. An inner node (count 0) has its two children at offset and
+//offset + 1; a leaf holds the count triangles at offset in the triangle list.
+struct BvhNode
+{
+	float min[3];
+	uint32_t offset;
+	float max[3];
+	uint32_t count;
+};
+
+struct Bvh
+{
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> triangles;	//TriMesh triangle numbers in leaf order
+};
+
+//Binned SAH build over the triangles of m: 16 bins per axis on the centroid bounds,
+//leaves of at most 8 triangles where splitting does not pay off. Triangle bounds and
+//the binning of large nodes run in parallel chunks; below 64K triangles the subtrees
+//are built one per thread and appended.
+void BuildBvh(const TriMesh* m, Bvh& bvh);
+
+//The .bvh file next to a converted scene, little endian, every section 32 byte aligned
+//so a mapped file hands out the arrays in place:
+//
+//    BvhFileHeader
+//    BvhMeshRecord[numMeshes]        bounds and BVH of each exported mesh, in export order
+//    BvhSceneNode[numSceneNodes]     the node tree depth-first, subtree bounds in world space
+//    uint32_t[numMeshRefs]           meshes of the scene nodes
+//    per mesh: BvhNode[], uint32_t[] triangle list
+//    names, not terminated
+//
+//Triangle numbers refer to the triangles of a mesh as extracted, before --optimize
+//reorders them.
+const uint32_t BVH_FILE_VERSION = 1;
+
+struct BvhFileHeader
+{
+	char magic[8];				//"FBXCBVH" and 0
+	uint32_t version;
+	uint32_t numMeshes;
+	uint32_t numSceneNodes;
+	uint32_t numMeshRefs;
+	uint64_t meshesOffset;
+	uint64_t sceneNodesOffset;
+	uint64_t meshRefsOffset;
+	uint64_t namesOffset;
+	uint64_t fileSize;
+	uint64_t reserved[4];
+};
+
+struct BvhMeshRecord
+{
+	uint64_t nodesOffset;
+	uint64_t trianglesOffset;
+	uint32_t numNodes;
+	uint32_t numTris;
+	uint32_t nameOffset;		//from namesOffset
+	uint32_t nameLength;
+	float min[3];
+	float max[3];
+	uint64_t reserved;
+};
+
+struct BvhSceneNode
+{
+	uint32_t parent;			//UINT32_MAX for a root
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t firstMeshRef;
+	uint32_t numMeshRefs;
+	uint32_t reserved;
+	float min[3];				//world space bounds of the node's meshes and its children
+	float max[3];
+};
+
+//what WriteBvhFile takes per mesh
+struct BvhMeshInput
+{
+	const TriMesh* mesh;
+	Bounds bounds;
+	const Bvh* bvh;
+};
+
+//write meshes and the node tree under roots; false if the file cannot be written
+bool WriteBvhFile(const char* pFilename, const std::vector<BvhMeshInput>& meshes,
+	const std::vector<MeshNode*>& roots);
+
+//Read-only view of a .bvh file, mapped and checked once in Open
+class BvhFile
+{
+public:
+	bool Open(const char* pFilename);
+
+	uint32_t NumMeshes() const { return Header()->numMeshes; }
+	const BvhMeshRecord& Mesh(uint32_t i) const;
+	const BvhNode* Nodes(uint32_t mesh) const;
+	const uint32_t* Triangles(uint32_t mesh) const;
+	std::string MeshName(uint32_t mesh) const;
+
+	uint32_t NumSceneNodes() const { return Header()->numSceneNodes; }
+	const BvhSceneNode& SceneNode(uint32_t i) const;
+	const uint32_t* MeshRefs() const;
+	std::string SceneNodeName(uint32_t i) const;
+
+private:
+	const BvhFileHeader* Header() const { return (const BvhFileHeader*)_file.Data(); }
+
+	MappedFile _file;
+};
@@ -0,0 +1,275 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//compactmesh.cpp
+
+#include "compactmesh.h"
+#include "profile.h"
+#include <algorithm>
+
+//triangles of the fan of an n-gon, none for degenerate polygons (as in the TriMesh constructor)
+static uint32_t FaceTriangles(uint32_t n)
+{
+	return n > 2 ? n - 2 : 0;
+}
+
+void AttributeStream::Encode(const double* src, size_t srcStride, uint32_t n, int numComponents, AttributeFormat fmt,
+	const uint32_t* indices)
+{
+	Allocate(n, numComponents, fmt);
+	for (int c = 0; c < components; ++c)
+	{
+		if (format == FORMAT_UNORM16)
+		{
+			double lo = 0.0, hi = 0.0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				double v = src[(indices ? indices[i] : i) * srcStride + c];
+				lo = i == 0 ? v : std::min(lo, v);
+				hi = i == 0 ? v : std::max(hi, v);
+			}
+			offset[c] = (float)lo;
+			scale[c] = hi > lo ? (float)((hi - lo) / 65535.0) : 1.0f;
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			double v = src[(indices ? indices[i] : i) * srcStride + c];
+			switch (format)
+			{
+			case FORMAT_FLOAT32:
+				((float*)streams[c].get())[i] = (float)v;
+				break;
+			case FORMAT_HALF:
+				((uint16_t*)streams[c].get())[i] = FloatToHalf((float)v);
+				break;
+			case FORMAT_UNORM16:
+			{
+				double q = (v - offset[c]) / scale[c] + 0.5;
+				((uint16_t*)streams[c].get())[i] = (uint16_t)std::min(std::max(q, 0.0), 65535.0);
+			}
+			break;
+			}
+		}
+	}
+}
+
+void AttributeStream::Gather(const uint32_t* source)
+{
+	const size_t size = ElementSize();
+	std::unique_ptr<uint8_t[]> old(new uint8_t[count * size]);
+	for (int c = 0; c < components; ++c)
+	{
+		uint8_t* data = streams[c].get();
+		memcpy(old.get(), data, count * size);
+		for (uint32_t i = 0; i < count; ++i)
+			memcpy(data + i * size, old.get() + source[i] * size, size);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+CompactMesh::CompactMesh(const PolyMesh* pMesh, AttributeFormat positionFormat,
+	AttributeFormat attributeFormat, bool cornerAttributes)
+	:numVert(0), numTris(0), numUV(0)
+{
+	name = pMesh->name;
+	PROFILE_SCOPE_DETAIL(STAGE_TRIANGULATE, "CompactMesh", &name);
+	const uint32_t nfaces = pMesh->nFaces;
+	const uint32_t* faceIndices = pMesh->FaceIndices.get();
+	const uint32_t* vertsIndex = pMesh->VertsIndices.get();
+	const uint32_t* uvIndices = pMesh->UVIndices.get();
+
+	size_t numCorners = 0;
+	for (uint32_t i = 0; i < nfaces; ++i)
+	{
+		numTris += FaceTriangles(faceIndices[i]);
+		numCorners += faceIndices[i];
+	}
+	//nothing to read, the attribute arrays of an empty PolyMesh may not exist
+	if (numCorners == 0)
+		return;
+
+	uint32_t maxVertIndex = 0, maxUVIndex = 0;
+	for (size_t k = 0; k < numCorners; ++k)
+	{
+		maxVertIndex = std::max(maxVertIndex, vertsIndex[k]);
+		maxUVIndex = std::max(maxUVIndex, uvIndices[k]);
+	}
+	numVert = maxVertIndex + 1;
+	numUV = maxUVIndex + 1;
+
+	//fan triangulation, remembering the polygon corner behind each triangle corner
+	const size_t numTriCorners = (size_t)numTris * 3;
+	triIndex = std::unique_ptr<uint32_t[]>(new uint32_t[numTriCorners]);
+	UVIndices = std::unique_ptr<uint32_t[]>(new uint32_t[numTriCorners]);
+	std::unique_ptr<uint32_t[]> cornerOf(new uint32_t[numTriCorners]);
+	for (uint32_t i = 0, k = 0, l = 0; i < nfaces; ++i)
+	{
+		for (uint32_t j = 0; j < FaceTriangles(faceIndices[i]); ++j, l += 3)
+		{
+			cornerOf[l] = k;
+			cornerOf[l + 1] = k + j + 1;
+			cornerOf[l + 2] = k + j + 2;
+		}
+		k += faceIndices[i];
+	}
+	for (size_t l = 0; l < numTriCorners; ++l)
+	{
+		triIndex[l] = vertsIndex[cornerOf[l]];
+		UVIndices[l] = uvIndices[cornerOf[l]];
+	}
+
+	//last writer per vertex / uv, unreferenced entries read corner 0 like an empty TriMesh slot
+	std::vector<uint32_t> vertexCorner(numVert, 0), uvCorner(numUV, 0);
+	for (size_t l = 0; l < numTriCorners; ++l)
+	{
+		vertexCorner[triIndex[l]] = cornerOf[l];
+		uvCorner[UVIndices[l]] = cornerOf[l];
+	}
+
+	const double* normals = pMesh->Normals[0].data();
+	const double* uvs = pMesh->UVs[0].data();
+	P.Encode(pMesh->Verts[0].data(), 3, numVert, 3, positionFormat);
+	PN.Encode(normals, 3, numVert, 3, attributeFormat, vertexCorner.data());
+	UV.Encode(uvs, 2, numUV, 2, attributeFormat, uvCorner.data());
+	if (cornerAttributes)
+	{
+		N.Encode(normals, 3, (uint32_t)numTriCorners, 3, attributeFormat, cornerOf.get());
+		T.Encode(uvs, 2, (uint32_t)numTriCorners, 2, attributeFormat, cornerOf.get());
+	}
+}
+
+CompactMesh::CompactMesh(const TriMesh* pTriMesh, AttributeFormat positionFormat,
+	AttributeFormat attributeFormat, bool cornerAttributes)
+	:numVert(pTriMesh->numVert), numTris(pTriMesh->numTris), numUV(pTriMesh->numUV)
+{
+	name = pTriMesh->name;
+	matname = pTriMesh->matname;
+	subMeshes = pTriMesh->subMeshes;
+	PROFILE_SCOPE_DETAIL(STAGE_TRIANGULATE, "CompactMesh", &name);
+	const size_t numTriCorners = (size_t)numTris * 3;
+	triIndex = std::unique_ptr<uint32_t[]>(new uint32_t[numTriCorners]);
+	UVIndices = std::unique_ptr<uint32_t[]>(new uint32_t[numTriCorners]);
+	if (numTriCorners > 0)
+	{
+		std::copy_n(pTriMesh->triIndex.get(), numTriCorners, triIndex.get());
+		std::copy_n(pTriMesh->UVIndices.get(), numTriCorners, UVIndices.get());
+	}
+	if (numVert > 0)
+	{
+		P.Encode(pTriMesh->P[0].data(), 3, numVert, 3, positionFormat);
+		PN.Encode(pTriMesh->PN[0].data(), 3, numVert, 3, attributeFormat);
+	}
+	if (numUV > 0)
+		UV.Encode(pTriMesh->UV[0].data(), 2, numUV, 2, attributeFormat);
+	if (cornerAttributes && numTriCorners > 0)
+	{
+		N.Encode(pTriMesh->N[0].data(), 3, (uint32_t)numTriCorners, 3, attributeFormat);
+		T.Encode(pTriMesh->T[0].data(), 2, (uint32_t)numTriCorners, 2, attributeFormat);
+	}
+}
+
+void CompactMesh::SplitByMaterial(const PolyMesh* pMesh, const int* faceMaterial, size_t numIds,
+	const std::vector<std::string>& materialNames)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_MATERIALS, "SplitByMaterial", &name);
+	const uint32_t nfaces = pMesh->nFaces;
+	const uint32_t* faceIndices = pMesh->FaceIndices.get();
+
+	//one group per distinct material name, polygons without a valid id share the unnamed group
+	const size_t numNames = materialNames.size();
+	std::vector<uint32_t> idGroup(numNames + 1);
+	std::vector<std::string> groupNames;
+	std::map<std::string, uint32_t> nameGroup;
+	for (size_t id = 0; id <= numNames; ++id)
+	{
+		const std::string& groupName = id < numNames ? materialNames[id] : std::string();
+		auto inserted = nameGroup.emplace(groupName, (uint32_t)groupNames.size());
+		if (inserted.second)
+			groupNames.push_back(groupName);
+		idGroup[id] = inserted.first->second;
+	}
+	auto group = [&](uint32_t face) {
+		const int id = face < numIds ? faceMaterial[face] : -1;
+		return idGroup[id >= 0 && (size_t)id < numNames ? id : numNames];
+	};
+
+	std::vector<uint32_t> groupTris(groupNames.size(), 0);
+	for (uint32_t i = 0; i < nfaces; ++i)
+		groupTris[group(i)] += FaceTriangles(faceIndices[i]);
+
+	subMeshes.clear();
+	std::vector<uint32_t> cursor(groupNames.size(), 0);
+	for (uint32_t g = 0, first = 0; g < groupNames.size(); ++g)
+	{
+		cursor[g] = first;
+		if (groupTris[g] == 0)
+			continue;
+		SubMesh sub;
+		sub.matname = groupNames[g];
+		sub.firstTri = first;
+		sub.numTris = groupTris[g];
+		subMeshes.push_back(sub);
+		first += groupTris[g];
+	}
+	if (subMeshes.size() <= 1)
+	{
+		if (!subMeshes.empty())
+			matname = subMeshes[0].matname;
+		subMeshes.clear();
+		return;
+	}
+	matname = subMeshes[0].matname;
+
+	//source corner of every corner in the grouped order, stable within a group
+	const size_t numTriCorners = (size_t)numTris * 3;
+	std::unique_ptr<uint32_t[]> source(new uint32_t[numTriCorners]);
+	bool grouped = true;
+	for (uint32_t i = 0, from = 0; i < nfaces; ++i)
+	{
+		const uint32_t tris = FaceTriangles(faceIndices[i]);
+		uint32_t& target = cursor[group(i)];
+		grouped = grouped && target == from;
+		for (uint32_t l = 0; l < tris * 3; ++l)
+			source[(size_t)target * 3 + l] = from * 3 + l;
+		target += tris;
+		from += tris;
+	}
+	if (grouped)
+		return;
+
+	auto gather = [&](std::unique_ptr<uint32_t[]>& data) {
+		std::unique_ptr<uint32_t[]> old(new uint32_t[numTriCorners]);
+		std::copy_n(data.get(), numTriCorners, old.get());
+		for (size_t l = 0; l < numTriCorners; ++l)
+			data[l] = old[source[l]];
+	};
+	gather(triIndex);
+	gather(UVIndices);
+	if (!N.Empty())
+		N.Gather(source.get());
+	if (!T.Empty())
+		T.Gather(source.get());
+}
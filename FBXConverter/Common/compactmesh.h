@@ -0,0 +1,216 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//compactmesh.h
+
+#pragma once
+
+#include <memory>
+#include <new>
+#include <string.h>
+#include "polymesh.h"
+
+//storage of one attribute component
+enum AttributeFormat
+{
+	FORMAT_FLOAT32,		//4 bytes
+	FORMAT_HALF,		//2 bytes, IEEE 754 binary16
+	FORMAT_UNORM16,		//2 bytes, quantized over the [min, max] range of the component
+};
+
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t f;
+	memcpy(&f, &value, 4);
+	uint32_t sign = (f >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((f >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = f & 0x7fffff;
+	if (((f >> 23) & 0xff) == 0xff)		//inf, nan
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31)					//overflow
+		return (uint16_t)(sign | 0x7c00);
+	if (exponent <= 0)					//subnormal or zero
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t midpoint = 1u << (shift - 1);
+		if (rest > midpoint || (rest == midpoint && (half & 1)))
+			++half;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		++half;	//may carry into the exponent, which rounds up correctly
+	return (uint16_t)half;
+}
+
+inline float HalfToFloat(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+	uint32_t f;
+	if (exponent == 0x1f)
+		f = sign | 0x7f800000 | (mantissa << 13);
+	else if (exponent != 0)
+		f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	else if (mantissa == 0)
+		f = sign;
+	else
+	{
+		//normalize the subnormal
+		exponent = 127 - 15 + 1;
+		while (!(mantissa & 0x400))
+		{
+			mantissa <<= 1;
+			--exponent;
+		}
+		f = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+	}
+	float value;
+	memcpy(&value, &f, 4);
+	return value;
+}
+
+//Structure of arrays storage for an attribute of up to 4 components: one contiguous,
+//64-byte aligned stream per component, padded to a multiple of 16 elements so SIMD
+//loops can always process full registers.
+class AttributeStream
+{
+public:
+	enum { ALIGNMENT = 64, PADDING = 16, MAX_COMPONENTS = 4 };
+
+	AttributeStream()
+		:count(0), components(0), format(FORMAT_FLOAT32)
+	{
+		for (int c = 0; c < MAX_COMPONENTS; ++c)
+		{
+			scale[c] = 1.0f;
+			offset[c] = 0.0f;
+		}
+	}
+
+	//encode count elements of n components read from src with a stride of srcStride doubles;
+	//if indices is set, element i is read from src[indices[i] * srcStride]
+	void Encode(const double* src, size_t srcStride, uint32_t n, int numComponents, AttributeFormat fmt,
+		const uint32_t* indices = NULL);
+
+	//reorder the elements: element i becomes the old element source[i]
+	void Gather(const uint32_t* source);
+
+	double Get(uint32_t i, int c) const
+	{
+		switch (format)
+		{
+		case FORMAT_HALF: return HalfToFloat(((const uint16_t*)streams[c].get())[i]);
+		case FORMAT_UNORM16: return offset[c] + scale[c] * ((const uint16_t*)streams[c].get())[i];
+		default: return ((const float*)streams[c].get())[i];
+		}
+	}
+
+	//raw component stream, float* for FORMAT_FLOAT32, uint16_t* otherwise
+	const void* Component(int c) const { return streams[c].get(); }
+	const float* Floats(int c) const { return format == FORMAT_FLOAT32 ? (const float*)streams[c].get() : NULL; }
+
+	size_t ElementSize() const { return format == FORMAT_FLOAT32 ? 4 : 2; }
+	size_t Bytes() const { return components * Padded(count) * ElementSize(); }
+	bool Empty() const { return count == 0; }
+
+	uint32_t count;
+	int components;
+	AttributeFormat format;
+	float scale[MAX_COMPONENTS];	//FORMAT_UNORM16: value = offset + scale * q
+	float offset[MAX_COMPONENTS];
+
+private:
+	struct AlignedDelete
+	{
+		void operator()(uint8_t* p) const { ::operator delete[](p, std::align_val_t(ALIGNMENT)); }
+	};
+
+	static size_t Padded(uint32_t n) { return ((size_t)n + PADDING - 1) / PADDING * PADDING; }
+
+	void Allocate(uint32_t n, int numComponents, AttributeFormat fmt)
+	{
+		count = n;
+		components = numComponents;
+		format = fmt;
+		size_t bytes = Padded(n) * ElementSize();
+		for (int c = 0; c < MAX_COMPONENTS; ++c)
+		{
+			streams[c].reset();
+			if (c < components && bytes > 0)
+			{
+				streams[c].reset((uint8_t*)::operator new[](bytes, std::align_val_t(ALIGNMENT)));
+				memset(streams[c].get(), 0, bytes);
+			}
+		}
+	}
+
+	std::unique_ptr<uint8_t[], AlignedDelete> streams[MAX_COMPONENTS];
+};
+
+//Triangle mesh with compact attribute storage, an alternative to TriMesh when memory
+//per mesh matters (ExportOptions::compact). Positions, normals and uvs are kept as float32
+//(or half/unorm16) SoA streams. Per-vertex PN/UV follow the TriMesh rules (the last triangle
+//corner referencing a vertex wins); the per-corner N/T streams are only built on request.
+class CompactMesh
+{
+public:
+	CompactMesh(const PolyMesh* pMesh, AttributeFormat positionFormat = FORMAT_FLOAT32,
+		AttributeFormat attributeFormat = FORMAT_FLOAT32, bool cornerAttributes = false);
+	//same layout from a triangulated mesh, its material ranges included
+	CompactMesh(const TriMesh* pTriMesh, AttributeFormat positionFormat = FORMAT_FLOAT32,
+		AttributeFormat attributeFormat = FORMAT_FLOAT32, bool cornerAttributes = false);
+
+	//group the triangles by the material of their polygon, as TriMesh::SplitByMaterial
+	void SplitByMaterial(const PolyMesh* pMesh, const int* faceMaterial, size_t numIds,
+		const std::vector<std::string>& materialNames);
+
+	//heap bytes held by the mesh
+	size_t MemoryBytes() const
+	{
+		return P.Bytes() + PN.Bytes() + UV.Bytes() + N.Bytes() + T.Bytes() + sizeof(uint32_t) * 6 * (size_t)numTris;
+	}
+
+	//member variables
+	std::string name;
+	std::string matname;
+	uint32_t numVert;							// number of vertices
+	uint32_t numTris;							// number of triangles
+	uint32_t numUV;								// number of UVs
+	AttributeStream P;							// vertex positions
+	std::unique_ptr<uint32_t[]> triIndex;		// vertex index array
+	std::unique_ptr<uint32_t[]> UVIndices;		// triangles texture index
+	AttributeStream PN;							// vertex normals
+	AttributeStream UV;							// UV coordinates
+	AttributeStream N;							// triangles vertex normals, empty unless requested
+	AttributeStream T;							// triangles texture coordinates, empty unless requested
+	std::vector<SubMesh> subMeshes;				// material ranges, empty when the whole mesh uses matname
+};
@@ -0,0 +1,422 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//fileio.cpp
+
+#include "fileio.h"
+#include "profile.h"
+#include "textwriter.h"
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <new>
+#include <thread>
+
+namespace
+{
+	uint64_t Nanos(std::chrono::steady_clock::time_point start)
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	enum OpKind { OP_WRITE, OP_CLOSE, OP_REMOVE };
+
+	//group of the files the calling thread opens, see AsyncWriter::BeginGroup
+	void*& CurrentGroup()
+	{
+		thread_local void* group = nullptr;
+		return group;
+	}
+}
+
+void AlignedDeleter::operator()(uint8_t* p) const
+{
+	::operator delete[](p, std::align_val_t(IO_ALIGNMENT));
+}
+
+AlignedBuffer MakeAlignedBuffer(size_t bytes)
+{
+	return AlignedBuffer(static_cast<uint8_t*>(::operator new[](bytes ? bytes : 1, std::align_val_t(IO_ALIGNMENT))));
+}
+
+bool ReadWholeFile(const char* pFilename, AlignedBuffer& data, size_t& size)
+{
+	std::error_code ec;
+	const uintmax_t length = std::filesystem::file_size(pFilename, ec);
+	FILE* fp = ec ? NULL : OpenFile(pFilename, "rb");
+	if (!fp)
+		return false;
+
+	//straight into the buffer in large blocks, no stdio copy
+	const size_t BLOCK = 8 << 20;
+	setvbuf(fp, NULL, _IONBF, 0);
+	size = (size_t)length;
+	data = MakeAlignedBuffer(size);
+	bool ok = true;
+	for (size_t done = 0; done < size && ok; )
+	{
+		const size_t n = fread(data.get() + done, 1, std::min(BLOCK, size - done), fp);
+		ok = n > 0;
+		done += n;
+	}
+	fclose(fp);
+	return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+OutputFile::OutputFile()
+	:_fp(NULL), _failed(false), _pWriter(NULL), _pFile(NULL), _buffer(NULL), _pos(0)
+{
+}
+
+bool OutputFile::Open(const char* pFilename, bool text)
+{
+	Close();
+	_failed = false;
+	_pWriter = AsyncWriter::Current();
+	if (_pWriter)
+	{
+		_pFile = _pWriter->OpenFile(pFilename, text);
+		return true;
+	}
+	_fp = OpenFile(pFilename, text ? "w" : "wb");
+	return _fp != NULL;
+}
+
+bool OutputFile::Write(const void* data, size_t bytes)
+{
+	if (_fp)
+	{
+		_failed = _failed || (bytes && fwrite(data, 1, bytes, _fp) != bytes);
+		return !_failed;
+	}
+	if (!_pFile)
+		return false;
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	while (bytes > 0)
+	{
+		if (!_buffer)
+			_buffer = _pWriter->AcquireBuffer();
+		const size_t n = std::min(bytes, AsyncWriter::BUFFER_SIZE - _pos);
+		memcpy(_buffer + _pos, p, n);
+		_pos += n;
+		p += n;
+		bytes -= n;
+		if (_pos == AsyncWriter::BUFFER_SIZE)
+		{
+			_pWriter->WriteBuffer((AsyncWriter::File*)_pFile, _buffer, _pos);
+			_buffer = NULL;
+			_pos = 0;
+		}
+	}
+	return true;
+}
+
+bool OutputFile::Close()
+{
+	bool ok = !_failed;
+	if (_fp)
+	{
+		ok = fclose(_fp) == 0 && ok;
+		_fp = NULL;
+	}
+	if (_pFile)
+	{
+		if (_buffer)
+			_pWriter->WriteBuffer((AsyncWriter::File*)_pFile, _buffer, _pos);
+		_pWriter->CloseFile((AsyncWriter::File*)_pFile);
+		_pFile = NULL;
+		_buffer = NULL;
+		_pos = 0;
+	}
+	return ok;
+}
+
+void RemoveOutputFile(const char* pFilename)
+{
+	if (AsyncWriter* pWriter = AsyncWriter::Current())
+		pWriter->Remove(pFilename);
+	else
+		remove(pFilename);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct AsyncWriter::Group
+{
+	std::atomic<int> pending{ 1 };		//open files plus one until EndGroup
+	std::atomic<bool> failed{ false };
+	std::function<void(bool)> done;
+};
+
+struct AsyncWriter::File
+{
+	std::string path;
+	bool text = false;
+	unsigned int queue = 0;
+	Group* pGroup = nullptr;
+	FILE* fp = NULL;
+	bool failed = false;
+};
+
+struct AsyncWriter::Op
+{
+	int kind = OP_WRITE;
+	File* pFile = nullptr;
+	uint8_t* buffer = nullptr;
+	size_t bytes = 0;
+	std::string path;				//OP_REMOVE
+};
+
+struct AsyncWriter::Queue
+{
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<Op> ops;
+	bool stop = false;
+	std::thread thread;
+};
+
+AsyncWriter::AsyncWriter(unsigned int numThreads, size_t numBuffers)
+	:_numBuffers(std::max<size_t>(numBuffers, 2)), _allocated(0), _files(0), _failed(0), _bytes(0), _busyNanos(0), _waitNanos(0)
+{
+	for (unsigned int i = 0; i < std::max(numThreads, 1u); ++i)
+		_queues.emplace_back(new Queue());
+	for (unsigned int i = 0; i < _queues.size(); ++i)
+		_queues[i]->thread = std::thread(&AsyncWriter::ThreadMain, this, i);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+	Close();
+	AlignedDeleter free;
+	for (uint8_t* buffer : _free)
+		free(buffer);
+}
+
+void AsyncWriter::Close()
+{
+	for (std::unique_ptr<Queue>& q : _queues)
+	{
+		if (!q->thread.joinable())
+			continue;
+		{
+			std::lock_guard<std::mutex> lock(q->mutex);
+			q->stop = true;
+		}
+		q->ready.notify_one();
+	}
+	for (std::unique_ptr<Queue>& q : _queues)
+		if (q->thread.joinable())
+			q->thread.join();
+}
+
+void AsyncWriter::BeginGroup()
+{
+	CurrentGroup() = new Group();
+}
+
+void AsyncWriter::EndGroup(std::function<void(bool ok)> done)
+{
+	Group* pGroup = (Group*)CurrentGroup();
+	CurrentGroup() = nullptr;
+	if (!pGroup)
+	{
+		done(true);
+		return;
+	}
+	pGroup->done = std::move(done);
+	Release(pGroup, false);
+}
+
+void AsyncWriter::Release(Group* pGroup, bool failed)
+{
+	if (failed)
+		pGroup->failed = true;
+	if (--pGroup->pending == 0)
+	{
+		pGroup->done(!pGroup->failed);
+		delete pGroup;
+	}
+}
+
+AsyncWriter::Stats AsyncWriter::GetStats() const
+{
+	Stats stats;
+	stats.threads = (unsigned int)_queues.size();
+	stats.files = _files;
+	stats.failed = _failed;
+	stats.bytes = _bytes;
+	stats.busySeconds = _busyNanos * 1e-9;
+	stats.waitSeconds = _waitNanos * 1e-9;
+	return stats;
+}
+
+AsyncWriter::File* AsyncWriter::OpenFile(const char* pFilename, bool text)
+{
+	File* pFile = new File();
+	pFile->path = pFilename;
+	pFile->text = text;
+	pFile->queue = QueueOf(pFilename);
+	pFile->pGroup = (Group*)CurrentGroup();
+	if (pFile->pGroup)
+		++pFile->pGroup->pending;
+	return pFile;
+}
+
+void AsyncWriter::WriteBuffer(File* pFile, uint8_t* buffer, size_t bytes)
+{
+	Op op;
+	op.kind = OP_WRITE;
+	op.pFile = pFile;
+	op.buffer = buffer;
+	op.bytes = bytes;
+	Push(pFile->queue, op);
+}
+
+void AsyncWriter::CloseFile(File* pFile)
+{
+	Op op;
+	op.kind = OP_CLOSE;
+	op.pFile = pFile;
+	Push(pFile->queue, op);
+}
+
+void AsyncWriter::Remove(const char* pFilename)
+{
+	Op op;
+	op.kind = OP_REMOVE;
+	op.path = pFilename;
+	Push(QueueOf(pFilename), op);
+}
+
+uint8_t* AsyncWriter::AcquireBuffer()
+{
+	std::unique_lock<std::mutex> lock(_poolMutex);
+	if (_free.empty() && _allocated < _numBuffers)
+	{
+		++_allocated;
+		lock.unlock();
+		return MakeAlignedBuffer(BUFFER_SIZE).release();
+	}
+	if (_free.empty())
+	{
+		auto start = std::chrono::steady_clock::now();
+		_bufferFree.wait(lock, [&]() { return !_free.empty(); });
+		_waitNanos += Nanos(start);
+	}
+	uint8_t* buffer = _free.back();
+	_free.pop_back();
+	return buffer;
+}
+
+void AsyncWriter::ReleaseBuffer(uint8_t* buffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(_poolMutex);
+		_free.push_back(buffer);
+	}
+	_bufferFree.notify_one();
+}
+
+unsigned int AsyncWriter::QueueOf(const char* pFilename) const
+{
+	return (unsigned int)(std::hash<std::string>()(pFilename) % _queues.size());
+}
+
+void AsyncWriter::Push(unsigned int queue, const Op& op)
+{
+	Queue& q = *_queues[queue];
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.ops.push_back(op);
+	}
+	q.ready.notify_one();
+}
+
+void AsyncWriter::ThreadMain(unsigned int index)
+{
+	Profiler::SetThreadName("writer " + std::to_string(index + 1));
+	Queue& q = *_queues[index];
+	for (;;)
+	{
+		Op op;
+		{
+			std::unique_lock<std::mutex> lock(q.mutex);
+			q.ready.wait(lock, [&]() { return q.stop || !q.ops.empty(); });
+			if (q.ops.empty())
+				return;
+			op = std::move(q.ops.front());
+			q.ops.pop_front();
+		}
+		auto start = std::chrono::steady_clock::now();
+		Process(op);
+		_busyNanos += Nanos(start);
+	}
+}
+
+void AsyncWriter::Process(Op& op)
+{
+	if (op.kind == OP_REMOVE)
+	{
+		remove(op.path.c_str());
+		return;
+	}
+
+	//opened on the first buffer, or on close for an empty file; the buffers are large
+	//enough to go to the file without stdio buffering
+	File& f = *op.pFile;
+	if (!f.fp && !f.failed)
+	{
+		PROFILE_SCOPE_DETAIL(STAGE_NONE, "OpenOutput", &f.path);
+		f.fp = ::OpenFile(f.path.c_str(), f.text ? "w" : "wb");
+		f.failed = f.fp == NULL;
+		if (f.fp)
+			setvbuf(f.fp, NULL, _IONBF, 0);
+	}
+	if (op.kind == OP_WRITE)
+	{
+		PROFILE_SCOPE_DETAIL(STAGE_NONE, "WriteOutput", &f.path);
+		if (f.fp && !f.failed)
+			f.failed = fwrite(op.buffer, 1, op.bytes, f.fp) != op.bytes;
+		_bytes += op.bytes;
+		ReleaseBuffer(op.buffer);
+		return;
+	}
+
+	if (f.fp && fclose(f.fp) != 0)
+		f.failed = true;
+	++_files;
+	if (f.failed)
+	{
+		printf("Error: cannot write %s\n", f.path.c_str());
+		++_failed;
+	}
+	if (f.pGroup)
+		Release(f.pGroup, f.failed);
+	delete op.pFile;
+}
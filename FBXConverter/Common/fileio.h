@@ -0,0 +1,172 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//fileio.h
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//page aligned heap buffers for whole-file reads and write buffers
+const size_t IO_ALIGNMENT = 4096;
+
+struct AlignedDeleter
+{
+	void operator()(uint8_t* p) const;
+};
+typedef std::unique_ptr<uint8_t[], AlignedDeleter> AlignedBuffer;
+
+AlignedBuffer MakeAlignedBuffer(size_t bytes);
+
+//a whole file in one aligned buffer, read in large sequential blocks; false if it cannot be read
+bool ReadWholeFile(const char* pFilename, AlignedBuffer& data, size_t& size);
+
+class AsyncWriter;
+
+//Output file of the exporters. Without an AsyncWriter on the calling thread it is a plain
+//FILE*. With one, the data is gathered into the writer's buffers and written by its threads:
+//Open and Close only queue work, and a file that cannot be written fails its write group
+//instead of the calls.
+class OutputFile
+{
+public:
+	OutputFile();
+	~OutputFile() { Close(); }
+
+	//text mode only changes line endings on Windows
+	bool Open(const char* pFilename, bool text = false);
+	bool Write(const void* data, size_t bytes);
+
+	//false if the file could not be written (known only when synchronous)
+	bool Close();
+
+	bool IsOpen() const { return _fp != NULL || _pFile != NULL; }
+
+private:
+	OutputFile(const OutputFile&) = delete;
+	OutputFile& operator=(const OutputFile&) = delete;
+
+	FILE* _fp;
+	bool _failed;
+	AsyncWriter* _pWriter;
+	void* _pFile;			//queued file of _pWriter
+	uint8_t* _buffer;		//writer buffer being filled, NULL until the first write
+	size_t _pos;
+};
+
+//remove a file written through OutputFile; with an AsyncWriter on the calling thread, once
+//the writes queued for it are done
+void RemoveOutputFile(const char* pFilename);
+
+//Writer threads with a bounded pool of large aligned buffers. The OutputFiles of the threads
+//using the writer fill one buffer at a time and queue it. A file always goes to the same
+//writer thread, so its buffers are written in order. A thread that finds no free buffer waits
+//until one is written, which bounds the memory of pending output and holds back the
+//converting threads when the disk is the bottleneck.
+class AsyncWriter
+{
+public:
+	static const size_t BUFFER_SIZE = 4 << 20;
+
+	struct Stats
+	{
+		unsigned int threads = 0;
+		size_t files = 0;
+		size_t failed = 0;				//files that could not be written
+		uint64_t bytes = 0;
+		double busySeconds = 0.0;		//opening, writing and closing, summed over the writer threads
+		double waitSeconds = 0.0;		//producers waiting for a free buffer, summed over them
+	};
+
+	//numBuffers should allow two per thread writing through it
+	AsyncWriter(unsigned int numThreads, size_t numBuffers);
+
+	~AsyncWriter();
+
+	//writes everything queued, then joins the threads; nothing can be queued afterwards
+	void Close();
+
+	//writer of the OutputFiles opened on the calling thread, NULL for synchronous files
+	static AsyncWriter*& Current()
+	{
+		thread_local AsyncWriter* writer = nullptr;
+		return writer;
+	}
+
+	//Group the files the calling thread opens until EndGroup. done(ok) runs once the last
+	//of them is written and closed, on a writer thread (or in EndGroup when nothing is
+	//pending); ok is false if any of them could not be written.
+	void BeginGroup();
+	void EndGroup(std::function<void(bool ok)> done);
+
+	Stats GetStats() const;
+
+private:
+	friend class OutputFile;
+	friend void RemoveOutputFile(const char* pFilename);
+
+	struct Group;
+	struct File;
+	struct Op;
+	struct Queue;
+
+	AsyncWriter(const AsyncWriter&) = delete;
+	AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+	File* OpenFile(const char* pFilename, bool text);
+	void WriteBuffer(File* pFile, uint8_t* buffer, size_t bytes);	//gives the buffer back to the pool once written
+	void CloseFile(File* pFile);
+	void Remove(const char* pFilename);
+
+	uint8_t* AcquireBuffer();
+	void ReleaseBuffer(uint8_t* buffer);
+	unsigned int QueueOf(const char* pFilename) const;
+	void Push(unsigned int queue, const Op& op);
+	void ThreadMain(unsigned int index);
+	void Process(Op& op);
+	void Release(Group* pGroup, bool failed);
+
+	std::vector<std::unique_ptr<Queue> > _queues;	//one per writer thread
+
+	std::mutex _poolMutex;
+	std::condition_variable _bufferFree;
+	std::vector<uint8_t*> _free;
+	size_t _numBuffers;
+	size_t _allocated;
+
+	std::atomic<size_t> _files;
+	std::atomic<size_t> _failed;
+	std::atomic<uint64_t> _bytes;
+	std::atomic<uint64_t> _busyNanos;
+	std::atomic<uint64_t> _waitNanos;
+};
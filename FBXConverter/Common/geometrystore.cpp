@@ -0,0 +1,201 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//geometrystore.cpp
+
+#include "geometrystore.h"
+#include "hash.h"
+#include "parallel.h"
+#include "profile.h"
+#include "textwriter.h"
+#include "weld.h"
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	bool WriteAll(FILE* fp, const void* data, size_t bytes)
+	{
+		return bytes == 0 || fwrite(data, 1, bytes, fp) == bytes;
+	}
+}
+
+GeometryStore::GeometryStore(const std::string& directory)
+	:_directory(directory)
+{
+}
+
+bool GeometryStore::Open()
+{
+	std::error_code ec;
+	fs::create_directories(_directory, ec);
+	return fs::is_directory(_directory, ec);
+}
+
+uint64_t GeometryStore::HashMesh(const TriMesh* m, uint64_t seed)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_EXPORT, "HashMesh", &m->name);
+	const size_t numCorners = (size_t)m->numTris * 3;
+	uint64_t h[6];
+	h[0] = HashArray(m->P.get(), (size_t)m->numVert * sizeof(Vector3d), seed);
+	h[1] = HashArray(m->triIndex.get(), numCorners * sizeof(uint32_t), seed);
+	h[2] = HashArray(m->N.get(), numCorners * sizeof(Vector3d), seed);
+	h[3] = HashArray(m->T.get(), numCorners * sizeof(Vector2d), seed);
+	std::vector<uint32_t> ranges;
+	for (const SubMesh& sub : m->subMeshes)
+	{
+		ranges.push_back(sub.firstTri);
+		ranges.push_back(sub.numTris);
+	}
+	h[4] = Hash64(ranges.data(), ranges.size() * sizeof(uint32_t), ((uint64_t)m->numVert << 32) | m->numTris);
+	//meshes without tangents keep the hashes of stores written before them
+	if (!m->TG)
+		return Hash64(h, 5 * sizeof(uint64_t), seed);
+	h[5] = HashArray(m->TG.get(), numCorners * sizeof(Vector4d), seed);
+	return Hash64(h, sizeof(h), seed);
+}
+
+uint64_t GeometryStore::SettingsSeed(const ExportOptions& options)
+{
+	char settings[96];
+	int len = snprintf(settings, sizeof(settings), "welded-v2|eps=%.9g|optimize=%d,%d",
+		options.weldEpsilon, options.optimize ? 1 : 0, options.optimizeOverdraw ? 1 : 0);
+	return Hash64(settings, std::min<size_t>(len, sizeof(settings) - 1));
+}
+
+std::string GeometryStore::FileName(uint64_t hash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+	return name;
+}
+
+bool GeometryStore::Find(uint64_t hash, const TriMesh* m, Entry& entry)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _entries.find(hash);
+	if (found == _entries.end() || found->second.meshVert != m->numVert || found->second.meshTris != m->numTris)
+		return false;
+	entry = found->second;
+	++_stats.references;
+	_stats.referencedBytes += entry.Bytes();
+	return true;
+}
+
+GeometryStore::Entry GeometryStore::Describe(const WeldedMesh* w)
+{
+	Entry entry;
+	entry.numVert = w->numVert;
+	entry.numTris = w->numTris;
+	entry.tangents = !w->tangents.empty();
+	for (int c = 0; c < 3; ++c)
+	{
+		entry.pmin[c] = entry.pmax[c] = w->numVert ? w->positions[c] : 0.0f;
+		for (uint32_t i = 1; i < w->numVert; ++i)
+		{
+			entry.pmin[c] = std::min(entry.pmin[c], w->positions[i * 3 + c]);
+			entry.pmax[c] = std::max(entry.pmax[c], w->positions[i * 3 + c]);
+		}
+	}
+	return entry;
+}
+
+bool GeometryStore::Add(uint64_t hash, const TriMesh* m, const WeldedMesh* w, Entry& entry)
+{
+	entry = Describe(w);
+	entry.meshVert = m->numVert;
+	entry.meshTris = m->numTris;
+	{
+		//rewriting the file would break the outputs referencing the other mesh
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto found = _entries.find(hash);
+		if (found != _entries.end() && (found->second.meshVert != entry.meshVert || found->second.meshTris != entry.meshTris))
+			return false;
+	}
+
+	//written outside the lock to a private name and published by rename; two workers
+	//racing on the same mesh write identical bytes
+	std::error_code ec;
+	const fs::path file = fs::path(_directory) / FileName(hash);
+	bool written = false;
+	const uintmax_t size = fs::file_size(file, ec);
+	if (ec || size != entry.Bytes())
+	{
+		PROFILE_SCOPE_DETAIL(STAGE_EXPORT, "StoreGeometry", &w->name);
+		std::random_device rd;
+		char suffix[24];
+		snprintf(suffix, sizeof(suffix), ".tmp.%08x", (unsigned int)rd());
+		const fs::path tmp = file.string() + suffix;
+		FILE* fp = OpenFile(tmp.string().c_str(), "wb");
+		if (!fp)
+			return false;
+		bool ok = WriteAll(fp, w->positions.data(), w->positions.size() * sizeof(float)) &&
+			WriteAll(fp, w->normals.data(), w->normals.size() * sizeof(float)) &&
+			WriteAll(fp, w->uvs.data(), w->uvs.size() * sizeof(float)) &&
+			WriteAll(fp, w->tangents.data(), w->tangents.size() * sizeof(float)) &&
+			WriteAll(fp, w->indices.data(), w->indices.size() * sizeof(uint32_t));
+		ok = fclose(fp) == 0 && ok;
+		if (ok)
+			fs::rename(tmp, file, ec);
+		if (!ok || ec)
+		{
+			fs::remove(tmp, ec);
+			return false;
+		}
+		PROFILE_COUNT(COUNTER_BYTES_WRITTEN, entry.Bytes());
+		written = true;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_entries.emplace(hash, entry).second)
+		++_stats.unique;
+	if (written)
+	{
+		++_stats.written;
+		_stats.writtenBytes += entry.Bytes();
+	}
+	++_stats.references;
+	_stats.referencedBytes += entry.Bytes();
+	return true;
+}
+
+GeometryStore::Stats GeometryStore::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _stats;
+}
+
+void GeometryStore::PrintReport(FILE* fp) const
+{
+	Stats stats = GetStats();
+	fprintf(fp, "geometry store %s: %zu mesh references, %zu unique, %zu duplicates\n",
+		_directory.c_str(), stats.references, stats.unique, stats.references - stats.unique);
+	fprintf(fp, "geometry store: %.2f MB referenced, %.2f MB written (%zu files), %.2f MB saved\n",
+		stats.referencedBytes / 1048576.0, stats.writtenBytes / 1048576.0, stats.written,
+		(stats.referencedBytes - std::min(stats.referencedBytes, stats.writtenBytes)) / 1048576.0);
+}
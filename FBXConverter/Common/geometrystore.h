@@ -0,0 +1,118 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//geometrystore.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include "scene.h"
+
+struct WeldedMesh;
+
+//Directory of welded mesh buffers shared by the glTF files of a batch, one file per
+//distinct mesh:
+//
+//    <dir>/<hash>.bin    positions, normals (3 floats) and uvs (2 floats, v = 1 - v as in glTF) per vertex,
+//                        tangents (4 floats) per vertex when the mesh has them,
+//                        then 3 uint32 indices per triangle
+//
+//The layout follows from the vertex and triangle counts, so an output that finds its
+//mesh in the store references the file without welding or writing it again. Files are
+//published by rename; one whose size does not match the layout (cut short, or another
+//mesh under a colliding hash) is written again. The store may be shared by runs. Thread safe.
+class GeometryStore
+{
+public:
+	//what an output needs to reference a stored buffer
+	struct Entry
+	{
+		uint32_t numVert = 0;
+		uint32_t numTris = 0;
+		uint32_t meshVert = 0;		//counts of the TriMesh welded into the buffer, checked by Find
+		uint32_t meshTris = 0;
+		bool tangents = false;
+		float pmin[3] = { 0.0f, 0.0f, 0.0f };	//position bounds for the accessor
+		float pmax[3] = { 0.0f, 0.0f, 0.0f };
+
+		uint64_t PositionOffset() const { return 0; }
+		uint64_t NormalOffset() const { return (uint64_t)numVert * 12; }
+		uint64_t UVOffset() const { return (uint64_t)numVert * 24; }
+		uint64_t TangentOffset() const { return (uint64_t)numVert * 32; }
+		uint64_t IndexOffset() const { return (uint64_t)numVert * (tangents ? 48 : 32); }
+		uint64_t Bytes() const { return IndexOffset() + (uint64_t)numTris * 12; }
+	};
+
+	struct Stats
+	{
+		size_t references = 0;			//meshes written by reference
+		size_t unique = 0;				//distinct meshes among them
+		size_t written = 0;				//buffers not found on disk and written
+		uint64_t referencedBytes = 0;	//sum over the references: the size without sharing
+		uint64_t writtenBytes = 0;
+	};
+
+	explicit GeometryStore(const std::string& directory);
+
+	//create the directory, false if that fails
+	bool Open();
+
+	const std::string& Directory() const { return _directory; }
+
+	//canonical content hash of a triangulated mesh: positions, triangle indices, corner
+	//normals, uvs and tangents and the material ranges (not the names). seed carries the export
+	//settings that change the welded buffer, see SettingsSeed
+	static uint64_t HashMesh(const TriMesh* m, uint64_t seed);
+	static uint64_t SettingsSeed(const ExportOptions& options);
+
+	//layout and bounds of a welded mesh
+	static Entry Describe(const WeldedMesh* w);
+
+	//layout of mesh m stored earlier in this run, counted as one more reference; false when
+	//the entry of hash was made from a mesh with other counts
+	bool Find(uint64_t hash, const TriMesh* m, Entry& entry);
+
+	//store w, welded from m, under hash unless a file of its size exists, describe it in entry
+	//and count the reference; false when the file cannot be written or hash already names
+	//another mesh in this run
+	bool Add(uint64_t hash, const TriMesh* m, const WeldedMesh* w, Entry& entry);
+
+	//name of the buffer file inside Directory()
+	static std::string FileName(uint64_t hash);
+
+	Stats GetStats() const;
+
+	//dedup report of the run
+	void PrintReport(FILE* fp) const;
+
+private:
+	std::string _directory;
+	mutable std::mutex _mutex;
+	std::map<uint64_t, Entry> _entries;
+	Stats _stats;
+};
@@ -0,0 +1,504 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//glTF 2.0 export of the extracted scene, binary (.glb) or JSON with external buffers (.gltf)
+
+#include "scene.h"
+#include "geometrystore.h"
+#include "profile.h"
+#include "textwriter.h"
+#include "weld.h"
+#include <math.h>
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <memory>
+#include <stdio.h>
+
+namespace
+{
+	enum
+	{
+		GLB_MAGIC = 0x46546C67,		//"glTF"
+		GLB_VERSION = 2,
+		CHUNK_JSON = 0x4E4F534A,	//"JSON"
+		CHUNK_BIN = 0x004E4942,		//"BIN\0"
+		GL_FLOAT = 5126,
+		GL_UNSIGNED_INT = 5125,
+		GL_ARRAY_BUFFER = 34962,
+		GL_ELEMENT_ARRAY_BUFFER = 34963,
+	};
+
+	//JSON text assembled in memory, the binary chunk is never copied into it
+	class JsonText
+	{
+	public:
+		JsonText& Raw(const char* s) { text += s; return *this; }
+		JsonText& Str(const std::string& s)
+		{
+			text += '"';
+			for (unsigned char c : s)
+			{
+				if (c == '"' || c == '\\') { text += '\\'; text += (char)c; }
+				else if (c < 0x20) { char buf[8]; snprintf(buf, sizeof(buf), "\\u%04x", c); text += buf; }
+				else text += (char)c;
+			}
+			text += '"';
+			return *this;
+		}
+		JsonText& Num(double v)
+		{
+			char buf[32];
+			if (!isfinite(v)) v = 0.0;
+			text.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+			return *this;
+		}
+		JsonText& Int(uint64_t v)
+		{
+			char buf[24];
+			text.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+			return *this;
+		}
+		JsonText& Sep(bool& first) { if (!first) text += ','; first = false; return *this; }
+
+		std::string text;
+	};
+
+	//one binary blob of the BIN chunk (or .bin file), written straight from its owner's memory,
+	//or a range of an external buffer that is already on disk (data is NULL)
+	struct BinaryView
+	{
+		const void* data;
+		size_t bytes;
+		size_t offset;
+		int target;
+		int external;	//index into GlbWriter::externals, -1 for the BIN chunk
+	};
+
+	struct ExternalBuffer
+	{
+		std::string uri;
+		uint64_t bytes;
+	};
+
+	class GlbWriter
+	{
+	public:
+		size_t AddView(const void* data, size_t bytes, int target)
+		{
+			BinaryView view = { data, bytes, binaryLength, target, -1 };
+			views.push_back(view);
+			binaryLength += (bytes + 3) & ~(size_t)3;
+			return views.size() - 1;
+		}
+
+		//a buffer referenced by uri, listed once after the BIN chunk's buffer
+		int AddExternal(const std::string& uri, uint64_t bytes)
+		{
+			auto found = externalIndex.emplace(uri, (int)externals.size());
+			if (found.second)
+			{
+				ExternalBuffer buffer = { uri, bytes };
+				externals.push_back(buffer);
+			}
+			return found.first->second;
+		}
+
+		size_t AddExternalView(int external, uint64_t offset, uint64_t bytes, int target)
+		{
+			BinaryView view = { NULL, (size_t)bytes, (size_t)offset, target, external };
+			views.push_back(view);
+			return views.size() - 1;
+		}
+
+		//accessor over a whole view, returns its index
+		size_t AddAccessor(size_t view, int componentType, size_t count, const char* type,
+			const float* minValues = NULL, const float* maxValues = NULL, int n = 0)
+		{
+			accessors.Sep(firstAccessor).Raw("{\"bufferView\":").Int(view)
+				.Raw(",\"componentType\":").Int(componentType)
+				.Raw(",\"count\":").Int(count)
+				.Raw(",\"type\":\"").Raw(type).Raw("\"");
+			if (minValues && maxValues)
+			{
+				accessors.Raw(",\"min\":[");
+				for (int i = 0; i < n; ++i) { if (i) accessors.Raw(","); accessors.Num(minValues[i]); }
+				accessors.Raw("],\"max\":[");
+				for (int i = 0; i < n; ++i) { if (i) accessors.Raw(","); accessors.Num(maxValues[i]); }
+				accessors.Raw("]");
+			}
+			accessors.Raw("}");
+			return numAccessors++;
+		}
+
+		//.gltf: the JSON as is, the BIN chunk content goes to binFilename
+		bool WriteText(const char* pFilename, const std::string& binFilename, const std::string& json)
+		{
+			OutputFile file;
+			if (!file.Open(pFilename))
+				return false;
+			file.Write(json.data(), json.size());
+			bool ok = file.Close();
+			if (ok && binaryLength)
+			{
+				if (!file.Open(binFilename.c_str()))
+					return false;
+				WriteViews(file);
+				ok = file.Close();
+			}
+			if (ok)
+				PROFILE_COUNT(COUNTER_BYTES_WRITTEN, json.size() + binaryLength);
+			return ok;
+		}
+
+		bool Write(const char* pFilename, const std::string& json)
+		{
+			std::string jsonChunk = json;
+			while (jsonChunk.size() % 4)
+				jsonChunk += ' ';
+			const uint32_t binLength = (uint32_t)binaryLength;
+			const uint32_t total = 12 + 8 + (uint32_t)jsonChunk.size() + (binLength ? 8 + binLength : 0);
+
+			OutputFile file;
+			if (!file.Open(pFilename))
+				return false;
+			uint32_t header[5] = { GLB_MAGIC, GLB_VERSION, total, (uint32_t)jsonChunk.size(), CHUNK_JSON };
+			file.Write(header, sizeof(header));
+			file.Write(jsonChunk.data(), jsonChunk.size());
+			if (binLength)
+			{
+				uint32_t chunk[2] = { binLength, CHUNK_BIN };
+				file.Write(chunk, sizeof(chunk));
+				WriteViews(file);
+			}
+			bool ok = file.Close();
+			if (ok)
+				PROFILE_COUNT(COUNTER_BYTES_WRITTEN, total);
+			return ok;
+		}
+
+		void WriteViews(OutputFile& file) const
+		{
+			static const uint8_t zeros[4] = { 0, 0, 0, 0 };
+			for (const BinaryView& view : views)
+			{
+				if (view.external >= 0)
+					continue;
+				file.Write(view.data, view.bytes);
+				file.Write(zeros, ((view.bytes + 3) & ~(size_t)3) - view.bytes);
+			}
+		}
+
+		std::string BufferViewsJson() const
+		{
+			const size_t firstExternal = binaryLength ? 1 : 0;
+			JsonText j;
+			bool first = true;
+			for (const BinaryView& view : views)
+			{
+				size_t buffer = view.external < 0 ? 0 : firstExternal + view.external;
+				j.Sep(first).Raw("{\"buffer\":").Int(buffer).Raw(",\"byteOffset\":").Int(view.offset)
+					.Raw(",\"byteLength\":").Int(view.bytes);
+				if (view.target)
+					j.Raw(",\"target\":").Int(view.target);
+				j.Raw("}");
+			}
+			return j.text;
+		}
+
+		//the BIN chunk's buffer first (with binUri for .gltf), then the external ones
+		std::string BuffersJson(const std::string& binUri) const
+		{
+			JsonText j;
+			bool first = true;
+			if (binaryLength)
+			{
+				j.Sep(first).Raw("{\"byteLength\":").Int(binaryLength);
+				if (!binUri.empty())
+					j.Raw(",\"uri\":").Str(binUri);
+				j.Raw("}");
+			}
+			for (const ExternalBuffer& buffer : externals)
+				j.Sep(first).Raw("{\"byteLength\":").Int(buffer.bytes).Raw(",\"uri\":").Str(buffer.uri).Raw("}");
+			return j.text;
+		}
+
+		std::vector<BinaryView> views;
+		std::vector<ExternalBuffer> externals;
+		std::map<std::string, int> externalIndex;
+		size_t binaryLength = 0;
+		JsonText accessors;
+		bool firstAccessor = true;
+		size_t numAccessors = 0;
+	};
+
+	//relative reference from the directory of an output file to a file or directory,
+	//'/' separated and percent-encoded as a glTF uri
+	std::string RelativeUri(const std::string& target, const std::string& fromFile)
+	{
+		namespace fs = std::filesystem;
+		std::error_code ec;
+		fs::path from = fs::absolute(fs::path(fromFile), ec).parent_path();
+		fs::path rel = fs::relative(fs::absolute(fs::path(target), ec), from, ec);
+		std::string path = (ec || rel.empty() ? fs::absolute(fs::path(target), ec) : rel).generic_string();
+		std::string uri;
+		for (unsigned char c : path)
+		{
+			if (isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~')
+				uri += (char)c;
+			else
+			{
+				char buf[4];
+				snprintf(buf, sizeof(buf), "%%%02X", c);
+				uri += buf;
+			}
+		}
+		return uri;
+	}
+
+	//phong shininess to roughness, the usual Blinn-Phong/GGX equivalence
+	double ShininessToRoughness(double ns)
+	{
+		return sqrt(2.0 / (std::max(ns, 0.0) + 2.0));
+	}
+
+	void WriteNode(JsonText& nodes, bool& first, size_t& numNodes, const MeshNode* pNode,
+		const std::map<const TriMesh*, size_t>& meshIndex, std::vector<size_t>* parentChildren)
+	{
+		//children first need their indices, so reserve this node's index up front
+		size_t self = numNodes++;
+		if (parentChildren)
+			parentChildren->push_back(self);
+
+		std::vector<size_t> children;
+		JsonText body;
+		body.Raw("{\"name\":").Str(pNode->_name);
+		if (!pNode->_transform.isIdentity())
+		{
+			//_transform is in FBX row-vector layout, which is exactly glTF's column-major order
+			body.Raw(",\"matrix\":[");
+			for (int i = 0; i < 4; ++i)
+				for (int j = 0; j < 4; ++j)
+				{
+					if (i || j) body.Raw(",");
+					body.Num(pNode->_transform(i, j));
+				}
+			body.Raw("]");
+		}
+
+		//a glTF node holds one mesh, any further ones go to extra child nodes
+		std::vector<size_t> extraMeshes;
+		for (size_t m = 0; m < pNode->_TriMeshes.size(); ++m)
+		{
+			auto found = meshIndex.find(pNode->_TriMeshes[m]);
+			if (found == meshIndex.end())
+				continue;
+			if (m == 0)
+				body.Raw(",\"mesh\":").Int(found->second);
+			else
+				extraMeshes.push_back(found->second);
+		}
+
+		std::vector<std::string> later;
+		for (size_t mesh : extraMeshes)
+		{
+			children.push_back(numNodes++);
+			JsonText extra;
+			extra.Raw("{\"name\":").Str(pNode->_name).Raw(",\"mesh\":").Int(mesh).Raw("}");
+			later.push_back(extra.text);
+		}
+
+		JsonText childNodes;
+		bool childFirst = true;
+		for (const MeshNode* pChild : pNode->_children)
+			WriteNode(childNodes, childFirst, numNodes, pChild, meshIndex, &children);
+
+		if (!children.empty())
+		{
+			body.Raw(",\"children\":[");
+			for (size_t i = 0; i < children.size(); ++i)
+			{
+				if (i) body.Raw(",");
+				body.Int(children[i]);
+			}
+			body.Raw("]");
+		}
+		body.Raw("}");
+
+		//node order in the array must match the indices handed out above
+		nodes.Sep(first).Raw(body.text.c_str());
+		for (const std::string& extra : later)
+			nodes.Raw(",").Raw(extra.c_str());
+		if (!childNodes.text.empty())
+			nodes.Raw(",").Raw(childNodes.text.c_str());
+	}
+
+	//FBX uvs start at the bottom left, glTF textures at the top left: v becomes 1 - v.
+	//Mirroring v turns the uv orientation, so the bitangent sign of the tangents flips too
+	void FlipTexcoords(WeldedMesh* w)
+	{
+		for (size_t i = 1; i < w->uvs.size(); i += 2)
+			w->uvs[i] = 1.0f - w->uvs[i];
+		for (size_t i = 3; i < w->tangents.size(); i += 4)
+			w->tangents[i] = -w->tangents[i];
+	}
+}
+
+int SceneParser::ExportGLB(const char* pFilename)
+{
+	if (TriMeshes.size() == 0)
+		return E_NO_MESH;
+
+	PROFILE_SCOPE(STAGE_NONE, "ExportGLB");
+	//materials in the order of the Materials map
+	std::map<std::string, size_t> materialIndex;
+	JsonText materials;
+	bool first = true;
+	for (auto iter = Materials.begin(); iter != Materials.end(); ++iter)
+	{
+		const Material* pMaterial = iter->second;
+		materialIndex[iter->first] = materialIndex.size();
+		materials.Sep(first).Raw("{\"name\":").Str(pMaterial->materialName)
+			.Raw(",\"pbrMetallicRoughness\":{\"baseColorFactor\":[")
+			.Num(pMaterial->Kd[0]).Raw(",").Num(pMaterial->Kd[1]).Raw(",").Num(pMaterial->Kd[2]).Raw(",").Num(pMaterial->Tr)
+			.Raw("],\"metallicFactor\":0,\"roughnessFactor\":").Num(ShininessToRoughness(pMaterial->Ns)).Raw("}");
+		if (pMaterial->Tr < 1.0f)
+			materials.Raw(",\"alphaMode\":\"BLEND\"");
+		materials.Raw(",\"doubleSided\":false}");
+	}
+
+	//one glTF mesh per TriMesh, its welded streams stay alive until the file is written.
+	//With a store, meshes found there are referenced without welding them again
+	GlbWriter glb;
+	std::vector<std::unique_ptr<WeldedMesh> > welded;
+	std::map<const TriMesh*, size_t> meshIndex;
+	std::string storeUri;
+	uint64_t storeSeed = 0;
+	if (_pGeometryStore)
+	{
+		storeUri = RelativeUri(_pGeometryStore->Directory(), pFilename) + "/";
+		storeSeed = GeometryStore::SettingsSeed(_options);
+	}
+	JsonText meshes;
+	first = true;
+	for (TriMesh* m : TriMeshes)
+	{
+		WeldedMesh* w = NULL;
+		GeometryStore::Entry entry;
+		uint64_t hash = 0;
+		if (_pGeometryStore)
+		{
+			hash = GeometryStore::HashMesh(m, storeSeed);
+			if (!_pGeometryStore->Find(hash, m, entry))
+			{
+				//the views refer to the stored file, the welded mesh is not needed after writing it
+				std::unique_ptr<WeldedMesh> stored(WeldForExport(m));
+				FlipTexcoords(stored.get());
+				if (!_pGeometryStore->Add(hash, m, stored.get(), entry))
+				{
+					printf("Error: cannot write %s to the geometry store %s\n", m->name.c_str(), _pGeometryStore->Directory().c_str());
+					return E_FAILOPENFILE;
+				}
+			}
+		}
+		else
+		{
+			w = WeldForExport(m);
+			welded.emplace_back(w);
+			FlipTexcoords(w);
+			entry = GeometryStore::Describe(w);
+		}
+		if (entry.numTris == 0)
+			continue;
+		const int external = _pGeometryStore ? glb.AddExternal(storeUri + GeometryStore::FileName(hash), entry.Bytes()) : -1;
+
+		//a range of the welded streams, from memory or from the stored file
+		auto view = [&](const void* data, uint64_t offset, uint64_t bytes, int target) {
+			return external >= 0 ? glb.AddExternalView(external, offset, bytes, target) : glb.AddView(data, (size_t)bytes, target);
+		};
+		size_t position = glb.AddAccessor(view(w ? w->positions.data() : NULL, entry.PositionOffset(), (uint64_t)entry.numVert * 12, GL_ARRAY_BUFFER),
+			GL_FLOAT, entry.numVert, "VEC3", entry.pmin, entry.pmax, 3);
+		size_t normal = glb.AddAccessor(view(w ? w->normals.data() : NULL, entry.NormalOffset(), (uint64_t)entry.numVert * 12, GL_ARRAY_BUFFER),
+			GL_FLOAT, entry.numVert, "VEC3");
+		size_t uv = glb.AddAccessor(view(w ? w->uvs.data() : NULL, entry.UVOffset(), (uint64_t)entry.numVert * 8, GL_ARRAY_BUFFER),
+			GL_FLOAT, entry.numVert, "VEC2");
+		size_t tangent = entry.tangents ? glb.AddAccessor(view(w ? w->tangents.data() : NULL, entry.TangentOffset(), (uint64_t)entry.numVert * 16, GL_ARRAY_BUFFER),
+			GL_FLOAT, entry.numVert, "VEC4") : 0;
+
+		//one primitive per material range, sharing the vertex streams; welding keeps the ranges
+		meshIndex[m] = meshIndex.size();
+		meshes.Sep(first).Raw("{\"name\":").Str(m->name).Raw(",\"primitives\":[");
+		bool firstPrimitive = true;
+		for (const SubMesh& sub : MaterialRanges(m->matname, entry.numTris, m->subMeshes))
+		{
+			const size_t numIndices = (size_t)sub.numTris * 3;
+			size_t indices = glb.AddAccessor(view(w ? w->indices.data() + (size_t)sub.firstTri * 3 : NULL,
+				entry.IndexOffset() + (uint64_t)sub.firstTri * 12, numIndices * sizeof(uint32_t),
+				GL_ELEMENT_ARRAY_BUFFER), GL_UNSIGNED_INT, numIndices, "SCALAR");
+			meshes.Sep(firstPrimitive).Raw("{\"attributes\":{\"POSITION\":").Int(position)
+				.Raw(",\"NORMAL\":").Int(normal).Raw(",\"TEXCOORD_0\":").Int(uv);
+			if (entry.tangents)
+				meshes.Raw(",\"TANGENT\":").Int(tangent);
+			meshes.Raw("},\"indices\":").Int(indices);
+			auto mat = materialIndex.find(sub.matname);
+			if (mat != materialIndex.end())
+				meshes.Raw(",\"material\":").Int(mat->second);
+			meshes.Raw(",\"mode\":4}");
+		}
+		meshes.Raw("]}");
+	}
+
+	JsonText nodes;
+	first = true;
+	size_t numNodes = 0;
+	std::vector<size_t> roots;
+	for (const MeshNode* pNode : Nodes)
+		WriteNode(nodes, first, numNodes, pNode, meshIndex, &roots);
+
+	JsonText json;
+	json.Raw("{\"asset\":{\"version\":\"2.0\",\"generator\":\"FBXConverter\"},\"scene\":0,\"scenes\":[{\"nodes\":[");
+	for (size_t i = 0; i < roots.size(); ++i)
+	{
+		if (i) json.Raw(",");
+		json.Int(roots[i]);
+	}
+	json.Raw("]}],\"nodes\":[").Raw(nodes.text.c_str()).Raw("],\"meshes\":[").Raw(meshes.text.c_str()).Raw("]");
+	if (!materials.text.empty())
+		json.Raw(",\"materials\":[").Raw(materials.text.c_str()).Raw("]");
+	json.Raw(",\"accessors\":[").Raw(glb.accessors.text.c_str()).Raw("]");
+	json.Raw(",\"bufferViews\":[").Raw(glb.BufferViewsJson().c_str()).Raw("]");
+
+	//.gltf keeps the BIN chunk content in a .bin of the same name
+	std::string binFile;
+	if (!IsGLB(pFilename))
+		binFile = std::filesystem::path(pFilename).replace_extension(".bin").string();
+	std::string buffers = glb.BuffersJson(binFile.empty() ? binFile : RelativeUri(binFile, pFilename));
+	if (!buffers.empty())
+		json.Raw(",\"buffers\":[").Raw(buffers.c_str()).Raw("]");
+	json.Raw("}");
+
+	PROFILE_SCOPE(STAGE_EXPORT, "WriteGLB");
+	bool ok = binFile.empty() ? glb.Write(pFilename, json.text) : glb.WriteText(pFilename, binFile, json.text);
+	return ok ? E_NOERROR : E_FAILOPENFILE;
+}
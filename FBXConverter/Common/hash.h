@@ -0,0 +1,125 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//hash.h
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "parallel.h"
+
+//64-bit xxHash (XXH64) of a buffer, little-endian reads. Fast enough to fingerprint
+//whole input files and mesh buffers; not a cryptographic hash.
+namespace hash_detail
+{
+	const uint64_t P1 = 11400714785074694791ull;
+	const uint64_t P2 = 14029467366897019727ull;
+	const uint64_t P3 = 1609587929392839161ull;
+	const uint64_t P4 = 9650029242287828579ull;
+	const uint64_t P5 = 2870177450012600261ull;
+
+	inline uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	inline uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+	inline uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+	inline uint64_t Round(uint64_t acc, uint64_t input)
+	{
+		acc += input * P2;
+		acc = Rotl(acc, 31);
+		return acc * P1;
+	}
+
+	inline uint64_t MergeRound(uint64_t acc, uint64_t val)
+	{
+		acc ^= Round(0, val);
+		return acc * P1 + P4;
+	}
+}
+
+inline uint64_t Hash64(const void* data, size_t len, uint64_t seed = 0)
+{
+	using namespace hash_detail;
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t* const end = p + len;
+	uint64_t h;
+
+	if (len >= 32)
+	{
+		const uint8_t* const limit = end - 32;
+		uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+		do
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+		h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else
+		h = seed + P5;
+
+	h += (uint64_t)len;
+	for (; p + 8 <= end; p += 8)
+		h = Rotl(h ^ Round(0, Read64(p)), 27) * P1 + P4;
+	if (p + 4 <= end)
+	{
+		h = Rotl(h ^ (uint64_t)Read32(p) * P1, 23) * P2 + P3;
+		p += 4;
+	}
+	for (; p < end; ++p)
+		h = Rotl(h ^ (*p * P5), 11) * P1;
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
+
+//Hash64 of a large array: fixed 1 MB blocks hashed on all cores, then the block digests
+//hashed in order, so the result does not depend on the number of threads
+inline uint64_t HashArray(const void* data, size_t bytes, uint64_t seed = 0)
+{
+	const size_t HASH_BLOCK = 1 << 20;
+	if (bytes <= HASH_BLOCK)
+		return Hash64(data, bytes, seed);
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	std::vector<uint64_t> digests((bytes + HASH_BLOCK - 1) / HASH_BLOCK);
+	ParallelFor(digests.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			digests[i] = Hash64(p + i * HASH_BLOCK, std::min(HASH_BLOCK, bytes - i * HASH_BLOCK), seed);
+	});
+	return Hash64(digests.data(), digests.size() * sizeof(uint64_t), seed);
+}
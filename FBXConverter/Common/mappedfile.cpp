@@ -0,0 +1,145 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+	:_data(NULL), _size(0), _attached(false), _hFile(INVALID_HANDLE_VALUE), _hMapping(NULL)
+{
+}
+
+bool MappedFile::Open(const char* pFilename)
+{
+	Close();
+	_hFile = CreateFileA(pFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_hFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	_size = (size_t)size.QuadPart;
+
+	_hMapping = CreateFileMappingA(_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_hMapping)
+		_data = (const uint8_t*)MapViewOfFile(_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!_data)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data && !_attached)
+		UnmapViewOfFile(_data);
+	if (_hMapping)
+		CloseHandle(_hMapping);
+	if (_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(_hFile);
+	_data = NULL;
+	_size = 0;
+	_attached = false;
+	_hMapping = NULL;
+	_hFile = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+MappedFile::MappedFile()
+	:_data(NULL), _size(0), _attached(false), _fd(-1)
+{
+}
+
+bool MappedFile::Open(const char* pFilename)
+{
+	Close();
+	_fd = open(pFilename, O_RDONLY);
+	if (_fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(_fd, &st) != 0 || st.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	_size = (size_t)st.st_size;
+
+	void* p = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (p == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	_data = (const uint8_t*)p;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data && !_attached)
+		munmap((void*)_data, _size);
+	if (_fd >= 0)
+		close(_fd);
+	_data = NULL;
+	_size = 0;
+	_attached = false;
+	_fd = -1;
+}
+
+#endif
+
+bool MappedFile::Attach(const uint8_t* data, size_t size)
+{
+	Close();
+	if (!data || size == 0)
+		return false;
+	_data = data;
+	_size = size;
+	_attached = true;
+	return true;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
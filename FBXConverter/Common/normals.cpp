@@ -0,0 +1,233 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//normals.cpp
+
+#include "normals.h"
+#include "parallel.h"
+#include "profile.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	const size_t FACE_GRAIN = 1 << 14;		//polygons per parallel chunk
+	const size_t VERTEX_GRAIN = 1 << 14;	//vertices per parallel chunk
+
+	//angle between the edges leaving p towards a and b, 0 for a degenerate corner
+	inline double CornerAngle(const Vector3d& p, const Vector3d& a, const Vector3d& b)
+	{
+		const Vector3d u = a - p, v = b - p;
+		const double sine = u.cross(v).norm(), cosine = u.dot(v);
+		return sine == 0.0 && cosine == 0.0 ? 0.0 : atan2(sine, cosine);
+	}
+}
+
+void GenerateNormals(PolyMesh* pMesh, const int32_t* smoothingGroups, float creaseAngle)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_NORMALS, "GenerateNormals", &pMesh->name);
+	const uint32_t nFaces = pMesh->nFaces, nVertices = pMesh->nVertices;
+	const uint32_t* faceSize = pMesh->FaceIndices.get();
+	const uint32_t* vertsIndices = pMesh->VertsIndices.get();
+	const Vector3d* verts = pMesh->Verts.get();
+
+	std::vector<uint32_t> firstCorner(nFaces + 1, 0);
+	for (uint32_t f = 0; f < nFaces; ++f)
+		firstCorner[f + 1] = firstCorner[f] + faceSize[f];
+	const uint32_t numCorners = firstCorner[nFaces];
+
+	//unit polygon normals, area times angle per corner
+	std::vector<Vector3d> faceNormal(nFaces);
+	std::vector<double> faceArea(nFaces);
+	std::vector<double> cornerWeight(numCorners);
+	std::vector<uint32_t> cornerFace(numCorners);
+	ParallelFor(nFaces, FACE_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t f = begin; f < end; ++f)
+		{
+			const uint32_t first = firstCorner[f], n = faceSize[f];
+			//twice the area vector of a planar polygon, the least squares plane otherwise
+			Vector3d normal = Vector3d::Zero();
+			const Vector3d& origin = verts[vertsIndices[first]];
+			for (uint32_t i = 1; i + 1 < n; ++i)
+				normal += (verts[vertsIndices[first + i]] - origin).cross(verts[vertsIndices[first + i + 1]] - origin);
+			const double length = normal.norm();
+			faceNormal[f] = length > 0.0 ? Vector3d(normal / length) : Vector3d::Zero();
+			faceArea[f] = 0.5 * length;
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				const Vector3d& p = verts[vertsIndices[first + i]];
+				const Vector3d& prev = verts[vertsIndices[first + (i + n - 1) % n]];
+				const Vector3d& next = verts[vertsIndices[first + (i + 1) % n]];
+				cornerWeight[first + i] = faceArea[f] * CornerAngle(p, next, prev);
+				cornerFace[first + i] = (uint32_t)f;
+			}
+		}
+	});
+
+	//corners of every vertex in corner order
+	std::vector<uint32_t> offsets(nVertices + 1, 0), corners(numCorners);
+	for (uint32_t c = 0; c < numCorners; ++c)
+		++offsets[vertsIndices[c] + 1];
+	for (uint32_t v = 0; v < nVertices; ++v)
+		offsets[v + 1] += offsets[v];
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t c = 0; c < numCorners; ++c)
+			corners[fill[vertsIndices[c]]++] = c;
+	}
+
+	//Every corner gets the normalized sum of the corners of its smoothing class at the vertex.
+	//With smoothing groups a class is the corners whose groups share a bit with the corner's
+	//own. Otherwise polygons are in one class when they are connected across edges at the
+	//vertex between polygons within the crease angle; a vertex whose polygons are all within
+	//the crease angle of each other is one class. A degenerate polygon takes the normal of
+	//everything around it and joins no class. Sums run in corner order, so the result does
+	//not depend on the number of threads.
+	const double crease = std::min(std::max(creaseAngle, 0.0f), 180.0f) * 3.14159265358979323846 / 180.0;
+	const double cosCrease = cos(crease), cosHalfCrease = cos(0.5 * crease);
+	const bool allSmooth = !smoothingGroups && creaseAngle >= 180.0f;
+
+	Vector3d* normals = pMesh->Normals.get();
+	ParallelFor(nVertices, VERTEX_GRAIN, [&](size_t begin, size_t end) {
+		std::vector<std::pair<uint32_t, uint32_t> > edges;	//other end of an edge at the vertex, local corner
+		std::vector<uint32_t> parent, order;
+		std::vector<Vector3d> sums;
+		auto find = [&](uint32_t i) {
+			while (parent[i] != i)
+				i = parent[i] = parent[parent[i]];
+			return i;
+		};
+
+		for (size_t v = begin; v < end; ++v)
+		{
+			const uint32_t* first = corners.data() + offsets[v];
+			const uint32_t n = offsets[v + 1] - offsets[v];
+			auto face = [&](uint32_t i) { return cornerFace[first[i]]; };
+			auto weighted = [&](uint32_t i) { return Vector3d(cornerWeight[first[i]] * faceNormal[face(i)]); };
+
+			Vector3d all = Vector3d::Zero();
+			for (uint32_t i = 0; i < n; ++i)
+				all += weighted(i);
+			auto setNormal = [&](uint32_t i, const Vector3d& sum) {
+				const double length = sum.norm();
+				normals[first[i]] = length > 0.0 ? Vector3d(sum / length) : faceNormal[face(i)];
+			};
+
+			//all polygons within the crease angle of each other when they lie within half of
+			//it around their mean normal
+			bool oneClass = allSmooth;
+			if (!oneClass && !smoothingGroups)
+			{
+				Vector3d mean = Vector3d::Zero();
+				for (uint32_t i = 0; i < n; ++i)
+					mean += faceNormal[face(i)];
+				const double length = mean.norm();
+				oneClass = true;
+				for (uint32_t i = 0; i < n && oneClass; ++i)
+					oneClass = faceArea[face(i)] == 0.0 || (length > 0.0 && faceNormal[face(i)].dot(mean) >= cosHalfCrease * length);
+			}
+			if (oneClass)
+			{
+				for (uint32_t i = 0; i < n; ++i)
+					setNormal(i, all);
+				continue;
+			}
+
+			sums.assign(n, Vector3d::Zero());
+			if (smoothingGroups)
+			{
+				//one sum per distinct group mask, a corner without groups keeps its polygon normal
+				order.resize(n);
+				for (uint32_t i = 0; i < n; ++i)
+					order[i] = i;
+				std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+					return smoothingGroups[face(a)] != smoothingGroups[face(b)] ? smoothingGroups[face(a)] < smoothingGroups[face(b)] : a < b;
+				});
+				for (uint32_t k = 0; k < n; )
+				{
+					const int32_t mask = smoothingGroups[face(order[k])];
+					uint32_t runEnd = k;
+					while (runEnd < n && smoothingGroups[face(order[runEnd])] == mask)
+						++runEnd;
+					Vector3d sum = Vector3d::Zero();
+					if (mask != 0)
+					{
+						for (uint32_t i = 0; i < n; ++i)
+							if ((smoothingGroups[face(i)] & mask) != 0)
+								sum += weighted(i);
+					}
+					for (; k < runEnd; ++k)
+					{
+						const uint32_t i = order[k];
+						if (faceArea[face(i)] == 0.0)
+							setNormal(i, all);
+						else
+							setNormal(i, mask != 0 ? sum : faceNormal[face(i)]);
+					}
+				}
+				continue;
+			}
+
+			//union the polygons across the smooth edges at the vertex: edges are matched by
+			//their other end, after sorting
+			edges.clear();
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				const uint32_t f = face(i), c = first[i], firstOfFace = firstCorner[f], size = faceSize[f];
+				const uint32_t at = c - firstOfFace;
+				const uint32_t prev = vertsIndices[firstOfFace + (at + size - 1) % size];
+				const uint32_t next = vertsIndices[firstOfFace + (at + 1) % size];
+				if (prev != v)
+					edges.emplace_back(prev, i);
+				if (next != v && next != prev)
+					edges.emplace_back(next, i);
+			}
+			std::sort(edges.begin(), edges.end());
+			//corners of one polygon at the vertex are consecutive and always together
+			parent.resize(n);
+			for (uint32_t i = 0; i < n; ++i)
+				parent[i] = i > 0 && face(i) == face(i - 1) ? i - 1 : i;
+			for (size_t e = 0; e < edges.size(); )
+			{
+				size_t runEnd = e + 1;
+				while (runEnd < edges.size() && edges[runEnd].first == edges[e].first)
+					++runEnd;
+				//polygons sharing the edge, more than two only at a non-manifold edge
+				for (size_t a = e; a + 1 < runEnd; ++a)
+				{
+					const uint32_t i = edges[a].second, j = edges[a + 1].second;
+					const uint32_t f = face(i), g = face(j);
+					if (faceArea[f] > 0.0 && faceArea[g] > 0.0 && faceNormal[f].dot(faceNormal[g]) >= cosCrease)
+						parent[find(i)] = find(j);
+				}
+				e = runEnd;
+			}
+			for (uint32_t i = 0; i < n; ++i)
+				sums[find(i)] += weighted(i);
+			for (uint32_t i = 0; i < n; ++i)
+				setNormal(i, faceArea[face(i)] == 0.0 ? all : sums[find(i)]);
+		}
+	});
+}
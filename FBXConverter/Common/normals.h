@@ -0,0 +1,42 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//normals.h
+
+#pragma once
+
+#include <stdint.h>
+#include "polymesh.h"
+
+//Corner normals for a PolyMesh read without usable normals, written to pMesh->Normals
+//(allocated by the caller, one per corner). Each corner gets the normal of its vertex over
+//the polygons around it that are smooth with its own polygon, every polygon weighted by its
+//area and by its corner angle at the vertex, then normalized. Polygons are smooth when their
+//smoothing groups share a bit (group 0 is flat); without groups (smoothingGroups NULL) when
+//their normals are at most creaseAngle degrees apart.
+//
+//The vertex to corner adjacency is built by counting sort, then each vertex gathers the
+//corners around it and writes only its own corners, so vertices run in parallel chunks
+//without atomics and the result does not depend on the number of threads.
+void GenerateNormals(PolyMesh* pMesh, const int32_t* smoothingGroups, float creaseAngle);
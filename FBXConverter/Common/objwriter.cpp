@@ -0,0 +1,252 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "objwriter.h"
+#include "compactmesh.h"
+#include "weld.h"
+#include "profile.h"
+#include <stdio.h>
+
+//faces without a material that follow named ones; usemtl stays in effect until the next one
+static const char DEFAULT_MATERIAL[] = "default";
+
+//false when the library cannot be written completely; withDefault adds DEFAULT_MATERIAL
+//unless the scene has a material of that name
+static bool WriteMaterials(const std::map<std::string, Material*> &materials, const char * filename, bool withDefault)
+{
+	std::string fileName = std::string(filename);
+	fileName += ".mtl";
+
+	if (materials.size() > 0 || withDefault)
+	{
+		PROFILE_SCOPE(STAGE_EXPORT, "WriteMaterials");
+		TextWriter out;
+		if (!out.Open(fileName.c_str()))return false;
+
+		out.Put("#\n# Wavefront material file\n# Created with Dolphin FBX \n#\n\n");
+
+		auto writeMaterial = [&](const Material* pMaterial) {
+			out.Put("newmtl ").Put(pMaterial->materialName).Put('\n');
+			out.PutLine("Ka", pMaterial->Ka.data(), 3, 6);
+			out.PutLine("Kd", pMaterial->Kd.data(), 3, 6);
+			out.PutLine("Ks", pMaterial->Ks.data(), 3, 6);
+			out.Put("Tr ").PutFloat(pMaterial->Tr, 6).Put('\n');
+			out.Put("Ns ").PutFloat(pMaterial->Ns, 6).Put('\n');
+
+			out.Put('\n');
+		};
+		std::map<std::string, Material*>::const_iterator iter2;
+		for (iter2 = materials.begin(); iter2 != materials.end(); ++iter2)
+			writeMaterial(iter2->second);
+		if (withDefault && materials.find(DEFAULT_MATERIAL) == materials.end())
+		{
+			Material defaultMaterial;
+			defaultMaterial.materialName = DEFAULT_MATERIAL;
+			writeMaterial(&defaultMaterial);
+		}
+
+		PROFILE_COUNT(COUNTER_BYTES_WRITTEN, out.BytesWritten());
+		return out.Close();
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+ObjWriter::ObjWriter(const ExportOptions& options)
+	:_options(options), _vplus(1), _vtplus(1), _meshes(0), _materialSet(false), _defaultUsed(false)
+{
+}
+
+void ObjWriter::UseMaterial(const std::string& matname)
+{
+	if (!matname.empty())
+	{
+		_out.Put("usemtl ").Put(matname).Put('\n');
+		_materialSet = true;
+	}
+	else if (_materialSet)
+	{
+		_out.Put("usemtl ").Put(DEFAULT_MATERIAL).Put('\n');
+		_materialSet = false;
+		_defaultUsed = true;
+	}
+}
+
+bool ObjWriter::Open(const char* pFilename, bool withMaterials)
+{
+	if (!_out.Open(pFilename))
+		return false;
+	_filename = pFilename;
+
+	std::string shortFilename(pFilename);
+	int LastSlash = shortFilename.size() - 1;
+	while (LastSlash >= 0 && shortFilename[LastSlash] != '/' && shortFilename[LastSlash] != '\\')
+		--LastSlash;
+	shortFilename = shortFilename.substr(LastSlash + 1);
+	int len = shortFilename.length() - 4;
+	shortFilename = shortFilename.substr(0, len);
+
+	_out.Put("###################\n#\n# Wavefront OBJ File\n# Created with Dolphin FBX\n#\n###################\n\n");
+
+	//library material
+	if (withMaterials)
+		_out.Put("mtllib ./").Put(shortFilename).Put(".mtl\n\n");
+	return true;
+}
+
+void ObjWriter::WriteMesh(const TriMesh* m, const WeldedMesh* w, const std::string* pGroupName)
+{
+	const std::string& groupName = pGroupName ? *pGroupName : m->name;
+	PROFILE_SCOPE_DETAIL(STAGE_EXPORT, "WriteMesh", &groupName);
+	const int pp = _options.positionPrecision, np = _options.normalPrecision, tp = _options.uvPrecision;
+	TextWriter& out = _out;
+	++_meshes;
+	out.Put("g ").Put(groupName).Put('\n');
+	if (w)
+	{
+		//one index space: v, vt and vn share the vertex number
+		for (uint32_t i = 0; i < w->numVert; ++i)
+			out.PutLine("v", &w->positions[i * 3], 3, pp);
+		for (uint32_t i = 0; i < w->numVert; ++i)
+			out.PutLine("vt", &w->uvs[i * 2], 2, tp);
+		for (uint32_t i = 0; i < w->numVert; ++i)
+			out.PutLine("vn", &w->normals[i * 3], 3, np);
+		for (const SubMesh& sub : MaterialRanges(w->matname, w->numTris, w->subMeshes))
+		{
+			UseMaterial(sub.matname);
+			for (size_t i = 0, l = (size_t)sub.firstTri * 3; i < sub.numTris; ++i, l += 3)
+			{
+				out.Put("f ", 2);
+				for (unsigned k = 0; k < 3; ++k)
+				{
+					int64_t vn = (int64_t)w->indices[l + k] + _vplus;
+					out.PutInt(vn).Put('/').PutInt(vn).Put('/').PutInt(vn).Put(' ');
+				}
+				out.Put('\n');
+			}
+		}
+		_vplus += w->numVert;
+		_vtplus += w->numVert;
+		return;
+	}
+
+	/*********************************** VERTICES *********************************/
+	for (uint32_t i = 0; i < m->numVert; ++i)
+	{
+		out.PutLine("v", m->P[i].data(), 3, pp);
+	}
+
+	for (uint32_t i = 0; i < m->numUV; ++i)
+	{
+		out.PutLine("vt", m->UV[i].data(), 2, tp);
+	}
+
+	for (uint32_t i = 0; i < m->numVert; ++i)
+	{
+		out.PutLine("vn", m->PN[i].data(), 3, np);
+	}
+
+	//one usemtl per material range
+	for (const SubMesh& sub : MaterialRanges(m->matname, m->numTris, m->subMeshes))
+	{
+		UseMaterial(sub.matname);
+		size_t l = (size_t)sub.firstTri * 3;
+		for (uint32_t i = 0; i < sub.numTris; ++i)
+		{
+			out.Put("f ", 2);
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				int64_t vn = (int64_t)m->triIndex[l + k] + _vplus;
+				int64_t tn = (int64_t)m->UVIndices[l + k] + _vtplus;
+				out.PutInt(vn).Put('/').PutInt(tn).Put('/').PutInt(vn).Put(' ');
+			}
+			out.Put('\n');
+			l += 3;
+		}
+	}
+
+	_vplus += m->numVert;
+	_vtplus += m->numUV;
+}
+
+void ObjWriter::WriteMesh(const CompactMesh* m, const std::string* pGroupName)
+{
+	const std::string& groupName = pGroupName ? *pGroupName : m->name;
+	PROFILE_SCOPE_DETAIL(STAGE_EXPORT, "WriteMesh", &groupName);
+	const int pp = _options.positionPrecision, np = _options.normalPrecision, tp = _options.uvPrecision;
+	TextWriter& out = _out;
+	++_meshes;
+	out.Put("g ").Put(groupName).Put('\n');
+
+	double value[3];
+	for (uint32_t i = 0; i < m->numVert; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			value[c] = m->P.Get(i, c);
+		out.PutLine("v", value, 3, pp);
+	}
+	for (uint32_t i = 0; i < m->numUV; ++i)
+	{
+		for (int c = 0; c < 2; ++c)
+			value[c] = m->UV.Get(i, c);
+		out.PutLine("vt", value, 2, tp);
+	}
+	for (uint32_t i = 0; i < m->numVert; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			value[c] = m->PN.Get(i, c);
+		out.PutLine("vn", value, 3, np);
+	}
+
+	for (const SubMesh& sub : MaterialRanges(m->matname, m->numTris, m->subMeshes))
+	{
+		UseMaterial(sub.matname);
+		for (size_t i = 0, l = (size_t)sub.firstTri * 3; i < sub.numTris; ++i, l += 3)
+		{
+			out.Put("f ", 2);
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				int64_t vn = (int64_t)m->triIndex[l + k] + _vplus;
+				int64_t tn = (int64_t)m->UVIndices[l + k] + _vtplus;
+				out.PutInt(vn).Put('/').PutInt(tn).Put('/').PutInt(vn).Put(' ');
+			}
+			out.Put('\n');
+		}
+	}
+
+	_vplus += m->numVert;
+	_vtplus += m->numUV;
+}
+
+bool ObjWriter::Close(const std::map<std::string, Material*>& materials)
+{
+	PROFILE_COUNT(COUNTER_BYTES_WRITTEN, _out.BytesWritten());
+	const bool ok = _out.Close();
+
+	//the material library sits next to the obj file, as referenced by mtllib above
+	std::string mtlfile(_filename);
+	mtlfile = mtlfile.substr(0, mtlfile.length() - 4);
+	return WriteMaterials(materials, mtlfile.c_str(), _defaultUsed) && ok;
+}
@@ -0,0 +1,73 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//objwriter.h
+
+#pragma once
+
+#include <map>
+#include <string>
+#include "scene.h"
+#include "textwriter.h"
+
+struct WeldedMesh;
+class CompactMesh;
+
+//Wavefront OBJ writer that takes one mesh at a time. The running v/vt numbering is
+//carried from mesh to mesh, so a file written while streaming is identical to one
+//written from a fully extracted scene.
+class ObjWriter
+{
+public:
+	explicit ObjWriter(const ExportOptions& options);
+
+	//write the header, and the mtllib line when the scene has materials
+	bool Open(const char* pFilename, bool withMaterials);
+
+	//append a mesh; with pWelded its welded vertices are written, sharing one v/vt/vn index;
+	//the group is named after the mesh unless pGroupName is given
+	void WriteMesh(const TriMesh* m, const WeldedMesh* pWelded = nullptr, const std::string* pGroupName = nullptr);
+	//same as an unwelded TriMesh, from the values stored in the compact streams
+	void WriteMesh(const CompactMesh* m, const std::string* pGroupName = nullptr);
+
+	//close the obj and write the material library next to it; false when either file
+	//could not be written completely
+	bool Close(const std::map<std::string, Material*>& materials);
+
+	size_t MeshesWritten() const { return _meshes; }
+
+private:
+	//usemtl for a material range; a range without a material after a named one switches to
+	//a default material, which Close adds to the library
+	void UseMaterial(const std::string& matname);
+
+	TextWriter _out;
+	std::string _filename;
+	ExportOptions _options;
+	int64_t _vplus;	//number of the first v/vn of the next mesh, past 32 bits in large combined files
+	int64_t _vtplus;
+	size_t _meshes;
+	bool _materialSet;	//a named usemtl is in effect
+	bool _defaultUsed;
+};
@@ -0,0 +1,386 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "optimize.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	const int CACHE_SIZE = 32;		//simulated LRU cache of the Forsyth scoring
+	const int MAX_VALENCE = 32;		//remaining triangle counts above this score the same
+	const int FIFO_SIZE = 16;		//FIFO cache used for the statistics and cluster cuts
+	const uint32_t NONE = 0xffffffffu;
+
+	struct ForsythScores
+	{
+		float cache[CACHE_SIZE];
+		float valence[MAX_VALENCE];
+
+		ForsythScores()
+		{
+			//the last triangle's vertices get a fixed score so the next one does not
+			//simply reuse the same edge, older entries decay with the cache position
+			for (int i = 0; i < CACHE_SIZE; ++i)
+				cache[i] = i < 3 ? 0.75f : powf(1.0f - (float)(i - 3) / (CACHE_SIZE - 3), 1.5f);
+			//vertices with few triangles left are boosted so they get finished off
+			valence[0] = 0.0f;
+			for (int i = 1; i < MAX_VALENCE; ++i)
+				valence[i] = 2.0f * powf((float)i, -0.5f);
+		}
+
+		float Vertex(int cachePos, uint32_t remaining) const
+		{
+			float score = valence[std::min<uint32_t>(remaining, MAX_VALENCE - 1)];
+			if (cachePos >= 0)
+				score += cache[cachePos];
+			return score;
+		}
+	};
+
+	inline bool FifoAccess(std::vector<uint32_t>& stamp, uint32_t& time, uint32_t v)
+	{
+		if (time - stamp[v] <= FIFO_SIZE)
+			return true;
+		stamp[v] = time++;
+		return false;
+	}
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVert, unsigned cacheSize)
+{
+	VertexCacheStats stats;
+	if (numIndices < 3 || numVert == 0)
+		return stats;
+
+	std::vector<uint32_t> stamp(numVert, 0);
+	uint32_t time = cacheSize + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < numIndices; ++i)
+	{
+		uint32_t v = indices[i];
+		assert(v < numVert);
+		if (time - stamp[v] > cacheSize)
+		{
+			stamp[v] = time++;
+			++misses;
+		}
+	}
+	stats.acmr = (double)misses / (double)(numIndices / 3);
+	stats.atvr = (double)misses / (double)numVert;
+	return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t numIndices, size_t numVert)
+{
+	const size_t numTris = numIndices / 3;
+	if (numTris < 2 || numVert == 0)
+		return;
+	static const ForsythScores scores;
+
+	//vertex -> live triangles, by counting sort; a vertex's list shrinks as its triangles are emitted
+	std::vector<uint32_t> remaining(numVert, 0);
+	for (size_t i = 0; i < numTris * 3; ++i)
+		++remaining[indices[i]];
+	std::vector<uint32_t> offset(numVert + 1);
+	offset[0] = 0;
+	for (size_t v = 0; v < numVert; ++v)
+		offset[v + 1] = offset[v] + remaining[v];
+	std::vector<uint32_t> adjacency(numTris * 3);
+	{
+		std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+		for (size_t i = 0; i < numTris * 3; ++i)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePos(numVert, -1);
+	std::vector<float> vertexScore(numVert);
+	for (size_t v = 0; v < numVert; ++v)
+		vertexScore[v] = scores.Vertex(-1, remaining[v]);
+
+	std::vector<uint8_t> emitted(numTris, 0);
+	uint32_t best = 0;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < numTris; ++t)
+	{
+		const uint32_t* tri = indices + t * 3;
+		float score = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+		if (score > bestScore)
+		{
+			bestScore = score;
+			best = (uint32_t)t;
+		}
+	}
+
+	std::vector<uint32_t> output(numTris * 3);
+	uint32_t cache[CACHE_SIZE + 3], newCache[CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t scan = 0;
+	for (size_t n = 0; n < numTris; ++n)
+	{
+		if (best == NONE)
+		{
+			//dead end: nothing in the cache has triangles left, take the next unemitted one
+			while (emitted[scan])
+				++scan;
+			best = (uint32_t)scan;
+		}
+
+		const uint32_t* tri = indices + (size_t)best * 3;
+		memcpy(&output[n * 3], tri, 3 * sizeof(uint32_t));
+		emitted[best] = 1;
+
+		for (int k = 0; k < 3; ++k)
+		{
+			uint32_t v = tri[k];
+			uint32_t* adj = &adjacency[offset[v]];
+			uint32_t r = remaining[v];
+			for (uint32_t j = 0; j < r; ++j)
+				if (adj[j] == best)
+				{
+					adj[j] = adj[r - 1];
+					break;
+				}
+			remaining[v] = r - 1;
+		}
+
+		//the emitted triangle moves to the front of the LRU cache
+		int newCount = 0;
+		for (int k = 0; k < 3; ++k)
+			if (std::find(newCache, newCache + newCount, tri[k]) == newCache + newCount)
+				newCache[newCount++] = tri[k];
+		for (int i = 0; i < cacheCount; ++i)
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				newCache[newCount++] = cache[i];
+		for (int i = CACHE_SIZE; i < newCount; ++i)
+		{
+			cachePos[newCache[i]] = -1;
+			vertexScore[newCache[i]] = scores.Vertex(-1, remaining[newCache[i]]);
+		}
+		cacheCount = std::min(newCount, CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+		for (int i = 0; i < cacheCount; ++i)
+		{
+			cachePos[cache[i]] = i;
+			vertexScore[cache[i]] = scores.Vertex(i, remaining[cache[i]]);
+		}
+
+		//only triangles touching the cache changed score, the best candidate is among them
+		best = NONE;
+		bestScore = -1.0f;
+		for (int i = 0; i < cacheCount; ++i)
+		{
+			uint32_t v = cache[i];
+			const uint32_t* adj = &adjacency[offset[v]];
+			for (uint32_t j = 0; j < remaining[v]; ++j)
+			{
+				uint32_t t = adj[j];
+				const uint32_t* ti = indices + (size_t)t * 3;
+				float score = vertexScore[ti[0]] + vertexScore[ti[1]] + vertexScore[ti[2]];
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+	}
+	memcpy(indices, output.data(), numTris * 3 * sizeof(uint32_t));
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t numIndices, const float* positions, size_t numVert)
+{
+	const size_t numTris = numIndices / 3;
+	if (numTris < 2 || numVert == 0)
+		return;
+
+	//cluster starts: triangles missing the FIFO cache on all three vertices
+	std::vector<uint32_t> clusters;
+	{
+		std::vector<uint32_t> stamp(numVert, 0);
+		uint32_t time = FIFO_SIZE + 1;
+		for (size_t t = 0; t < numTris; ++t)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; ++k)
+				misses += FifoAccess(stamp, time, indices[t * 3 + k]) ? 0 : 1;
+			if (t == 0 || misses == 3)
+				clusters.push_back((uint32_t)t);
+		}
+	}
+	const size_t numClusters = clusters.size();
+	if (numClusters < 2)
+		return;
+	clusters.push_back((uint32_t)numTris);
+
+	//area weighted centroid and normal of every cluster and of the whole mesh
+	std::vector<double> centroid(numClusters * 3, 0.0), normal(numClusters * 3, 0.0);
+	double meshCenter[3] = { 0.0, 0.0, 0.0 }, meshArea = 0.0;
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		double area = 0.0;
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+		{
+			const float* p0 = positions + (size_t)indices[t * 3] * 3;
+			const float* p1 = positions + (size_t)indices[t * 3 + 1] * 3;
+			const float* p2 = positions + (size_t)indices[t * 3 + 2] * 3;
+			double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			double a = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; ++k)
+			{
+				centroid[c * 3 + k] += a * (p0[k] + p1[k] + p2[k]) / 3.0;
+				normal[c * 3 + k] += n[k];
+			}
+			area += a;
+		}
+		for (int k = 0; k < 3; ++k)
+			meshCenter[k] += centroid[c * 3 + k];
+		meshArea += area;
+		if (area > 0.0)
+			for (int k = 0; k < 3; ++k)
+				centroid[c * 3 + k] /= area;
+	}
+	if (meshArea <= 0.0)
+		return;
+	for (int k = 0; k < 3; ++k)
+		meshCenter[k] /= meshArea;
+
+	//clusters facing away from the center are likely in front, draw them first
+	std::vector<double> key(numClusters);
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		const double* n = &normal[c * 3];
+		double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		double d = 0.0;
+		for (int k = 0; k < 3; ++k)
+			d += (centroid[c * 3 + k] - meshCenter[k]) * n[k];
+		key[c] = len > 0.0 ? d / len : 0.0;
+	}
+	std::vector<uint32_t> order(numClusters);
+	for (size_t c = 0; c < numClusters; ++c)
+		order[c] = (uint32_t)c;
+	std::stable_sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) { return key[a] > key[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(numTris * 3);
+	for (uint32_t c : order)
+		output.insert(output.end(), indices + (size_t)clusters[c] * 3, indices + (size_t)clusters[c + 1] * 3);
+	memcpy(indices, output.data(), numTris * 3 * sizeof(uint32_t));
+}
+
+void OptimizeVertexFetch(WeldedMesh* pMesh)
+{
+	assert(pMesh);
+	std::vector<uint32_t> remap(pMesh->numVert, NONE);
+	uint32_t next = 0;
+	for (uint32_t& index : pMesh->indices)
+	{
+		if (remap[index] == NONE)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	//unreferenced vertices are dropped
+	std::vector<float> positions(next * 3), normals(next * 3), uvs(next * 2), tangents(pMesh->tangents.empty() ? 0 : next * 4);
+	for (uint32_t v = 0; v < pMesh->numVert; ++v)
+	{
+		uint32_t r = remap[v];
+		if (r == NONE)
+			continue;
+		memcpy(&positions[r * 3], &pMesh->positions[v * 3], 3 * sizeof(float));
+		memcpy(&normals[r * 3], &pMesh->normals[v * 3], 3 * sizeof(float));
+		memcpy(&uvs[r * 2], &pMesh->uvs[v * 2], 2 * sizeof(float));
+		if (!tangents.empty())
+			memcpy(&tangents[r * 4], &pMesh->tangents[v * 4], 4 * sizeof(float));
+	}
+	pMesh->positions.swap(positions);
+	pMesh->normals.swap(normals);
+	pMesh->uvs.swap(uvs);
+	pMesh->tangents.swap(tangents);
+	pMesh->numVert = next;
+}
+
+void OptimizeWeldedMesh(WeldedMesh* pMesh, bool overdraw, VertexCacheStats* before, VertexCacheStats* after)
+{
+	assert(pMesh);
+	uint32_t* indices = pMesh->indices.data();
+	const size_t numIndices = pMesh->indices.size();
+	if (before)
+		*before = AnalyzeVertexCache(indices, numIndices, pMesh->numVert);
+	//triangles only move inside their material range
+	std::vector<SubMesh> ranges = MaterialRanges(pMesh->matname, pMesh->numTris, pMesh->subMeshes);
+	if (ranges.size() == 1)
+	{
+		OptimizeVertexCache(indices, numIndices, pMesh->numVert);
+		if (overdraw)
+			OptimizeOverdraw(indices, numIndices, pMesh->positions.data(), pMesh->numVert);
+		OptimizeVertexFetch(pMesh);
+		if (after)
+			*after = AnalyzeVertexCache(pMesh->indices.data(), pMesh->indices.size(), pMesh->numVert);
+		return;
+	}
+
+	//the passes allocate per vertex, so each range is renumbered into the vertices it uses;
+	//localOf is shared by the ranges and only the entries of the range are reset
+	std::vector<uint32_t> localOf(pMesh->numVert, NONE), globalOf, local;
+	std::vector<float> positions;
+	for (const SubMesh& sub : ranges)
+	{
+		uint32_t* range = indices + (size_t)sub.firstTri * 3;
+		const size_t count = (size_t)sub.numTris * 3;
+		globalOf.clear();
+		local.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t& l = localOf[range[i]];
+			if (l == NONE)
+			{
+				l = (uint32_t)globalOf.size();
+				globalOf.push_back(range[i]);
+			}
+			local[i] = l;
+		}
+		OptimizeVertexCache(local.data(), count, globalOf.size());
+		if (overdraw)
+		{
+			positions.resize(globalOf.size() * 3);
+			for (size_t v = 0; v < globalOf.size(); ++v)
+				memcpy(&positions[v * 3], &pMesh->positions[(size_t)globalOf[v] * 3], 3 * sizeof(float));
+			OptimizeOverdraw(local.data(), count, positions.data(), globalOf.size());
+		}
+		for (size_t i = 0; i < count; ++i)
+			range[i] = globalOf[local[i]];
+		for (uint32_t v : globalOf)
+			localOf[v] = NONE;
+	}
+	OptimizeVertexFetch(pMesh);
+	if (after)
+		*after = AnalyzeVertexCache(pMesh->indices.data(), pMesh->indices.size(), pMesh->numVert);
+}
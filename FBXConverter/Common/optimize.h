@@ -0,0 +1,58 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//optimize.h
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "weld.h"
+
+//post-transform vertex cache behaviour of an index buffer, simulated as a FIFO cache
+struct VertexCacheStats
+{
+	double acmr = 0.0;	//average cache miss ratio: vertex shader runs per triangle (0.5 ideal, 3 worst)
+	double atvr = 0.0;	//average transformed vertex ratio: vertex shader runs per vertex (1 ideal)
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t numIndices, size_t numVert, unsigned cacheSize = 16);
+
+//Reorder triangles for vertex cache locality (Forsyth, "Linear-Speed Vertex Cache
+//Optimisation"). Runs in O(triangles * cache size): the next triangle is picked among
+//those touching the simulated LRU cache, with a forward scan when that runs dry.
+void OptimizeVertexCache(uint32_t* indices, size_t numIndices, size_t numVert);
+
+//Reorder the clusters of an already cache-optimized index buffer front to back
+//(Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+//Clusters are cut where a triangle misses the cache on all three vertices, so the
+//cache efficiency is kept; they are sorted by how much they face away from the center.
+void OptimizeOverdraw(uint32_t* indices, size_t numIndices, const float* positions, size_t numVert);
+
+//Renumber vertices in order of first use by the index buffer and permute the streams,
+//so vertex fetch walks memory forward.
+void OptimizeVertexFetch(WeldedMesh* pMesh);
+
+//the three passes above in order, cache and overdraw within each material range; before/after may be NULL
+void OptimizeWeldedMesh(WeldedMesh* pMesh, bool overdraw, VertexCacheStats* before, VertexCacheStats* after);
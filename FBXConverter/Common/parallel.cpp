@@ -0,0 +1,145 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//parallel.cpp
+
+#include "parallel.h"
+#include <string>
+
+ParallelPool& ParallelPool::Instance()
+{
+	static ParallelPool pool;
+	return pool;
+}
+
+ParallelPool::ParallelPool()
+	:_stop(false)
+{
+	//the caller of a loop is one of its threads
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i + 1 < cores; ++i)
+		_threads.emplace_back(&ParallelPool::ThreadMain, this, i);
+}
+
+ParallelPool::~ParallelPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_posted.notify_all();
+	for (std::thread& t : _threads)
+		t.join();
+}
+
+void ParallelPool::Run(size_t numTasks, const std::function<void(size_t)>& task)
+{
+	Job job;
+	job.task = &task;
+	job.numTasks = numTasks;
+	job.wanted = std::min(numTasks > 0 ? numTasks - 1 : 0, _threads.size());
+	job.stats = Profiler::CurrentStats();
+	if (job.wanted > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.push_back(&job);
+		}
+		if (job.wanted == 1)
+			_posted.notify_one();
+		else
+			_posted.notify_all();
+	}
+
+	Work(job);
+
+	//no pool thread takes the job once it is off the queue, then wait for the ones on it
+	if (job.wanted > 0)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = std::find(_jobs.begin(), _jobs.end(), &job);
+		if (it != _jobs.end())
+			_jobs.erase(it);
+	}
+	std::unique_lock<std::mutex> lock(job.mutex);
+	job.done.wait(lock, [&]() { return job.finished == job.numTasks && job.refs == 0; });
+	if (job.error)
+		std::rethrow_exception(job.error);
+}
+
+void ParallelPool::Work(Job& job)
+{
+	size_t count = 0;
+	for (size_t i = job.next++; i < job.numTasks; i = job.next++, ++count)
+	{
+		if (job.failed)
+			continue;
+		try
+		{
+			(*job.task)(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(job.mutex);
+			if (!job.error)
+				job.error = std::current_exception();
+			job.failed = true;
+		}
+	}
+	if (count > 0)
+	{
+		std::lock_guard<std::mutex> lock(job.mutex);
+		job.finished += count;
+		if (job.finished == job.numTasks)
+			job.done.notify_all();
+	}
+}
+
+void ParallelPool::ThreadMain(unsigned int index)
+{
+	Profiler::SetThreadName("parallel " + std::to_string(index + 1));
+	for (;;)
+	{
+		Job* pJob;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_posted.wait(lock, [&]() { return _stop || !_jobs.empty(); });
+			if (_jobs.empty())
+				return;
+			pJob = _jobs.front();
+			++pJob->refs;
+			if (++pJob->helpers == pJob->wanted)
+				_jobs.pop_front();
+		}
+
+		//the tasks add to the profile stats of the file the caller works on
+		Profiler::CurrentStats() = pJob->stats;
+		Work(*pJob);
+		Profiler::CurrentStats() = nullptr;
+
+		std::lock_guard<std::mutex> lock(pJob->mutex);
+		--pJob->refs;
+		pJob->done.notify_all();
+	}
+}
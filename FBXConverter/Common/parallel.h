@@ -0,0 +1,160 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//parallel.h
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "profile.h"
+
+//Maximum number of threads ParallelFor may use from the calling thread, 0 for all cores.
+//Batch workers lower it so that nested loops don't oversubscribe the machine.
+inline unsigned int& ParallelThreadLimit()
+{
+	thread_local unsigned int limit = 0;
+	return limit;
+}
+
+//Threads shared by the parallel loops, started on first use and kept until exit. A loop
+//posts a job that the calling thread works on too, and free pool threads join it. Tasks are
+//claimed from a counter, so the caller only ever waits for tasks already running and loops
+//nested in a task cannot deadlock. Several threads (batch workers) can post at once.
+class ParallelPool
+{
+public:
+	static ParallelPool& Instance();
+
+	//call task(i) for every i in [0, numTasks) on the calling thread and at most numTasks - 1
+	//pool threads, in the profile stats of the caller. After the first exception no new task
+	//starts; it is rethrown here once the running ones are done.
+	void Run(size_t numTasks, const std::function<void(size_t)>& task);
+
+	unsigned int NumThreads() const { return (unsigned int)_threads.size(); }
+
+private:
+	struct Job
+	{
+		const std::function<void(size_t)>* task;
+		size_t numTasks;
+		size_t wanted;				//pool threads that can help
+		size_t helpers = 0;			//pool threads that took the job
+		ProfileStats* stats;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> refs{ 0 };		//pool threads still working on it
+		std::atomic<bool> failed{ false };
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t finished = 0;
+		std::exception_ptr error;
+	};
+
+	ParallelPool();
+	~ParallelPool();
+	ParallelPool(const ParallelPool&) = delete;
+	ParallelPool& operator=(const ParallelPool&) = delete;
+
+	void ThreadMain(unsigned int index);
+	static void Work(Job& job);
+
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _posted;
+	std::deque<Job*> _jobs;
+	bool _stop;
+};
+
+//number of chunks ParallelForChunks splits n items into, each at least grain items
+inline size_t ParallelChunks(size_t n, size_t grain)
+{
+	size_t numThreads = ParallelThreadLimit() ? ParallelThreadLimit() : std::thread::hardware_concurrency();
+	size_t chunks = (n + std::max<size_t>(grain, 1) - 1) / std::max<size_t>(grain, 1);
+	return std::max<size_t>(1, std::min(std::max<size_t>(numThreads, 1), chunks));
+}
+
+//call func(chunk, begin, end) for ParallelChunks(n, grain) contiguous ranges of [0, n) on the
+//calling thread and the ParallelPool; the first exception thrown by func is rethrown here
+template <typename F>
+void ParallelForChunks(size_t n, size_t grain, F func)
+{
+	const size_t numChunks = ParallelChunks(n, grain);
+	const size_t chunkSize = (n + numChunks - 1) / numChunks;
+	if (numChunks <= 1)
+	{
+		func((size_t)0, (size_t)0, n);
+		return;
+	}
+
+	ParallelPool::Instance().Run(numChunks, [&func, n, chunkSize](size_t chunk) {
+		size_t begin = std::min(n, chunk * chunkSize), end = std::min(n, begin + chunkSize);
+		func(chunk, begin, end);
+	});
+}
+
+//call func(begin, end) over [0, n) in parallel ranges of at least grain items
+template <typename F>
+void ParallelFor(size_t n, size_t grain, F func)
+{
+	ParallelForChunks(n, grain, [&func](size_t, size_t begin, size_t end) { func(begin, end); });
+}
+
+//call func(i) for every i in [0, n); threads pull the next index from a shared counter so
+//items of uneven cost balance out. Parallel loops nested in func run serially. The first
+//exception thrown by func is rethrown on the calling thread once all threads are done.
+template <typename F>
+void ParallelForEach(size_t n, F func)
+{
+	const size_t numThreads = ParallelChunks(n, 1);
+	std::atomic<size_t> next(0);
+	auto worker = [&](size_t) {
+		struct Limit
+		{
+			unsigned int saved = ParallelThreadLimit();
+			Limit() { ParallelThreadLimit() = 1; }
+			~Limit() { ParallelThreadLimit() = saved; }
+		} limit;
+		try
+		{
+			for (size_t i = next++; i < n; i = next++)
+				func(i);
+		}
+		catch (...)
+		{
+			next = n;
+			throw;
+		}
+	};
+	if (numThreads <= 1)
+		worker(0);
+	else
+		ParallelPool::Instance().Run(numThreads, worker);
+}
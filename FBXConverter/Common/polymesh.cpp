@@ -0,0 +1,336 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "polymesh.h"
+#include "parallel.h"
+#include "profile.h"
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace
+{
+	const size_t FACE_GRAIN = 16384;
+	const size_t CORNER_GRAIN = 65536;
+
+	enum { FACES_MIXED, FACES_TRIANGLES, FACES_QUADS };
+
+	//largest value of a[begin, end), four independent accumulators so the loop vectorizes
+	uint32_t MaxIndex(const uint32_t* a, size_t begin, size_t end)
+	{
+		uint32_t m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+		size_t i = begin;
+		for (; i + 4 <= end; i += 4)
+		{
+			m0 = std::max(m0, a[i]);
+			m1 = std::max(m1, a[i + 1]);
+			m2 = std::max(m2, a[i + 2]);
+			m3 = std::max(m3, a[i + 3]);
+		}
+		for (; i < end; ++i)
+			m0 = std::max(m0, a[i]);
+		return std::max(std::max(m0, m1), std::max(m2, m3));
+	}
+
+	inline void AtomicMax(std::atomic<uint32_t>& a, uint32_t v)
+	{
+		uint32_t cur = a.load(std::memory_order_relaxed);
+		while (cur < v && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+			;
+	}
+}
+
+TriMesh::TriMesh(const std::string& name, uint32_t numVert, uint32_t numTris, MeshArena* pArena)
+	:name(name), numVert(numVert), numTris(numTris), numUV(numVert)
+{
+	const size_t numTriCorners = (size_t)numTris * 3;
+	P = MakeMeshArray<Vector3d>(numVert, pArena);
+	triIndex = MakeMeshArray<uint32_t>(numTriCorners, pArena);
+	N = MakeMeshArray<Vector3d>(numTriCorners, pArena);
+	T = MakeMeshArray<Vector2d>(numTriCorners, pArena);
+	UVIndices = MakeMeshArray<uint32_t>(numTriCorners, pArena);
+	PN = MakeMeshArray<Vector3d>(numVert, pArena);
+	UV = MakeMeshArray<Vector2d>(numVert, pArena);
+}
+
+TriMesh::TriMesh(const std::string& name)
+	:name(name), numVert(0), numTris(0), numUV(0)
+{
+}
+
+TriMesh::TriMesh(const PolyMesh* pMesh, MeshArena* pArena)
+	:numVert(0), numTris(0), numUV(0)
+{
+	name = pMesh->name;
+	PROFILE_SCOPE_DETAIL(STAGE_TRIANGULATE, "TriMesh", &name);
+	const uint32_t nfaces = pMesh->nFaces;
+	const uint32_t* faceIndices = pMesh->FaceIndices.get();
+	const uint32_t* vertsIndex = pMesh->VertsIndices.get();
+	const uint32_t* uvIndices = pMesh->UVIndices.get();
+	const Vector3d* verts = pMesh->Verts.get();
+	const Vector3d* normals = pMesh->Normals.get();
+	const Vector2d* vt = pMesh->UVs.get();
+
+	// prefix sum of corners and triangles per chunk of faces, so every chunk knows where it writes
+	const size_t numChunks = ParallelChunks(nfaces, FACE_GRAIN);
+	std::vector<size_t> chunkCorners(numChunks + 1, 0), chunkTris(numChunks + 1, 0);
+	std::vector<uint32_t> chunkMinFace(numChunks, UINT32_MAX), chunkMaxFace(numChunks, 0);
+	ParallelForChunks(nfaces, FACE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+		size_t corners = 0, tris = 0;
+		uint32_t lo = UINT32_MAX, hi = 0;
+		for (size_t i = begin; i < end; ++i)
+		{
+			uint32_t n = faceIndices[i];
+			corners += n;
+			tris += n > 2 ? n - 2 : 0;
+			lo = std::min(lo, n);
+			hi = std::max(hi, n);
+		}
+		chunkCorners[chunk + 1] = corners;
+		chunkTris[chunk + 1] = tris;
+		chunkMinFace[chunk] = lo;
+		chunkMaxFace[chunk] = hi;
+	});
+	uint32_t minFace = UINT32_MAX, maxFace = 0;
+	for (size_t c = 0; c < numChunks; ++c)
+	{
+		chunkCorners[c + 1] += chunkCorners[c];
+		chunkTris[c + 1] += chunkTris[c];
+		minFace = std::min(minFace, chunkMinFace[c]);
+		maxFace = std::max(maxFace, chunkMaxFace[c]);
+	}
+	const size_t numCorners = chunkCorners[numChunks];
+	numTris = (uint32_t)chunkTris[numChunks];
+	PROFILE_COUNT(COUNTER_MESHES, 1);
+	PROFILE_COUNT(COUNTER_FACES, nfaces);
+	PROFILE_COUNT(COUNTER_CORNERS, numCorners);
+	PROFILE_COUNT(COUNTER_TRIANGLES, numTris);
+	int layout = FACES_MIXED;
+	if (nfaces > 0 && minFace == maxFace && minFace == 3)
+		layout = FACES_TRIANGLES;
+	else if (nfaces > 0 && minFace == maxFace && minFace == 4)
+		layout = FACES_QUADS;
+
+	// find out how many vertices and uvs are referenced
+	const size_t numCornerChunks = ParallelChunks(numCorners, CORNER_GRAIN);
+	std::vector<uint32_t> chunkMaxVert(numCornerChunks, 0), chunkMaxUV(numCornerChunks, 0);
+	ParallelForChunks(numCorners, CORNER_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+		chunkMaxVert[chunk] = MaxIndex(vertsIndex, begin, end);
+		chunkMaxUV[chunk] = MaxIndex(uvIndices, begin, end);
+	});
+	uint32_t maxVertIndex = 0, maxUVIndex = 0;
+	for (size_t c = 0; c < numCornerChunks; ++c)
+	{
+		maxVertIndex = std::max(maxVertIndex, chunkMaxVert[c]);
+		maxUVIndex = std::max(maxUVIndex, chunkMaxUV[c]);
+	}
+	maxVertIndex += 1;
+	maxUVIndex += 1;
+
+	// allocate memory to store the position of the mesh vertices
+	P = MakeMeshArray<Vector3d>(maxVertIndex, pArena);
+	ParallelFor(maxVertIndex, CORNER_GRAIN, [&](size_t begin, size_t end) {
+		std::copy(verts + begin, verts + end, &P[begin]);
+	});
+	numVert = maxVertIndex;
+	numUV = maxUVIndex;
+
+	// allocate memory to store triangle indices
+	const size_t numTriCorners = (size_t)numTris * 3;
+	triIndex = MakeMeshArray<uint32_t>(numTriCorners, pArena);
+	UVIndices = MakeMeshArray<uint32_t>(numTriCorners, pArena);
+	N = MakeMeshArray<Vector3d>(numTriCorners, pArena);
+	T = MakeMeshArray<Vector2d>(numTriCorners, pArena);
+	PN = MakeMeshArray<Vector3d>(maxVertIndex, pArena);
+	UV = MakeMeshArray<Vector2d>(maxUVIndex, pArena);
+
+	auto corner = [&](size_t l, size_t k) {
+		triIndex[l] = vertsIndex[k];
+		UVIndices[l] = uvIndices[k];
+		N[l] = normals[k];
+		T[l] = vt[k];
+	};
+	ParallelForChunks(nfaces, FACE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+		if (layout == FACES_TRIANGLES)
+		{
+			// triangle corners are the polygon corners
+			const size_t k = begin * 3, count = (end - begin) * 3;
+			memcpy(&triIndex[k], vertsIndex + k, count * sizeof(uint32_t));
+			memcpy(&UVIndices[k], uvIndices + k, count * sizeof(uint32_t));
+			std::copy(normals + k, normals + k + count, &N[k]);
+			std::copy(vt + k, vt + k + count, &T[k]);
+		}
+		else if (layout == FACES_QUADS)
+		{
+			for (size_t i = begin, k = begin * 4, l = begin * 6; i < end; ++i, k += 4, l += 6)
+			{
+				corner(l, k);
+				corner(l + 1, k + 1);
+				corner(l + 2, k + 2);
+				corner(l + 3, k);
+				corner(l + 4, k + 2);
+				corner(l + 5, k + 3);
+			}
+		}
+		else
+		{
+			size_t k = chunkCorners[chunk], l = chunkTris[chunk] * 3;
+			for (size_t i = begin; i < end; ++i) { // for each polygon
+				const uint32_t n = faceIndices[i];
+				for (uint32_t j = 0; j + 2 < n; ++j) { // for each triangle in the polygon
+					corner(l, k);
+					corner(l + 1, k + j + 1);
+					corner(l + 2, k + j + 2);
+					l += 3;
+				}
+				k += n;
+			}
+		}
+	});
+
+	// a serial fan writes PN/UV corner after corner, so the last corner referencing a vertex wins;
+	// find it with an atomic max of the corner number, then gather
+	std::unique_ptr<std::atomic<uint32_t>[]> lastVert(new std::atomic<uint32_t>[maxVertIndex]);
+	std::unique_ptr<std::atomic<uint32_t>[]> lastUV(new std::atomic<uint32_t>[maxUVIndex]);
+	ParallelFor(std::max(maxVertIndex, maxUVIndex), CORNER_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (i < maxVertIndex)
+				lastVert[i].store(0, std::memory_order_relaxed);
+			if (i < maxUVIndex)
+				lastUV[i].store(0, std::memory_order_relaxed);
+		}
+	});
+	ParallelFor(numTriCorners, CORNER_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t l = begin; l < end; ++l)
+		{
+			AtomicMax(lastVert[triIndex[l]], (uint32_t)(l + 1));
+			AtomicMax(lastUV[UVIndices[l]], (uint32_t)(l + 1));
+		}
+	});
+	ParallelFor(maxVertIndex, CORNER_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v)
+		{
+			uint32_t last = lastVert[v].load(std::memory_order_relaxed);
+			PN[v] = last ? N[last - 1] : Vector3d::Zero();
+		}
+	});
+	ParallelFor(maxUVIndex, CORNER_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t u = begin; u < end; ++u)
+		{
+			uint32_t last = lastUV[u].load(std::memory_order_relaxed);
+			UV[u] = last ? T[last - 1] : Vector2d::Zero();
+		}
+	});
+}
+
+void TriMesh::SplitByMaterial(const PolyMesh* pMesh, const int* faceMaterial, size_t numIds,
+	const std::vector<std::string>& materialNames)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_MATERIALS, "SplitByMaterial", &name);
+	const uint32_t nfaces = pMesh->nFaces;
+	const uint32_t* faceIndices = pMesh->FaceIndices.get();
+
+	// one group per distinct material name, polygons without a valid id share the unnamed group
+	const size_t numNames = materialNames.size();
+	std::vector<uint32_t> idGroup(numNames + 1);
+	std::vector<std::string> groupNames;
+	std::map<std::string, uint32_t> nameGroup;
+	for (size_t id = 0; id <= numNames; ++id)
+	{
+		const std::string& groupName = id < numNames ? materialNames[id] : std::string();
+		auto inserted = nameGroup.emplace(groupName, (uint32_t)groupNames.size());
+		if (inserted.second)
+			groupNames.push_back(groupName);
+		idGroup[id] = inserted.first->second;
+	}
+	auto group = [&](uint32_t face) {
+		const int id = face < numIds ? faceMaterial[face] : -1;
+		return idGroup[id >= 0 && (size_t)id < numNames ? id : numNames];
+	};
+
+	// counting pass: triangles per group
+	std::vector<uint32_t> groupTris(groupNames.size(), 0);
+	for (uint32_t i = 0; i < nfaces; ++i)
+		groupTris[group(i)] += faceIndices[i] > 2 ? faceIndices[i] - 2 : 0;
+
+	subMeshes.clear();
+	std::vector<uint32_t> cursor(groupNames.size(), 0);
+	for (uint32_t g = 0, first = 0; g < groupNames.size(); ++g)
+	{
+		cursor[g] = first;
+		if (groupTris[g] == 0)
+			continue;
+		SubMesh sub;
+		sub.matname = groupNames[g];
+		sub.firstTri = first;
+		sub.numTris = groupTris[g];
+		subMeshes.push_back(sub);
+		first += groupTris[g];
+	}
+	if (subMeshes.size() <= 1)
+	{
+		if (!subMeshes.empty())
+			matname = subMeshes[0].matname;
+		subMeshes.clear();
+		return;
+	}
+	matname = subMeshes[0].matname;
+
+	// destination of every polygon's triangles, nothing moves when the mesh is already grouped
+	std::vector<uint32_t> faceSource(nfaces), faceTarget(nfaces);
+	bool grouped = true;
+	for (uint32_t i = 0, source = 0; i < nfaces; ++i)
+	{
+		const uint32_t tris = faceIndices[i] > 2 ? faceIndices[i] - 2 : 0;
+		uint32_t& target = cursor[group(i)];
+		faceSource[i] = source;
+		faceTarget[i] = target;
+		grouped = grouped && target == source;
+		target += tris;
+		source += tris;
+	}
+	if (grouped)
+		return;
+
+	// scatter pass over each per-corner array
+	const size_t numTriCorners = (size_t)numTris * 3;
+	auto scatter = [&](auto* data) {
+		typedef typename std::remove_reference<decltype(*data)>::type Element;
+		std::vector<Element> source(data, data + numTriCorners);
+		ParallelFor(nfaces, FACE_GRAIN, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				const size_t corners = faceIndices[i] > 2 ? (size_t)(faceIndices[i] - 2) * 3 : 0;
+				std::copy_n(source.data() + (size_t)faceSource[i] * 3, corners, data + (size_t)faceTarget[i] * 3);
+			}
+		});
+	};
+	scatter(triIndex.get());
+	scatter(UVIndices.get());
+	scatter(N.get());
+	scatter(T.get());
+}
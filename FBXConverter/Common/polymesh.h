@@ -24,11 +24,15 @@ OF SUCH DAMAGE.
 
 //polymesh.h
 
+#pragma once
+
+#include <string>
 #include <memory>
 #include <vector>
 #include <map>
 #include <utility>
 #include <Eigen/Dense>
+#include "arena.h"
 
 using namespace Eigen;
 
@@ -38,87 +42,56 @@ public:
 	std::string name;
 	unsigned int nVertices;
 	uint32_t nFaces;
-	std::unique_ptr<uint32_t[]> FaceIndices;
-	std::unique_ptr<uint32_t[]> VertsIndices;
-	std::unique_ptr<Vector3d[]> Verts;		//vertex positions
-	std::unique_ptr<Vector3d[]> Normals;	//normals
-	std::unique_ptr<Vector2d[]> UVs;		//texture coordinates
-	std::unique_ptr<uint32_t[]> UVIndices;
+	MeshArray<uint32_t> FaceIndices;
+	MeshArray<uint32_t> VertsIndices;
+	MeshArray<Vector3d> Verts;		//vertex positions
+	MeshArray<Vector3d> Normals;	//normals
+	MeshArray<Vector2d> UVs;		//texture coordinates
+	MeshArray<uint32_t> UVIndices;
+};
+
+//triangles [firstTri, firstTri + numTris) of a mesh, drawn with one material
+struct SubMesh
+{
+	std::string matname;
+	uint32_t firstTri = 0;
+	uint32_t numTris = 0;
 };
 
+//the material ranges to write for a mesh: its submeshes, or the whole mesh with matname
+inline std::vector<SubMesh> MaterialRanges(const std::string& matname, uint32_t numTris, const std::vector<SubMesh>& subMeshes)
+{
+	if (!subMeshes.empty())
+		return subMeshes;
+	SubMesh whole;
+	whole.matname = matname;
+	whole.numTris = numTris;
+	return std::vector<SubMesh>(1, whole);
+}
+
 class TriMesh 
 {
 public:
-    // Build a triangle mesh from a face index array and a vertex index array
-    TriMesh( const PolyMesh* pMesh )
-        :numTris(0), numVert(0), numUV(0)
-    {
-		name = pMesh->name;
-		const uint32_t nfaces = pMesh->nFaces;
-		const std::unique_ptr<uint32_t[]> &faceIndices = pMesh->FaceIndices;
-		const std::unique_ptr<uint32_t[]> &vertsIndex = pMesh->VertsIndices;
-		const std::unique_ptr<uint32_t[]> &uvIndices = pMesh->UVIndices;
-		const std::unique_ptr<Vector3d[]> &verts = pMesh->Verts;
-		const std::unique_ptr<Vector3d[]> &normals = pMesh->Normals;
-		const std::unique_ptr<Vector2d[]> &vt = pMesh->UVs;
+	// Build a triangle mesh by fan-triangulating every polygon. Faces are triangulated
+	// in parallel chunks from a prefix sum of the face sizes; per-vertex normals and
+	// UVs (PN, UV) take the value of the last corner referencing them, as a serial fan
+	// would leave them. Buffers come from pArena when given, from the heap otherwise.
+	TriMesh(const PolyMesh* pMesh, MeshArena* pArena = nullptr);
+
+	// An empty mesh with every array allocated for numVert vertices (and as many UVs)
+	// and numTris triangles, filled in by the caller.
+	TriMesh(const std::string& name, uint32_t numVert, uint32_t numTris, MeshArena* pArena = nullptr);
 
-        uint32_t k = 0, maxVertIndex = 0, maxUVIndex=0;
-        // find out how many triangles we need to create for this mesh
-        for (uint32_t i = 0; i < nfaces; ++i) {
-			numTris += (faceIndices[i] - 2);
-			for (uint32_t j = 0; j < faceIndices[i]; ++j)
-			{
-                if (vertsIndex[k + j] > maxVertIndex)
-                    maxVertIndex = vertsIndex[k + j];
-				if (uvIndices[k + j] > maxUVIndex)
-					maxUVIndex = uvIndices[k + j];
-			}
-            k += faceIndices[i];
-        }
-        maxVertIndex += 1;
-		maxUVIndex += 1;
-        
-        // allocate memory to store the position of the mesh vertices
-        P = std::unique_ptr<Vector3d []>(new Vector3d[maxVertIndex]);
-        for (uint32_t i = 0; i < maxVertIndex; ++i) {
-            P[i] = verts[i];
-        }
-		numVert = maxVertIndex;
-		numUV = maxUVIndex;
+	// A mesh without arrays, for a caller that points them at existing buffers.
+	explicit TriMesh(const std::string& name);
 
-        uint32_t l = 0;
-        // allocate memory to store triangle indices
-        triIndex = std::unique_ptr<uint32_t []>(new uint32_t [numTris * 3]);
-		UVIndices = std::unique_ptr<uint32_t[]>(new uint32_t[numTris * 3]);
-		N = std::unique_ptr<Vector3d []>(new Vector3d[numTris * 3]);
-		T = std::unique_ptr<Vector2d []>(new Vector2d[numTris * 3]);
-		PN = std::unique_ptr<Vector3d[]>(new Vector3d[maxVertIndex]);
-		UV = std::unique_ptr<Vector2d[]>(new Vector2d[maxUVIndex]);
-		for (uint32_t i = 0, k = 0; i < nfaces; ++i) { // for each polygon
-            for (uint32_t j = 0; j < faceIndices[i] - 2; ++j) { // for each triangle in the polygon
-                triIndex[l] = vertsIndex[k];
-                triIndex[l + 1] = vertsIndex[k + j + 1];
-                triIndex[l + 2] = vertsIndex[k + j + 2];
-				UVIndices[l] = uvIndices[k];
-				UVIndices[l + 1] = uvIndices[k + j + 1];
-				UVIndices[l + 2] = uvIndices[k + j + 2];
-				N[l] = normals[k];
-                N[l + 1] = normals[k + j + 1];
-                N[l + 2] = normals[k + j + 2];
-				T[l] = vt[k];
-				T[l + 1] = vt[k + j + 1];
-				T[l + 2] = vt[k + j + 2];
-				PN[vertsIndex[k]] = normals[k];
-				PN[vertsIndex[k + j + 1]] = normals[k + j + 1];
-				PN[vertsIndex[k + j + 2]] = normals[k + j + 2];
-				UV[uvIndices[k]] = vt[k];
-				UV[uvIndices[k + j + 1]] = vt[k + j + 1];
-				UV[uvIndices[k + j + 2]] = vt[k + j + 2];
-				l += 3;
-            }                                                                                                                                                                                                                                
-            k += faceIndices[i];
-        }
-    }
+	// Group the triangles by material with a counting sort over the per-polygon material
+	// ids of pMesh (the mesh this was built from): faceMaterial[i] indexes materialNames,
+	// polygons without a valid id (or beyond numIds) form an unnamed group. Triangle order
+	// is kept within a group. With more than one group, subMeshes lists the ranges in
+	// material id order; otherwise the mesh keeps a single matname.
+	void SplitByMaterial(const PolyMesh* pMesh, const int* faceMaterial, size_t numIds,
+		const std::vector<std::string>& materialNames);
 
 	//member variables
 	std::string name;
@@ -126,12 +99,14 @@ public:
 	uint32_t numVert;							// number of vertices
 	uint32_t numTris;							// number of triangles
 	uint32_t numUV;								// number of UVs
-	std::unique_ptr<Vector3d []> P;             // triangles vertex position
-    std::unique_ptr<uint32_t []> triIndex;		// vertex index array
-    std::unique_ptr<Vector3d []> N;             // triangles vertex normals
-	std::unique_ptr<Vector2d []> T;				// triangles texture coordinates
-	std::unique_ptr<uint32_t[]> UVIndices;		// triangles texture index
-	std::unique_ptr<Vector3d[]> PN;             // vertex normals
-	std::unique_ptr<Vector2d[]> UV;             // UV coordinates
+	MeshArray<Vector3d> P;						// triangles vertex position
+	MeshArray<uint32_t> triIndex;				// vertex index array
+	MeshArray<Vector3d> N;						// triangles vertex normals
+	MeshArray<Vector2d> T;						// triangles texture coordinates
+	MeshArray<uint32_t> UVIndices;				// triangles texture index
+	MeshArray<Vector3d> PN;						// vertex normals
+	MeshArray<Vector2d> UV;						// UV coordinates
+	MeshArray<Vector4d> TG;						// triangles vertex tangents and bitangent sign, empty unless generated (tangents.h)
+	std::vector<SubMesh> subMeshes;				// material ranges, empty when the whole mesh uses matname
 };
 
@@ -0,0 +1,221 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "profile.h"
+#include "textwriter.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	const char* STAGE_NAMES[NUM_PROFILE_STAGES] = {
+		"load", "extract", "normals", "triangulate", "materials", "transform", "simplify", "tangents", "weld", "optimize", "bvh", "export", "cache",
+	};
+
+	const char* COUNTER_NAMES[NUM_PROFILE_COUNTERS] = {
+		"meshes", "instances", "faces", "corners", "triangles", "bytes_written", "allocations", "allocated_bytes",
+	};
+
+	struct TraceEvent
+	{
+		const char* name;
+		ProfileStage stage;
+		std::string detail;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	//events of one thread at a time, appended without locking by the owning thread
+	struct Track
+	{
+		std::string name;
+		std::vector<TraceEvent> events;
+		bool inUse = false;
+		bool named = false;		//named by its thread (e.g. a batch worker), never reused
+	};
+
+	std::mutex g_trackMutex;
+	std::deque<Track> g_tracks;		//stable addresses, a track id is its index + 1
+	std::chrono::steady_clock::time_point g_origin = std::chrono::steady_clock::now();
+
+	//Track of the calling thread. An unnamed track is handed back when its thread exits,
+	//so the short lived threads of the parallel loops reuse a few tracks instead of one per loop.
+	struct ThreadTrack
+	{
+		Track* track = nullptr;
+
+		~ThreadTrack()
+		{
+			if (track && !track->named)
+			{
+				std::lock_guard<std::mutex> lock(g_trackMutex);
+				track->inUse = false;
+			}
+		}
+
+		Track* Get()
+		{
+			if (!track)
+			{
+				std::lock_guard<std::mutex> lock(g_trackMutex);
+				for (Track& t : g_tracks)
+					if (!t.inUse)
+					{
+						track = &t;
+						break;
+					}
+				if (!track)
+				{
+					g_tracks.emplace_back();
+					track = &g_tracks.back();
+					track->name = "thread " + std::to_string(g_tracks.size());
+				}
+				track->inUse = true;
+			}
+			return track;
+		}
+	};
+
+	thread_local ThreadTrack t_track;
+
+	void WriteString(FILE* fp, const std::string& s)
+	{
+		fputc('"', fp);
+		for (unsigned char c : s)
+		{
+			if (c == '"' || c == '\\')
+				fprintf(fp, "\\%c", c);
+			else if (c < 0x20)
+				fprintf(fp, "\\u%04x", c);
+			else
+				fputc(c, fp);
+		}
+		fputc('"', fp);
+	}
+}
+
+std::atomic<bool> Profiler::s_enabled(false);
+std::atomic<bool> Profiler::s_tracing(false);
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void ProfileStats::Reset()
+{
+	for (int i = 0; i < NUM_PROFILE_STAGES; ++i)
+	{
+		stageNanos[i] = 0;
+		stageCalls[i] = 0;
+	}
+	for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+		counters[i] = 0;
+}
+
+void ProfileStats::WriteJSON(FILE* fp, const std::string& file, int status, double seconds) const
+{
+	fprintf(fp, "{\"file\":");
+	WriteString(fp, file);
+	fprintf(fp, ",\"status\":%d,\"seconds\":%.6f,\"stages\":{", status, seconds);
+	for (int i = 0; i < NUM_PROFILE_STAGES; ++i)
+		fprintf(fp, "%s\"%s\":{\"seconds\":%.6f,\"calls\":%llu}", i ? "," : "", STAGE_NAMES[i],
+			stageNanos[i].load() * 1e-9, (unsigned long long)stageCalls[i].load());
+	fprintf(fp, "},\"counters\":{");
+	for (int i = 0; i < NUM_PROFILE_COUNTERS; ++i)
+		fprintf(fp, "%s\"%s\":%llu", i ? "," : "", COUNTER_NAMES[i], (unsigned long long)counters[i].load());
+	fprintf(fp, "}}\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void Profiler::Enable(bool stats, bool trace)
+{
+	g_origin = std::chrono::steady_clock::now();
+	s_tracing = trace;
+	s_enabled = stats || trace;
+}
+
+uint64_t Profiler::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_origin).count();
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+	if (!Tracing())
+		return;
+	Track* track = t_track.Get();
+	std::lock_guard<std::mutex> lock(g_trackMutex);
+	track->name = name;
+	track->named = true;
+}
+
+void Profiler::Record(ProfileStage stage, const char* name, const std::string* detail, uint64_t start, uint64_t end)
+{
+	ProfileStats* stats = CurrentStats();
+	if (stats && stage < NUM_PROFILE_STAGES)
+	{
+		stats->stageNanos[stage].fetch_add(end - start, std::memory_order_relaxed);
+		stats->stageCalls[stage].fetch_add(1, std::memory_order_relaxed);
+	}
+	if (Tracing())
+		t_track.Get()->events.push_back({ name, stage, detail ? *detail : std::string(), start, end });
+}
+
+//call once the traced threads are done
+bool Profiler::WriteTrace(const char* pFilename)
+{
+	FILE* fp = OpenFile(pFilename, "w");
+	if (!fp)
+		return false;
+
+	std::lock_guard<std::mutex> lock(g_trackMutex);
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"FBXConverter\"}}");
+	for (size_t t = 0; t < g_tracks.size(); ++t)
+	{
+		const Track& track = g_tracks[t];
+		fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", t + 1);
+		WriteString(fp, track.name);
+		fprintf(fp, "}}");
+		for (const TraceEvent& e : track.events)
+		{
+			fprintf(fp, ",\n{\"name\":");
+			WriteString(fp, e.name);
+			fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f",
+				e.stage < NUM_PROFILE_STAGES ? STAGE_NAMES[e.stage] : "span", t + 1, e.start * 1e-3, (e.end - e.start) * 1e-3);
+			if (!e.detail.empty())
+			{
+				fprintf(fp, ",\"args\":{\"detail\":");
+				WriteString(fp, e.detail);
+				fprintf(fp, "}");
+			}
+			fprintf(fp, "}");
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	bool ok = ferror(fp) == 0;
+	fclose(fp);
+	return ok;
+}
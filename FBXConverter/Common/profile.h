@@ -0,0 +1,157 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//profile.h
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <string>
+
+//Scoped timers and counters for the conversion stages. Nothing is recorded until
+//Profiler::Enable is called, a disabled PROFILE_SCOPE costs one predictable branch;
+//defining FBXCONVERTER_NO_PROFILE compiles the macros out altogether.
+//Stage times and counters go to the ProfileStats of the calling thread, which parallel
+//loops hand on to their threads, so every thread working on a file adds to its stats.
+//With tracing on, every scope is also kept as a Chrome trace event of its thread.
+
+enum ProfileStage
+{
+	STAGE_LOAD,			//importer: read and parse the file
+	STAGE_EXTRACT,		//node walk and PolyMesh extraction
+	STAGE_NORMALS,		//normals generated for meshes without them
+	STAGE_TRIANGULATE,	//TriMesh constructor
+	STAGE_MATERIALS,	//material extraction
+	STAGE_TRANSFORM,	//world transforms baked into the meshes
+	STAGE_SIMPLIFY,		//quadric mesh simplification
+	STAGE_TANGENTS,		//tangent generation
+	STAGE_WELD,			//welding for the exporters
+	STAGE_OPTIMIZE,		//vertex cache / overdraw / fetch optimization
+	STAGE_BVH,			//mesh bounds and BVH build
+	STAGE_EXPORT,		//writing the output files
+	STAGE_CACHE,		//conversion cache lookup and store
+	NUM_PROFILE_STAGES,
+	STAGE_NONE = NUM_PROFILE_STAGES,	//trace only, e.g. spans enclosing other stages
+};
+
+enum ProfileCounter
+{
+	COUNTER_MESHES,
+	COUNTER_INSTANCES,			//extra nodes referencing an extracted mesh
+	COUNTER_FACES,
+	COUNTER_CORNERS,
+	COUNTER_TRIANGLES,
+	COUNTER_BYTES_WRITTEN,
+	COUNTER_ALLOCATIONS,		//scene arena allocations
+	COUNTER_ALLOCATED_BYTES,
+	NUM_PROFILE_COUNTERS,
+};
+
+//totals of one file
+struct ProfileStats
+{
+	std::atomic<uint64_t> stageNanos[NUM_PROFILE_STAGES];	//summed over threads
+	std::atomic<uint64_t> stageCalls[NUM_PROFILE_STAGES];
+	std::atomic<uint64_t> counters[NUM_PROFILE_COUNTERS];
+
+	ProfileStats() { Reset(); }
+	void Reset();
+
+	//one line of JSON
+	void WriteJSON(FILE* fp, const std::string& file, int status, double seconds) const;
+};
+
+class Profiler
+{
+public:
+	static void Enable(bool stats, bool trace);
+	static bool Enabled() { return s_enabled.load(std::memory_order_relaxed); }
+	static bool Tracing() { return s_tracing.load(std::memory_order_relaxed); }
+
+	//stats the calling thread adds to, NULL for none
+	static ProfileStats*& CurrentStats()
+	{
+		thread_local ProfileStats* stats = nullptr;
+		return stats;
+	}
+
+	//name of the calling thread's track in the trace
+	static void SetThreadName(const std::string& name);
+
+	static uint64_t Now();	//ns since Enable
+
+	static void Count(ProfileCounter counter, uint64_t n)
+	{
+		ProfileStats* stats;
+		if (Enabled() && (stats = CurrentStats()) != nullptr)
+			stats->counters[counter].fetch_add(n, std::memory_order_relaxed);
+	}
+
+	static void Record(ProfileStage stage, const char* name, const std::string* detail, uint64_t start, uint64_t end);
+
+	//Chrome trace event format (chrome://tracing, Perfetto), one track per thread
+	static bool WriteTrace(const char* pFilename);
+
+private:
+	static std::atomic<bool> s_enabled;
+	static std::atomic<bool> s_tracing;
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(ProfileStage stage, const char* name, const std::string* detail = nullptr)
+		:_stage(stage), _name(name), _detail(detail), _start(Profiler::Enabled() ? Profiler::Now() : UINT64_MAX)
+	{
+	}
+
+	~ProfileScope()
+	{
+		if (_start != UINT64_MAX)
+			Profiler::Record(_stage, _name, _detail, _start, Profiler::Now());
+	}
+
+private:
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	ProfileStage _stage;
+	const char* _name;
+	const std::string* _detail;	//e.g. the mesh or file name, must outlive the scope
+	uint64_t _start;
+};
+
+#ifndef FBXCONVERTER_NO_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage, name)
+#define PROFILE_SCOPE_DETAIL(stage, name, detail) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage, name, detail)
+#define PROFILE_COUNT(counter, n) Profiler::Count(counter, n)
+#else
+#define PROFILE_SCOPE(stage, name) ((void)0)
+#define PROFILE_SCOPE_DETAIL(stage, name, detail) ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)0)
+#endif
@@ -0,0 +1,489 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "scene.h"
+#include "bvh.h"
+#include "compactmesh.h"
+#include "objwriter.h"
+#include "textwriter.h"
+#include "optimize.h"
+#include "parallel.h"
+#include "profile.h"
+#include "scenefile.h"
+#include "simplify.h"
+#include "tangents.h"
+#include "transform.h"
+#include "weld.h"
+#include <stdio.h>
+#include <assert.h>
+#include <ctype.h>
+#include <algorithm>
+#include <set>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+MeshNode::MeshNode(MeshNode* parent, std::string name)
+	:_name(name), _parent(parent)
+{
+	_transform.setIdentity();
+}
+
+MeshNode::~MeshNode()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+SceneParser::SceneParser()
+	:_geometryArena(&_arena), _pGeometryStore(NULL), _pInput(NULL), _inputSize(0)
+{
+}
+
+SceneParser::~SceneParser()
+{
+	SceneParser::Clear();
+}
+
+void SceneParser::Clear()
+{
+	Meshes.clear();
+	TriMeshes.clear();
+	Materials.clear();
+	Nodes.clear();
+	_arena.Reset();
+}
+
+TriMesh* SceneParser::AddMesh(PolyMesh* pMesh, MeshNode* pMeshNode)
+{
+	assert(pMesh);
+	TriMesh* pTriMesh = NewGeometry<TriMesh>(pMesh, _geometryArena);
+	AddMesh(pMesh, pTriMesh, pMeshNode);
+	return pTriMesh;
+}
+
+void SceneParser::AddMesh(PolyMesh* pMesh, TriMesh* pTriMesh, MeshNode* pMeshNode)
+{
+	assert(pMesh && pTriMesh);
+	Meshes.push_back(pMesh);
+	TriMeshes.push_back(pTriMesh);
+	if (pMeshNode)
+		pMeshNode->_TriMeshes.push_back(pTriMesh);
+}
+
+void SceneParser::AddInstance(TriMesh* pTriMesh, MeshNode* pMeshNode)
+{
+	assert(pTriMesh && pMeshNode);
+	pMeshNode->_TriMeshes.push_back(pTriMesh);
+	PROFILE_COUNT(COUNTER_INSTANCES, 1);
+}
+
+void SceneParser::AddMaterial(Material* pMaterial)
+{
+	assert(pMaterial);
+	Materials.emplace(pMaterial->materialName, pMaterial);
+}
+
+WeldedMesh* SceneParser::WeldForExport(const TriMesh* pTriMesh) const
+{
+	WeldedMesh* w;
+	{
+		PROFILE_SCOPE_DETAIL(STAGE_WELD, "Weld", &pTriMesh->name);
+		w = WeldTriMesh(pTriMesh, _options.weldEpsilon);
+	}
+	if (_options.optimize || _options.optimizeOverdraw)
+	{
+		PROFILE_SCOPE_DETAIL(STAGE_OPTIMIZE, "Optimize", &pTriMesh->name);
+		//the cache simulation only runs for the report
+		VertexCacheStats before, after;
+		OptimizeWeldedMesh(w, _options.optimizeOverdraw, _options.verbose ? &before : NULL, _options.verbose ? &after : NULL);
+		if (_options.verbose)
+			printf("Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+				w->name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+	}
+	return w;
+}
+
+static std::string LowerExtension(const std::string& filename)
+{
+	size_t dot = filename.rfind('.');
+	std::string ext = dot == std::string::npos ? std::string() : filename.substr(dot + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext;
+}
+
+bool SceneParser::IsGLB(const std::string& filename)
+{
+	return LowerExtension(filename) == "glb";
+}
+
+bool SceneParser::IsGLTF(const std::string& filename)
+{
+	std::string ext = LowerExtension(filename);
+	return ext == "glb" || ext == "gltf";
+}
+
+bool SceneParser::IsSceneFile(const std::string& filename)
+{
+	return LowerExtension(filename) == "scene";
+}
+
+std::string SceneParser::LodFileName(const std::string& filename, size_t level)
+{
+	size_t slash = filename.find_last_of("/\\");
+	size_t dot = filename.rfind('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		dot = filename.size();
+	return filename.substr(0, dot) + "_lod" + std::to_string(level) + filename.substr(dot);
+}
+
+std::string SceneParser::BvhFileName(const std::string& filename)
+{
+	size_t slash = filename.find_last_of("/\\");
+	size_t dot = filename.rfind('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		dot = filename.size();
+	return filename.substr(0, dot) + ".bvh";
+}
+
+int SceneParser::Export(const char* pFilename)
+{
+	if (_options.bakeTransforms)
+		BakeTransforms();
+	if (_options.simplifyRatio >= 1.0f && _options.simplifyError <= 0.0f && _options.lodRatios.empty() && !_options.bvh)
+		return ExportFile(pFilename);
+
+	std::vector<uint32_t> baseTris;
+	for (const TriMesh* m : TriMeshes)
+		baseTris.push_back(m->numTris);
+	if (_options.simplifyRatio < 1.0f || _options.simplifyError > 0.0f)
+		SimplifyMeshes(baseTris, _options.simplifyRatio, _options.simplifyError);
+	int status = ExportFile(pFilename);
+	if (status == E_NOERROR && _options.bvh)
+		status = ExportBVH(BvhFileName(pFilename).c_str());
+
+	//every level starts from the previous one, so the chain costs about one simplification
+	for (size_t level = 0; level < _options.lodRatios.size() && status == E_NOERROR; ++level)
+	{
+		SimplifyMeshes(baseTris, _options.lodRatios[level], 0.0f);
+		status = ExportFile(LodFileName(pFilename, level + 1).c_str());
+	}
+	return status;
+}
+
+int SceneParser::ExportBVH(const char* pFilename)
+{
+	if (TriMeshes.size() == 0)
+		return E_NO_MESH;
+
+	PROFILE_SCOPE(STAGE_NONE, "ExportBVH");
+	std::vector<Bvh> bvhs(TriMeshes.size());
+	std::vector<BvhMeshInput> meshes(TriMeshes.size());
+	auto build = [&](size_t i) {
+		const TriMesh* m = TriMeshes[i];
+		{
+			PROFILE_SCOPE_DETAIL(STAGE_BVH, "Bounds", &m->name);
+			meshes[i].bounds = ComputeBounds(m->P.get(), m->numVert);
+		}
+		BuildBvh(m, bvhs[i]);
+		meshes[i].mesh = m;
+		meshes[i].bvh = &bvhs[i];
+	};
+
+	//large meshes one after the other on all cores, then the small ones one per thread
+	const uint32_t LARGE_MESH_TRIS = 1 << 16;
+	std::vector<size_t> small;
+	for (size_t i = 0; i < TriMeshes.size(); ++i)
+	{
+		if (TriMeshes[i]->numTris >= LARGE_MESH_TRIS)
+			build(i);
+		else
+			small.push_back(i);
+	}
+	ParallelForEach(small.size(), [&](size_t k) { build(small[k]); });
+
+	PROFILE_SCOPE(STAGE_EXPORT, "WriteBVH");
+	return WriteBvhFile(pFilename, meshes, Nodes) ? E_NOERROR : E_FAILOPENFILE;
+}
+
+int SceneParser::ExportFile(const char* pFilename)
+{
+	if (IsGLTF(pFilename) || IsSceneFile(pFilename))
+	{
+		if (_options.tangents)
+			GenerateMeshTangents();
+		return IsSceneFile(pFilename) ? ExportScene(pFilename) : ExportGLB(pFilename);
+	}
+	return ExportOBJ(pFilename);
+}
+
+int SceneParser::ExportScene(const char* pFilename)
+{
+	if (TriMeshes.size() == 0)
+		return E_NO_MESH;
+
+	PROFILE_SCOPE(STAGE_EXPORT, "ExportScene");
+	return WriteSceneFile(pFilename, TriMeshes, Nodes, Materials) ? E_NOERROR : E_FAILOPENFILE;
+}
+
+void SceneParser::GenerateMeshTangents()
+{
+	//large meshes one after the other on all cores, then the small ones one per thread
+	const uint32_t LARGE_MESH_TRIS = 1 << 16;
+	std::vector<TriMesh*> small;
+	for (TriMesh* m : TriMeshes)
+	{
+		if (m->TG)
+			continue;
+		if (m->numTris >= LARGE_MESH_TRIS)
+			GenerateTangents(m, &_arena);
+		else
+			small.push_back(m);
+	}
+	ParallelForEach(small.size(), [&](size_t i) { GenerateTangents(small[i], &_arena); });
+}
+
+void SceneParser::BakeTransforms()
+{
+	PROFILE_SCOPE(STAGE_NONE, "BakeTransforms");
+	std::vector<NodeTransform> transforms = ComputeWorldTransforms(Nodes);
+
+	//one job per use of a mesh by a node, numbered in node order
+	struct Use
+	{
+		MeshNode* node;
+		size_t slot;
+		const Eigen::Matrix4d* world;
+	};
+	std::vector<Use> uses;
+	for (const NodeTransform& transform : transforms)
+	{
+		MeshNode* pNode = transform.node;
+		for (size_t slot = 0; slot < pNode->_TriMeshes.size(); ++slot)
+			uses.push_back({ pNode, slot, &transform.world });
+	}
+
+	//large meshes one after the other on all cores, then the small ones one per thread;
+	//an identity use keeps the mesh itself
+	std::vector<TriMesh*> baked(uses.size());
+	auto bake = [&](size_t i) {
+		TriMesh* m = uses[i].node->_TriMeshes[uses[i].slot];
+		baked[i] = uses[i].world->isIdentity() ? m : TransformTriMesh(m, *uses[i].world, &_arena);
+	};
+	const uint32_t LARGE_MESH_VERTS = 1 << 16;
+	std::vector<size_t> small;
+	for (size_t i = 0; i < uses.size(); ++i)
+	{
+		if (uses[i].node->_TriMeshes[uses[i].slot]->numVert >= LARGE_MESH_VERTS)
+			bake(i);
+		else
+			small.push_back(i);
+	}
+	ParallelForEach(small.size(), [&](size_t k) { bake(small[k]); });
+
+	//meshes no node uses stay as they are, after the baked ones
+	std::set<const TriMesh*> used, added;
+	std::vector<TriMesh*> meshes;
+	for (size_t i = 0; i < uses.size(); ++i)
+	{
+		used.insert(uses[i].node->_TriMeshes[uses[i].slot]);
+		uses[i].node->_TriMeshes[uses[i].slot] = baked[i];
+		if (added.insert(baked[i]).second)
+			meshes.push_back(baked[i]);
+	}
+	for (TriMesh* m : TriMeshes)
+		if (used.count(m) == 0)
+			meshes.push_back(m);
+	TriMeshes.swap(meshes);
+	for (const NodeTransform& transform : transforms)
+		transform.node->_transform.setIdentity();
+}
+
+static void ReplaceMeshes(MeshNode* pNode, const std::map<const TriMesh*, TriMesh*>& replaced)
+{
+	for (TriMesh*& m : pNode->_TriMeshes)
+	{
+		auto found = replaced.find(m);
+		if (found != replaced.end())
+			m = found->second;
+	}
+	for (MeshNode* pChild : pNode->_children)
+		ReplaceMeshes(pChild, replaced);
+}
+
+//ratio of baseTris triangles, or down to maxError alone when ratio is 1; verbose prints the result
+static TriMesh* Simplify(const TriMesh* pTriMesh, uint32_t baseTris, float ratio, float maxError, MeshArena* pArena, bool verbose)
+{
+	SimplifyOptions options;
+	options.targetError = maxError;
+	uint32_t target = ratio < 1.0f ? (uint32_t)(baseTris * (double)ratio) : 0;
+	float error = 0.0f;
+	TriMesh* m = SimplifyTriMesh(pTriMesh, target, options, pArena, &error);
+	if (verbose)
+		printf("Simplified %s: %u -> %u triangles, error %.5f\n", pTriMesh->name.c_str(), pTriMesh->numTris, m->numTris, error);
+	return m;
+}
+
+void SceneParser::SimplifyMeshes(const std::vector<uint32_t>& baseTris, float ratio, float maxError)
+{
+	std::vector<TriMesh*> simplified(TriMeshes.size());
+	ParallelForEach(TriMeshes.size(), [&](size_t i) {
+		simplified[i] = Simplify(TriMeshes[i], baseTris[i], ratio, maxError, &_arena, _options.verbose);
+	});
+
+	std::map<const TriMesh*, TriMesh*> replaced;
+	for (size_t i = 0; i < TriMeshes.size(); ++i)
+	{
+		replaced[TriMeshes[i]] = simplified[i];
+		TriMeshes[i] = simplified[i];
+	}
+	//the previous level stays in the arena until Clear
+	for (MeshNode* pNode : Nodes)
+		ReplaceMeshes(pNode, replaced);
+}
+
+int SceneParser::ExportOBJ(const char* pFilename)
+{
+	if (TriMeshes.size() == 0)
+		return E_NO_MESH;
+
+	PROFILE_SCOPE(STAGE_NONE, "ExportOBJ");
+	ObjWriter writer(_options);
+	if (!writer.Open(pFilename, Materials.size() > 0))
+		return E_FAILOPENFILE;
+	if (_options.expandInstances)
+		AppendInstancesOBJ(writer);
+	else
+	{
+		for (auto iter = TriMeshes.begin(); iter != TriMeshes.end(); ++iter)
+			AppendOBJ(writer, *iter);
+	}
+	if (!writer.Close(Materials))
+		return E_FAILOPENFILE;
+	return E_NOERROR;
+}
+
+void SceneParser::AppendOBJ(ObjWriter& writer, const TriMesh* m) const
+{
+	if (_options.weld || _options.optimize || _options.optimizeOverdraw)
+	{
+		std::unique_ptr<WeldedMesh> w(WeldForExport(m));
+		writer.WriteMesh(m, w.get());
+	}
+	else
+		writer.WriteMesh(m);
+}
+
+static void CollectInstances(const MeshNode* pNode, std::vector<std::pair<const MeshNode*, const TriMesh*> >& instances)
+{
+	for (const TriMesh* m : pNode->_TriMeshes)
+		instances.emplace_back(pNode, m);
+	for (const MeshNode* pChild : pNode->_children)
+		CollectInstances(pChild, instances);
+}
+
+void SceneParser::AppendInstancesOBJ(ObjWriter& writer) const
+{
+	std::vector<std::pair<const MeshNode*, const TriMesh*> > instances;
+	for (const MeshNode* pNode : Nodes)
+		CollectInstances(pNode, instances);
+
+	if (!(_options.weld || _options.optimize || _options.optimizeOverdraw))
+	{
+		for (const auto& instance : instances)
+			writer.WriteMesh(instance.second, nullptr, &instance.first->_name);
+		return;
+	}
+
+	//a shared mesh is welded once and kept until its last instance is written
+	std::map<const TriMesh*, size_t> remaining;
+	for (const auto& instance : instances)
+		++remaining[instance.second];
+	std::map<const TriMesh*, std::unique_ptr<WeldedMesh> > welded;
+	for (const auto& instance : instances)
+	{
+		std::unique_ptr<WeldedMesh>& w = welded[instance.second];
+		if (!w)
+			w.reset(WeldForExport(instance.second));
+		writer.WriteMesh(instance.second, w.get(), &instance.first->_name);
+		if (--remaining[instance.second] == 0)
+			welded.erase(instance.second);
+	}
+}
+
+CompactMesh* SceneParser::StreamCompactMesh(size_t i)
+{
+	std::unique_ptr<TriMesh> pTriMesh(StreamMesh(i));
+	return pTriMesh ? new CompactMesh(pTriMesh.get()) : nullptr;
+}
+
+int SceneParser::StreamOBJ(const char* pFilename)
+{
+	PROFILE_SCOPE(STAGE_NONE, "StreamOBJ");
+	const size_t numMeshes = BeginStream();
+	if (numMeshes == 0)
+		return E_NO_MESH;
+
+	ObjWriter writer(_options);
+	if (!writer.Open(pFilename, Materials.size() > 0))
+		return E_FAILOPENFILE;
+
+	//geometry goes to the heap so every mesh is freed as soon as it is written
+	MeshArena* pSaved = _geometryArena;
+	_geometryArena = nullptr;
+	const bool compact = _options.compact && !(_options.weld || _options.optimize || _options.optimizeOverdraw) &&
+		_options.simplifyRatio >= 1.0f && _options.simplifyError <= 0.0f;
+	try
+	{
+		for (size_t i = 0; i < numMeshes; ++i)
+		{
+			if (compact)
+			{
+				std::unique_ptr<CompactMesh> pMesh(StreamCompactMesh(i));
+				if (pMesh)
+					writer.WriteMesh(pMesh.get());
+				continue;
+			}
+			std::unique_ptr<TriMesh> pTriMesh(StreamMesh(i));
+			if (pTriMesh && (_options.simplifyRatio < 1.0f || _options.simplifyError > 0.0f))
+				pTriMesh.reset(Simplify(pTriMesh.get(), pTriMesh->numTris, _options.simplifyRatio, _options.simplifyError, nullptr, _options.verbose));
+			if (pTriMesh)
+				AppendOBJ(writer, pTriMesh.get());
+		}
+	}
+	catch (...)
+	{
+		_geometryArena = pSaved;
+		throw;
+	}
+	_geometryArena = pSaved;
+
+	if (!writer.Close(Materials))
+		return E_FAILOPENFILE;
+	if (writer.MeshesWritten() == 0)
+	{
+		RemoveOutputFile(pFilename);
+		return E_NO_MESH;
+	}
+	return E_NOERROR;
+}
@@ -0,0 +1,273 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//scene.h
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "arena.h"
+#include "polymesh.h"
+
+struct WeldedMesh;
+class CompactMesh;
+class ObjWriter;
+class GeometryStore;
+
+//output settings shared by the exporters
+struct ExportOptions
+{
+	//digits after the decimal point (at most TextWriter::MAX_PRECISION), TextWriter::SHORTEST (-1) for shortest round-trip
+	int positionPrecision = 6;
+	int normalPrecision = 6;
+	int uvPrecision = 6;
+
+	//weld corners into unique (position, normal, uv) vertices with one index per corner
+	bool weld = false;
+	float weldEpsilon = 0.0f;	//0 welds identical values only
+
+	//reorder the welded triangles for the vertex cache (and front to back for overdraw),
+	//then renumber the vertices in fetch order; implies weld for OBJ
+	bool optimize = false;
+	bool optimizeOverdraw = false;
+
+	//importers: normals generated for meshes without them split at edges sharper than this
+	//many degrees, unless the file has smoothing groups (see GenerateNormals)
+	float creaseAngle = 60.0f;
+
+	//OBJ only: write each mesh as soon as it is extracted and free it (SceneParser::StreamOBJ)
+	bool stream = false;
+
+	//streamed OBJ: build each mesh as a CompactMesh (float32 streams, no per-corner arrays)
+	//instead of a TriMesh; values are rounded to float. Not used with weld, optimize or
+	//simplify, which need the TriMesh
+	bool compact = false;
+
+	//OBJ only: write geometry shared by several nodes once per node instead of once
+	bool expandInstances = false;
+
+	//Export only: transform every mesh into world space by its node, once per node using it,
+	//and reset the node transforms to identity (see TransformTriMesh)
+	bool bakeTransforms = false;
+
+	//Export only: simplify every mesh to simplifyRatio of its triangles, or until a collapse
+	//would exceed simplifyError (relative to the mesh extent, 0 for no limit); then write
+	//one more file per lodRatios entry (fractions of the original triangle count), each
+	//simplified from the previous level, next to the output (see LodFileName)
+	float simplifyRatio = 1.0f;
+	float simplifyError = 0.0f;
+	std::vector<float> lodRatios;
+
+	//glTF and .scene only: generate MikkTSpace style tangents (see GenerateTangents) and write
+	//them as the TANGENT attribute or with the scene
+	bool tangents = false;
+
+	//Export only: also write the mesh bounds, node bounds and a BVH per mesh to a .bvh
+	//next to the output (see bvh.h)
+	bool bvh = false;
+
+	//print per mesh results of the optimizer (ACMR, ATVR) and the simplifier on stdout, and
+	//the version of every FBX file loaded; off so that batch workers and the benchmarks do
+	//not write a line per mesh or file
+	bool verbose = false;
+
+	//importers: ask on stdin for what a file needs (the FBX SDK password prompt); the batch
+	//workers share stdin and clear it, such a file then fails to load
+	bool interactive = true;
+};
+
+struct Material
+{
+	unsigned int index = -1;//index of material
+	std::string materialName;
+
+	Vector3d Ka = Vector3d(0.2f, 0.2f, 0.2f); //ambient
+	Vector3d Kd = Vector3d(1.0f, 1.0f, 1.0f); //diffuse
+	Vector3d Ks = Vector3d(1.0f, 1.0f, 1.0f); //specular
+
+	float d; //alpha
+	float Tr = 1.0f; //alpha
+
+	int illum = 2; //specular illumination
+	float Ns = 0.f;
+
+	std::string map_Kd; //filename texture
+};
+
+//Nodes are allocated in the scene arena and own nothing, the arena destroys them all.
+class MeshNode
+{
+public:
+	MeshNode(MeshNode* parent, std::string name);
+	~MeshNode();
+
+	bool hasMeshNodes() { return _TriMeshes.size() > 0; }
+	void setTransform(const Eigen::Matrix4d& matrix) { _transform = matrix; }
+
+	std::string _name;
+	Eigen::Matrix4d _transform;		//local transform in FBX layout (row vectors, translation in row 3)
+	std::vector<MeshNode* > _children;
+	std::vector<TriMesh* > _TriMeshes;	//meshes attached to this node
+	MeshNode* _parent;
+};
+
+//Scene content shared by the importers: the extracted meshes, materials and node
+//tree, plus the exporters working on them. An importer fills the containers in
+//LoadScene/ExtractContent; nothing here depends on the Autodesk FBX SDK.
+class SceneParser
+{
+public:
+	SceneParser();
+	virtual ~SceneParser();
+	enum { E_NOERROR, E_NO_MESH, E_FAILOPENFILE, E_FAILLOADSCENE, };
+
+	virtual bool LoadScene(const char* pFilename) = 0;
+
+	//bytes of the file LoadScene opens, read ahead by the caller, NULL to open the file;
+	//they must stay valid until Clear. The importers reading a mapped file use them instead
+	//(the FBX SDK reads the file itself, which then comes from the OS cache)
+	void SetInput(const uint8_t* data, size_t size) { _pInput = data; _inputSize = size; }
+
+	virtual void ExtractContent() = 0;
+
+	int ExportOBJ(const char* pFilename);
+
+	//Extract and write an OBJ one mesh at a time instead of ExtractContent + ExportOBJ.
+	//Each mesh is freed once written, so peak memory follows the largest mesh rather than
+	//the scene; the output is the same. Meshes are not kept in the scene containers.
+	int StreamOBJ(const char* pFilename);
+
+	//glTF 2.0, one welded mesh per TriMesh and the node tree with local transforms: binary
+	//(.glb) or JSON (.gltf, buffers in a .bin next to it); with a geometry store every
+	//mesh buffer is a shared file of the store instead
+	int ExportGLB(const char* pFilename);
+
+	//bounds and BVHs of the meshes, built in parallel, and the node tree bounds
+	int ExportBVH(const char* pFilename);
+
+	//the extracted scene as a memory-mappable .scene file that SceneFileParser loads
+	//without copying the meshes (see scenefile.h)
+	int ExportScene(const char* pFilename);
+
+	//pick the exporter from the file extension (.glb or .gltf, .scene, anything else is OBJ), baking
+	//transforms, simplifying the meshes and writing the LOD and .bvh files when the options
+	//ask for it
+	int Export(const char* pFilename);
+	static bool IsGLB(const std::string& filename);
+	static bool IsGLTF(const std::string& filename);	//.gltf or .glb
+	static bool IsSceneFile(const std::string& filename);	//.scene
+
+	//level 1.. of a LOD chain: "dir/name_lod<level>.ext" for "dir/name.ext"
+	static std::string LodFileName(const std::string& filename, size_t level);
+
+	//"dir/name.bvh" for "dir/name.ext"
+	static std::string BvhFileName(const std::string& filename);
+
+	//share identical meshes between glTF outputs through a store, NULL for none
+	void SetGeometryStore(GeometryStore* pStore) { _pGeometryStore = pStore; }
+
+	//release the extracted content so the parser can be reused for the next file;
+	//the arena keeps its blocks for the next scene
+	virtual void Clear();
+
+	//allocation statistics of the scene arena, see MeshArena::Stats
+	MeshArena::Stats GetArenaStats() const { return _arena.GetStats(); }
+
+	void SetExportOptions(const ExportOptions& options) { _options = options; }
+	const ExportOptions& GetExportOptions() const { return _options; }
+
+protected:
+	//triangulate an arena mesh, register both and attach the triangles to a node
+	TriMesh* AddMesh(PolyMesh* pMesh, MeshNode* pMeshNode);
+
+	//same for a mesh already triangulated elsewhere (e.g. on a worker thread)
+	void AddMesh(PolyMesh* pMesh, TriMesh* pTriMesh, MeshNode* pMeshNode);
+
+	//attach a mesh registered by AddMesh to one more node: an instance of shared geometry,
+	//placed by the node transform. Meshes/TriMeshes keep one entry per geometry.
+	void AddInstance(TriMesh* pTriMesh, MeshNode* pMeshNode);
+
+	//register an arena material unless one with the same name is already known,
+	//in which case the known one is kept
+	void AddMaterial(Material* pMaterial);
+
+	//weld a mesh for the exporters, optimized and reported when the options ask for it
+	WeldedMesh* WeldForExport(const TriMesh* pTriMesh) const;
+
+	//write through the exporter of the file extension, generating the tangents glTF needs
+	//(and a .scene keeps)
+	int ExportFile(const char* pFilename);
+
+	//tangents of every mesh that has none yet
+	void GenerateMeshTangents();
+
+	//replace every use of a mesh by a node with a copy in world space and make the node
+	//transforms identity; TriMeshes then holds one mesh per use
+	void BakeTransforms();
+
+	//replace every mesh (and its uses by nodes) with a simplification down to ratio times
+	//baseTris[i] triangles, or down to maxError when ratio is 1
+	void SimplifyMeshes(const std::vector<uint32_t>& baseTris, float ratio, float maxError);
+
+	//write a mesh, welded when the options ask for it
+	void AppendOBJ(ObjWriter& writer, const TriMesh* m) const;
+
+	//ExportOBJ with expandInstances: every node's meshes in depth-first order, named after the node
+	void AppendInstancesOBJ(ObjWriter& writer) const;
+
+	//StreamOBJ hooks: walk the scene and collect every material, returning the number
+	//of meshes; then extract mesh i (in walk order) as a heap TriMesh whose PolyMesh
+	//is already freed, or NULL for a mesh without polygons or an instance of geometry
+	//already streamed (unless ExportOptions::expandInstances)
+	virtual size_t BeginStream() = 0;
+	virtual TriMesh* StreamMesh(size_t i) = 0;
+	//the same mesh as a heap CompactMesh for ExportOptions::compact; by default converted
+	//from StreamMesh, importers holding the PolyMesh build it without the TriMesh
+	virtual CompactMesh* StreamCompactMesh(size_t i);
+
+	//geometry object from _geometryArena, or from the heap while streaming
+	template <typename T, typename... Args>
+	T* NewGeometry(Args&&... args)
+	{
+		if (_geometryArena)
+			return _geometryArena->New<T>(std::forward<Args>(args)...);
+		return new T(std::forward<Args>(args)...);
+	}
+
+	//meshes, materials and nodes below all live in _arena and are released by Clear()
+	MeshArena _arena;
+	MeshArena* _geometryArena;	//PolyMesh/TriMesh storage, &_arena or NULL (heap) while streaming
+
+	std::vector<PolyMesh* > Meshes;
+	std::vector<TriMesh* > TriMeshes;
+	std::map<std::string, Material*> Materials;
+	std::vector<MeshNode* > Nodes;
+
+	ExportOptions _options;
+	GeometryStore* _pGeometryStore;
+	const uint8_t* _pInput;		//see SetInput, NULL to open the file
+	size_t _inputSize;
+};
@@ -0,0 +1,485 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//scenefile.cpp
+
+#include "scenefile.h"
+#include "hash.h"
+#include "parallel.h"
+#include "profile.h"
+#include "textwriter.h"
+#include <algorithm>
+#include <atomic>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(sizeof(Vector2d) == 2 * sizeof(double) && sizeof(Vector3d) == 3 * sizeof(double) &&
+	sizeof(Vector4d) == 4 * sizeof(double), "mesh arrays are stored as packed doubles");
+static_assert(sizeof(SceneFileHeader) == 160 && sizeof(SceneMeshRecord) == 168 && sizeof(SceneNodeRecord) == 152 &&
+	sizeof(SceneMaterialRecord) == 104 && sizeof(SceneSubMeshRecord) == 16, "scene file records are fixed size");
+
+namespace
+{
+	const uint64_t FILE_ALIGNMENT = 64;
+	const size_t INDEX_GRAIN = 1 << 16;		//triangle corners per parallel chunk of the index check
+
+	inline uint64_t Align(uint64_t offset)
+	{
+		return (offset + FILE_ALIGNMENT - 1) & ~(uint64_t)(FILE_ALIGNMENT - 1);
+	}
+
+	uint64_t ArrayBytes(const SceneMeshRecord& r, int array)
+	{
+		const uint64_t numCorners = (uint64_t)r.numTris * 3;
+		switch (array)
+		{
+		case SCENE_P:
+		case SCENE_PN: return (uint64_t)r.numVert * sizeof(Vector3d);
+		case SCENE_TRI_INDEX:
+		case SCENE_UV_INDICES: return numCorners * sizeof(uint32_t);
+		case SCENE_N: return numCorners * sizeof(Vector3d);
+		case SCENE_T: return numCorners * sizeof(Vector2d);
+		case SCENE_UV: return (uint64_t)r.numUV * sizeof(Vector2d);
+		default: return numCorners * sizeof(Vector4d);
+		}
+	}
+
+	const void* ArrayData(const TriMesh* m, int array)
+	{
+		switch (array)
+		{
+		case SCENE_P: return m->P.get();
+		case SCENE_TRI_INDEX: return m->triIndex.get();
+		case SCENE_N: return m->N.get();
+		case SCENE_T: return m->T.get();
+		case SCENE_UV_INDICES: return m->UVIndices.get();
+		case SCENE_PN: return m->PN.get();
+		case SCENE_UV: return m->UV.get();
+		default: return m->TG.get();
+		}
+	}
+
+	struct SceneTables
+	{
+		std::vector<SceneMeshRecord> meshes;
+		std::vector<SceneNodeRecord> nodes;
+		std::vector<uint32_t> meshRefs;
+		std::vector<SceneMaterialRecord> materials;
+		std::vector<SceneSubMeshRecord> subMeshes;
+		std::string strings;
+	};
+
+	void AddString(std::string& strings, const std::string& s, uint32_t& offset, uint32_t& length)
+	{
+		offset = (uint32_t)strings.size();
+		length = (uint32_t)s.size();
+		strings += s;
+	}
+
+	void AddSceneNode(SceneTables& tables, const MeshNode* pNode, uint32_t parent,
+		const std::map<const TriMesh*, uint32_t>& meshIndex)
+	{
+		const uint32_t self = (uint32_t)tables.nodes.size();
+		SceneNodeRecord record = {};
+		memcpy(record.transform, pNode->_transform.data(), sizeof(record.transform));
+		record.parent = parent;
+		AddString(tables.strings, pNode->_name, record.nameOffset, record.nameLength);
+		record.firstMeshRef = (uint32_t)tables.meshRefs.size();
+		for (const TriMesh* m : pNode->_TriMeshes)
+		{
+			auto found = meshIndex.find(m);
+			if (found != meshIndex.end())
+				tables.meshRefs.push_back(found->second);
+		}
+		record.numMeshRefs = (uint32_t)tables.meshRefs.size() - record.firstMeshRef;
+		tables.nodes.push_back(record);
+		for (const MeshNode* pChild : pNode->_children)
+			AddSceneNode(tables, pChild, self, meshIndex);
+	}
+
+	bool WritePadded(OutputFile& file, const void* data, size_t bytes, uint64_t& offset)
+	{
+		static const uint8_t zeros[FILE_ALIGNMENT] = {};
+		if (!file.Write(data, bytes))
+			return false;
+		offset += bytes;
+		const size_t pad = (size_t)(Align(offset) - offset);
+		offset += pad;
+		return file.Write(zeros, pad);
+	}
+
+	bool InFile(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize)
+	{
+		return offset % FILE_ALIGNMENT == 0 && offset <= fileSize && count <= (fileSize - offset) / size;
+	}
+}
+
+bool WriteSceneFile(const char* pFilename, const std::vector<TriMesh*>& meshes,
+	const std::vector<MeshNode*>& roots, const std::map<std::string, Material*>& materials)
+{
+	SceneTables tables;
+	std::map<const TriMesh*, uint32_t> meshIndex;
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const TriMesh* m = meshes[i];
+		meshIndex.emplace(m, (uint32_t)i);
+		SceneMeshRecord r = {};
+		AddString(tables.strings, m->name, r.nameOffset, r.nameLength);
+		AddString(tables.strings, m->matname, r.matnameOffset, r.matnameLength);
+		r.numVert = m->numVert;
+		r.numTris = m->numTris;
+		r.numUV = m->numUV;
+		r.firstSubMesh = (uint32_t)tables.subMeshes.size();
+		r.numSubMeshes = (uint32_t)m->subMeshes.size();
+		for (const SubMesh& sub : m->subMeshes)
+		{
+			SceneSubMeshRecord s = {};
+			AddString(tables.strings, sub.matname, s.matnameOffset, s.matnameLength);
+			s.firstTri = sub.firstTri;
+			s.numTris = sub.numTris;
+			tables.subMeshes.push_back(s);
+		}
+		tables.meshes.push_back(r);
+	}
+	for (const MeshNode* pRoot : roots)
+		AddSceneNode(tables, pRoot, UINT32_MAX, meshIndex);
+	for (const auto& entry : materials)
+	{
+		const Material* pMaterial = entry.second;
+		SceneMaterialRecord r = {};
+		memcpy(r.Ka, pMaterial->Ka.data(), sizeof(r.Ka));
+		memcpy(r.Kd, pMaterial->Kd.data(), sizeof(r.Kd));
+		memcpy(r.Ks, pMaterial->Ks.data(), sizeof(r.Ks));
+		r.Tr = pMaterial->Tr;
+		r.Ns = pMaterial->Ns;
+		r.illum = pMaterial->illum;
+		r.index = pMaterial->index;
+		AddString(tables.strings, pMaterial->materialName, r.nameOffset, r.nameLength);
+		AddString(tables.strings, pMaterial->map_Kd, r.mapKdOffset, r.mapKdLength);
+		tables.materials.push_back(r);
+	}
+
+	//every offset follows from the counts
+	SceneFileHeader header = {};
+	memcpy(header.magic, "FBXCSCN", 8);
+	header.version = SCENE_FILE_VERSION;
+	header.numMeshes = (uint32_t)tables.meshes.size();
+	header.numNodes = (uint32_t)tables.nodes.size();
+	header.numMeshRefs = (uint32_t)tables.meshRefs.size();
+	header.numMaterials = (uint32_t)tables.materials.size();
+	header.numSubMeshes = (uint32_t)tables.subMeshes.size();
+	const void* sections[SCENE_NUM_SECTIONS] = { tables.meshes.data(), tables.nodes.data(), tables.meshRefs.data(),
+		tables.materials.data(), tables.subMeshes.data(), tables.strings.data() };
+	const size_t sectionBytes[SCENE_NUM_SECTIONS] = { tables.meshes.size() * sizeof(SceneMeshRecord),
+		tables.nodes.size() * sizeof(SceneNodeRecord), tables.meshRefs.size() * sizeof(uint32_t),
+		tables.materials.size() * sizeof(SceneMaterialRecord), tables.subMeshes.size() * sizeof(SceneSubMeshRecord),
+		tables.strings.size() };
+	uint64_t offset = Align(sizeof(SceneFileHeader));
+	for (int s = 0; s < SCENE_NUM_SECTIONS; ++s)
+	{
+		header.offsets[s] = offset;
+		offset = Align(offset + sectionBytes[s]);
+	}
+	header.stringsSize = tables.strings.size();
+
+	//the arrays follow the tables mesh by mesh, hashed from the meshes (large arrays in parallel blocks)
+	{
+		PROFILE_SCOPE(STAGE_EXPORT, "HashScene");
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			SceneMeshRecord& r = tables.meshes[i];
+			for (int a = 0; a < SCENE_NUM_ARRAYS; ++a)
+			{
+				const void* data = ArrayData(meshes[i], a);
+				if (a == SCENE_TG && !data)
+					continue;
+				r.offsets[a] = offset;
+				r.checksums[a] = HashArray(data, ArrayBytes(r, a));
+				offset = Align(offset + ArrayBytes(r, a));
+			}
+		}
+	}
+	header.fileSize = offset;
+	for (int s = 0; s < SCENE_NUM_SECTIONS; ++s)
+		header.checksums[s] = HashArray(sections[s], sectionBytes[s]);
+	header.headerChecksum = Hash64(&header, offsetof(SceneFileHeader, headerChecksum));
+
+	OutputFile file;
+	if (!file.Open(pFilename))
+		return false;
+	offset = 0;
+	bool ok = WritePadded(file, &header, sizeof(header), offset);
+	for (int s = 0; s < SCENE_NUM_SECTIONS && ok; ++s)
+		ok = WritePadded(file, sections[s], sectionBytes[s], offset);
+	for (size_t i = 0; i < meshes.size() && ok; ++i)
+	{
+		for (int a = 0; a < SCENE_NUM_ARRAYS && ok; ++a)
+			if (tables.meshes[i].offsets[a])
+				ok = WritePadded(file, ArrayData(meshes[i], a), (size_t)ArrayBytes(tables.meshes[i], a), offset);
+	}
+	ok = file.Close() && ok && offset == header.fileSize;
+	if (ok)
+		PROFILE_COUNT(COUNTER_BYTES_WRITTEN, offset);
+	return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool SceneFile::Open(const char* pFilename)
+{
+	return _file.Open(pFilename) && Check();
+}
+
+bool SceneFile::Attach(const uint8_t* data, size_t size)
+{
+	return _file.Attach(data, size) && Check();
+}
+
+bool SceneFile::Check()
+{
+	const uint8_t* data = _file.Data();
+	const uint64_t fileSize = _file.Size();
+	const SceneFileHeader& h = Header();
+	bool ok = fileSize >= sizeof(SceneFileHeader) && memcmp(h.magic, "FBXCSCN", 8) == 0 &&
+		h.version == SCENE_FILE_VERSION && h.fileSize == fileSize &&
+		h.headerChecksum == Hash64(&h, offsetof(SceneFileHeader, headerChecksum)) &&
+		InFile(h.offsets[SCENE_MESHES], h.numMeshes, sizeof(SceneMeshRecord), fileSize) &&
+		InFile(h.offsets[SCENE_NODES], h.numNodes, sizeof(SceneNodeRecord), fileSize) &&
+		InFile(h.offsets[SCENE_MESH_REFS], h.numMeshRefs, sizeof(uint32_t), fileSize) &&
+		InFile(h.offsets[SCENE_MATERIALS], h.numMaterials, sizeof(SceneMaterialRecord), fileSize) &&
+		InFile(h.offsets[SCENE_SUBMESHES], h.numSubMeshes, sizeof(SceneSubMeshRecord), fileSize) &&
+		InFile(h.offsets[SCENE_STRINGS], h.stringsSize, 1, fileSize);
+	if (ok)
+	{
+		const uint64_t sectionBytes[SCENE_NUM_SECTIONS] = { h.numMeshes * sizeof(SceneMeshRecord),
+			h.numNodes * sizeof(SceneNodeRecord), h.numMeshRefs * sizeof(uint32_t),
+			h.numMaterials * sizeof(SceneMaterialRecord), h.numSubMeshes * sizeof(SceneSubMeshRecord), h.stringsSize };
+		for (int s = 0; s < SCENE_NUM_SECTIONS && ok; ++s)
+			ok = h.checksums[s] == HashArray(data + h.offsets[s], (size_t)sectionBytes[s]);
+	}
+
+	//names and references, so that nothing handed out points outside the file
+	auto inStrings = [&](uint32_t offset, uint32_t length) { return (uint64_t)offset + length <= h.stringsSize; };
+	for (uint32_t i = 0; ok && i < h.numMeshes; ++i)
+	{
+		const SceneMeshRecord& r = Mesh(i);
+		ok = inStrings(r.nameOffset, r.nameLength) && inStrings(r.matnameOffset, r.matnameLength) &&
+			(uint64_t)r.firstSubMesh + r.numSubMeshes <= h.numSubMeshes;
+		for (int a = 0; a < SCENE_NUM_ARRAYS && ok; ++a)
+			ok = (a == SCENE_TG && r.offsets[a] == 0) || (r.offsets[a] != 0 && InFile(r.offsets[a], ArrayBytes(r, a), 1, fileSize));
+		for (uint32_t k = 0; k < r.numSubMeshes && ok; ++k)
+		{
+			const SceneSubMeshRecord& s = SubMesh(r.firstSubMesh + k);
+			ok = inStrings(s.matnameOffset, s.matnameLength) && (uint64_t)s.firstTri + s.numTris <= r.numTris;
+		}
+	}
+	for (uint32_t i = 0; ok && i < h.numNodes; ++i)
+	{
+		const SceneNodeRecord& n = Node(i);
+		ok = (n.parent == UINT32_MAX || n.parent < i) && inStrings(n.nameOffset, n.nameLength) &&
+			(uint64_t)n.firstMeshRef + n.numMeshRefs <= h.numMeshRefs;
+	}
+	for (uint32_t i = 0; ok && i < h.numMeshRefs; ++i)
+		ok = MeshRefs()[i] < h.numMeshes;
+	for (uint32_t i = 0; ok && i < h.numMaterials; ++i)
+		ok = inStrings(Material(i).nameOffset, Material(i).nameLength) && inStrings(Material(i).mapKdOffset, Material(i).mapKdLength);
+	if (!ok)
+		_file.Close();
+	return ok;
+}
+
+bool SceneFile::VerifyMesh(uint32_t i) const
+{
+	const SceneMeshRecord& r = Mesh(i);
+	for (int a = 0; a < SCENE_NUM_ARRAYS; ++a)
+		if (r.offsets[a] && r.checksums[a] != HashArray(_file.Data() + r.offsets[a], (size_t)ArrayBytes(r, a)))
+			return false;
+
+	//checksums can be recomputed by whoever wrote the file, the exporters index P, PN and UV
+	//with these without checking
+	const uint32_t* triIndex = (const uint32_t*)(_file.Data() + r.offsets[SCENE_TRI_INDEX]);
+	const uint32_t* uvIndices = (const uint32_t*)(_file.Data() + r.offsets[SCENE_UV_INDICES]);
+	std::atomic<bool> inRange(true);
+	ParallelFor((size_t)r.numTris * 3, INDEX_GRAIN, [&](size_t begin, size_t end) {
+		uint32_t maxVert = 0, maxUV = 0;
+		for (size_t c = begin; c < end; ++c)
+		{
+			maxVert = std::max(maxVert, triIndex[c]);
+			maxUV = std::max(maxUV, uvIndices[c]);
+		}
+		if (begin < end && (maxVert >= r.numVert || maxUV >= r.numUV))
+			inRange.store(false, std::memory_order_relaxed);
+	});
+	return inRange.load(std::memory_order_relaxed);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool SceneFileParser::LoadScene(const char* pFilename)
+{
+	Clear();
+	PROFILE_SCOPE(STAGE_LOAD, "LoadScene");
+	if (!(_pInput ? _file.Attach(_pInput, _inputSize) : _file.Open(pFilename)))
+	{
+		printf("Error: %s is not a valid scene file\n", pFilename);
+		return false;
+	}
+
+	//large meshes one after the other on all cores, then the small ones one per thread
+	const uint32_t numMeshes = _file.Header().numMeshes;
+	const uint32_t LARGE_MESH_TRIS = 1 << 16;
+	std::vector<char> verified(numMeshes, 1);
+	std::vector<uint32_t> small;
+	for (uint32_t i = 0; i < numMeshes; ++i)
+	{
+		if (_file.Mesh(i).numTris >= LARGE_MESH_TRIS)
+			verified[i] = _file.VerifyMesh(i);
+		else
+			small.push_back(i);
+	}
+	ParallelForEach(small.size(), [&](size_t k) { verified[small[k]] = _file.VerifyMesh(small[k]); });
+	for (uint32_t i = 0; i < numMeshes; ++i)
+	{
+		if (!verified[i])
+		{
+			printf("Error: mesh %u of %s does not match its checksum or indexes past its arrays\n", i, pFilename);
+			_file.Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void SceneFileParser::ExtractContent()
+{
+	if (!_file.IsOpen())
+	{
+		printf("Error: No scene file!\n");
+		return;
+	}
+
+	PROFILE_SCOPE(STAGE_EXTRACT, "ExtractScene");
+	std::vector<TriMesh*> meshes(_file.Header().numMeshes);
+	for (uint32_t i = 0; i < meshes.size(); ++i)
+	{
+		meshes[i] = NewMesh(i);
+		TriMeshes.push_back(meshes[i]);
+	}
+	ExtractNodes(meshes);
+	ExtractMaterials();
+}
+
+void SceneFileParser::Clear()
+{
+	SceneParser::Clear();
+	_file.Close();
+}
+
+size_t SceneFileParser::BeginStream()
+{
+	if (!_file.IsOpen())
+	{
+		printf("Error: No scene file!\n");
+		return 0;
+	}
+	ExtractNodes(std::vector<TriMesh*>());
+	ExtractMaterials();
+	return _options.expandInstances ? _file.Header().numMeshRefs : _file.Header().numMeshes;
+}
+
+TriMesh* SceneFileParser::StreamMesh(size_t i)
+{
+	return NewMesh(_options.expandInstances ? _file.MeshRefs()[i] : (uint32_t)i);
+}
+
+TriMesh* SceneFileParser::NewMesh(uint32_t i)
+{
+	const SceneMeshRecord& r = _file.Mesh(i);
+	TriMesh* m = NewGeometry<TriMesh>(std::string(_file.String(r.nameOffset, r.nameLength)));
+	m->matname = _file.String(r.matnameOffset, r.matnameLength);
+	m->numVert = r.numVert;
+	m->numTris = r.numTris;
+	m->numUV = r.numUV;
+	m->P = MeshArrayView(_file.Array<Vector3d>(i, SCENE_P));
+	m->triIndex = MeshArrayView(_file.Array<uint32_t>(i, SCENE_TRI_INDEX));
+	m->N = MeshArrayView(_file.Array<Vector3d>(i, SCENE_N));
+	m->T = MeshArrayView(_file.Array<Vector2d>(i, SCENE_T));
+	m->UVIndices = MeshArrayView(_file.Array<uint32_t>(i, SCENE_UV_INDICES));
+	m->PN = MeshArrayView(_file.Array<Vector3d>(i, SCENE_PN));
+	m->UV = MeshArrayView(_file.Array<Vector2d>(i, SCENE_UV));
+	m->TG = MeshArrayView(_file.Array<Vector4d>(i, SCENE_TG));
+	for (uint32_t k = 0; k < r.numSubMeshes; ++k)
+	{
+		const SceneSubMeshRecord& s = _file.SubMesh(r.firstSubMesh + k);
+		SubMesh sub;
+		sub.matname = _file.String(s.matnameOffset, s.matnameLength);
+		sub.firstTri = s.firstTri;
+		sub.numTris = s.numTris;
+		m->subMeshes.push_back(sub);
+	}
+	PROFILE_COUNT(COUNTER_MESHES, 1);
+	PROFILE_COUNT(COUNTER_TRIANGLES, m->numTris);
+	return m;
+}
+
+void SceneFileParser::ExtractNodes(const std::vector<TriMesh*>& meshes)
+{
+	//parents come first, so every node finds its parent already created
+	std::vector<MeshNode*> nodes(_file.Header().numNodes);
+	for (uint32_t i = 0; i < nodes.size(); ++i)
+	{
+		const SceneNodeRecord& r = _file.Node(i);
+		MeshNode* pParent = r.parent == UINT32_MAX ? nullptr : nodes[r.parent];
+		MeshNode* pNode = _arena.New<MeshNode>(pParent, std::string(_file.String(r.nameOffset, r.nameLength)));
+		pNode->setTransform(Eigen::Map<const Eigen::Matrix4d>(r.transform));
+		if (!meshes.empty())
+			for (uint32_t k = 0; k < r.numMeshRefs; ++k)
+				pNode->_TriMeshes.push_back(meshes[_file.MeshRefs()[r.firstMeshRef + k]]);
+		if (pParent)
+			pParent->_children.push_back(pNode);
+		else
+			Nodes.push_back(pNode);
+		nodes[i] = pNode;
+	}
+}
+
+void SceneFileParser::ExtractMaterials()
+{
+	for (uint32_t i = 0; i < _file.Header().numMaterials; ++i)
+	{
+		const SceneMaterialRecord& r = _file.Material(i);
+		Material* pMaterial = _arena.New<Material>();
+		pMaterial->index = r.index;
+		pMaterial->materialName = _file.String(r.nameOffset, r.nameLength);
+		pMaterial->Ka = Vector3d(r.Ka[0], r.Ka[1], r.Ka[2]);
+		pMaterial->Kd = Vector3d(r.Kd[0], r.Kd[1], r.Kd[2]);
+		pMaterial->Ks = Vector3d(r.Ks[0], r.Ks[1], r.Ks[2]);
+		pMaterial->Tr = r.Tr;
+		pMaterial->Ns = r.Ns;
+		pMaterial->illum = r.illum;
+		pMaterial->map_Kd = _file.String(r.mapKdOffset, r.mapKdLength);
+		AddMaterial(pMaterial);
+	}
+}
@@ -0,0 +1,219 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//scenefile.h
+
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mappedfile.h"
+#include "scene.h"
+
+//The .scene file: an extracted scene (meshes, node tree, materials) written as it sits in
+//memory, little endian, every section and array 64 byte aligned at an offset from the
+//start of the file, so a mapped file hands out the TriMesh arrays in place:
+//
+//    SceneFileHeader
+//    SceneMeshRecord[numMeshes]          in SceneParser::TriMeshes order
+//    SceneNodeRecord[numNodes]           the node tree depth-first, parents first
+//    uint32_t[numMeshRefs]               meshes of the nodes
+//    SceneMaterialRecord[numMaterials]   in name order
+//    SceneSubMeshRecord[numSubMeshes]    material ranges of the meshes
+//    strings, not terminated
+//    per mesh: the arrays of SceneArray
+//
+//The header, every table and every mesh array carry an xxHash (HashArray) of their bytes.
+const uint32_t SCENE_FILE_VERSION = 1;
+
+//the arrays of a mesh, in file order
+enum SceneArray
+{
+	SCENE_P,				//Vector3d[numVert]
+	SCENE_TRI_INDEX,		//uint32_t[numTris * 3]
+	SCENE_N,				//Vector3d[numTris * 3]
+	SCENE_T,				//Vector2d[numTris * 3]
+	SCENE_UV_INDICES,		//uint32_t[numTris * 3]
+	SCENE_PN,				//Vector3d[numVert]
+	SCENE_UV,				//Vector2d[numUV]
+	SCENE_TG,				//Vector4d[numTris * 3], offset 0 when the mesh has no tangents
+	SCENE_NUM_ARRAYS,
+};
+
+//the tables after the header
+enum SceneSection
+{
+	SCENE_MESHES,
+	SCENE_NODES,
+	SCENE_MESH_REFS,
+	SCENE_MATERIALS,
+	SCENE_SUBMESHES,
+	SCENE_STRINGS,
+	SCENE_NUM_SECTIONS,
+};
+
+struct SceneFileHeader
+{
+	char magic[8];				//"FBXCSCN" and 0
+	uint32_t version;
+	uint32_t numMeshes;
+	uint32_t numNodes;
+	uint32_t numMeshRefs;
+	uint32_t numMaterials;
+	uint32_t numSubMeshes;
+	uint64_t offsets[SCENE_NUM_SECTIONS];
+	uint64_t checksums[SCENE_NUM_SECTIONS];
+	uint64_t stringsSize;
+	uint64_t fileSize;
+	uint64_t reserved;
+	uint64_t headerChecksum;	//of the header bytes before it
+};
+
+struct SceneMeshRecord
+{
+	uint32_t nameOffset;		//in the strings
+	uint32_t nameLength;
+	uint32_t matnameOffset;
+	uint32_t matnameLength;
+	uint32_t numVert;
+	uint32_t numTris;
+	uint32_t numUV;
+	uint32_t firstSubMesh;
+	uint32_t numSubMeshes;
+	uint32_t reserved;
+	uint64_t offsets[SCENE_NUM_ARRAYS];
+	uint64_t checksums[SCENE_NUM_ARRAYS];
+};
+
+struct SceneNodeRecord
+{
+	double transform[16];		//MeshNode::_transform in Eigen (column major) order
+	uint32_t parent;			//UINT32_MAX for a root
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t firstMeshRef;
+	uint32_t numMeshRefs;
+	uint32_t reserved;
+};
+
+struct SceneMaterialRecord
+{
+	double Ka[3];
+	double Kd[3];
+	double Ks[3];
+	float Tr;
+	float Ns;
+	int32_t illum;
+	uint32_t index;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t mapKdOffset;
+	uint32_t mapKdLength;
+};
+
+struct SceneSubMeshRecord
+{
+	uint32_t matnameOffset;
+	uint32_t matnameLength;
+	uint32_t firstTri;
+	uint32_t numTris;
+};
+
+//write meshes, the node tree under roots and the materials; false if the file cannot be written
+bool WriteSceneFile(const char* pFilename, const std::vector<TriMesh*>& meshes,
+	const std::vector<MeshNode*>& roots, const std::map<std::string, Material*>& materials);
+
+//Read-only view of a .scene file. Open maps it and checks the header, the table checksums
+//and that every offset, count, name and reference stays inside the file; the mesh arrays,
+//the bulk of the file, are only read by VerifyMesh.
+class SceneFile
+{
+public:
+	bool Open(const char* pFilename);
+	bool Attach(const uint8_t* data, size_t size);	//see MappedFile::Attach
+	void Close() { _file.Close(); }
+	bool IsOpen() const { return _file.Data() != nullptr; }
+
+	//compare the arrays of mesh i with their checksums and check that its indices stay below numVert / numUV
+	bool VerifyMesh(uint32_t i) const;
+
+	const SceneFileHeader& Header() const { return *(const SceneFileHeader*)_file.Data(); }
+	const SceneMeshRecord& Mesh(uint32_t i) const { return Table<SceneMeshRecord>(SCENE_MESHES)[i]; }
+	const SceneNodeRecord& Node(uint32_t i) const { return Table<SceneNodeRecord>(SCENE_NODES)[i]; }
+	const uint32_t* MeshRefs() const { return Table<uint32_t>(SCENE_MESH_REFS); }
+	const SceneMaterialRecord& Material(uint32_t i) const { return Table<SceneMaterialRecord>(SCENE_MATERIALS)[i]; }
+	const SceneSubMeshRecord& SubMesh(uint32_t i) const { return Table<SceneSubMeshRecord>(SCENE_SUBMESHES)[i]; }
+
+	//an array of mesh i in place, NULL when the mesh has none
+	template <typename T>
+	const T* Array(uint32_t i, SceneArray array) const
+	{
+		const uint64_t offset = Mesh(i).offsets[array];
+		return offset ? (const T*)(_file.Data() + offset) : nullptr;
+	}
+
+	std::string_view String(uint32_t offset, uint32_t length) const
+	{
+		return std::string_view((const char*)_file.Data() + Header().offsets[SCENE_STRINGS] + offset, length);
+	}
+
+private:
+	bool Check();
+
+	template <typename T>
+	const T* Table(SceneSection section) const { return (const T*)(_file.Data() + Header().offsets[section]); }
+
+	MappedFile _file;
+};
+
+//Importer of .scene files. The TriMesh arrays point into the mapped file instead of being
+//copied; the mapping is read-only, which is safe because every stage after extraction
+//reads its input meshes and writes new ones. LoadScene verifies every mesh checksum.
+class SceneFileParser : public SceneParser
+{
+public:
+	bool LoadScene(const char* pFilename) override;
+
+	void ExtractContent() override;
+
+	void Clear() override;
+
+protected:
+	//every mesh once, or every use of a mesh by a node with ExportOptions::expandInstances
+	size_t BeginStream() override;
+	TriMesh* StreamMesh(size_t i) override;
+
+private:
+	//mesh i of the file over its arrays in place, from NewGeometry
+	TriMesh* NewMesh(uint32_t i);
+
+	//node tree and materials, with meshes[i] attached where the nodes reference mesh i
+	void ExtractNodes(const std::vector<TriMesh*>& meshes);
+	void ExtractMaterials();
+
+	SceneFile _file;
+};
@@ -0,0 +1,668 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//simplify.cpp
+
+#include "simplify.h"
+#include "arena.h"
+#include "parallel.h"
+#include "profile.h"
+#include "weld.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	const int NUM_ATTRIBUTES = 5;			//normal xyz, uv
+	const float BORDER_WEIGHT = 10.0f;		//edge planes keeping sliding borders in shape
+	const float SEAM_WEIGHT = 1.0f;			//same for attribute seams
+	const uint32_t INVALID = 0xffffffffu;
+	const int SORT_BITS = 11;				//error buckets: 8 exponent and 3 mantissa bits
+
+	enum VertexKind
+	{
+		KIND_MANIFOLD,	//interior vertex with one attribute set
+		KIND_BORDER,	//on an open border
+		KIND_SEAM,		//two attribute sets on a closed surface
+		KIND_LOCKED,	//never moves
+	};
+
+	//a vertex of the first kind may collapse onto one of the second
+	const bool CAN_COLLAPSE[4][4] = {
+		{ true, true, true, true },
+		{ false, true, false, true },
+		{ false, false, true, true },
+		{ false, false, false, false },
+	};
+
+	struct Vec3
+	{
+		float x, y, z;
+	};
+
+	inline Vec3 Sub(const Vec3& a, const Vec3& b) { Vec3 r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+	inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Vec3 Cross(const Vec3& a, const Vec3& b)
+	{
+		Vec3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		return r;
+	}
+
+	//p^T A p + 2 b.p + c, the weighted sum of squared distances to planes; w sums the weights
+	struct Quadric
+	{
+		float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		float b0 = 0, b1 = 0, b2 = 0;
+		float c = 0, w = 0;
+	};
+
+	//adds w * (n.p + d)^2; n need not be unit length
+	void AddPlane(Quadric& q, const Vec3& n, float d, float w)
+	{
+		q.a00 += w * n.x * n.x; q.a11 += w * n.y * n.y; q.a22 += w * n.z * n.z;
+		q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z; q.a12 += w * n.y * n.z;
+		q.b0 += w * n.x * d; q.b1 += w * n.y * d; q.b2 += w * n.z * d;
+		q.c += w * d * d;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& r)
+	{
+		q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+		q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+		q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+		q.c += r.c; q.w += r.w;
+	}
+
+	float Evaluate(const Quadric& q, const Vec3& p)
+	{
+		float rx = q.a00 * p.x + q.a01 * p.y + q.a02 * p.z;
+		float ry = q.a01 * p.x + q.a11 * p.y + q.a12 * p.z;
+		float rz = q.a02 * p.x + q.a12 * p.y + q.a22 * p.z;
+		return rx * p.x + ry * p.y + rz * p.z + 2.0f * (q.b0 * p.x + q.b1 * p.y + q.b2 * p.z) + q.c;
+	}
+
+	//Per triangle every attribute s is the linear function g.p + d of the position; the
+	//error of a vertex at p with value s is the area weighted sum of (s - g.p - d)^2:
+	//q holds the (g.p + d)^2 terms, g the (g, d) of the cross terms and q.w the area of s^2
+	struct AttributeQuadric
+	{
+		Quadric q;
+		float g[NUM_ATTRIBUTES][4] = {};
+	};
+
+	void AddAttributeQuadric(AttributeQuadric& a, const AttributeQuadric& r)
+	{
+		AddQuadric(a.q, r.q);
+		for (int k = 0; k < NUM_ATTRIBUTES; ++k)
+			for (int i = 0; i < 4; ++i)
+				a.g[k][i] += r.g[k][i];
+	}
+
+	float Evaluate(const AttributeQuadric& a, const Vec3& p, const float* s)
+	{
+		float e = Evaluate(a.q, p);
+		for (int k = 0; k < NUM_ATTRIBUTES; ++k)
+			e += a.q.w * s[k] * s[k] - 2.0f * s[k] * (a.g[k][0] * p.x + a.g[k][1] * p.y + a.g[k][2] * p.z + a.g[k][3]);
+		return e;
+	}
+
+	//uint32 values per vertex in flat rows, filled by counting sort
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> data;
+
+		const uint32_t* Begin(uint32_t v) const { return data.data() + offsets[v]; }
+		const uint32_t* End(uint32_t v) const { return data.data() + offsets[v + 1]; }
+		bool Has(uint32_t v, uint32_t value) const { return std::find(Begin(v), End(v), value) != End(v); }
+	};
+
+	//row key(c) gets value(c) for every corner c, rows in corner order
+	template <typename K, typename V>
+	void BuildAdjacency(Adjacency& adj, size_t numRows, size_t numCorners, K key, V value)
+	{
+		adj.offsets.assign(numRows + 1, 0);
+		for (size_t c = 0; c < numCorners; ++c)
+			++adj.offsets[key(c) + 1];
+		for (size_t v = 0; v < numRows; ++v)
+			adj.offsets[v + 1] += adj.offsets[v];
+		adj.data.resize(numCorners);
+		std::vector<uint32_t> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+		for (size_t c = 0; c < numCorners; ++c)
+			adj.data[fill[key(c)]++] = value(c);
+	}
+
+	inline size_t NextCorner(size_t c) { return c % 3 == 2 ? c - 2 : c + 1; }
+
+	inline uint32_t PositionWord(float v)
+	{
+		if (v == 0.0f)
+			v = 0.0f;	//-0 and +0 are one position
+		uint32_t bits;
+		memcpy(&bits, &v, 4);
+		return bits;
+	}
+
+	struct Collapse
+	{
+		uint32_t v0, v1;	//welded vertex v0 moves onto v1
+		float error;
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const WeldedMesh* w, const TriMesh* m, const SimplifyOptions& options);
+		void Run(uint32_t targetTris);
+
+		std::vector<uint32_t> indices;		//welded vertex per corner
+		std::vector<uint32_t> triRange;		//material range per triangle
+		uint32_t numTris;
+		float maxError = 0.0f;				//squared, in normalized units
+
+	private:
+		void RemapPositions(const WeldedMesh* w);
+		void Classify();
+		void ComputeQuadrics();
+		float Cost(uint32_t a, uint32_t b) const;
+		uint32_t Partner(uint32_t x, uint32_t rb, uint32_t b) const;
+		bool HasFlips(uint32_t ra, uint32_t rb, const Vec3& target) const;
+		void SortByError(std::vector<uint32_t>& order) const;
+		size_t CollapsePass(uint32_t targetTris);
+
+		const SimplifyOptions& _options;
+		uint32_t _numVert;
+		std::vector<Vec3> _pos;				//normalized to the unit cube
+		std::vector<float> _attr;			//weighted attributes, NUM_ATTRIBUTES per vertex
+		std::vector<uint32_t> _remap;		//first welded vertex with the same position
+		std::vector<uint32_t> _ring;		//next welded vertex with the same position, circular
+		std::vector<uint8_t> _kind;			//VertexKind per position (indexed by _remap)
+		std::vector<Quadric> _vq;			//position quadric per position
+		std::vector<AttributeQuadric> _aq;	//attribute quadric per welded vertex
+
+		Adjacency _edges;					//welded vertex -> next welded vertex of its triangles
+		Adjacency _positionEdges;			//same over positions
+		Adjacency _triangles;				//position -> triangles using it
+		std::vector<Collapse> _candidates;
+		std::vector<uint32_t> _collapseRemap;
+		std::vector<uint8_t> _collapseLocked;
+	};
+
+	Simplifier::Simplifier(const WeldedMesh* w, const TriMesh* m, const SimplifyOptions& options)
+		:indices(w->indices), numTris(w->numTris), _options(options), _numVert(w->numVert)
+	{
+		//material range of every triangle, so vertices between materials stay put
+		triRange.assign(numTris, 0);
+		for (size_t r = 0; r < m->subMeshes.size(); ++r)
+		{
+			const SubMesh& sub = m->subMeshes[r];
+			std::fill(triRange.begin() + sub.firstTri, triRange.begin() + sub.firstTri + sub.numTris, (uint32_t)r);
+		}
+
+		//positions into the unit cube so that errors and weights do not depend on the scale
+		float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t v = 0; v < _numVert; ++v)
+			for (int c = 0; c < 3; ++c)
+			{
+				lo[c] = std::min(lo[c], w->positions[v * 3 + c]);
+				hi[c] = std::max(hi[c], w->positions[v * 3 + c]);
+			}
+		float extent = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+		const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+		_pos.resize(_numVert);
+		_attr.resize((size_t)_numVert * NUM_ATTRIBUTES);
+		for (uint32_t v = 0; v < _numVert; ++v)
+		{
+			Vec3 p = { (w->positions[v * 3] - lo[0]) * scale, (w->positions[v * 3 + 1] - lo[1]) * scale,
+				(w->positions[v * 3 + 2] - lo[2]) * scale };
+			_pos[v] = p;
+			float* s = &_attr[(size_t)v * NUM_ATTRIBUTES];
+			for (int c = 0; c < 3; ++c)
+				s[c] = w->normals[v * 3 + c] * options.normalWeight;
+			s[3] = w->uvs[v * 2] * options.uvWeight;
+			s[4] = w->uvs[v * 2 + 1] * options.uvWeight;
+		}
+
+		RemapPositions(w);
+		BuildAdjacency(_edges, _numVert, indices.size(),
+			[&](size_t c) { return indices[c]; }, [&](size_t c) { return indices[NextCorner(c)]; });
+		BuildAdjacency(_positionEdges, _numVert, indices.size(),
+			[&](size_t c) { return _remap[indices[c]]; }, [&](size_t c) { return _remap[indices[NextCorner(c)]]; });
+		Classify();
+		ComputeQuadrics();
+	}
+
+	void Simplifier::RemapPositions(const WeldedMesh* w)
+	{
+		//open addressing over the position bits
+		size_t capacity = 16;
+		while (capacity < (size_t)_numVert * 2)
+			capacity *= 2;
+		std::vector<uint32_t> table(capacity, INVALID);
+		_remap.resize(_numVert);
+		_ring.resize(_numVert);
+		for (uint32_t v = 0; v < _numVert; ++v)
+		{
+			uint32_t key[3];
+			for (int c = 0; c < 3; ++c)
+				key[c] = PositionWord(w->positions[v * 3 + c]);
+			uint64_t h = ((uint64_t)key[0] * 73856093u) ^ ((uint64_t)key[1] * 19349663u) ^ ((uint64_t)key[2] * 83492791u);
+			h ^= h >> 29;
+			size_t slot = (size_t)(h * 0x9e3779b97f4a7c15ull >> 20) & (capacity - 1);
+			for (;; slot = (slot + 1) & (capacity - 1))
+			{
+				uint32_t u = table[slot];
+				if (u == INVALID)
+				{
+					table[slot] = v;
+					_remap[v] = v;
+					_ring[v] = v;
+					break;
+				}
+				if (PositionWord(w->positions[u * 3]) == key[0] && PositionWord(w->positions[u * 3 + 1]) == key[1] &&
+					PositionWord(w->positions[u * 3 + 2]) == key[2])
+				{
+					_remap[v] = u;
+					_ring[v] = _ring[u];
+					_ring[u] = v;
+					break;
+				}
+			}
+		}
+	}
+
+	void Simplifier::Classify()
+	{
+		std::vector<uint8_t> open(_numVert, 0), locked(_numVert, 0);
+		for (uint32_t r = 0; r < _numVert; ++r)
+		{
+			if (_remap[r] != r)
+				continue;
+			for (const uint32_t* e = _positionEdges.Begin(r); e != _positionEdges.End(r); ++e)
+			{
+				if (!_positionEdges.Has(*e, r))
+					open[r] = open[*e] = 1;
+				if (std::count(_positionEdges.Begin(r), _positionEdges.End(r), *e) > 1)
+					locked[r] = locked[*e] = 1;	//edge used by more than two triangles
+			}
+		}
+
+		std::vector<uint32_t> range(_numVert, INVALID);
+		for (size_t c = 0; c < indices.size(); ++c)
+		{
+			uint32_t r = _remap[indices[c]];
+			uint32_t t = triRange[c / 3];
+			if (range[r] == INVALID)
+				range[r] = t;
+			else if (range[r] != t)
+				locked[r] = 1;
+		}
+
+		_kind.assign(_numVert, KIND_LOCKED);
+		for (uint32_t r = 0; r < _numVert; ++r)
+		{
+			if (_remap[r] != r)
+				continue;
+			int wedges = 1;
+			for (uint32_t v = _ring[r]; v != r && wedges <= 2; v = _ring[v])
+				++wedges;
+			if (locked[r] || wedges > 2 || (wedges == 2 && open[r]))
+				_kind[r] = KIND_LOCKED;
+			else if (wedges == 2)
+				_kind[r] = KIND_SEAM;
+			else if (open[r])
+				_kind[r] = _options.lockBorder ? KIND_LOCKED : KIND_BORDER;
+			else
+				_kind[r] = KIND_MANIFOLD;
+		}
+	}
+
+	void Simplifier::ComputeQuadrics()
+	{
+		_vq.assign(_numVert, Quadric());
+		_aq.assign(_numVert, AttributeQuadric());
+		for (uint32_t t = 0; t < numTris; ++t)
+		{
+			const uint32_t v[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+			const Vec3 e1 = Sub(_pos[v[1]], _pos[v[0]]), e2 = Sub(_pos[v[2]], _pos[v[0]]);
+			Vec3 n = Cross(e1, e2);
+			const float length = sqrtf(Dot(n, n));
+			if (length <= 0.0f)
+				continue;
+			const float area = 0.5f * length;
+			n.x /= length; n.y /= length; n.z /= length;
+
+			const float d = -Dot(n, _pos[v[0]]);
+			for (int k = 0; k < 3; ++k)
+			{
+				AddPlane(_vq[_remap[v[k]]], n, d, area);
+				_vq[_remap[v[k]]].w += area;
+			}
+
+			//planes through open border edges and seam edges, perpendicular to the triangle
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t a = v[k], b = v[(k + 1) % 3];
+				const uint32_t ra = _remap[a], rb = _remap[b];
+				float weight;
+				if (!_positionEdges.Has(rb, ra))
+					weight = BORDER_WEIGHT;
+				else if (!_edges.Has(b, a))
+					weight = SEAM_WEIGHT;
+				else
+					continue;
+				const Vec3 edge = Sub(_pos[b], _pos[a]);
+				Vec3 pn = Cross(edge, n);
+				const float pl = sqrtf(Dot(pn, pn));
+				if (pl <= 0.0f)
+					continue;
+				pn.x /= pl; pn.y /= pl; pn.z /= pl;
+				const float edgeWeight = weight * sqrtf(Dot(edge, edge));
+				AddPlane(_vq[ra], pn, -Dot(pn, _pos[a]), edgeWeight);
+				AddPlane(_vq[rb], pn, -Dot(pn, _pos[a]), edgeWeight);
+			}
+
+			//gradient of every attribute over the triangle: g = alpha e1 + beta e2
+			const float d11 = Dot(e1, e1), d12 = Dot(e1, e2), d22 = Dot(e2, e2);
+			const float det = d11 * d22 - d12 * d12;
+			if (det <= 0.0f)
+				continue;
+			AttributeQuadric triangle;
+			triangle.q.w = area;
+			for (int k = 0; k < NUM_ATTRIBUTES; ++k)
+			{
+				const float s0 = _attr[(size_t)v[0] * NUM_ATTRIBUTES + k];
+				const float ds1 = _attr[(size_t)v[1] * NUM_ATTRIBUTES + k] - s0;
+				const float ds2 = _attr[(size_t)v[2] * NUM_ATTRIBUTES + k] - s0;
+				const float alpha = (d22 * ds1 - d12 * ds2) / det;
+				const float beta = (d11 * ds2 - d12 * ds1) / det;
+				const Vec3 g = { alpha * e1.x + beta * e2.x, alpha * e1.y + beta * e2.y, alpha * e1.z + beta * e2.z };
+				const float gd = s0 - Dot(g, _pos[v[0]]);
+				AddPlane(triangle.q, g, gd, area);
+				triangle.g[k][0] = area * g.x;
+				triangle.g[k][1] = area * g.y;
+				triangle.g[k][2] = area * g.z;
+				triangle.g[k][3] = area * gd;
+			}
+			for (int k = 0; k < 3; ++k)
+				AddAttributeQuadric(_aq[v[k]], triangle);
+		}
+	}
+
+	//the welded vertex of position rb that x (another vertex at the position of a) connects to
+	uint32_t Simplifier::Partner(uint32_t x, uint32_t rb, uint32_t b) const
+	{
+		uint32_t y = rb;
+		do
+		{
+			if (y != b && (_edges.Has(x, y) || _edges.Has(y, x)))
+				return y;
+			y = _ring[y];
+		} while (y != rb);
+		return INVALID;
+	}
+
+	//error of moving the position of welded vertex a onto b, FLT_MAX if not allowed
+	float Simplifier::Cost(uint32_t a, uint32_t b) const
+	{
+		const uint32_t ra = _remap[a], rb = _remap[b];
+		const int ka = _kind[ra];
+		if (!CAN_COLLAPSE[ka][_kind[rb]])
+			return FLT_MAX;
+		//borders collapse along the border, seams along the seam
+		if (ka == KIND_BORDER && _positionEdges.Has(rb, ra) && _positionEdges.Has(ra, rb))
+			return FLT_MAX;
+		if (ka == KIND_SEAM && _edges.Has(b, a) && _edges.Has(a, b))
+			return FLT_MAX;
+
+		const Vec3& target = _pos[b];
+		float error = Evaluate(_vq[ra], target);
+		uint32_t x = ra;
+		do
+		{
+			uint32_t y = x == a ? b : Partner(x, rb, b);
+			if (y == INVALID)
+				return FLT_MAX;
+			error += Evaluate(_aq[x], target, &_attr[(size_t)y * NUM_ATTRIBUTES]);
+			x = _ring[x];
+		} while (x != ra);
+		return fabsf(error) / std::max(_vq[ra].w, FLT_MIN);
+	}
+
+	bool Simplifier::HasFlips(uint32_t ra, uint32_t rb, const Vec3& target) const
+	{
+		for (const uint32_t* t = _triangles.Begin(ra); t != _triangles.End(ra); ++t)
+		{
+			//corners as moved by the collapses made so far in this pass
+			const uint32_t* v = &indices[(size_t)*t * 3];
+			int k = 0;
+			while (k < 3 && _remap[v[k]] != ra)
+				++k;
+			if (k == 3)
+				continue;
+			const uint32_t v1 = _remap[_collapseRemap[v[(k + 1) % 3]]], v2 = _remap[_collapseRemap[v[(k + 2) % 3]]];
+			if (v1 == rb || v2 == rb || v1 == v2)
+				continue;	//removed by this collapse or an earlier one
+			const Vec3& p0 = _pos[ra];
+			const Vec3 before = Cross(Sub(_pos[v1], p0), Sub(_pos[v2], p0));
+			const Vec3 after = Cross(Sub(_pos[v1], target), Sub(_pos[v2], target));
+			//reject flips and turns of the normal by more than about 75 degrees
+			if (Dot(before, after) <= 0.25f * sqrtf(Dot(before, before) * Dot(after, after)))
+				return true;
+		}
+		return false;
+	}
+
+	//counting sort on the top bits of the (non-negative) float errors
+	void Simplifier::SortByError(std::vector<uint32_t>& order) const
+	{
+		const size_t numBuckets = (size_t)1 << SORT_BITS;
+		std::vector<uint32_t> histogram(numBuckets + 1, 0);
+		auto bucket = [](float error) {
+			uint32_t bits;
+			memcpy(&bits, &error, 4);
+			return (bits >> (31 - SORT_BITS)) & ((1u << SORT_BITS) - 1);
+		};
+		for (const Collapse& c : _candidates)
+			++histogram[bucket(c.error) + 1];
+		for (size_t i = 0; i < numBuckets; ++i)
+			histogram[i + 1] += histogram[i];
+		order.resize(_candidates.size());
+		for (size_t i = 0; i < _candidates.size(); ++i)
+			order[histogram[bucket(_candidates[i].error)]++] = (uint32_t)i;
+	}
+
+	size_t Simplifier::CollapsePass(uint32_t targetTris)
+	{
+		const size_t numCorners = (size_t)numTris * 3;
+		BuildAdjacency(_edges, _numVert, numCorners,
+			[&](size_t c) { return indices[c]; }, [&](size_t c) { return indices[NextCorner(c)]; });
+		BuildAdjacency(_positionEdges, _numVert, numCorners,
+			[&](size_t c) { return _remap[indices[c]]; }, [&](size_t c) { return _remap[indices[NextCorner(c)]]; });
+		BuildAdjacency(_triangles, _numVert, numCorners,
+			[&](size_t c) { return _remap[indices[c]]; }, [&](size_t c) { return (uint32_t)(c / 3); });
+
+		//one candidate per edge; an interior edge is seen from both triangles, keep one of them
+		_candidates.clear();
+		for (size_t c = 0; c < numCorners; ++c)
+		{
+			const uint32_t a = indices[c], b = indices[NextCorner(c)];
+			if (_remap[a] > _remap[b] && _edges.Has(b, a))
+				continue;
+			Collapse collapse = { a, b, 0.0f };
+			_candidates.push_back(collapse);
+		}
+		ParallelFor(_candidates.size(), 4096, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				Collapse& c = _candidates[i];
+				const float forward = Cost(c.v0, c.v1), backward = Cost(c.v1, c.v0);
+				if (backward < forward)
+					std::swap(c.v0, c.v1);
+				c.error = std::min(forward, backward);
+			}
+		});
+		_candidates.erase(std::remove_if(_candidates.begin(), _candidates.end(),
+			[](const Collapse& c) { return c.error == FLT_MAX; }), _candidates.end());
+		std::vector<uint32_t> order;
+		SortByError(order);
+
+		const float errorLimit = _options.targetError > 0.0f ? _options.targetError * _options.targetError : FLT_MAX;
+		const size_t goal = numTris - targetTris;
+		size_t removed = 0, collapses = 0;
+		_collapseRemap.resize(_numVert);
+		for (uint32_t v = 0; v < _numVert; ++v)
+			_collapseRemap[v] = v;
+		_collapseLocked.assign(_numVert, 0);
+		for (uint32_t i : order)
+		{
+			const Collapse& c = _candidates[i];
+			if (c.error > errorLimit || removed >= goal)
+				break;
+			const uint32_t ra = _remap[c.v0], rb = _remap[c.v1];
+			if (_collapseLocked[ra] || _collapseLocked[rb] || HasFlips(ra, rb, _pos[c.v1]))
+				continue;
+
+			uint32_t x = ra;
+			do
+			{
+				uint32_t y = x == c.v0 ? c.v1 : Partner(x, rb, c.v1);
+				_collapseRemap[x] = y;
+				AddAttributeQuadric(_aq[y], _aq[x]);
+				x = _ring[x];
+			} while (x != ra);
+			AddQuadric(_vq[rb], _vq[ra]);
+			_collapseLocked[ra] = _collapseLocked[rb] = 1;
+			removed += _kind[ra] == KIND_BORDER ? 1 : 2;
+			maxError = std::max(maxError, c.error);
+			++collapses;
+		}
+		if (collapses == 0)
+			return 0;
+
+		//move the corners and drop the triangles that became degenerate, keeping the order
+		uint32_t kept = 0;
+		for (uint32_t t = 0; t < numTris; ++t)
+		{
+			const uint32_t a = _collapseRemap[indices[t * 3]], b = _collapseRemap[indices[t * 3 + 1]],
+				c = _collapseRemap[indices[t * 3 + 2]];
+			if (_remap[a] == _remap[b] || _remap[b] == _remap[c] || _remap[a] == _remap[c])
+				continue;
+			indices[kept * 3] = a;
+			indices[kept * 3 + 1] = b;
+			indices[kept * 3 + 2] = c;
+			triRange[kept] = triRange[t];
+			++kept;
+		}
+		numTris = kept;
+		indices.resize((size_t)kept * 3);
+		triRange.resize(kept);
+		return collapses;
+	}
+
+	void Simplifier::Run(uint32_t targetTris)
+	{
+		while (numTris > targetTris && CollapsePass(targetTris) > 0)
+		{
+		}
+	}
+}
+
+TriMesh* SimplifyTriMesh(const TriMesh* pTriMesh, uint32_t targetTris, const SimplifyOptions& options,
+	MeshArena* pArena, float* pError)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_SIMPLIFY, "Simplify", &pTriMesh->name);
+	std::unique_ptr<WeldedMesh> w(WeldTriMesh(pTriMesh));
+
+	//the first corner of every welded vertex, to copy the exact double values
+	std::vector<uint32_t> firstCorner(w->numVert, INVALID);
+	for (size_t c = w->indices.size(); c-- > 0;)
+		firstCorner[w->indices[c]] = (uint32_t)c;
+
+	Simplifier simplifier(w.get(), pTriMesh, options);
+	w->positions.clear();
+	w->normals.clear();
+	w->uvs.clear();
+	simplifier.Run(targetTris);
+	if (pError)
+		*pError = sqrtf(simplifier.maxError);
+
+	//vertices in order of first use
+	const std::vector<uint32_t>& indices = simplifier.indices;
+	std::vector<uint32_t> newIndex(w->numVert, INVALID);
+	std::vector<uint32_t> used;
+	for (uint32_t v : indices)
+		if (newIndex[v] == INVALID)
+		{
+			newIndex[v] = (uint32_t)used.size();
+			used.push_back(v);
+		}
+
+	const uint32_t numTris = simplifier.numTris;
+	TriMesh* m = pArena ? pArena->New<TriMesh>(pTriMesh->name, (uint32_t)used.size(), numTris, pArena) :
+		new TriMesh(pTriMesh->name, (uint32_t)used.size(), numTris, nullptr);
+	for (uint32_t i = 0; i < (uint32_t)used.size(); ++i)
+	{
+		const uint32_t c = firstCorner[used[i]];
+		m->P[i] = pTriMesh->P[pTriMesh->triIndex[c]];
+		m->PN[i] = pTriMesh->N[c];
+		m->UV[i] = pTriMesh->T[c];
+	}
+	for (size_t c = 0; c < indices.size(); ++c)
+	{
+		const uint32_t v = newIndex[indices[c]];
+		m->triIndex[c] = m->UVIndices[c] = v;
+		m->N[c] = m->PN[v];
+		m->T[c] = m->UV[v];
+	}
+
+	//material ranges that still have triangles
+	m->matname = pTriMesh->matname;
+	const std::vector<uint32_t>& triRange = simplifier.triRange;
+	for (uint32_t t = 0; t < numTris;)
+	{
+		uint32_t end = t;
+		while (end < numTris && triRange[end] == triRange[t])
+			++end;
+		if (!pTriMesh->subMeshes.empty())
+		{
+			SubMesh sub;
+			sub.matname = pTriMesh->subMeshes[triRange[t]].matname;
+			sub.firstTri = t;
+			sub.numTris = end - t;
+			m->subMeshes.push_back(sub);
+		}
+		t = end;
+	}
+	if (m->subMeshes.size() == 1)
+	{
+		m->matname = m->subMeshes[0].matname;
+		m->subMeshes.clear();
+	}
+	return m;
+}
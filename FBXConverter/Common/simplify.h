@@ -0,0 +1,65 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//simplify.h
+
+#pragma once
+
+#include <stdint.h>
+#include "polymesh.h"
+
+class MeshArena;
+
+struct SimplifyOptions
+{
+	//stop before a collapse whose error exceeds this distance, relative to the largest
+	//extent of the mesh (0.01 is 1%); 0 for no limit
+	float targetError = 0.0f;
+
+	//weights of the attribute deviations against the position error, in units of the
+	//normalized mesh: normals (unit length) and uvs
+	float normalWeight = 0.5f;
+	float uvWeight = 1.0f;
+
+	//keep vertices on open borders in place; otherwise they only slide along the border
+	bool lockBorder = true;
+};
+
+//Quadric error metric simplification (Garland and Heckbert) of a TriMesh down to about
+//targetTris triangles. Corners are welded into vertices first; each collapse moves a
+//vertex onto a neighbour, so the result keeps a subset of the original vertices and their
+//exact attributes. The cost adds attribute quadrics (Hoppe) for normals and uvs per welded
+//vertex. Vertices on a uv or normal seam only collapse along the seam with both sides
+//together, border vertices are locked (or slide along the border), and vertices shared by
+//material ranges, non-manifold edges or more than two attribute sets never move.
+//
+//Collapses run in passes without a priority queue: every pass picks the cheaper direction
+//of each edge, bucket-sorts the candidates by error and performs them in order, skipping
+//vertices already touched in the pass or triangles that would flip, then compacts the
+//triangles. Adjacency is rebuilt per pass as flat arrays by counting sort.
+//
+//The result comes from pArena (heap when NULL), material ranges keep their order.
+//pError receives the largest error of the collapses made, relative to the mesh extent.
+TriMesh* SimplifyTriMesh(const TriMesh* pTriMesh, uint32_t targetTris, const SimplifyOptions& options,
+	MeshArena* pArena = nullptr, float* pError = nullptr);
@@ -0,0 +1,194 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//tangents.cpp
+
+#include "tangents.h"
+#include "arena.h"
+#include "parallel.h"
+#include "profile.h"
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace
+{
+	const size_t TRI_GRAIN = 1 << 14;		//triangles per parallel chunk
+	const size_t VERTEX_GRAIN = 1 << 14;	//positions per parallel chunk
+
+	//v without its component along the unit vector n, normalized (zero stays zero)
+	inline Vector3d Project(const Vector3d& v, const Vector3d& n)
+	{
+		const Vector3d p = v - n * n.dot(v);
+		const double length = p.norm();
+		return length > 0.0 ? Vector3d(p / length) : Vector3d::Zero();
+	}
+
+	//acos within 7e-5 radians (Abramowitz and Stegun 4.4.45), enough for a weight
+	inline double FastAcos(double x)
+	{
+		const double a = fabs(std::min(1.0, std::max(-1.0, x)));
+		const double r = sqrt(1.0 - a) * (1.5707288 + a * (-0.2121144 + a * (0.0742610 + a * -0.0187293)));
+		return x < 0.0 ? 3.14159265358979323846 - r : r;
+	}
+
+	//some unit vector perpendicular to n
+	inline Vector3d Perpendicular(const Vector3d& n)
+	{
+		const Vector3d axis = fabs(n[0]) < 0.9 ? Vector3d::UnitX() : Vector3d::UnitY();
+		const Vector3d t = axis - n * n.dot(axis);
+		const double length = t.norm();
+		return length > 0.0 ? Vector3d(t / length) : Vector3d::UnitX();
+	}
+}
+
+void GenerateTangents(TriMesh* pTriMesh, MeshArena* pArena)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_TANGENTS, "GenerateTangents", &pTriMesh->name);
+	const uint32_t numVert = pTriMesh->numVert;
+	const size_t numCorners = (size_t)pTriMesh->numTris * 3;
+	const uint32_t* triIndex = pTriMesh->triIndex.get();
+	const Vector3d* P = pTriMesh->P.get();
+	const Vector3d* N = pTriMesh->N.get();
+	const Vector2d* T = pTriMesh->T.get();
+	pTriMesh->TG = MakeMeshArray<Vector4d>(numCorners, pArena);
+	Vector4d* TG = pTriMesh->TG.get();
+
+	//the weighted contribution of every corner, w the orientation of its triangle
+	//(+1 or -1, 0 when the uvs are degenerate and the corner joins either side)
+	ParallelFor(pTriMesh->numTris, TRI_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t)
+		{
+			const size_t c0 = t * 3;
+			const Vector3d d1 = P[triIndex[c0 + 1]] - P[triIndex[c0]], d2 = P[triIndex[c0 + 2]] - P[triIndex[c0]];
+			const Vector2d t21 = T[c0 + 1] - T[c0], t31 = T[c0 + 2] - T[c0];
+			const double signedArea = t21[0] * t31[1] - t21[1] * t31[0];
+			Vector3d os = d1 * t31[1] - d2 * t21[1];
+			const double orientation = signedArea > 0.0 ? 1.0 : -1.0;
+			if (signedArea == 0.0 || os.squaredNorm() == 0.0)
+			{
+				TG[c0] = TG[c0 + 1] = TG[c0 + 2] = Vector4d::Zero();
+				continue;
+			}
+			os *= orientation;
+
+			//corner angles from the unit edges of the triangle
+			Vector3d edge[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				edge[k] = P[triIndex[c0 + (k + 1) % 3]] - P[triIndex[c0 + k]];
+				const double length = edge[k].norm();
+				if (length > 0.0)
+					edge[k] /= length;
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				const double angle = FastAcos(-edge[k].dot(edge[(k + 2) % 3]));
+				const Vector3d weighted = Project(os, N[c0 + k]) * angle;
+				TG[c0 + k] = Vector4d(weighted[0], weighted[1], weighted[2], orientation);
+			}
+		}
+	});
+
+	//corners of every position: counted and placed with atomics, then sorted per position
+	std::unique_ptr<std::atomic<uint32_t>[]> counts(new std::atomic<uint32_t>[(size_t)numVert + 1]);
+	ParallelFor((size_t)numVert + 1, VERTEX_GRAIN, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v)
+			counts[v].store(0, std::memory_order_relaxed);
+	});
+	ParallelFor(numCorners, TRI_GRAIN * 3, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c)
+			counts[triIndex[c] + 1].fetch_add(1, std::memory_order_relaxed);
+	});
+	std::vector<uint32_t> offsets((size_t)numVert + 1, 0);
+	for (uint32_t v = 0; v < numVert; ++v)
+	{
+		offsets[v + 1] = offsets[v] + counts[v + 1].load(std::memory_order_relaxed);
+		counts[v].store(offsets[v], std::memory_order_relaxed);
+	}
+	std::vector<uint32_t> corners(numCorners);
+	ParallelFor(numCorners, TRI_GRAIN * 3, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c)
+			corners[counts[triIndex[c]].fetch_add(1, std::memory_order_relaxed)] = (uint32_t)c;
+	});
+	counts.reset();
+
+	//every position sums the contributions of its corners with the same normal, uv and
+	//orientation; results wait in a buffer of the chunk until the position is done
+	ParallelFor(numVert, VERTEX_GRAIN, [&](size_t begin, size_t end) {
+		std::vector<Vector4d> result;
+		for (size_t v = begin; v < end; ++v)
+		{
+			uint32_t* first = corners.data() + offsets[v];
+			uint32_t* last = corners.data() + offsets[v + 1];
+			if (first == last)
+				continue;	//a position no triangle uses (index gaps, 2-corner faces)
+			std::sort(first, last);
+
+			//usually every corner of a position matches the first one
+			const uint32_t c0 = *first;
+			const double side = TG[c0][3];
+			bool uniform = side != 0.0;
+			Vector3d total = Vector3d::Zero();
+			for (const uint32_t* c = first; c != last && uniform; ++c)
+			{
+				uniform = N[*c] == N[c0] && T[*c] == T[c0] && TG[*c][3] == side;
+				total += TG[*c].head<3>();
+			}
+			if (uniform)
+			{
+				const double length = total.norm();
+				const Vector3d tangent = length > 0.0 ? Vector3d(total / length) : Perpendicular(N[c0]);
+				for (const uint32_t* c = first; c != last; ++c)
+					TG[*c] = Vector4d(tangent[0], tangent[1], tangent[2], side);
+				continue;
+			}
+
+			result.resize(last - first);
+			for (const uint32_t* c = first; c != last; ++c)
+			{
+				//a degenerate corner takes the side of the first corner it matches
+				auto matches = [&](uint32_t d) { return N[d] == N[*c] && T[d] == T[*c]; };
+				double orientation = TG[*c][3];
+				for (const uint32_t* d = first; d != last && orientation == 0.0; ++d)
+					if (matches(*d))
+						orientation = TG[*d][3];
+				Vector3d sum = Vector3d::Zero();
+				for (const uint32_t* d = first; d != last; ++d)
+				{
+					const double other = TG[*d][3];
+					if (matches(*d) && (other == 0.0 || other == orientation))
+						sum += TG[*d].head<3>();
+				}
+				const double length = sum.norm();
+				const Vector3d tangent = length > 0.0 ? Vector3d(sum / length) : Perpendicular(N[*c]);
+				result[c - first] = Vector4d(tangent[0], tangent[1], tangent[2], orientation != 0.0 ? orientation : 1.0);
+			}
+			for (const uint32_t* c = first; c != last; ++c)
+				TG[*c] = result[c - first];
+		}
+	});
+}
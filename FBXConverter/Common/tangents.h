@@ -0,0 +1,44 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//tangents.h
+
+#pragma once
+
+#include "polymesh.h"
+
+class MeshArena;
+
+//Per-corner tangents of a TriMesh in TG, following the MikkTSpace conventions: every
+//triangle's tangent is the direction in which u grows, projected into the tangent plane of
+//each corner normal and weighted by the corner angle there. The corners of a vertex (same
+//position, normal and uv) that agree in uv orientation share the normalized sum. w is the
+//bitangent sign, +1 when the uvs keep the orientation of the triangle and -1 when they mirror
+//it: bitangent = w * cross(normal, tangent). Corners without a usable uv gradient get a
+//tangent perpendicular to their normal.
+//
+//Triangles are evaluated in parallel chunks; the corners of every position are then sorted
+//and summed in corner order, so the result does not depend on the number of threads. TG
+//comes from pArena (heap when NULL).
+void GenerateTangents(TriMesh* pTriMesh, MeshArena* pArena = nullptr);
@@ -0,0 +1,179 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//textwriter.h
+
+#pragma once
+
+#include <charconv>
+#include <memory>
+#include <string>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "fileio.h"
+
+//fopen that also compiles with the MSVC secure CRT checks
+inline FILE* OpenFile(const char* pFilename, const char* mode)
+{
+	FILE* fp = NULL;
+#ifdef _WIN32
+	fopen_s(&fp, pFilename, mode);
+#else
+	fp = fopen(pFilename, mode);
+#endif
+	return fp;
+}
+
+//Buffered text output for the OBJ/MTL writers (and any other text format).
+//Numbers are converted with std::to_chars straight into a large reusable buffer,
+//which avoids the per-call format parsing and locale lookups of fprintf; the buffer
+//goes to the file in big sequential writes (through the thread's AsyncWriter in a batch).
+class TextWriter
+{
+public:
+	enum
+	{
+		SHORTEST = -1,		//precision value selecting the shortest round-trip representation
+		MAX_PRECISION = 17,	//more digits after the point than any double needs to round-trip
+	};
+
+	TextWriter(size_t bufferSize = 1 << 20)
+		:_size(bufferSize < 4096 ? 4096 : bufferSize), _pos(0), _written(0)
+	{
+		_buffer = std::unique_ptr<char[]>(new char[_size]);
+	}
+
+	~TextWriter() { Close(); }
+
+	bool Open(const char* pFilename)
+	{
+		Close();
+		//same text mode as the former fprintf writers, so line endings are unchanged
+		_written = 0;
+		return _file.Open(pFilename, true);
+	}
+
+	//false when a write or the close failed (disk full), the file is then incomplete
+	bool Close()
+	{
+		if (!_file.IsOpen())
+			return true;
+		Flush();
+		return _file.Close();
+	}
+
+	bool IsOpen() const { return _file.IsOpen(); }
+
+	//bytes produced so far, flushed or not
+	size_t BytesWritten() const { return _written + _pos; }
+
+	TextWriter& Put(char c)
+	{
+		Reserve(1);
+		_buffer[_pos++] = c;
+		return *this;
+	}
+
+	TextWriter& Put(const char* s, size_t len)
+	{
+		if (len > _size)
+		{
+			Flush();
+			_file.Write(s, len);
+			_written += len;
+			return *this;
+		}
+		Reserve(len);
+		memcpy(&_buffer[_pos], s, len);
+		_pos += len;
+		return *this;
+	}
+
+	TextWriter& Put(const char* s) { return Put(s, strlen(s)); }
+	TextWriter& Put(const std::string& s) { return Put(s.c_str(), s.length()); }
+
+	TextWriter& PutInt(int64_t value)
+	{
+		Reserve(24);
+		char* p = &_buffer[_pos];
+		_pos += std::to_chars(p, p + 24, value).ptr - p;
+		return *this;
+	}
+
+	//precision is the number of digits after the decimal point ("%.*f"), at most MAX_PRECISION;
+	//SHORTEST (or any negative value) for round-trip
+	TextWriter& PutFloat(double value, int precision)
+	{
+		//fixed notation of the largest doubles has 309 integer digits, which fits the
+		//4096 byte minimum buffer
+		if (precision > MAX_PRECISION)
+			precision = MAX_PRECISION;
+		const size_t maxLen = 320 + (precision > 0 ? precision : 0);
+		Reserve(maxLen);
+		char* p = &_buffer[_pos];
+		std::to_chars_result res = precision < 0
+			? std::to_chars(p, p + maxLen, value)
+			: std::to_chars(p, p + maxLen, value, std::chars_format::fixed, precision);
+		if (res.ec != std::errc())
+			res = std::to_chars(p, p + maxLen, value);
+		if (res.ec == std::errc())
+			_pos += res.ptr - p;
+		return *this;
+	}
+
+	//"tag x y z\n" style line for n components
+	template <typename T>
+	TextWriter& PutLine(const char* tag, const T* values, int n, int precision)
+	{
+		Put(tag);
+		for (int i = 0; i < n; ++i)
+		{
+			Put(' ');
+			PutFloat(values[i], precision);
+		}
+		return Put('\n');
+	}
+
+	void Flush()
+	{
+		if (_file.IsOpen() && _pos > 0)
+			_file.Write(_buffer.get(), _pos);
+		_written += _pos;
+		_pos = 0;
+	}
+
+private:
+	void Reserve(size_t n)
+	{
+		if (_pos + n > _size)
+			Flush();
+	}
+
+	OutputFile _file;
+	std::unique_ptr<char[]> _buffer;
+	size_t _size;
+	size_t _pos;
+	size_t _written;
+};
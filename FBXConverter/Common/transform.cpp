@@ -0,0 +1,213 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//transform.cpp
+
+#include "transform.h"
+#include "parallel.h"
+#include "profile.h"
+#include "scene.h"
+#include <math.h>
+#include <algorithm>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TRANSFORM_AVX2 __attribute__((target("avx2,fma")))
+#elif defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#define TRANSFORM_AVX2
+#endif
+
+static_assert(sizeof(Vector3d) == 3 * sizeof(double), "the kernels read vectors as packed doubles");
+
+std::vector<NodeTransform> ComputeWorldTransforms(const std::vector<MeshNode*>& roots)
+{
+	//breadth first: the list itself is the queue, so every parent is done before its children
+	std::vector<NodeTransform> transforms;
+	for (MeshNode* pNode : roots)
+		transforms.push_back({ pNode, pNode->_transform });
+	for (size_t i = 0; i < transforms.size(); ++i)
+		for (MeshNode* pChild : transforms[i].node->_children)
+			transforms.push_back({ pChild, pChild->_transform * transforms[i].world });
+	return transforms;
+}
+
+namespace
+{
+	const size_t VERTEX_GRAIN = 1 << 15;	//vertices or corners per parallel chunk
+
+	//row vectors: p' = p * m, translation in row 3 (zero for normals)
+	void TransformVectorsScalar(const Vector3d* src, Vector3d* dst, size_t n, const Eigen::Matrix4d& m, bool normalize)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double x = src[i][0], y = src[i][1], z = src[i][2];
+			Vector3d r(x * m(0, 0) + y * m(1, 0) + z * m(2, 0) + m(3, 0),
+				x * m(0, 1) + y * m(1, 1) + z * m(2, 1) + m(3, 1),
+				x * m(0, 2) + y * m(1, 2) + z * m(2, 2) + m(3, 2));
+			if (normalize)
+			{
+				const double length = sqrt(r.dot(r));
+				if (length > 0.0)
+					r /= length;
+			}
+			dst[i] = r;
+		}
+	}
+
+#ifdef TRANSFORM_AVX2
+	bool CpuHasAVX2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0, osxsave = (info[2] & (1 << 27)) != 0;
+		if (!fma || !osxsave || (_xgetbv(0) & 6) != 6)	//the OS saves the ymm registers
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+
+	//four vertices per iteration: the 12 packed doubles are shuffled into x, y and z
+	//registers, transformed with FMAs and shuffled back
+	TRANSFORM_AVX2 void TransformVectorsAVX2(const Vector3d* src, Vector3d* dst, size_t n, const Eigen::Matrix4d& m, bool normalize)
+	{
+		__m256d rows[4][3];
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 3; ++j)
+				rows[i][j] = _mm256_set1_pd(m(i, j));
+		const __m256d zero = _mm256_setzero_pd();
+		const double* s = (const double*)src;
+		double* d = (double*)dst;
+		size_t i = 0;
+		for (; i + 4 <= n; i += 4, s += 12, d += 12)
+		{
+			//a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+			const __m256d a = _mm256_loadu_pd(s), b = _mm256_loadu_pd(s + 4), c = _mm256_loadu_pd(s + 8);
+			const __m256d t1 = _mm256_permute2f128_pd(a, c, 0x30);	//x0 y0 y3 z3
+			const __m256d t2 = _mm256_permute2f128_pd(a, c, 0x21);	//z0 x1 z2 x3
+			const __m256d u = _mm256_blend_pd(t1, b, 0xC);			//x0 y0 x2 y2
+			const __m256d w = _mm256_blend_pd(b, t1, 0xC);			//y1 z1 y3 z3
+			const __m256d x = _mm256_shuffle_pd(u, t2, 0xA);
+			const __m256d y = _mm256_shuffle_pd(u, w, 0x5);
+			const __m256d z = _mm256_shuffle_pd(t2, w, 0xA);
+
+			__m256d r[3];
+			for (int j = 0; j < 3; ++j)
+				r[j] = _mm256_fmadd_pd(x, rows[0][j], _mm256_fmadd_pd(y, rows[1][j], _mm256_fmadd_pd(z, rows[2][j], rows[3][j])));
+			if (normalize)
+			{
+				const __m256d length = _mm256_sqrt_pd(_mm256_fmadd_pd(r[0], r[0], _mm256_fmadd_pd(r[1], r[1], _mm256_mul_pd(r[2], r[2]))));
+				const __m256d nonzero = _mm256_cmp_pd(length, zero, _CMP_GT_OQ);
+				for (int j = 0; j < 3; ++j)
+					r[j] = _mm256_blendv_pd(r[j], _mm256_div_pd(r[j], length), nonzero);
+			}
+
+			const __m256d ou = _mm256_shuffle_pd(r[0], r[1], 0x0);	//x0 y0 x2 y2
+			const __m256d ot2 = _mm256_shuffle_pd(r[2], r[0], 0xA);	//z0 x1 z2 x3
+			const __m256d ow = _mm256_shuffle_pd(r[1], r[2], 0xF);	//y1 z1 y3 z3
+			const __m256d ot1 = _mm256_blend_pd(ou, ow, 0xC);		//x0 y0 y3 z3
+			_mm256_storeu_pd(d, _mm256_permute2f128_pd(ot1, ot2, 0x20));
+			_mm256_storeu_pd(d + 4, _mm256_blend_pd(ow, ou, 0xC));
+			_mm256_storeu_pd(d + 8, _mm256_permute2f128_pd(ot2, ot1, 0x31));
+		}
+		TransformVectorsScalar(src + i, dst + i, n - i, m, normalize);
+	}
+#endif
+
+	void TransformVectors(const Vector3d* src, Vector3d* dst, size_t n, const Eigen::Matrix4d& m, bool normalize)
+	{
+#ifdef TRANSFORM_AVX2
+		static const bool hasAVX2 = CpuHasAVX2();
+		if (hasAVX2)
+		{
+			TransformVectorsAVX2(src, dst, n, m, normalize);
+			return;
+		}
+#endif
+		TransformVectorsScalar(src, dst, n, m, normalize);
+	}
+}
+
+TriMesh* TransformTriMesh(const TriMesh* pTriMesh, const Eigen::Matrix4d& world, MeshArena* pArena)
+{
+	PROFILE_SCOPE_DETAIL(STAGE_TRANSFORM, "Transform", &pTriMesh->name);
+	TriMesh* m = pArena ? pArena->New<TriMesh>(pTriMesh->name, pTriMesh->numVert, pTriMesh->numTris, pArena) :
+		new TriMesh(pTriMesh->name, pTriMesh->numVert, pTriMesh->numTris, nullptr);
+	if (pTriMesh->numUV != pTriMesh->numVert)
+	{
+		m->numUV = pTriMesh->numUV;
+		m->UV = MakeMeshArray<Vector2d>(m->numUV, pArena);
+	}
+	m->matname = pTriMesh->matname;
+	m->subMeshes = pTriMesh->subMeshes;
+
+	//normals by the cofactor matrix of the 3x3 part, det times the inverse transpose: the
+	//same directions once renormalized, and defined for a singular matrix too. Its rows are
+	//cross products of the rows of the matrix (the images of the axes).
+	const Eigen::Matrix3d linear = world.topLeftCorner<3, 3>();
+	const double det = linear.determinant();
+	Eigen::Matrix4d normalMatrix = Eigen::Matrix4d::Zero();
+	for (int i = 0; i < 3; ++i)
+	{
+		const Eigen::Vector3d cofactors = linear.row((i + 1) % 3).cross(linear.row((i + 2) % 3)).transpose();
+		normalMatrix.block<1, 3>(i, 0) = (det < 0.0 ? -cofactors : cofactors).transpose();
+	}
+	const bool mirror = det < 0.0;
+
+	ParallelFor(pTriMesh->numVert, VERTEX_GRAIN, [&](size_t begin, size_t end) {
+		TransformVectors(pTriMesh->P.get() + begin, m->P.get() + begin, end - begin, world, false);
+		TransformVectors(pTriMesh->PN.get() + begin, m->PN.get() + begin, end - begin, normalMatrix, true);
+	});
+	ParallelFor(pTriMesh->numUV, VERTEX_GRAIN, [&](size_t begin, size_t end) {
+		std::copy(pTriMesh->UV.get() + begin, pTriMesh->UV.get() + end, m->UV.get() + begin);
+	});
+
+	//corners by whole triangles; a mirror swaps corners 1 and 2 of every triangle
+	ParallelFor(pTriMesh->numTris, VERTEX_GRAIN / 3, [&](size_t begin, size_t end) {
+		const size_t first = begin * 3, last = end * 3;
+		TransformVectors(pTriMesh->N.get() + first, m->N.get() + first, last - first, normalMatrix, true);
+		std::copy(pTriMesh->triIndex.get() + first, pTriMesh->triIndex.get() + last, m->triIndex.get() + first);
+		std::copy(pTriMesh->UVIndices.get() + first, pTriMesh->UVIndices.get() + last, m->UVIndices.get() + first);
+		std::copy(pTriMesh->T.get() + first, pTriMesh->T.get() + last, m->T.get() + first);
+		if (mirror)
+		{
+			for (size_t c = first; c < last; c += 3)
+			{
+				std::swap(m->triIndex[c + 1], m->triIndex[c + 2]);
+				std::swap(m->UVIndices[c + 1], m->UVIndices[c + 2]);
+				std::swap(m->N[c + 1], m->N[c + 2]);
+				std::swap(m->T[c + 1], m->T[c + 2]);
+			}
+		}
+	});
+	return m;
+}
@@ -0,0 +1,53 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//transform.h
+
+#pragma once
+
+#include <vector>
+#include "polymesh.h"
+
+class MeshNode;
+class MeshArena;
+
+//world matrix of a node in FBX layout (row vectors): its local transform times the world
+//matrix of its parent
+struct NodeTransform
+{
+	MeshNode* node;
+	Eigen::Matrix4d world;
+};
+
+//world matrices of every node in the trees below roots, composed in one top-down pass;
+//parents come before their children
+std::vector<NodeTransform> ComputeWorldTransforms(const std::vector<MeshNode*>& roots);
+
+//Copy of a mesh with the world matrix baked in: positions are transformed by the matrix,
+//normals (N, PN) by the inverse transpose of its upper 3x3 and renormalized. A mirroring
+//matrix (negative determinant) also swaps two corners of every triangle so the winding
+//still faces outward. Positions and normals go through AVX2 four vertices at a time when
+//the CPU has it, through the scalar loop otherwise; large meshes run in parallel chunks.
+//The copy comes from pArena (heap when NULL) and keeps the uvs and material ranges.
+TriMesh* TransformTriMesh(const TriMesh* pTriMesh, const Eigen::Matrix4d& world, MeshArena* pArena = nullptr);
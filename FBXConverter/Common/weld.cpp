@@ -0,0 +1,228 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "weld.h"
+#include "parallel.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	const int BASE_KEY_WORDS = 8;		//3 position, 3 normal, 2 uv
+	const int TANGENT_KEY_WORDS = 12;	//the same plus 4 tangent
+	const uint32_t EMPTY = 0xffffffffu;
+
+	template <int KEY_WORDS>
+	struct CornerKey
+	{
+		uint32_t w[KEY_WORDS];
+		bool operator==(const CornerKey& o) const { return memcmp(w, o.w, sizeof(w)) == 0; }
+	};
+
+	inline uint32_t KeyWord(float v, float invEpsilon)
+	{
+		if (invEpsilon > 0.0f)
+			return (uint32_t)(int32_t)floorf(v * invEpsilon + 0.5f);
+		if (v == 0.0f)
+			v = 0.0f;	//-0 and +0 weld
+		uint32_t bits;
+		memcpy(&bits, &v, 4);
+		return bits;
+	}
+
+	template <int KEY_WORDS>
+	inline uint64_t HashKey(const CornerKey<KEY_WORDS>& key)
+	{
+		uint64_t h = 0x9e3779b97f4a7c15ull;
+		for (int i = 0; i < KEY_WORDS; ++i)
+		{
+			h ^= key.w[i];
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+}
+
+//WeldTriMesh for keys of KEY_WORDS words
+template <int KEY_WORDS>
+static WeldedMesh* Weld(const TriMesh* pTriMesh, float epsilon)
+{
+	WeldedMesh* pWelded = new WeldedMesh();
+	pWelded->name = pTriMesh->name;
+	pWelded->matname = pTriMesh->matname;
+	pWelded->subMeshes = pTriMesh->subMeshes;
+	pWelded->numTris = pTriMesh->numTris;
+
+	const size_t numCorners = (size_t)pTriMesh->numTris * 3;
+	const float invEpsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+	const size_t grain = 1 << 16;
+
+	//corner attributes as float, in key order
+	auto cornerAttributes = [pTriMesh](size_t c, float* a) {
+		const Vector3d& p = pTriMesh->P[pTriMesh->triIndex[c]];
+		const Vector3d& n = pTriMesh->N[c];
+		const Vector2d& t = pTriMesh->T[c];
+		a[0] = (float)p[0]; a[1] = (float)p[1]; a[2] = (float)p[2];
+		a[3] = (float)n[0]; a[4] = (float)n[1]; a[5] = (float)n[2];
+		a[6] = (float)t[0]; a[7] = (float)t[1];
+		if constexpr (KEY_WORDS == TANGENT_KEY_WORDS)
+		{
+			const Vector4d& g = pTriMesh->TG[c];
+			a[8] = (float)g[0]; a[9] = (float)g[1]; a[10] = (float)g[2]; a[11] = (float)g[3];
+		}
+	};
+
+	std::vector<CornerKey<KEY_WORDS> > keys(numCorners);
+	std::vector<uint64_t> hashes(numCorners);
+	ParallelFor(numCorners, grain, [&](size_t begin, size_t end) {
+		float a[KEY_WORDS];
+		for (size_t c = begin; c < end; ++c)
+		{
+			cornerAttributes(c, a);
+			for (int i = 0; i < KEY_WORDS; ++i)
+				keys[c].w[i] = KeyWord(a[i], invEpsilon);
+			hashes[c] = HashKey(keys[c]);
+		}
+	});
+
+	//stable counting sort of the corners into hash partitions, one partition per task
+	const size_t numChunks = ParallelChunks(numCorners, grain);
+	size_t numPartitions = 1;
+	while (numPartitions < numChunks * 4)
+		numPartitions <<= 1;
+	const int partitionShift = 64 - (int)log2((double)numPartitions);
+	auto partitionOf = [&](size_t c) { return numPartitions > 1 ? (size_t)(hashes[c] >> partitionShift) : 0; };
+
+	std::vector<size_t> histogram(numChunks * numPartitions, 0);
+	ParallelForChunks(numCorners, grain, [&](size_t chunk, size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c)
+			++histogram[chunk * numPartitions + partitionOf(c)];
+	});
+	std::vector<size_t> partitionStart(numPartitions + 1, 0);
+	std::vector<size_t> offsets(numChunks * numPartitions);
+	for (size_t p = 0, sum = 0; p < numPartitions; ++p)
+	{
+		partitionStart[p] = sum;
+		for (size_t chunk = 0; chunk < numChunks; ++chunk)
+		{
+			offsets[chunk * numPartitions + p] = sum;
+			sum += histogram[chunk * numPartitions + p];
+		}
+		partitionStart[p + 1] = sum;
+	}
+	std::vector<uint32_t> sorted(numCorners);
+	ParallelForChunks(numCorners, grain, [&](size_t chunk, size_t begin, size_t end) {
+		size_t* offset = &offsets[chunk * numPartitions];
+		for (size_t c = begin; c < end; ++c)
+			sorted[offset[partitionOf(c)]++] = (uint32_t)c;
+	});
+
+	//open addressing per partition, corners are inserted in increasing order so the
+	//representative of each key is its first corner
+	std::vector<uint32_t> representative(numCorners);
+	ParallelFor(numPartitions, 1, [&](size_t pBegin, size_t pEnd) {
+		std::vector<uint32_t> table;
+		for (size_t p = pBegin; p < pEnd; ++p)
+		{
+			const size_t count = partitionStart[p + 1] - partitionStart[p];
+			size_t capacity = 16;
+			while (capacity < count * 2)
+				capacity <<= 1;
+			table.assign(capacity, EMPTY);
+			const size_t mask = capacity - 1;
+			for (size_t s = partitionStart[p]; s < partitionStart[p + 1]; ++s)
+			{
+				const uint32_t c = sorted[s];
+				size_t slot = (size_t)hashes[c] & mask;
+				while (true)
+				{
+					uint32_t other = table[slot];
+					if (other == EMPTY)
+					{
+						table[slot] = c;
+						representative[c] = c;
+						break;
+					}
+					if (hashes[other] == hashes[c] && keys[other] == keys[c])
+					{
+						representative[c] = other;
+						break;
+					}
+					slot = (slot + 1) & mask;
+				}
+			}
+		}
+	});
+
+	//number the representatives in corner order
+	std::vector<uint32_t> vertexId(numCorners);
+	std::vector<uint32_t> chunkVertices(numChunks + 1, 0);
+	ParallelForChunks(numCorners, grain, [&](size_t chunk, size_t begin, size_t end) {
+		uint32_t count = 0;
+		for (size_t c = begin; c < end; ++c)
+			count += representative[c] == c;
+		chunkVertices[chunk + 1] = count;
+	});
+	for (size_t chunk = 0; chunk < numChunks; ++chunk)
+		chunkVertices[chunk + 1] += chunkVertices[chunk];
+	const uint32_t numVert = chunkVertices[numChunks];
+	pWelded->numVert = numVert;
+	pWelded->positions.resize((size_t)numVert * 3);
+	pWelded->normals.resize((size_t)numVert * 3);
+	pWelded->uvs.resize((size_t)numVert * 2);
+	if constexpr (KEY_WORDS == TANGENT_KEY_WORDS)
+		pWelded->tangents.resize((size_t)numVert * 4);
+	pWelded->indices.resize(numCorners);
+
+	ParallelForChunks(numCorners, grain, [&](size_t chunk, size_t begin, size_t end) {
+		uint32_t v = chunkVertices[chunk];
+		float a[KEY_WORDS];
+		for (size_t c = begin; c < end; ++c)
+		{
+			if (representative[c] != c)
+				continue;
+			cornerAttributes(c, a);
+			memcpy(&pWelded->positions[(size_t)v * 3], a, 3 * sizeof(float));
+			memcpy(&pWelded->normals[(size_t)v * 3], a + 3, 3 * sizeof(float));
+			memcpy(&pWelded->uvs[(size_t)v * 2], a + 6, 2 * sizeof(float));
+			if constexpr (KEY_WORDS == TANGENT_KEY_WORDS)
+				memcpy(&pWelded->tangents[(size_t)v * 4], a + 8, 4 * sizeof(float));
+			vertexId[c] = v++;
+		}
+	});
+	ParallelFor(numCorners, grain, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c)
+			pWelded->indices[c] = vertexId[representative[c]];
+	});
+
+	return pWelded;
+}
+
+WeldedMesh* WeldTriMesh(const TriMesh* pTriMesh, float epsilon)
+{
+	assert(pTriMesh);
+	return pTriMesh->TG ? Weld<TANGENT_KEY_WORDS>(pTriMesh, epsilon) : Weld<BASE_KEY_WORDS>(pTriMesh, epsilon);
+}
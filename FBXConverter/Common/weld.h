@@ -0,0 +1,53 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//weld.h
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "polymesh.h"
+
+//Triangle mesh with a single index space: every vertex is a unique
+//(position, normal, uv[, tangent]) combination, in the float32 layout GPU formats expect.
+struct WeldedMesh
+{
+	std::string name;
+	std::string matname;
+	uint32_t numVert = 0;				// number of unique vertices
+	uint32_t numTris = 0;				// number of triangles
+	std::vector<float> positions;		// xyz per vertex
+	std::vector<float> normals;			// xyz per vertex
+	std::vector<float> uvs;				// uv per vertex
+	std::vector<float> tangents;		// xyzw per vertex, empty when the TriMesh has no tangents
+	std::vector<uint32_t> indices;		// 3 per triangle, into the vertex streams
+	std::vector<SubMesh> subMeshes;		// material ranges of the TriMesh, triangles keep their order
+};
+
+//Merge the triangle corners of a TriMesh (position from P[triIndex], normal from N,
+//uv from T, tangent from TG when present) into unique vertices. With epsilon 0 corners weld when the float values
+//are identical; otherwise values are snapped to a grid of that size first. Vertices
+//are numbered in order of first use, so the result does not depend on the threads.
+WeldedMesh* WeldTriMesh(const TriMesh* pTriMesh, float epsilon = 0.0f);
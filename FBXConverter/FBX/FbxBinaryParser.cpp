@@ -0,0 +1,916 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "FbxBinaryParser.h"
+#include "../Common/compactmesh.h"
+#include "../Common/normals.h"
+#include "../Common/parallel.h"
+#include "../Common/profile.h"
+#include <algorithm>
+#include <ctype.h>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <zlib.h>
+
+static const char FBX_BINARY_MAGIC[] = "Kaydara FBX Binary  ";	//followed by 0x00 0x1a 0x00
+static const size_t FBX_HEADER_SIZE = 27;
+
+static_assert(sizeof(Vector3d) == 3 * sizeof(double), "Vector3d arrays are inflated in place");
+static_assert(sizeof(Vector2d) == 2 * sizeof(double), "Vector2d arrays are inflated in place");
+
+template <typename T>
+static T Load(const uint8_t* p)
+{
+	T value;
+	memcpy(&value, p, sizeof(T));
+	return value;
+}
+
+//deeper node trees are rejected instead of exhausting the stack of the recursive walks
+static const int MAX_NODE_DEPTH = 1024;
+
+static void Malformed(const char* what)
+{
+	throw std::runtime_error(std::string("Malformed FBX file: ") + what);
+}
+
+//"Name\x00\x01Class" -> "Name"
+static std::string ObjectName(std::string_view name)
+{
+	size_t end = name.find('\0');
+	return std::string(name.substr(0, end));
+}
+
+static bool EqualNoCase(std::string_view a, const char* b)
+{
+	size_t n = strlen(b);
+	if (a.size() != n)
+		return false;
+	for (size_t i = 0; i < n; ++i)
+		if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+			return false;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// property decoding
+
+static size_t ArrayElementSize(char type)
+{
+	switch (type)
+	{
+	case 'b': return 1;
+	case 'i': case 'f': return 4;
+	case 'l': case 'd': return 8;
+	default: return 0;
+	}
+}
+
+//size in bytes of the property starting at p (type code included)
+static size_t PropertySize(const uint8_t* p, const uint8_t* limit)
+{
+	if (p >= limit)
+		Malformed("property list overrun");
+	switch (p[0])
+	{
+	case 'C': return 1 + 1;
+	case 'Y': return 1 + 2;
+	case 'I': case 'F': return 1 + 4;
+	case 'L': case 'D': return 1 + 8;
+	case 'S': case 'R':
+		if (p + 5 > limit) Malformed("string property");
+		return 1 + 4 + Load<uint32_t>(p + 1);
+	case 'b': case 'i': case 'f': case 'l': case 'd':
+	{
+		if (p + 13 > limit) Malformed("array property");
+		uint32_t count = Load<uint32_t>(p + 1);
+		uint32_t encoding = Load<uint32_t>(p + 5);
+		uint32_t compressedLength = Load<uint32_t>(p + 9);
+		return 1 + 12 + (encoding ? compressedLength : (size_t)count * ArrayElementSize(p[0]));
+	}
+	default:
+		Malformed("unknown property type");
+	}
+	return 0;
+}
+
+static const uint8_t* PropertyAt(const FbxBinaryParser::Record& rec, uint64_t index)
+{
+	if (index >= rec.numProps)
+		return nullptr;
+	const uint8_t* p = rec.props;
+	for (uint64_t i = 0; i < index; ++i)
+		p += PropertySize(p, rec.children);
+	if (p + PropertySize(p, rec.children) > rec.children)
+		Malformed("property list overrun");
+	return p;
+}
+
+static int64_t PropertyInt(const uint8_t* p)
+{
+	if (!p)
+		Malformed("missing property");
+	switch (p[0])
+	{
+	case 'C': return p[1];
+	case 'Y': return Load<int16_t>(p + 1);
+	case 'I': return Load<int32_t>(p + 1);
+	case 'L': return Load<int64_t>(p + 1);
+	case 'F': return (int64_t)Load<float>(p + 1);
+	case 'D': return (int64_t)Load<double>(p + 1);
+	default: Malformed("integer property expected");
+	}
+	return 0;
+}
+
+static double PropertyDouble(const uint8_t* p)
+{
+	if (!p)
+		Malformed("missing property");
+	switch (p[0])
+	{
+	case 'F': return Load<float>(p + 1);
+	case 'D': return Load<double>(p + 1);
+	default: return (double)PropertyInt(p);
+	}
+}
+
+static std::string_view PropertyString(const uint8_t* p)
+{
+	if (!p || (p[0] != 'S' && p[0] != 'R'))
+		return std::string_view();
+	return std::string_view((const char*)p + 5, Load<uint32_t>(p + 1));
+}
+
+struct ArrayProperty
+{
+	char type = 0;
+	uint32_t count = 0;
+	uint32_t encoding = 0;
+	uint32_t compressedLength = 0;
+	const uint8_t* data = nullptr;
+};
+
+static bool GetArray(const uint8_t* p, ArrayProperty& array)
+{
+	if (!p || ArrayElementSize(p[0]) == 0)
+		return false;
+	array.type = p[0];
+	array.count = Load<uint32_t>(p + 1);
+	array.encoding = Load<uint32_t>(p + 5);
+	array.compressedLength = Load<uint32_t>(p + 9);
+	array.data = p + 13;
+	return true;
+}
+
+//raw element bytes of an array, inflated if needed, into a buffer of exactly count * element size bytes
+static void InflateArray(const ArrayProperty& array, void* dst)
+{
+	size_t bytes = (size_t)array.count * ArrayElementSize(array.type);
+	if (array.encoding == 0)
+	{
+		memcpy(dst, array.data, bytes);
+		return;
+	}
+	if (array.encoding != 1)
+		Malformed("unknown array encoding");
+	//uLongf is 32 bits on Windows, a larger array would be truncated
+	if (bytes > (size_t)std::numeric_limits<uLongf>::max())
+		Malformed("array too large to inflate");
+	uLongf destLen = (uLongf)bytes;
+	if (uncompress((Bytef*)dst, &destLen, array.data, array.compressedLength) != Z_OK || destLen != bytes)
+		Malformed("cannot inflate array");
+}
+
+template <typename T> struct ArrayType;
+template <> struct ArrayType<double> { static const char code = 'd'; };
+template <> struct ArrayType<float> { static const char code = 'f'; };
+template <> struct ArrayType<int32_t> { static const char code = 'i'; };
+template <> struct ArrayType<int64_t> { static const char code = 'l'; };
+
+//decode an array of any numeric type into dst[array.count], inflating in place when the types match
+template <typename T>
+static void DecodeArray(const ArrayProperty& array, T* dst)
+{
+	if (array.type == ArrayType<T>::code)
+	{
+		InflateArray(array, dst);
+		return;
+	}
+	std::vector<uint8_t> raw((size_t)array.count * ArrayElementSize(array.type));
+	InflateArray(array, raw.data());
+	const uint8_t* src = raw.data();
+	for (uint32_t i = 0; i < array.count; ++i)
+	{
+		switch (array.type)
+		{
+		case 'b': dst[i] = (T)src[i]; break;
+		case 'i': dst[i] = (T)Load<int32_t>(src + 4 * i); break;
+		case 'f': dst[i] = (T)Load<float>(src + 4 * i); break;
+		case 'l': dst[i] = (T)Load<int64_t>(src + 8 * i); break;
+		case 'd': dst[i] = (T)Load<double>(src + 8 * i); break;
+		}
+	}
+}
+
+template <typename T>
+static void DecodeArray(const ArrayProperty& array, std::vector<T>& dst)
+{
+	dst.resize(array.count);
+	DecodeArray(array, dst.data());
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// layer elements
+
+enum MappingMode { MAP_NONE, MAP_BY_CONTROL_POINT, MAP_BY_POLYGON_VERTEX, MAP_BY_POLYGON, MAP_ALL_SAME };
+
+static MappingMode ParseMapping(std::string_view mode)
+{
+	if (mode == "ByPolygonVertex") return MAP_BY_POLYGON_VERTEX;
+	if (mode == "ByVertice" || mode == "ByVertex" || mode == "ByControlPoint") return MAP_BY_CONTROL_POINT;
+	if (mode == "ByPolygon") return MAP_BY_POLYGON;
+	if (mode == "AllSame") return MAP_ALL_SAME;
+	return MAP_NONE;
+}
+
+//index of the direct array element used by corner c of polygon f
+static uint32_t LayerIndex(MappingMode mapping, const std::vector<int32_t>& index, uint32_t c, uint32_t f,
+	const uint32_t* vertsIndices)
+{
+	uint32_t i = 0;
+	switch (mapping)
+	{
+	case MAP_BY_CONTROL_POINT: i = vertsIndices[c]; break;
+	case MAP_BY_POLYGON_VERTEX: i = c; break;
+	case MAP_BY_POLYGON: i = f; break;
+	default: i = 0; break;
+	}
+	if (index.empty())
+		return i;
+	if (i >= index.size())
+		Malformed("layer element index out of range");
+	return (uint32_t)index[i];
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+FbxBinaryParser::FbxBinaryParser()
+	:_version(0)
+{
+}
+
+FbxBinaryParser::~FbxBinaryParser()
+{
+	Clear();
+}
+
+void FbxBinaryParser::Clear()
+{
+	SceneParser::Clear();
+	_objects.clear();
+	_connections.clear();
+	_templates.clear();
+	_geometryMap.clear();
+	_streamItems.clear();
+	_visitedModels.clear();
+	_file.Close();
+	_version = 0;
+}
+
+bool FbxBinaryParser::ReadRecord(const uint8_t* p, const uint8_t* limit, Record& rec) const
+{
+	const bool wide = _version >= 7500;
+	const size_t headerSize = wide ? 25 : 13;
+	if (p + headerSize > limit)
+		return false;
+
+	uint64_t endOffset, propListLen;
+	uint8_t nameLen;
+	if (wide)
+	{
+		endOffset = Load<uint64_t>(p);
+		rec.numProps = Load<uint64_t>(p + 8);
+		propListLen = Load<uint64_t>(p + 16);
+		nameLen = p[24];
+	}
+	else
+	{
+		endOffset = Load<uint32_t>(p);
+		rec.numProps = Load<uint32_t>(p + 4);
+		propListLen = Load<uint32_t>(p + 8);
+		nameLen = p[12];
+	}
+	if (endOffset == 0)
+		return false;	//null record closing a nested list
+
+	const uint8_t* base = _file.Data();
+	rec.end = base + endOffset;
+	rec.name = std::string_view((const char*)p + headerSize, nameLen);
+	rec.props = p + headerSize + nameLen;
+	rec.children = rec.props + propListLen;
+	if (endOffset > _file.Size() || rec.end > limit || rec.children > rec.end || rec.props > rec.children)
+		Malformed("record overrun");
+	return true;
+}
+
+template <typename F>
+void FbxBinaryParser::ForEachChild(const Record& parent, F func) const
+{
+	const uint8_t* p = parent.children;
+	Record rec;
+	while (ReadRecord(p, parent.end, rec))
+	{
+		func(rec);
+		p = rec.end;
+	}
+}
+
+bool FbxBinaryParser::FindChild(const Record& parent, const char* name, Record& child) const
+{
+	const uint8_t* p = parent.children;
+	while (ReadRecord(p, parent.end, child))
+	{
+		if (child.name == name)
+			return true;
+		p = child.end;
+	}
+	return false;
+}
+
+bool FbxBinaryParser::LoadScene(const char* pFilename)
+{
+	Clear();
+	PROFILE_SCOPE(STAGE_LOAD, "LoadScene");
+	if (!(_pInput ? _file.Attach(_pInput, _inputSize) : _file.Open(pFilename)))
+	{
+		printf("Error: Unable to open %s\n", pFilename);
+		return false;
+	}
+
+	const uint8_t* data = _file.Data();
+	if (_file.Size() < FBX_HEADER_SIZE || memcmp(data, FBX_BINARY_MAGIC, sizeof(FBX_BINARY_MAGIC)) != 0)
+	{
+		printf("Error: %s is not a binary FBX file\n", pFilename);
+		_file.Close();
+		return false;
+	}
+	_version = Load<uint32_t>(data + 23);
+	if (_version < 7000 || _version >= 8000)
+	{
+		printf("Error: FBX file format version %u of '%s' is not supported\n", _version, pFilename);
+		_file.Close();
+		return false;
+	}
+	if (_options.verbose)
+		printf("FBX file format version for file '%s' is %u.%u.%u\n\n", pFilename,
+			_version / 1000, (_version % 1000) / 100, (_version % 100) / 10);
+
+	try
+	{
+		Record top;
+		top.children = data + FBX_HEADER_SIZE;
+		top.end = data + _file.Size();
+
+		Record objects, connections, definitions;
+		bool hasObjects = false;
+		ForEachChild(top, [&](const Record& rec) {
+			if (rec.name == "Objects") { objects = rec; hasObjects = true; }
+			else if (rec.name == "Connections") connections = rec;
+			else if (rec.name == "Definitions") definitions = rec;
+		});
+		if (!hasObjects)
+			Malformed("no Objects section");
+
+		ForEachChild(objects, [&](const Record& rec) {
+			const uint8_t* id = PropertyAt(rec, 0);
+			if (id && id[0] == 'L')
+				_objects[Load<int64_t>(id + 1)] = rec;
+		});
+
+		if (connections.end)
+		{
+			ForEachChild(connections, [&](const Record& rec) {
+				const uint8_t* type = PropertyAt(rec, 0);
+				if (rec.name != "C" || PropertyString(type) != "OO")
+					return;
+				if (rec.numProps < 3)
+					Malformed("connection record");
+				int64_t child = PropertyInt(PropertyAt(rec, 1));
+				int64_t parent = PropertyInt(PropertyAt(rec, 2));
+				_connections[parent].push_back(child);
+			});
+		}
+
+		//default property values, objects only store the ones that differ
+		if (definitions.end)
+		{
+			ForEachChild(definitions, [&](const Record& objectType) {
+				if (objectType.name != "ObjectType")
+					return;
+				ForEachChild(objectType, [&](const Record& rec) {
+					Record props70;
+					if (rec.name == "PropertyTemplate" && FindChild(rec, "Properties70", props70))
+						_templates[std::string(PropertyString(PropertyAt(rec, 0)))] = props70;
+				});
+			});
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("Error: %s\n", e.what());
+		Clear();
+		return false;
+	}
+	return true;
+}
+
+void FbxBinaryParser::ExtractContent()
+{
+	if (!_file.Data())
+	{
+		printf("Error: No FBX scene!\n");
+		return;
+	}
+
+	PROFILE_SCOPE(STAGE_NONE, "ExtractContent");
+
+	//serial walk over the connections: node tree, transforms and the meshes to decode
+	MeshNode* pRootMeshNode = _arena.New<MeshNode>(nullptr, "RootNode");
+	Nodes.push_back(pRootMeshNode);
+	std::vector<MeshItem> items;
+	{
+		PROFILE_SCOPE(STAGE_EXTRACT, "ExtractModel");
+		_visitedModels.clear();
+		ExtractModel(0, pRootMeshNode, items);
+	}
+
+	//geometry records are independent, decode and triangulate them concurrently;
+	//on a malformed record the arena reclaims the finished ones in Clear()
+	ParallelForEach(items.size(), [&](size_t i) {
+		MeshItem& item = items[i];
+		if (item.instance)
+			return;
+		item.pMesh = ExtractGeometry(*item.pGeometry, item.pMeshNode->_name, item.materialIds);
+		if (item.pMesh)
+		{
+			item.pTriMesh = NewGeometry<TriMesh>(item.pMesh, _geometryArena);
+			ApplyMaterialIds(item, item.pMesh, item.pTriMesh);
+		}
+	});
+
+	//merge in walk order so the result matches a serial extraction
+	for (MeshItem& item : items)
+	{
+		GeometryKey key(item.pGeometry, item.materials);
+		if (item.instance)
+		{
+			TriMesh* pShared = _geometryMap[key];
+			if (pShared)
+				AddInstance(pShared, item.pMeshNode);
+			continue;
+		}
+		if (!item.pMesh) //a mesh without polygons is only a group node
+			continue;
+		AddMesh(item.pMesh, item.pTriMesh, item.pMeshNode);
+		_geometryMap[key] = item.pTriMesh;
+		ExtractMaterial(item.materials);
+	}
+}
+
+void FbxBinaryParser::ExtractModel(int64_t id, MeshNode* pMeshNode, std::vector<MeshItem>& items, int depth)
+{
+	//a model reached twice is connected to several parents or to itself (a cycle)
+	if (depth > MAX_NODE_DEPTH)
+		Malformed("node tree too deep");
+	if (!_visitedModels.insert(id).second)
+		Malformed("model connected more than once");
+
+	auto conn = _connections.find(id);
+	if (id != 0)
+	{
+		auto model = _objects.find(id);
+		if (model == _objects.end())
+			Malformed("model not found");
+		pMeshNode->setTransform(ExtractTransform(model->second));
+	}
+	if (conn == _connections.end())
+		return;
+
+	//geometry and materials are connected to the model in the order the SDK reports them
+	const Record* pGeometry = nullptr;
+	std::vector<const Record*> materials;
+	for (int64_t childId : conn->second)
+	{
+		auto child = _objects.find(childId);
+		if (child == _objects.end())
+			continue;
+		if (child->second.name == "Geometry" && !pGeometry)
+			pGeometry = &child->second;
+		else if (child->second.name == "Material")
+			materials.push_back(&child->second);
+	}
+
+	if (id != 0 && pGeometry)
+	{
+		MeshItem item;
+		item.pMeshNode = pMeshNode;
+		item.pGeometry = pGeometry;
+		item.materials.swap(materials);
+		//a geometry shared by several models with the same materials is decoded once; models
+		//with other materials keep their own copy since the material ids are baked into it
+		item.instance = !_geometryMap.emplace(GeometryKey(pGeometry, item.materials), nullptr).second;
+		items.push_back(std::move(item));
+	}
+
+	for (int64_t childId : conn->second)
+	{
+		auto child = _objects.find(childId);
+		if (child == _objects.end() || child->second.name != "Model")
+			continue;
+		std::string name = ObjectName(PropertyString(PropertyAt(child->second, 1)));
+		MeshNode* pChildNode = _arena.New<MeshNode>(pMeshNode, name);
+		pMeshNode->_children.push_back(pChildNode);
+		ExtractModel(childId, pChildNode, items, depth + 1);
+	}
+}
+
+size_t FbxBinaryParser::BeginStream()
+{
+	if (!_file.Data())
+	{
+		printf("Error: No FBX scene!\n");
+		return 0;
+	}
+
+	MeshNode* pRootMeshNode = _arena.New<MeshNode>(nullptr, "RootNode");
+	Nodes.push_back(pRootMeshNode);
+	_streamItems.clear();
+	{
+		PROFILE_SCOPE(STAGE_EXTRACT, "ExtractModel");
+		_visitedModels.clear();
+		ExtractModel(0, pRootMeshNode, _streamItems);
+	}
+
+	//all materials up front, the mtllib line precedes the meshes
+	for (const MeshItem& item : _streamItems)
+		if (!item.instance && HasPolygons(*item.pGeometry))
+			ExtractMaterial(item.materials);
+	return _streamItems.size();
+}
+
+TriMesh* FbxBinaryParser::StreamMesh(size_t i)
+{
+	MeshItem& item = _streamItems[i];
+	if (item.instance && !_options.expandInstances)
+		return nullptr;
+	std::unique_ptr<PolyMesh> pMesh(ExtractGeometry(*item.pGeometry, item.pMeshNode->_name, item.materialIds));
+	if (!pMesh)
+		return nullptr;
+	TriMesh* pTriMesh = NewGeometry<TriMesh>(pMesh.get(), _geometryArena);
+	ApplyMaterialIds(item, pMesh.get(), pTriMesh);
+	return pTriMesh;
+}
+
+CompactMesh* FbxBinaryParser::StreamCompactMesh(size_t i)
+{
+	MeshItem& item = _streamItems[i];
+	if (item.instance && !_options.expandInstances)
+		return nullptr;
+	std::unique_ptr<PolyMesh> pMesh(ExtractGeometry(*item.pGeometry, item.pMeshNode->_name, item.materialIds));
+	if (!pMesh)
+		return nullptr;
+	CompactMesh* pCompact = new CompactMesh(pMesh.get());
+	ApplyMaterialIds(item, pMesh.get(), pCompact);
+	return pCompact;
+}
+
+template <typename Mesh>
+void FbxBinaryParser::ApplyMaterialIds(const MeshItem& item, const PolyMesh* pMesh, Mesh* pTriMesh) const
+{
+	//same rules as FbxParser::ExtractMaterialConnections: per polygon ids give one submesh per material
+	if (item.materialIds.size() > 1)
+	{
+		std::vector<std::string> materialNames(item.materials.size());
+		for (size_t i = 0; i < item.materials.size(); ++i)
+			materialNames[i] = ObjectName(PropertyString(PropertyAt(*item.materials[i], 1)));
+		pTriMesh->SplitByMaterial(pMesh, item.materialIds.data(), item.materialIds.size(), materialNames);
+	}
+	else if (item.materialIds.size() == 1 && item.materialIds[0] >= 0 && (size_t)item.materialIds[0] < item.materials.size())
+		pTriMesh->matname = ObjectName(PropertyString(PropertyAt(*item.materials[item.materialIds[0]], 1)));
+}
+
+bool FbxBinaryParser::HasPolygons(const Record& geometry) const
+{
+	Record vertices, polygonVertexIndex;
+	ArrayProperty va, ia;
+	return FindChild(geometry, "Vertices", vertices) && GetArray(PropertyAt(vertices, 0), va) &&
+		FindChild(geometry, "PolygonVertexIndex", polygonVertexIndex) && GetArray(PropertyAt(polygonVertexIndex, 0), ia) &&
+		ia.count > 0;
+}
+
+PolyMesh* FbxBinaryParser::ExtractGeometry(const Record& geometry, const std::string& name,
+	std::vector<int32_t>& materialIds)
+{
+	if (!HasPolygons(geometry))
+		return nullptr;
+	PROFILE_SCOPE_DETAIL(STAGE_EXTRACT, "ExtractGeometry", &name);
+	Record vertices, polygonVertexIndex;
+	ArrayProperty va, ia;
+	FindChild(geometry, "Vertices", vertices);
+	GetArray(PropertyAt(vertices, 0), va);
+	FindChild(geometry, "PolygonVertexIndex", polygonVertexIndex);
+	GetArray(PropertyAt(polygonVertexIndex, 0), ia);
+	if (va.count % 3 != 0)
+		Malformed("vertex array size");
+
+	PolyMesh* polyMesh = NewGeometry<PolyMesh>();
+	std::unique_ptr<PolyMesh> heapGuard(_geometryArena ? nullptr : polyMesh);	//streaming: freed if malformed
+	polyMesh->name = name;
+	polyMesh->nVertices = va.count / 3;
+	polyMesh->Verts = MakeMeshArray<Vector3d>(polyMesh->nVertices, _geometryArena);
+	DecodeArray(va, (double*)polyMesh->Verts.get());
+
+	//polygon ends are stored as ~index
+	const uint32_t numCorners = ia.count;
+	polyMesh->VertsIndices = MakeMeshArray<uint32_t>(numCorners, _geometryArena);
+	int32_t* indices = (int32_t*)polyMesh->VertsIndices.get();
+	DecodeArray(ia, indices);
+	uint32_t nFaces = 0;
+	for (uint32_t c = 0; c < numCorners; ++c)
+		nFaces += indices[c] < 0;
+	if (indices[numCorners - 1] >= 0)
+		++nFaces;
+
+	polyMesh->nFaces = nFaces;
+	polyMesh->FaceIndices = MakeMeshArray<uint32_t>(nFaces, _geometryArena);
+	std::vector<uint32_t> faceOfCorner(numCorners);
+	for (uint32_t c = 0, f = 0, start = 0; c < numCorners; ++c)
+	{
+		faceOfCorner[c] = f;
+		bool last = indices[c] < 0 || c == numCorners - 1;
+		if (indices[c] < 0)
+			indices[c] = ~indices[c];
+		if ((uint32_t)indices[c] >= polyMesh->nVertices)
+			Malformed("vertex index out of range");
+		if (last)
+		{
+			polyMesh->FaceIndices[f++] = c + 1 - start;
+			start = c + 1;
+		}
+	}
+	const uint32_t* vertsIndices = polyMesh->VertsIndices.get();
+
+	polyMesh->Normals = MakeMeshArray<Vector3d>(numCorners, _geometryArena);
+	polyMesh->UVs = MakeMeshArray<Vector2d>(numCorners, _geometryArena);
+	polyMesh->UVIndices = MakeMeshArray<uint32_t>(numCorners, _geometryArena);
+	std::fill_n(polyMesh->Normals.get(), numCorners, Vector3d::Zero());
+	std::fill_n(polyMesh->UVs.get(), numCorners, Vector2d::Zero());
+	std::fill_n(polyMesh->UVIndices.get(), numCorners, 0u);
+
+	Record layer, rec;
+	ArrayProperty direct, index;
+	std::vector<int32_t> indexArray;
+
+	//first normal layer
+	bool hasNormals = false;
+	if (FindChild(geometry, "LayerElementNormal", layer) && FindChild(layer, "Normals", rec) && GetArray(PropertyAt(rec, 0), direct))
+	{
+		MappingMode mapping = FindChild(layer, "MappingInformationType", rec) ? ParseMapping(PropertyString(PropertyAt(rec, 0))) : MAP_NONE;
+		indexArray.clear();
+		if (FindChild(layer, "NormalsIndex", rec) && GetArray(PropertyAt(rec, 0), index))
+			DecodeArray(index, indexArray);
+
+		if (mapping == MAP_BY_POLYGON_VERTEX && indexArray.empty() && direct.count == 3 * numCorners)
+		{
+			DecodeArray(direct, (double*)polyMesh->Normals.get());
+			hasNormals = true;
+		}
+		else if (mapping != MAP_NONE)
+		{
+			hasNormals = true;
+			std::vector<double> normals;
+			DecodeArray(direct, normals);
+			for (uint32_t c = 0; c < numCorners; ++c)
+			{
+				uint32_t i = LayerIndex(mapping, indexArray, c, faceOfCorner[c], vertsIndices);
+				if (3 * (size_t)i + 2 >= normals.size())
+					Malformed("normal index out of range");
+				polyMesh->Normals[c] = Vector3d(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+			}
+		}
+	}
+
+	//without normals generate them, split by the smoothing groups when the file has them
+	//(per edge smoothing is not resolved, the crease angle applies instead)
+	if (!hasNormals)
+	{
+		std::vector<int32_t> smoothingGroups;
+		if (FindChild(geometry, "LayerElementSmoothing", layer) && FindChild(layer, "Smoothing", rec) && GetArray(PropertyAt(rec, 0), index))
+		{
+			MappingMode mapping = FindChild(layer, "MappingInformationType", rec) ? ParseMapping(PropertyString(PropertyAt(rec, 0))) : MAP_NONE;
+			if (mapping == MAP_BY_POLYGON && index.count == nFaces)
+				DecodeArray(index, smoothingGroups);
+		}
+		GenerateNormals(polyMesh, smoothingGroups.empty() ? nullptr : smoothingGroups.data(), _options.creaseAngle);
+	}
+
+	//first uv layer, one uv per vertex as the autodesk fbx converter
+	if (FindChild(geometry, "LayerElementUV", layer) && FindChild(layer, "UV", rec) && GetArray(PropertyAt(rec, 0), direct))
+	{
+		MappingMode mapping = FindChild(layer, "MappingInformationType", rec) ? ParseMapping(PropertyString(PropertyAt(rec, 0))) : MAP_NONE;
+		indexArray.clear();
+		if (FindChild(layer, "UVIndex", rec) && GetArray(PropertyAt(rec, 0), index))
+			DecodeArray(index, indexArray);
+
+		if (mapping == MAP_BY_POLYGON_VERTEX && indexArray.empty() && direct.count == 2 * numCorners)
+		{
+			DecodeArray(direct, (double*)polyMesh->UVs.get());
+			for (uint32_t c = 0; c < numCorners; ++c)
+				polyMesh->UVIndices[c] = c;
+		}
+		else if (mapping == MAP_BY_POLYGON_VERTEX || mapping == MAP_BY_CONTROL_POINT)
+		{
+			std::vector<double> uvs;
+			DecodeArray(direct, uvs);
+			for (uint32_t c = 0; c < numCorners; ++c)
+			{
+				uint32_t i = LayerIndex(mapping, indexArray, c, faceOfCorner[c], vertsIndices);
+				if (2 * (size_t)i + 1 >= uvs.size())
+					Malformed("uv index out of range");
+				polyMesh->UVIndices[c] = i;
+				polyMesh->UVs[c] = Vector2d(uvs[2 * i], uvs[2 * i + 1]);
+			}
+		}
+	}
+
+	//per polygon material ids, a single entry for AllSame
+	materialIds.clear();
+	if (FindChild(geometry, "LayerElementMaterial", layer) && FindChild(layer, "Materials", rec) && GetArray(PropertyAt(rec, 0), index))
+	{
+		MappingMode mapping = FindChild(layer, "MappingInformationType", rec) ? ParseMapping(PropertyString(PropertyAt(rec, 0))) : MAP_NONE;
+		DecodeArray(index, materialIds);
+		if (mapping == MAP_ALL_SAME && materialIds.size() > 1)
+			materialIds.erase(materialIds.begin() + 1, materialIds.end());
+	}
+
+	heapGuard.release();
+	return polyMesh;
+}
+
+void FbxBinaryParser::ExtractMaterial(const std::vector<const Record*>& materials)
+{
+	PROFILE_SCOPE(STAGE_MATERIALS, "ExtractMaterial");
+	for (size_t lCount = 0; lCount < materials.size(); ++lCount)
+	{
+		const Record& material = *materials[lCount];
+		std::string matName = ObjectName(PropertyString(PropertyAt(material, 1)));
+		if (Materials.find(matName) != Materials.end())
+			continue;
+
+		Record rec;
+		std::string_view shading = FindChild(material, "ShadingModel", rec) ? PropertyString(PropertyAt(rec, 0)) : "lambert";
+		const bool phong = EqualNoCase(shading, "phong");
+		if (!phong && !EqualNoCase(shading, "lambert"))
+		{
+			printf("Unknown or unsupported type of Material");
+			continue;
+		}
+		const char* templateName = phong ? "FbxSurfacePhong" : "FbxSurfaceLambert";
+
+		Material* pMaterial = _arena.New<Material>();
+		pMaterial->index = (unsigned int)lCount;
+		pMaterial->materialName = matName;
+
+		//FbxSurfaceLambert/FbxSurfacePhong defaults
+		double ambient[3] = { 0.2, 0.2, 0.2 }, diffuse[3] = { 0.8, 0.8, 0.8 }, specular[3] = { 0.2, 0.2, 0.2 };
+		double shininess = 20.0, transparency = 0.0;
+		ReadP(material, templateName, "AmbientColor", ambient, 3);
+		ReadP(material, templateName, "DiffuseColor", diffuse, 3);
+		ReadP(material, templateName, "TransparencyFactor", &transparency, 1);
+		if (phong)
+		{
+			ReadP(material, templateName, "SpecularColor", specular, 3);
+			if (!ReadP(material, templateName, "Shininess", &shininess, 1))
+				ReadP(material, templateName, "ShininessExponent", &shininess, 1);
+			pMaterial->Ks = Vector3d(specular[0], specular[1], specular[2]);
+			pMaterial->Ns = (float)shininess;
+		}
+		pMaterial->Ka = Vector3d(ambient[0], ambient[1], ambient[2]);
+		pMaterial->Kd = Vector3d(diffuse[0], diffuse[1], diffuse[2]);
+		pMaterial->Tr = (float)(1.0 - transparency);
+		Materials[matName] = pMaterial;
+	}
+}
+
+//read a Properties70 value of an object, falling back on the class template
+bool FbxBinaryParser::ReadP(const Record& object, const char* templateName, const char* name, double* values, int n) const
+{
+	auto readFrom = [&](const Record& props70) {
+		bool found = false;
+		ForEachChild(props70, [&](const Record& p) {
+			if (found || p.name != "P" || p.numProps < 4 + (uint64_t)n || PropertyString(PropertyAt(p, 0)) != name)
+				return;
+			for (int i = 0; i < n; ++i)
+				values[i] = PropertyDouble(PropertyAt(p, 4 + i));
+			found = true;
+		});
+		return found;
+	};
+
+	Record props70;
+	if (FindChild(object, "Properties70", props70) && readFrom(props70))
+		return true;
+	auto templ = _templates.find(templateName);
+	return templ != _templates.end() && readFrom(templ->second);
+}
+
+static Eigen::Matrix4d TranslationMatrix(const double* v)
+{
+	Eigen::Matrix4d m = Eigen::Matrix4d::Identity();
+	m(0, 3) = v[0];
+	m(1, 3) = v[1];
+	m(2, 3) = v[2];
+	return m;
+}
+
+//euler angles in degrees, order is the FBX EFbxRotationOrder (0 = XYZ: x applied first)
+static Eigen::Matrix4d RotationMatrix(const double* degrees, int order)
+{
+	static const int axes[6][3] = { {0, 1, 2}, {0, 2, 1}, {1, 2, 0}, {1, 0, 2}, {2, 0, 1}, {2, 1, 0} };
+	if (order < 0 || order > 5)
+		order = 0;	//spheric XYZ is evaluated as XYZ
+	Eigen::Matrix3d r = Eigen::Matrix3d::Identity();
+	for (int i = 0; i < 3; ++i)
+	{
+		int axis = axes[order][i];
+		r = Eigen::AngleAxisd(degrees[axis] * EIGEN_PI / 180.0, Eigen::Vector3d::Unit(axis)).toRotationMatrix() * r;
+	}
+	Eigen::Matrix4d m = Eigen::Matrix4d::Identity();
+	m.topLeftCorner<3, 3>() = r;
+	return m;
+}
+
+static Eigen::Matrix4d ScalingMatrix(const double* v)
+{
+	Eigen::Matrix4d m = Eigen::Matrix4d::Identity();
+	m(0, 0) = v[0];
+	m(1, 1) = v[1];
+	m(2, 2) = v[2];
+	return m;
+}
+
+//local transform as FbxNode::EvaluateLocalTransform computes it without animation:
+//T * Roff * Rp * Rpre * R * Rpost^-1 * Rp^-1 * Soff * Sp * S * Sp^-1
+Eigen::Matrix4d FbxBinaryParser::ExtractTransform(const Record& model) const
+{
+	double t[3] = { 0, 0, 0 }, r[3] = { 0, 0, 0 }, s[3] = { 1, 1, 1 };
+	double pre[3] = { 0, 0, 0 }, post[3] = { 0, 0, 0 };
+	double roff[3] = { 0, 0, 0 }, rp[3] = { 0, 0, 0 }, soff[3] = { 0, 0, 0 }, sp[3] = { 0, 0, 0 };
+	double order = 0, rotationActive = 0;
+	ReadP(model, "FbxNode", "Lcl Translation", t, 3);
+	ReadP(model, "FbxNode", "Lcl Rotation", r, 3);
+	ReadP(model, "FbxNode", "Lcl Scaling", s, 3);
+	ReadP(model, "FbxNode", "RotationOffset", roff, 3);
+	ReadP(model, "FbxNode", "RotationPivot", rp, 3);
+	ReadP(model, "FbxNode", "ScalingOffset", soff, 3);
+	ReadP(model, "FbxNode", "ScalingPivot", sp, 3);
+	ReadP(model, "FbxNode", "RotationActive", &rotationActive, 1);
+	if (rotationActive != 0)
+	{
+		ReadP(model, "FbxNode", "RotationOrder", &order, 1);
+		ReadP(model, "FbxNode", "PreRotation", pre, 3);
+		ReadP(model, "FbxNode", "PostRotation", post, 3);
+	}
+
+	const double nrp[3] = { -rp[0], -rp[1], -rp[2] }, nsp[3] = { -sp[0], -sp[1], -sp[2] };
+	Eigen::Matrix4d m = TranslationMatrix(t) * TranslationMatrix(roff) * TranslationMatrix(rp) * RotationMatrix(pre, 0) *
+		RotationMatrix(r, (int)order) * RotationMatrix(post, 0).transpose() * TranslationMatrix(nrp) *
+		TranslationMatrix(soff) * TranslationMatrix(sp) * ScalingMatrix(s) * TranslationMatrix(nsp);
+
+	//MeshNode keeps the FBX layout (row vectors)
+	return m.transpose();
+}
@@ -0,0 +1,103 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "../Common/scene.h"
+#include "../Common/mappedfile.h"
+
+//Importer reading binary FBX 7.x straight from a memory mapped file, without the
+//Autodesk FBX SDK. Node records are walked in place and only the ones needed for the
+//node tree, meshes and materials are decoded; zlib compressed property arrays are
+//inflated directly into the PolyMesh buffers.
+class FbxBinaryParser : public SceneParser
+{
+public:
+	FbxBinaryParser();
+	~FbxBinaryParser();
+
+	bool LoadScene(const char* pFilename) override;
+
+	void ExtractContent() override;
+
+	void Clear() override;
+
+	//one node record, all pointers are into the mapped file
+	struct Record
+	{
+		std::string_view name;
+		const uint8_t* props = nullptr;		//first property
+		const uint8_t* children = nullptr;	//first nested record, == end if there is none
+		const uint8_t* end = nullptr;		//end of the record including nested records
+		uint64_t numProps = 0;
+	};
+
+protected:
+	size_t BeginStream() override;
+	TriMesh* StreamMesh(size_t i) override;
+	CompactMesh* StreamCompactMesh(size_t i) override;
+
+private:
+	//a model with geometry found by the node walk, decoded and triangulated later on any thread
+	struct MeshItem
+	{
+		MeshNode* pMeshNode;
+		const Record* pGeometry;
+		std::vector<const Record*> materials;
+		std::vector<int32_t> materialIds;
+		PolyMesh* pMesh = nullptr;
+		TriMesh* pTriMesh = nullptr;
+		bool instance = false;		//same geometry and materials as an earlier model, not decoded again
+	};
+	typedef std::pair<const Record*, std::vector<const Record*> > GeometryKey;
+
+	bool ReadRecord(const uint8_t* p, const uint8_t* limit, Record& rec) const;
+	bool FindChild(const Record& parent, const char* name, Record& child) const;
+	template <typename F> void ForEachChild(const Record& parent, F func) const;
+
+	void ExtractModel(int64_t id, MeshNode* pMeshNode, std::vector<MeshItem>& items, int depth = 0);
+	bool HasPolygons(const Record& geometry) const;
+	//Mesh is TriMesh or CompactMesh, triangulated from pMesh
+	template <typename Mesh> void ApplyMaterialIds(const MeshItem& item, const PolyMesh* pMesh, Mesh* pTriMesh) const;
+	PolyMesh* ExtractGeometry(const Record& geometry, const std::string& name, std::vector<int32_t>& materialIds);
+	void ExtractMaterial(const std::vector<const Record*>& materials);
+	Eigen::Matrix4d ExtractTransform(const Record& model) const;
+	bool ReadP(const Record& object, const char* templateName, const char* name, double* values, int n) const;
+
+	MappedFile _file;
+	uint32_t _version;
+	std::unordered_map<int64_t, Record> _objects;				//Objects children by id
+	std::unordered_map<int64_t, std::vector<int64_t> > _connections;	//parent id -> child ids, in file order
+	std::map<std::string, Record, std::less<> > _templates;		//Definitions property templates by class name
+	std::map<GeometryKey, TriMesh*> _geometryMap;	//decoded geometry, shared by every model referencing it
+	std::vector<MeshItem> _streamItems;		//meshes of the scene being streamed
+	std::unordered_set<int64_t> _visitedModels;	//models placed by the node walk, each has one parent
+};
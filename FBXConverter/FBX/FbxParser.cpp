@@ -23,71 +23,21 @@ OF SUCH DAMAGE.
 */
 
 #include "FbxParser.h"
+#include "../Common/compactmesh.h"
+#include "../Common/normals.h"
+#include "../Common/parallel.h"
+#include "../Common/profile.h"
+#include <algorithm>
 #include <stdio.h>
-#include <filesystem>
+#include <string.h>
 
-namespace fs = std::filesystem;
-
-static int WriteMaterials(std::map<std::string, Material*> &materials, const char * filename)
-{
-	std::string fileName = std::string(filename);
-	fileName += ".mtl";
-
-	if (materials.size() > 0)
-	{
-		FILE *fp;
-		fopen_s(&fp, fileName.c_str(), "w");
-		if (fp == NULL)return -1;
-
-		fprintf(fp, "#\n# Wavefront material file\n# Created with Dolphin FBX \n#\n\n");
-
-		int current = 0;
-
-		std::map<std::string, Material*>::iterator iter2;
-		for (iter2 = materials.begin(); iter2 != materials.end(); ++iter2)
-		{
-			Material* pMaterial = iter2->second;
-			fprintf(fp, "newmtl %s\n", pMaterial->materialName.c_str());
-			fprintf(fp, "Ka %f %f %f\n", pMaterial->Ka[0], pMaterial->Ka[1], pMaterial->Ka[2]);
-			fprintf(fp, "Kd %f %f %f\n", pMaterial->Kd[0], pMaterial->Kd[1], pMaterial->Kd[2]);
-			fprintf(fp, "Ks %f %f %f\n", pMaterial->Ks[0], pMaterial->Ks[1], pMaterial->Ks[2]);
-			fprintf(fp, "Tr %f\n", pMaterial->Tr);
-			fprintf(fp, "Ns %f\n", pMaterial->Ns);
-
-			fprintf(fp, "\n");
-
-		}
-
-		fclose(fp);
-	}
-	return 0;
-}
-
-
-/////////////////////////////////////////////////////////////////////////////////
-//
-MeshNode::MeshNode(MeshNode* parent, std::string name)
-	:_parent(parent), _name(name)
-{
-	_transform.setIdentity();
-}
-
-MeshNode::~MeshNode()
-{
-	std::vector<MeshNode*>::iterator iter;
-	for (iter = _children.begin(); iter != _children.end(); ++iter)
-	{
-		MeshNode* pNode = *iter;
-		delete pNode;
-	}
-	_children.clear();
-}
-
-void MeshNode::setTransform(FbxAMatrix& fbxmatrix)
+static Eigen::Matrix4d ToMatrix(const FbxAMatrix& fbxmatrix)
 {
+	Eigen::Matrix4d matrix;
 	for (int i = 0; i < 4; i++)
 		for (int j = 0; j < 4; j++)
-			_transform(i, j) = fbxmatrix.Get(i, j);
+			matrix(i, j) = fbxmatrix.Get(i, j);
+	return matrix;
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -99,40 +49,22 @@ FbxParser::FbxParser()
 
 FbxParser::~FbxParser()
 {
+	Clear();
+
 	if (_pFbxManager) 
 		_pFbxManager->Destroy();
+}
 
-	std::vector<PolyMesh*>::iterator iter;
-	for (iter = Meshes.begin(); iter != Meshes.end(); ++iter)
-	{
-		PolyMesh* pMesh = *iter;
-		delete pMesh;
-	}
-	Meshes.clear();
-
-	std::vector<TriMesh*>::iterator iter1;
-	for (iter1 = TriMeshes.begin(); iter1 != TriMeshes.end(); ++iter1)
-	{
-		TriMesh* pTriMesh = *iter1;
-		delete pTriMesh;
-	}
-	TriMeshes.clear();
-
-	std::map<std::string, Material*>::iterator iter2;
-	for (iter2 = Materials.begin(); iter2 != Materials.end(); ++iter2)
-	{
-		Material* pMaterial = iter2->second;
-		delete pMaterial;
-	}
-	Materials.clear();
-
-	std::vector<MeshNode*>::iterator iter3;
-	for (iter3 = Nodes.begin(); iter3 != Nodes.end(); ++iter3)
-	{
-		MeshNode* pNode = *iter3;
-		delete pNode;
-	}
-	Nodes.clear();
+void FbxParser::Clear()
+{
+	SceneParser::Clear();
+	FbxMeshMap.clear();
+	_streamItems.clear();
+	_streamUses.clear();
+
+	//keep the manager and its loaded plugins, only drop the imported objects
+	if (_pFbxScene)
+		_pFbxScene->Clear();
 }
 
 void FbxParser::Initialize()
@@ -164,6 +96,7 @@ void FbxParser::Initialize()
 
 bool FbxParser::LoadScene(const char* pFilename)
 {
+	PROFILE_SCOPE(STAGE_LOAD, "LoadScene");
 	if (!_pFbxManager)
 	{
 		Initialize();
@@ -205,12 +138,14 @@ bool FbxParser::LoadScene(const char* pFilename)
 		return false;
 	}
 
-	FBXSDK_printf("FBX file format version for this FBX SDK is %d.%d.%d\n", lSDKMajor, lSDKMinor, lSDKRevision);
+	if (_options.verbose)
+		FBXSDK_printf("FBX file format version for this FBX SDK is %d.%d.%d\n", lSDKMajor, lSDKMinor, lSDKRevision);
 
 	FbxIOSettings* ios = _pFbxManager->GetIOSettings();
 	if (lImporter->IsFBX())
 	{
-		FBXSDK_printf("FBX file format version for file '%s' is %d.%d.%d\n\n", pFilename, lFileMajor, lFileMinor, lFileRevision);
+		if (_options.verbose)
+			FBXSDK_printf("FBX file format version for file '%s' is %d.%d.%d\n\n", pFilename, lFileMajor, lFileMinor, lFileRevision);
 		if (ios)
 		{
 			ios->SetBoolProp(IMP_FBX_MATERIAL, true);
@@ -224,15 +159,21 @@ bool FbxParser::LoadScene(const char* pFilename)
 	}
 
 	// Import the scene.
-	lStatus = lImporter->Import(_pFbxScene);
-	if (lStatus == false && lImporter->GetStatus() == FbxStatus::ePasswordError)
+	{
+		PROFILE_SCOPE(STAGE_NONE, "FbxImporter::Import");
+		lStatus = lImporter->Import(_pFbxScene);
+	}
+	//batch workers share stdin, a protected file fails there instead of waiting for a password
+	if (lStatus == false && lImporter->GetStatus() == FbxStatus::ePasswordError && !_options.interactive)
+		FBXSDK_printf("Error: %s is password protected\n", pFilename);
+	else if (lStatus == false && lImporter->GetStatus() == FbxStatus::ePasswordError)
 	{
 		FBXSDK_printf("Please enter password: ");
 
 		lPassword[0] = '\0';
 
 		FBXSDK_CRT_SECURE_NO_WARNING_BEGIN
-			scanf("%s", lPassword);
+			scanf("%1023s", lPassword);	//sizeof(lPassword) - 1
 		FBXSDK_CRT_SECURE_NO_WARNING_END
 
 		FbxString lString(lPassword);
@@ -297,14 +238,154 @@ void FbxParser::ExtractContent()
 		return;
 	}
 
+	PROFILE_SCOPE(STAGE_NONE, "ExtractContent");
+
+	//serial walk: node tree, transforms and the list of meshes in depth-first order
 	int lDepth = 0;
 	FbxNode* rootNode = _pFbxScene->GetRootNode();
-	MeshNode* pRootMeshNode = new MeshNode(NULL, rootNode->GetName());
+	MeshNode* pRootMeshNode = _arena.New<MeshNode>(nullptr, rootNode->GetName());
 	Nodes.push_back(pRootMeshNode);
-	ExtractNode(rootNode, lDepth, pRootMeshNode);
+	std::vector<MeshItem> items;
+	{
+		PROFILE_SCOPE(STAGE_EXTRACT, "ExtractNode");
+		ExtractNode(rootNode, lDepth, pRootMeshNode, items);
+	}
+
+	//the SDK is not thread safe: its arrays, layers and materials are copied on this thread
+	for (MeshItem& item : items)
+	{
+		if (item.instance)
+			continue;
+		item.pMesh = ExtractMesh(item.pFbxMesh, item);
+		ExtractMaterial(item.pNode, item.materials);
+		ExtractMaterialConnections(item.pFbxMesh, item);
+	}
+
+	//the meshes are independent, so generate normals and triangulate them concurrently. Large
+	//meshes go one at a time so their own loops get all cores; the rest share the cores one
+	//mesh per thread.
+	const uint32_t LARGE_MESH_POLYGONS = 1 << 18;
+	std::vector<size_t> small;
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		if (items[i].instance)
+			continue;
+		if (items[i].pMesh->nFaces >= LARGE_MESH_POLYGONS)
+			BuildMesh(items[i]);
+		else
+			small.push_back(i);
+	}
+	ParallelForEach(small.size(), [&](size_t i) { BuildMesh(items[small[i]]); });
+
+	//merge in walk order so the result matches a serial extraction
+	for (MeshItem& item : items)
+	{
+		if (item.instance)
+		{
+			AddInstance(FbxMeshMap[Key(item)], item.pMeshNode);
+			continue;
+		}
+		AddMesh(item.pMesh, item.pTriMesh, item.pMeshNode);
+		FbxMeshMap[Key(item)] = item.pTriMesh;
+		for (Material* pMaterial : item.materials)
+			AddMaterial(pMaterial);
+	}
+}
+
+size_t FbxParser::BeginStream()
+{
+	if (!_pFbxScene)
+	{
+		FBXSDK_printf("Error: No FBX scene!\n");
+		return 0;
+	}
+
+	FbxNode* rootNode = _pFbxScene->GetRootNode();
+	MeshNode* pRootMeshNode = _arena.New<MeshNode>(nullptr, rootNode->GetName());
+	Nodes.push_back(pRootMeshNode);
+	_streamItems.clear();
+	{
+		PROFILE_SCOPE(STAGE_EXTRACT, "ExtractNode");
+		ExtractNode(rootNode, 0, pRootMeshNode, _streamItems);
+	}
+
+	//all materials up front, the mtllib line precedes the meshes
+	for (MeshItem& item : _streamItems)
+	{
+		if (item.instance && !_options.expandInstances)
+			continue;
+		if (!item.instance)
+		{
+			ExtractMaterial(item.pNode, item.materials);
+			for (Material* pMaterial : item.materials)
+				AddMaterial(pMaterial);
+		}
+		++_streamUses[item.pFbxMesh];
+	}
+	return _streamItems.size();
+}
+
+PolyMesh* FbxParser::StreamPolyMesh(size_t i)
+{
+	MeshItem& item = _streamItems[i];
+	if (item.instance && !_options.expandInstances)
+		return NULL;
+	PolyMesh* pMesh = ExtractMesh(item.pFbxMesh, item);
+	ExtractMaterialConnections(item.pFbxMesh, item);
+
+	//the SDK copy of the geometry is not needed once its last instance is extracted
+	if (--_streamUses[item.pFbxMesh] == 0)
+		item.pFbxMesh->Destroy();
+
+	if (item.generateNormals)
+		GenerateNormals(pMesh, item.smoothingGroups.empty() ? nullptr : item.smoothingGroups.data(), _options.creaseAngle);
+	return pMesh;
+}
+
+TriMesh* FbxParser::StreamMesh(size_t i)
+{
+	std::unique_ptr<PolyMesh> pMesh(StreamPolyMesh(i));
+	if (!pMesh)
+		return NULL;
+	TriMesh* pTriMesh = NewGeometry<TriMesh>(pMesh.get(), _geometryArena);
+	ApplyMaterials(_streamItems[i], pMesh.get(), pTriMesh);
+	return pTriMesh;
+}
+
+CompactMesh* FbxParser::StreamCompactMesh(size_t i)
+{
+	std::unique_ptr<PolyMesh> pMesh(StreamPolyMesh(i));
+	if (!pMesh)
+		return NULL;
+	CompactMesh* pCompact = new CompactMesh(pMesh.get());
+	ApplyMaterials(_streamItems[i], pMesh.get(), pCompact);
+	return pCompact;
+}
+
+void FbxParser::BuildMesh(MeshItem& item)
+{
+	assert(item.pMesh);
+	//without normals generate them, split by the smoothing groups when the file has them
+	if (item.generateNormals)
+		GenerateNormals(item.pMesh, item.smoothingGroups.empty() ? nullptr : item.smoothingGroups.data(), _options.creaseAngle);
+	item.pTriMesh = NewGeometry<TriMesh>(item.pMesh, _geometryArena);
+	ApplyMaterials(item, item.pMesh, item.pTriMesh);
+}
+
+template <typename Mesh>
+void FbxParser::ApplyMaterials(MeshItem& item, const PolyMesh* pPolyMesh, Mesh* pMesh)
+{
+	if (item.byPolygonMaterials)
+		pMesh->SplitByMaterial(pPolyMesh, item.materialIds.data(), item.materialIds.size(), item.materialNames);
+	else if (!item.matname.empty())
+		pMesh->matname = item.matname;
+
+	//the per polygon copies are not needed anymore, streamed items are kept until the end
+	std::vector<int32_t>().swap(item.smoothingGroups);
+	std::vector<int>().swap(item.materialIds);
 }
 
-void FbxParser::ExtractNode(FbxNode* pNode, int lDepth, MeshNode* pMeshNode)
+void FbxParser::ExtractNode(FbxNode* pNode, int lDepth, MeshNode* pMeshNode, std::vector<MeshItem>& items)
 {
 	if (!pNode) return;
 
@@ -341,309 +422,233 @@ void FbxParser::ExtractNode(FbxNode* pNode, int lDepth, MeshNode* pMeshNode)
 				etype = FbxNodeAttribute::eNull;
 		}
 	}
+	pMeshNode->setTransform(ToMatrix(pNode->EvaluateLocalTransform()));
 	if (pNodeAttribute && etype == FbxNodeAttribute::eMesh)
 	{
 		FbxMesh* pFbxMesh = (FbxMesh*)pNodeAttribute;
 		assert(pFbxMesh);
-		PolyMesh* pMesh = ExtractMesh(pFbxMesh);
-		assert(pMesh);
-		Meshes.push_back(pMesh);
-		TriMesh* pTriMesh = new TriMesh(pMesh);
-		assert(pTriMesh);
-		TriMeshes.push_back(pTriMesh);
-		FbxMeshMap[pFbxMesh] = pTriMesh;
-		if (pMeshNode->_parent)
-			pMeshNode->_parent->_TriMeshes.push_back(pTriMesh);
-		pMeshNode->setTransform(pNode->EvaluateLocalTransform());
-		ExtractMaterial(pFbxMesh);
-		ExtractMaterialConnections(pFbxMesh);
+		//a mesh referenced by several nodes with the same materials is extracted at the first one only
+		MeshItem item = { pFbxMesh, pNode, pMeshNode, NULL, NULL, {}, false };
+		const bool instance = !FbxMeshMap.emplace(Key(item), (TriMesh*)NULL).second;
+		item.instance = instance;
+		//normals generated later need polygon smoothing groups; the SDK converts per edge
+		//smoothing in place, so it is done here on the walking thread before any extraction
+		if (!instance && pFbxMesh->GetElementNormalCount() == 0 && pFbxMesh->GetElementSmoothingCount() > 0
+			&& pFbxMesh->GetElementSmoothing(0)->GetMappingMode() == FbxGeometryElement::eByEdge)
+		{
+			FbxGeometryConverter converter(pFbxMesh->GetFbxManager());
+			converter.ComputePolygonSmoothingFromEdgeSmoothing(pFbxMesh);
+		}
+		items.push_back(item);
 	}
-	else
+
+	const unsigned int childCount = pNode->GetChildCount();
+	for (unsigned int i = 0; i < childCount; i++)
 	{
-		pMeshNode->setTransform(pNode->EvaluateGlobalTransform());
-		const unsigned int childCount = pNode->GetChildCount();
-		for (unsigned int i = 0; i < childCount; i++)
+		FbxNode* pChildNode = pNode->GetChild(i);
+		MeshNode* pDolChildNode = _arena.New<MeshNode>(pMeshNode, pChildNode->GetName());
+		pMeshNode->_children.push_back(pDolChildNode);
+		ExtractNode(pChildNode, lDepth+1, pDolChildNode, items);
+	}
+}
+
+//Resolve a layer element's mapping and reference mode once into the direct array index
+//of every polygon corner. cornerSource is the SDK polygon-vertex index of each corner.
+template <typename TElement>
+static bool ResolveLayerIndices(TElement* pElement, const PolyMesh* polyMesh, const int* cornerSource,
+	int directCount, uint32_t* indices)
+{
+	const FbxGeometryElement::EMappingMode mapping = pElement->GetMappingMode();
+	const FbxGeometryElement::EReferenceMode reference = pElement->GetReferenceMode();
+	if (mapping != FbxGeometryElement::eByControlPoint && mapping != FbxGeometryElement::eByPolygonVertex &&
+		mapping != FbxGeometryElement::eByPolygon && mapping != FbxGeometryElement::eAllSame)
+		return false;
+
+	const bool indexed = reference != FbxGeometryElement::eDirect;
+	FbxLayerElementArrayTemplate<int>& indexArray = pElement->GetIndexArray();
+	const int indexCount = indexed ? indexArray.GetCount() : 0;
+	int* index = indexed ? indexArray.GetLocked(FbxLayerElementArray::eReadLock) : NULL;
+	if (indexed && !index)
+		return false;
+
+	const uint32_t* vertsIndices = polyMesh->VertsIndices.get();
+	const uint32_t* faceIndices = polyMesh->FaceIndices.get();
+	int invalid = 0;
+	for (uint32_t i = 0, c = 0; i < polyMesh->nFaces; ++i)
+	{
+		for (uint32_t j = 0; j < faceIndices[i]; ++j, ++c)
 		{
-			FbxNode* pChildNode = pNode->GetChild(i);
-			MeshNode* pDolChildNode = new MeshNode(pMeshNode, pChildNode->GetName());
-			pMeshNode->_children.push_back(pDolChildNode);
-			ExtractNode(pChildNode, lDepth+1, pDolChildNode);
+			int key;
+			switch (mapping)
+			{
+			case FbxGeometryElement::eByControlPoint: key = vertsIndices[c]; break;
+			case FbxGeometryElement::eByPolygonVertex: key = cornerSource[c]; break;
+			case FbxGeometryElement::eByPolygon: key = i; break;
+			default: key = 0; break;
+			}
+			if (indexed)
+				key = key < indexCount ? index[key] : -1;
+			if (key < 0 || key >= directCount)
+			{
+				key = 0;
+				++invalid;
+			}
+			indices[c] = key;
 		}
 	}
+
+	if (index)
+		indexArray.Release(&index);
+	if (invalid > 0)
+		FBXSDK_printf("            %d invalid layer element indices in %s\n", invalid, polyMesh->name.c_str());
+	return directCount > 0;
 }
 
-PolyMesh* FbxParser::ExtractMesh(FbxMesh* pMesh)
+PolyMesh* FbxParser::ExtractMesh(FbxMesh* pMesh, MeshItem& item)
 {
-	PolyMesh* polyMesh = new PolyMesh();
-	FbxNode* pNode = pMesh->GetNode();
-	polyMesh->name = pNode->GetName();
-
-	int i, j, lPolygonCount = pMesh->GetPolygonCount();
-	char header[100];
+	PolyMesh* polyMesh = NewGeometry<PolyMesh>();
+	polyMesh->name = item.pNode->GetName();
+	PROFILE_SCOPE_DETAIL(STAGE_EXTRACT, "ExtractMesh", &polyMesh->name);
 
+	const int lPolygonCount = pMesh->GetPolygonCount();
+	const int controlPointCount = pMesh->GetControlPointsCount();
 	polyMesh->nFaces = lPolygonCount;
-	int controlPointCount = pMesh->GetControlPointsCount();
 	polyMesh->nVertices = controlPointCount;
-	int UVCount = pMesh->GetElementUVCount();
-	int normalCount = pMesh->GetElementNormalCount();
 
-	polyMesh->FaceIndices = std::unique_ptr<uint32_t[]>(new uint32_t[lPolygonCount]);
-	polyMesh->Verts = std::unique_ptr<Vector3d[]>(new Vector3d[controlPointCount]);
+	/*********************************** POSITIONS *********************************/
+	//FbxVector4 holds 4 doubles, so this is a strided copy rather than a memcpy
+	polyMesh->Verts = MakeMeshArray<Vector3d>(controlPointCount, _geometryArena);
+	const FbxVector4* lControlPoints = pMesh->GetControlPoints();
+	for (int i = 0; i < controlPointCount; i++)
+		polyMesh->Verts[i] = Vector3d(lControlPoints[i][0], lControlPoints[i][1], lControlPoints[i][2]);
 
+	/*********************************** TOPOLOGY *********************************/
+	polyMesh->FaceIndices = MakeMeshArray<uint32_t>(lPolygonCount, _geometryArena);
+	std::vector<int> cornerSource;	//SDK polygon-vertex index of each corner
 	int vertsIndexCount = 0;
-	for (i = 0; i < lPolygonCount; i++)
+	bool contiguous = true;
+	for (int i = 0; i < lPolygonCount; i++)
 	{
-		uint32_t lPolygonSize = pMesh->GetPolygonSize(i);
-		vertsIndexCount += lPolygonSize;
+		polyMesh->FaceIndices[i] = pMesh->GetPolygonSize(i);
+		contiguous = contiguous && pMesh->GetPolygonVertexIndex(i) == vertsIndexCount;
+		vertsIndexCount += polyMesh->FaceIndices[i];
 	}
-	polyMesh->VertsIndices = std::unique_ptr<uint32_t[]>(new uint32_t[vertsIndexCount]);
-	polyMesh->UVs = std::unique_ptr<Vector2d[]>(new Vector2d[vertsIndexCount]);
-	polyMesh->Normals = std::unique_ptr<Vector3d[]>(new Vector3d[vertsIndexCount]);
-	polyMesh->UVIndices = std::unique_ptr<uint32_t[]>(new uint32_t[vertsIndexCount]);
-
-	FbxVector4* lControlPoints = pMesh->GetControlPoints();
-	for (i = 0; i < polyMesh->nVertices; i++)
+	cornerSource.resize(vertsIndexCount);
+	for (int i = 0, c = 0; i < lPolygonCount; i++)
 	{
-		FbxVector4 point = lControlPoints[i];
-		polyMesh->Verts[i][0] = point[0];
-		polyMesh->Verts[i][1] = point[1];
-		polyMesh->Verts[i][2] = point[2];
+		int start = contiguous ? c : pMesh->GetPolygonVertexIndex(i);
+		for (uint32_t j = 0; j < polyMesh->FaceIndices[i]; j++)
+			cornerSource[c++] = start + j;
 	}
 
-	int vertexId = 0;
-	for (i = 0; i < lPolygonCount; i++)
+	polyMesh->VertsIndices = MakeMeshArray<uint32_t>(vertsIndexCount, _geometryArena);
+	const int* lPolygonVertices = pMesh->GetPolygonVertices();
+	if (contiguous)
+		memcpy(polyMesh->VertsIndices.get(), lPolygonVertices, sizeof(uint32_t) * vertsIndexCount);
+	else
+		for (int c = 0; c < vertsIndexCount; c++)
+			polyMesh->VertsIndices[c] = lPolygonVertices[cornerSource[c]];
+
+	int invalid = 0;
+	for (int c = 0; c < vertsIndexCount; c++)
 	{
-		int l;
-		for (l = 0; l < pMesh->GetElementPolygonGroupCount(); l++)
+		if (polyMesh->VertsIndices[c] >= (uint32_t)controlPointCount)
 		{
-			FbxGeometryElementPolygonGroup* lePolgrp = pMesh->GetElementPolygonGroup(l);
-			switch (lePolgrp->GetMappingMode())
-			{
-			case FbxGeometryElement::eByPolygon:
-				if (lePolgrp->GetReferenceMode() == FbxGeometryElement::eIndex)
-				{
-					FBXSDK_sprintf(header, 100, "        Assigned to group: ");
-					int polyGroupId = lePolgrp->GetIndexArray().GetAt(i);
-					break;
-				}
-			default:
-				// any other mapping modes don't make sense
-				FBXSDK_printf("        \"unsupported group assignment\"");
-				break;
-			}
+			polyMesh->VertsIndices[c] = 0;
+			++invalid;
 		}
-
-		int lPolygonSize = pMesh->GetPolygonSize(i);
-		polyMesh->FaceIndices[i] = lPolygonSize;
-
-		for (j = 0; j < lPolygonSize; j++)
+	}
+	if (invalid > 0)
+		FBXSDK_printf("            Coordinates: %d invalid indices found!\n", invalid);
+
+	polyMesh->UVs = MakeMeshArray<Vector2d>(vertsIndexCount, _geometryArena);
+	polyMesh->Normals = MakeMeshArray<Vector3d>(vertsIndexCount, _geometryArena);
+	polyMesh->UVIndices = MakeMeshArray<uint32_t>(vertsIndexCount, _geometryArena);
+	std::fill_n(polyMesh->UVs.get(), vertsIndexCount, Vector2d::Zero());
+	std::fill_n(polyMesh->Normals.get(), vertsIndexCount, Vector3d::Zero());
+	std::fill_n(polyMesh->UVIndices.get(), vertsIndexCount, 0u);
+
+	/*********************************** UVS *********************************/
+	//one uv set per vertex as autodesk fbx converter
+	if (pMesh->GetElementUVCount() > 0)
+	{
+		FbxGeometryElementUV* leUV = pMesh->GetElementUV(0);
+		FbxLayerElementArrayTemplate<FbxVector2>& directArray = leUV->GetDirectArray();
+		const int directCount = directArray.GetCount();
+		if (ResolveLayerIndices(leUV, polyMesh, cornerSource.data(), directCount, polyMesh->UVIndices.get()))
 		{
-			int lControlPointIndex = pMesh->GetPolygonVertex(i, j);
-			if (lControlPointIndex < 0)
+			FbxVector2* direct = directArray.GetLocked(FbxLayerElementArray::eReadLock);
+			static_assert(sizeof(FbxVector2) == sizeof(Vector2d), "FbxVector2 and Vector2d layouts differ");
+			if (leUV->GetMappingMode() == FbxGeometryElement::eByPolygonVertex &&
+				leUV->GetReferenceMode() == FbxGeometryElement::eDirect && contiguous && directCount == vertsIndexCount)
 			{
-				FBXSDK_printf("            Coordinates: Invalid index found!");
-				continue;
+				memcpy(polyMesh->UVs.get(), direct, sizeof(Vector2d) * vertsIndexCount);
 			}
 			else
 			{
-				polyMesh->VertsIndices[vertexId] = lControlPointIndex;
+				const uint32_t* uvIndices = polyMesh->UVIndices.get();
+				for (int c = 0; c < vertsIndexCount; c++)
+					polyMesh->UVs[c] = Vector2d(direct[uvIndices[c]][0], direct[uvIndices[c]][1]);
 			}
-
-			for (l = 0; l < pMesh->GetElementUVCount(); ++l)
-			{
-				FbxGeometryElementUV* leUV = pMesh->GetElementUV(l);
-				FBXSDK_sprintf(header, 100, "            Texture UV: ");
-
-				switch (leUV->GetMappingMode())
-				{
-				default:
-					break;
-				case FbxGeometryElement::eByControlPoint:
-					switch (leUV->GetReferenceMode())
-					{
-					case FbxGeometryElement::eDirect:
-						polyMesh->UVs[vertexId][0] = leUV->GetDirectArray().GetAt(lControlPointIndex)[0];
-						polyMesh->UVs[vertexId][1] = leUV->GetDirectArray().GetAt(lControlPointIndex)[1];
-						break;
-					case FbxGeometryElement::eIndexToDirect:
-					{
-						int id = leUV->GetIndexArray().GetAt(lControlPointIndex);
-						polyMesh->UVs[vertexId][0] = leUV->GetDirectArray().GetAt(id)[0];
-						polyMesh->UVs[vertexId][1] = leUV->GetDirectArray().GetAt(id)[1];
-					}
-					break;
-					default:
-						break; // other reference modes not shown here!
-					}
-					break;
-
-				case FbxGeometryElement::eByPolygonVertex:
-				{
-					int lTextureUVIndex = pMesh->GetTextureUVIndex(i, j);
-					polyMesh->UVIndices[vertexId] = lTextureUVIndex;
-					switch (leUV->GetReferenceMode())
-					{
-					case FbxGeometryElement::eDirect:
-					case FbxGeometryElement::eIndexToDirect:
-					{
-						polyMesh->UVs[vertexId][0] = leUV->GetDirectArray().GetAt(lTextureUVIndex)[0];
-						polyMesh->UVs[vertexId][1] = leUV->GetDirectArray().GetAt(lTextureUVIndex)[1];
-					}
-					break;
-					default:
-						break; // other reference modes not shown here!
-					}
-				}
-				break;
-
-				case FbxGeometryElement::eByPolygon: // doesn't make much sense for UVs
-				case FbxGeometryElement::eAllSame:   // doesn't make much sense for UVs
-				case FbxGeometryElement::eNone:       // doesn't make much sense for UVs
-					break;
-				}
-
-				break; //heck: one uv per vertex as autodesk fbx converter
-			}
-
-			for (l = 0; l < pMesh->GetElementNormalCount(); ++l)
-			{
-				FbxGeometryElementNormal* leNormal = pMesh->GetElementNormal(l);
-				FBXSDK_sprintf(header, 100, "            Normal: ");
-
-				if (leNormal->GetMappingMode() == FbxGeometryElement::eByPolygonVertex)
-				{
-					switch (leNormal->GetReferenceMode())
-					{
-					case FbxGeometryElement::eDirect:
-						polyMesh->Normals[vertexId][0] = leNormal->GetDirectArray().GetAt(vertexId)[0];
-						polyMesh->Normals[vertexId][1] = leNormal->GetDirectArray().GetAt(vertexId)[1];
-						polyMesh->Normals[vertexId][2] = leNormal->GetDirectArray().GetAt(vertexId)[0];
-						break;
-					case FbxGeometryElement::eIndexToDirect:
-					{
-						int id = leNormal->GetIndexArray().GetAt(vertexId);
-						polyMesh->Normals[vertexId][0] = leNormal->GetDirectArray().GetAt(id)[0];
-						polyMesh->Normals[vertexId][1] = leNormal->GetDirectArray().GetAt(id)[1];
-						polyMesh->Normals[vertexId][2] = leNormal->GetDirectArray().GetAt(id)[0];
-					}
-					break;
-					default:
-						break; // other reference modes not shown here!
-					}
-				}
-				else if (leNormal->GetMappingMode() == FbxGeometryElement::eByControlPoint)
-				{
-					switch (leNormal->GetReferenceMode())
-					{
-					case FbxGeometryElement::eDirect:
-						polyMesh->Normals[vertexId][0] = leNormal->GetDirectArray().GetAt(lControlPointIndex)[0];
-						polyMesh->Normals[vertexId][1] = leNormal->GetDirectArray().GetAt(lControlPointIndex)[1];
-						polyMesh->Normals[vertexId][2] = leNormal->GetDirectArray().GetAt(lControlPointIndex)[2];
-						break;
-					case FbxGeometryElement::eIndexToDirect:
-					{
-						int id = leNormal->GetIndexArray().GetAt(lControlPointIndex);
-						polyMesh->Normals[vertexId][0] = leNormal->GetDirectArray().GetAt(id)[0];
-						polyMesh->Normals[vertexId][1] = leNormal->GetDirectArray().GetAt(id)[1];
-						polyMesh->Normals[vertexId][2] = leNormal->GetDirectArray().GetAt(id)[2];
-					}
-					break;
-					default:
-						break; // other reference modes not shown here!
-					}
-				}
-				else {
-					assert(false); //not supported
-				}
-
-			}
-			vertexId++;
-		} // for polygonSize
-	} // for polygonCount
-
-	return polyMesh;
-}
-
-int FbxParser::ExportOBJ(const char* pFilename)
-{
-	if (TriMeshes.size() == 0)
-		return E_NO_MESH;
-	
-	FILE* fp; 
-	fopen_s(&fp, pFilename, "w");
-	if (fp == NULL) return E_FAILOPENFILE;
-
-	std::string shortFilename(pFilename);
-	int LastSlash = shortFilename.size() - 1;
-	while (LastSlash >= 0 && shortFilename[LastSlash] != '/')
-		--LastSlash;
-	shortFilename = shortFilename.substr(LastSlash + 1);
-	int len = shortFilename.length() - 4;
-	shortFilename = shortFilename.substr(0, len);
-
-	fprintf(fp, "###################\n#\n# Wavefront OBJ File\n# Created with Dolphin FBX\n#\n###################\n\n");
-
-	//library material
-	if (Materials.size() > 0)
-		fprintf(fp, "mtllib ./%s.mtl\n\n", shortFilename.c_str());
-	
-	uint32_t vplus = 1, vtplus = 1;
-	for (auto iter = TriMeshes.begin(); iter != TriMeshes.end(); ++iter)
-	{
-		TriMesh* m = *iter;
-		fprintf(fp, "g %s\n", m->name.c_str());
-		/*********************************** VERTICES *********************************/
-		for (uint32_t i = 0, k = 0; i < m->numVert; ++i)
-		{
-			fprintf(fp, "v %f %f %f\n", m->P[i][0], m->P[i][1], m->P[i][2]);
-		}
-
-		for (uint32_t i = 0, k = 0; i < m->numUV; ++i)
-		{
-			fprintf(fp, "vt %f %f\n", m->UV[i][0], m->UV[i][1]);
+			directArray.Release(&direct);
 		}
+		else
+			FBXSDK_printf("            Texture UV: unsupported mapping mode\n");
+	}
 
-		for (uint32_t i = 0, k = 0; i < m->numVert; ++i)
+	/*********************************** NORMALS *********************************/
+	bool hasNormals = false;
+	if (pMesh->GetElementNormalCount() > 0)
+	{
+		FbxGeometryElementNormal* leNormal = pMesh->GetElementNormal(0);
+		FbxLayerElementArrayTemplate<FbxVector4>& directArray = leNormal->GetDirectArray();
+		std::vector<uint32_t> normalIndices(vertsIndexCount);
+		if (ResolveLayerIndices(leNormal, polyMesh, cornerSource.data(), directArray.GetCount(), normalIndices.data()))
 		{
-			fprintf(fp, "vn %f %f %f\n", m->PN[i][0], m->PN[i][1], m->PN[i][2]);
+			FbxVector4* direct = directArray.GetLocked(FbxLayerElementArray::eReadLock);
+			for (int c = 0; c < vertsIndexCount; c++)
+			{
+				const FbxVector4& n = direct[normalIndices[c]];
+				polyMesh->Normals[c] = Vector3d(n[0], n[1], n[2]);
+			}
+			directArray.Release(&direct);
+			hasNormals = true;
 		}
+		else
+			FBXSDK_printf("            Normal: unsupported mapping mode\n");
+	}
 
-		if (!m->matname.empty())
-			fprintf(fp, "usemtl %s\n", m->matname.c_str());
-		uint32_t l = 0;
-		for (uint32_t i = 0, k = 0; i < m->numTris; ++i)
+	//BuildMesh generates the missing normals, split by the smoothing groups when the file has
+	//them; per edge smoothing was converted to groups by ExtractNode
+	item.generateNormals = !hasNormals;
+	item.smoothingGroups.clear();
+	if (!hasNormals)
+	{
+		std::vector<int32_t>& smoothingGroups = item.smoothingGroups;
+		FbxGeometryElementSmoothing* leSmoothing = pMesh->GetElementSmoothingCount() > 0 ? pMesh->GetElementSmoothing(0) : NULL;
+		if (leSmoothing && leSmoothing->GetMappingMode() == FbxGeometryElement::eByPolygon)
 		{
-			fprintf(fp, "f ");
-			for (unsigned k = 0; k < 3; ++k)
+			FbxLayerElementArrayTemplate<int>& directArray = leSmoothing->GetDirectArray();
+			const bool indexed = leSmoothing->GetReferenceMode() != FbxGeometryElement::eDirect;
+			smoothingGroups.resize(lPolygonCount);
+			for (int i = 0; i < lPolygonCount; i++)
 			{
-				int vn = m->triIndex[l + k] + vplus;
-				int tn = m->UVIndices[l + k] + vtplus;
-				fprintf(fp, "%d/%d/%d", vn, tn, vn);
-				fprintf(fp, " ");
+				int key = indexed && i < leSmoothing->GetIndexArray().GetCount() ? leSmoothing->GetIndexArray().GetAt(i) : i;
+				smoothingGroups[i] = key >= 0 && key < directArray.GetCount() ? directArray.GetAt(key) : 0;
 			}
-			fprintf(fp, "\n");
-			l += 3;
 		}
-
-		vplus += m->numVert;
-		vtplus += m->numUV;
 	}
-	fclose(fp); 
 
-	std::string mtlfile = shortFilename;
-	WriteMaterials(Materials, shortFilename.c_str());
-
-	return E_NOERROR;
+	return polyMesh;
 }
 
-void FbxParser::ExtractMaterial(FbxMesh* pMesh)
+void FbxParser::ExtractMaterial(FbxNode* lNode, std::vector<Material*>& materials)
 {
-	if (!pMesh)
+	PROFILE_SCOPE(STAGE_MATERIALS, "ExtractMaterial");
+	if (!lNode)
 		return;
 
 	int lMaterialCount = 0;
-	FbxNode* lNode = pMesh->GetNode();
-	assert(lNode);
 	lMaterialCount = lNode->GetMaterialCount();
 
 	if (lMaterialCount > 0)
@@ -655,137 +660,131 @@ void FbxParser::ExtractMaterial(FbxMesh* pMesh)
 		for (int lCount = 0; lCount < lMaterialCount; lCount++)
 		{
 			FbxSurfaceMaterial *lMaterial = lNode->GetMaterial(lCount);
-			std::string matName = lMaterial->GetName();
-			if (Materials.find(matName) == Materials.end())
+			Material* pMaterial = _arena.New<Material>();
+			assert(pMaterial);
+			pMaterial->index = lCount;
+			pMaterial->materialName = lMaterial->GetName();
+
+			if (lMaterial->GetClassId().Is(FbxSurfacePhong::ClassId))
+			{
+				// the Ambient Color
+				dFbxAmbient = ((FbxSurfacePhong *)lMaterial)->Ambient;
+				theColor.Set(dFbxAmbient.Get()[0], dFbxAmbient.Get()[1], dFbxAmbient.Get()[2]);
+
+				// the Diffuse Color
+				dFbxDiffuse = ((FbxSurfacePhong *)lMaterial)->Diffuse;
+				theColor.Set(dFbxDiffuse.Get()[0], dFbxDiffuse.Get()[1], dFbxDiffuse.Get()[2]);
+
+				// the Specular Color (unique to Phong materials)
+				dFbxSpecular = ((FbxSurfacePhong *)lMaterial)->Specular;
+				theColor.Set(dFbxSpecular.Get()[0], dFbxSpecular.Get()[1], dFbxSpecular.Get()[2]);
+
+				// Display the Emissive Color
+				dFbxEmissive = ((FbxSurfacePhong *)lMaterial)->Emissive;
+				theColor.Set(dFbxEmissive.Get()[0], dFbxEmissive.Get()[1], dFbxEmissive.Get()[2]);
+
+				//Opacity is Transparency factor now
+				dFbxTransparency = ((FbxSurfacePhong *)lMaterial)->TransparencyFactor;
+
+				// the Shininess
+				dFbxShininess = ((FbxSurfacePhong *)lMaterial)->Shininess;
+
+				// the Reflectivity
+				dFbxReflectivity = ((FbxSurfacePhong *)lMaterial)->ReflectionFactor;
+
+				pMaterial->Ks = Vector3d(dFbxSpecular.Get()[0], dFbxSpecular.Get()[1], dFbxSpecular.Get()[2]);
+				pMaterial->Ns = dFbxShininess.Get();
+			}
+			else if (lMaterial->GetClassId().Is(FbxSurfaceLambert::ClassId))
+			{
+				// We found a Lambert material. Display its properties.
+				// the Ambient Color
+				dFbxAmbient = ((FbxSurfaceLambert *)lMaterial)->Ambient;
+				theColor.Set(dFbxAmbient.Get()[0], dFbxAmbient.Get()[1], dFbxAmbient.Get()[2]);
+
+				// the Diffuse Color
+				dFbxDiffuse = ((FbxSurfaceLambert *)lMaterial)->Diffuse;
+				theColor.Set(dFbxDiffuse.Get()[0], dFbxDiffuse.Get()[1], dFbxDiffuse.Get()[2]);
+
+				// the Emissive
+				dFbxEmissive = ((FbxSurfaceLambert *)lMaterial)->Emissive;
+				theColor.Set(dFbxEmissive.Get()[0], dFbxEmissive.Get()[1], dFbxEmissive.Get()[2]);
+
+				// Display the Opacity
+				dFbxTransparency = ((FbxSurfaceLambert *)lMaterial)->TransparencyFactor;
+			}
+			else
 			{
-				Material* pMaterial = new Material;
-				assert(pMaterial);
-				pMaterial->index = lCount;
-				pMaterial->materialName = lMaterial->GetName();
-
-				if (lMaterial->GetClassId().Is(FbxSurfacePhong::ClassId))
-				{
-					// the Ambient Color
-					dFbxAmbient = ((FbxSurfacePhong *)lMaterial)->Ambient;
-					theColor.Set(dFbxAmbient.Get()[0], dFbxAmbient.Get()[1], dFbxAmbient.Get()[2]);
-
-					// the Diffuse Color
-					dFbxDiffuse = ((FbxSurfacePhong *)lMaterial)->Diffuse;
-					theColor.Set(dFbxDiffuse.Get()[0], dFbxDiffuse.Get()[1], dFbxDiffuse.Get()[2]);
-
-					// the Specular Color (unique to Phong materials)
-					dFbxSpecular = ((FbxSurfacePhong *)lMaterial)->Specular;
-					theColor.Set(dFbxSpecular.Get()[0], dFbxSpecular.Get()[1], dFbxSpecular.Get()[2]);
-
-					// Display the Emissive Color
-					dFbxEmissive = ((FbxSurfacePhong *)lMaterial)->Emissive;
-					theColor.Set(dFbxEmissive.Get()[0], dFbxEmissive.Get()[1], dFbxEmissive.Get()[2]);
-
-					//Opacity is Transparency factor now
-					dFbxTransparency = ((FbxSurfacePhong *)lMaterial)->TransparencyFactor;
-
-					// the Shininess
-					dFbxShininess = ((FbxSurfacePhong *)lMaterial)->Shininess;
-
-					// the Reflectivity
-					dFbxReflectivity = ((FbxSurfacePhong *)lMaterial)->ReflectionFactor;
-
-					pMaterial->Ks = Vector3d(dFbxSpecular.Get()[0], dFbxSpecular.Get()[1], dFbxSpecular.Get()[2]);
-					pMaterial->Ns = dFbxShininess.Get();
-				}
-				else if (lMaterial->GetClassId().Is(FbxSurfaceLambert::ClassId))
-				{
-					// We found a Lambert material. Display its properties.
-					// the Ambient Color
-					dFbxAmbient = ((FbxSurfaceLambert *)lMaterial)->Ambient;
-					theColor.Set(dFbxAmbient.Get()[0], dFbxAmbient.Get()[1], dFbxAmbient.Get()[2]);
-
-					// the Diffuse Color
-					dFbxDiffuse = ((FbxSurfaceLambert *)lMaterial)->Diffuse;
-					theColor.Set(dFbxDiffuse.Get()[0], dFbxDiffuse.Get()[1], dFbxDiffuse.Get()[2]);
-
-					// the Emissive
-					dFbxEmissive = ((FbxSurfaceLambert *)lMaterial)->Emissive;
-					theColor.Set(dFbxEmissive.Get()[0], dFbxEmissive.Get()[1], dFbxEmissive.Get()[2]);
-
-					// Display the Opacity
-					dFbxTransparency = ((FbxSurfaceLambert *)lMaterial)->TransparencyFactor;
-				}
-				else
-				{
-					FBXSDK_printf("Unknown or unsupported type of Material");
-					continue;
-				}
-
-				pMaterial->Ka = Vector3d(dFbxAmbient.Get()[0], dFbxAmbient.Get()[1], dFbxAmbient.Get()[2]);
-				pMaterial->Kd = Vector3d(dFbxDiffuse.Get()[0], dFbxDiffuse.Get()[1], dFbxDiffuse.Get()[2]);
-				pMaterial->Tr = 1.0 - dFbxTransparency.Get();
-				Materials[matName] = pMaterial;
+				FBXSDK_printf("Unknown or unsupported type of Material");
+				continue;
 			}
+
+			pMaterial->Ka = Vector3d(dFbxAmbient.Get()[0], dFbxAmbient.Get()[1], dFbxAmbient.Get()[2]);
+			pMaterial->Kd = Vector3d(dFbxDiffuse.Get()[0], dFbxDiffuse.Get()[1], dFbxDiffuse.Get()[2]);
+			pMaterial->Tr = 1.0 - dFbxTransparency.Get();
+			materials.push_back(pMaterial);
 		}
 	}
 }
 
-void FbxParser::ExtractMaterialConnections(FbxMesh* pMesh)
+FbxParser::GeometryKey FbxParser::Key(const MeshItem& item)
 {
-	int i, l, lPolygonCount = pMesh->GetPolygonCount();
+	GeometryKey key(item.pFbxMesh, std::vector<FbxSurfaceMaterial*>(item.pNode->GetMaterialCount()));
+	for (int i = 0; i < (int)key.second.size(); ++i)
+		key.second[i] = item.pNode->GetMaterial(i);
+	return key;
+}
 
-	//check whether the material maps with only one mesh
-	bool lIsAllSame = true;
+void FbxParser::ExtractMaterialConnections(FbxMesh* pMesh, MeshItem& item)
+{
+	PROFILE_SCOPE(STAGE_MATERIALS, "ExtractMaterialConnections");
+	int l;
+	item.byPolygonMaterials = false;
+	item.materialIds.clear();
+	item.materialNames.clear();
+	item.matname.clear();
+
+	//For eByPolygon mapping type, group the triangles into one submesh per material
 	for (l = 0; l < pMesh->GetElementMaterialCount(); l++)
 	{
 		FbxGeometryElementMaterial* lMaterialElement = pMesh->GetElementMaterial(l);
-		if (lMaterialElement->GetMappingMode() == FbxGeometryElement::eByPolygon)
+		if (lMaterialElement->GetMappingMode() != FbxGeometryElement::eByPolygon)
+			continue;
+
+		FbxNode* lNode = item.pNode;
+		item.materialNames.resize(lNode->GetMaterialCount());
+		for (int i = 0; i < (int)item.materialNames.size(); i++)
+			item.materialNames[i] = lNode->GetMaterial(i)->GetName();
+
+		FbxLayerElementArrayTemplate<int>& lIndexArray = lMaterialElement->GetIndexArray();
+		int* lMatIds = lIndexArray.GetLocked(FbxLayerElementArray::eReadLock);
+		if (lMatIds)
 		{
-			lIsAllSame = false;
-			break;
+			item.materialIds.assign(lMatIds, lMatIds + lIndexArray.GetCount());
+			item.byPolygonMaterials = true;
+			lIndexArray.Release(&lMatIds);
 		}
+		return;
 	}
 
 	//For eAllSame mapping type, just out the material and texture mapping info once
-	if (lIsAllSame)
-	{
-		for (l = 0; l < pMesh->GetElementMaterialCount(); l++)
-		{
-			FbxGeometryElementMaterial* lMaterialElement = pMesh->GetElementMaterial(l);
-			if (lMaterialElement->GetMappingMode() == FbxGeometryElement::eAllSame)
-			{
-				FbxSurfaceMaterial* lMaterial = pMesh->GetNode()->GetMaterial(lMaterialElement->GetIndexArray().GetAt(0));
-				int lMatId = lMaterialElement->GetIndexArray().GetAt(0);
-				if (lMatId >= 0)
-				{
-					//FBXSDK_printf("        All polygons share the same material in mesh ", l);
-					TriMesh* pTriMesh = FbxMeshMap[pMesh];
-					pTriMesh->matname = lMaterial->GetName();
-				}
-			}
-		}
-
-		//no material
-		if (l == 0)
-			FBXSDK_printf("        no material applied");
-	}
-	//For eByPolygon mapping type, just out the material and texture mapping info once
-	else
+	for (l = 0; l < pMesh->GetElementMaterialCount(); l++)
 	{
-		//FBXSDK_printf("   not supported material connection.\n");
-		TriMesh* pTriMesh = FbxMeshMap[pMesh];
-		for (i = 0; i < lPolygonCount; i++)
+		FbxGeometryElementMaterial* lMaterialElement = pMesh->GetElementMaterial(l);
+		if (lMaterialElement->GetMappingMode() == FbxGeometryElement::eAllSame)
 		{
-			for (l = 0; l < pMesh->GetElementMaterialCount(); l++)
+			FbxSurfaceMaterial* lMaterial = item.pNode->GetMaterial(lMaterialElement->GetIndexArray().GetAt(0));
+			int lMatId = lMaterialElement->GetIndexArray().GetAt(0);
+			if (lMatId >= 0)
 			{
-				FbxGeometryElementMaterial* lMaterialElement = pMesh->GetElementMaterial(l);
-				FbxSurfaceMaterial* lMaterial = NULL;
-				int lMatId = -1;
-				lMaterial = pMesh->GetNode()->GetMaterial(lMaterialElement->GetIndexArray().GetAt(i));
-				lMatId = lMaterialElement->GetIndexArray().GetAt(i);
-
-				if (lMatId >= 0)
-				{
-					pTriMesh->matname = lMaterial->GetName(); //temperary hack, need map matid <--> material name and tris <--> matid
-				}
+				//FBXSDK_printf("        All polygons share the same material in mesh ", l);
+				item.matname = lMaterial->GetName();
 			}
 		}
 	}
+
+	//no material
+	if (l == 0)
+		FBXSDK_printf("        no material applied");
 }
 
@@ -25,73 +25,74 @@ OF SUCH DAMAGE.
 #pragma once
 
 #include <fbxsdk.h>
+#include <map>
 #include <memory>
 #include <vector>
-#include "../Common/polymesh.h"
+#include "../Common/scene.h"
 
-
-struct Material
-{
-	unsigned int index = -1;//index of material
-	std::string materialName;
-
-	Vector3d Ka = Vector3d(0.2f, 0.2f, 0.2f); //ambient
-	Vector3d Kd = Vector3d(1.0f, 1.0f, 1.0f); //diffuse
-	Vector3d Ks = Vector3d(1.0f, 1.0f, 1.0f); //specular
-
-	float d; //alpha
-	float Tr = 1.0f; //alpha
-
-	int illum = 2; //specular illumination
-	float Ns = 0.f;
-
-	std::string map_Kd; //filename texture
-};
-
-class MeshNode
-{
-public:
-	MeshNode(MeshNode* parent, std::string name);
-	~MeshNode();
-
-	bool hasMeshNodes() { return _TriMeshes.size() > 0; }
-	void setTransform(FbxAMatrix& fbxmatrix);
-
-	std::string _name;
-	Eigen::Matrix4d _transform;
-	std::vector<MeshNode* > _children;
-	std::vector<TriMesh* > _TriMeshes;
-	MeshNode* _parent;
-};
-
-class FbxParser
+//Importer built on the Autodesk FBX SDK
+class FbxParser : public SceneParser
 {
 public:
 	FbxParser();
 	~FbxParser();
-	enum { E_NOERROR, E_NO_MESH, E_FAILOPENFILE, };
 
-	bool LoadScene(const char* pFilename);
+	bool LoadScene(const char* pFilename) override;
 
-	void ExtractContent();
+	void ExtractContent() override;
 
-	int ExportOBJ(const char* pFilename);
+	//release the extracted content and empty the scene, the FBX manager is kept for the next file
+	void Clear() override;
+
+protected:
+	size_t BeginStream() override;
+	TriMesh* StreamMesh(size_t i) override;
+	CompactMesh* StreamCompactMesh(size_t i) override;
 
 private:
-	void Initialize();
-	void ExtractNode(FbxNode* pNode, int lDepth, MeshNode* pMeshNode);
-	PolyMesh* ExtractMesh(FbxMesh* lMesh);
-	void ExtractMaterial(FbxMesh* lMesh);
-	void ExtractMaterialConnections(FbxMesh* lMesh);
+	//A mesh found by the node walk. The SDK is not thread safe, so everything it holds is
+	//read on the calling thread first; BuildMesh then runs on any thread without the SDK.
+	struct MeshItem
+	{
+		FbxMesh* pFbxMesh;
+		FbxNode* pNode;						//node being extracted, its materials apply
+		MeshNode* pMeshNode;
+		PolyMesh* pMesh;
+		TriMesh* pTriMesh;
+		std::vector<Material*> materials;	//node materials in order, merged by name afterwards
+		bool instance;						//pFbxMesh with the same materials was found at an earlier node, not extracted again
+
+		bool generateNormals = false;		//no usable normal layer
+		std::vector<int32_t> smoothingGroups;	//per polygon, empty without a smoothing layer
+		bool byPolygonMaterials = false;	//materialIds holds the material of every polygon
+		std::vector<int> materialIds;
+		std::vector<std::string> materialNames;
+		std::string matname;				//material shared by all polygons
+	};
+
+	//an SDK mesh with the materials of a node referencing it; nodes that share a mesh but
+	//assign other materials get their own copy since the material ids are baked into it
+	typedef std::pair<FbxMesh*, std::vector<FbxSurfaceMaterial*> > GeometryKey;
 
-	std::vector<PolyMesh* > Meshes;
-	std::vector<TriMesh* > TriMeshes;
-	std::map<std::string, Material*> Materials;
-	std::map<FbxMesh*, TriMesh*> FbxMeshMap;
-	std::vector<MeshNode* > Nodes;
+	void Initialize();
+	void ExtractNode(FbxNode* pNode, int lDepth, MeshNode* pMeshNode, std::vector<MeshItem>& items);
+	PolyMesh* ExtractMesh(FbxMesh* lMesh, MeshItem& item);
+	void ExtractMaterial(FbxNode* pNode, std::vector<Material*>& materials);
+	//material ids and names of the mesh at item.pNode for BuildMesh
+	void ExtractMaterialConnections(FbxMesh* lMesh, MeshItem& item);
+	static GeometryKey Key(const MeshItem& item);
+	//normals, triangulation and submeshes from what the SDK reads left in the item
+	void BuildMesh(MeshItem& item);
+	//streamed mesh i read from the SDK with its normals, NULL when it is not written
+	PolyMesh* StreamPolyMesh(size_t i);
+	//materials read by ExtractMaterialConnections, for a TriMesh or CompactMesh
+	template <typename Mesh> void ApplyMaterials(MeshItem& item, const PolyMesh* pPolyMesh, Mesh* pMesh);
+
+	std::map<GeometryKey, TriMesh*> FbxMeshMap;	//extracted geometry, shared by every node referencing it with the same materials
+	std::vector<MeshItem> _streamItems;		//meshes of the scene being streamed
+	std::map<FbxMesh*, int> _streamUses;	//items still to write per SDK mesh
 
 	FbxManager* _pFbxManager;
 	FbxScene* _pFbxScene;
 
 };
-
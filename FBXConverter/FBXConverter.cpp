@@ -2,38 +2,206 @@
 //
 
 #include <string>
-#include <io.h>
 #include <assert.h>
 #include <stdio.h>
-#include "FBX/FbxParser.h"
+#include <stdlib.h>
+#include <string.h>
+#include "Batch/BatchConverter.h"
+#include "Batch/ConversionCache.h"
+#include "Common/geometrystore.h"
+#include "Common/profile.h"
+#include "Common/textwriter.h"
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+
+//digits after the point, anything negative selects the shortest round-trip form
+static int ParsePrecision(const char* s)
+{
+	int precision = atoi(s);
+	return precision < 0 ? TextWriter::SHORTEST : std::min(precision, (int)TextWriter::MAX_PRECISION);
+}
+
+static int RunBatch(const char* pDirectory, unsigned int numWorkers, bool native, const char* pExtension, const ExportOptions& options,
+	const std::string& cacheDir, uint64_t cacheBytes, bool printStats, GeometryStore* pStore, const PipelineOptions& pipeline)
+{
+	std::vector<std::string> files = BatchConverter::CollectFiles(pDirectory);
+	if (files.empty()) {
+		printf("No fbx file found in %s.\n", pDirectory);
+		return -1;
+	}
+
+	BatchConverter batch(numWorkers, native);
+	batch.SetExportOptions(options);
+	batch.SetOutputExtension(pExtension);
+	batch.SetGeometryStore(pStore);
+	batch.SetPipeline(pipeline);
+
+	std::unique_ptr<ConversionCache> cache;
+	if (!cacheDir.empty())
+	{
+		cache.reset(new ConversionCache(cacheDir, cacheBytes));
+		if (cache->Open())
+			batch.SetCache(cache.get());
+		else
+			printf("Cannot create cache directory %s, converting without cache.\n", cacheDir.c_str());
+	}
+
+	int failed = batch.Run(files);
+	batch.PrintSummary(stdout);
+	if (printStats)
+		batch.PrintStats(stdout);
+	return failed > 0 ? 1 : 0;
+}
 
 int main(int argc, char** argv)
 {
 	std::string strFile;
+	std::string outFile("");
+	std::string batchDir;
+	unsigned int numWorkers = 0;
+	ExportOptions options;
+	bool native = false;
+	const char* outExtension = ".obj";
+	bool arenaStats = false;
+	std::string cacheDir;
+	uint64_t cacheBytes = ConversionCache::DEFAULT_MAX_BYTES;
+	bool printStats = false;
+	std::string traceFile;
+	std::string storeDir;
+	PipelineOptions pipeline;
 
-	if (argc >= 2) {
-		std::string input(argv[1]);
-		strFile = input;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg(argv[i]);
+		if (arg == "--batch" && i + 1 < argc)
+			batchDir = argv[++i];
+		else if (arg == "-j" && i + 1 < argc)
+			numWorkers = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--readers" && i + 1 < argc)	//batch: threads reading input files ahead
+			pipeline.numReaders = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--writers" && i + 1 < argc)	//batch: threads writing output files
+			pipeline.numWriters = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--prefetch" && i + 1 < argc)	//batch: MB of input read ahead at most
+			pipeline.prefetchBytes = (uint64_t)atoll(argv[++i]) << 20;
+		else if (arg == "--native")	//built-in binary FBX reader instead of the Autodesk SDK
+			native = true;
+		else if (arg == "--precision" && i + 1 < argc)	//digits after the point, -1 for shortest round-trip
+			options.positionPrecision = options.normalPrecision = options.uvPrecision = ParsePrecision(argv[++i]);
+		else if (arg == "--position-precision" && i + 1 < argc)
+			options.positionPrecision = ParsePrecision(argv[++i]);
+		else if (arg == "--normal-precision" && i + 1 < argc)
+			options.normalPrecision = ParsePrecision(argv[++i]);
+		else if (arg == "--uv-precision" && i + 1 < argc)
+			options.uvPrecision = ParsePrecision(argv[++i]);
+		else if (arg == "--glb")	//binary glTF output instead of obj
+			outExtension = ".glb";
+		else if (arg == "--gltf")	//glTF JSON output with the buffers in a .bin
+			outExtension = ".gltf";
+		else if (arg == "--scene")	//the extracted scene as a memory-mappable .scene
+			outExtension = ".scene";
+		else if (arg == "--dedup" && i + 1 < argc)	//glTF: identical meshes of all outputs stored once in this directory
+			storeDir = argv[++i];
+		else if (arg == "--optimize")	//vertex cache order and vertex fetch remap
+			options.optimize = true;
+		else if (arg == "--optimize-overdraw")	//same plus front to back cluster order
+			options.optimize = options.optimizeOverdraw = true;
+		else if (arg == "--arena-stats")	//print the scene arena usage after converting
+			arenaStats = true;
+		else if (arg == "--cache" && i + 1 < argc)	//batch: reuse results of unchanged files
+			cacheDir = argv[++i];
+		else if (arg == "--cache-size" && i + 1 < argc)	//MB
+			cacheBytes = (uint64_t)atoll(argv[++i]) << 20;
+		else if (arg == "--stats")	//JSON line of stage times and counters per file
+			printStats = true;
+		else if (arg == "--trace" && i + 1 < argc)	//Chrome trace of the stages, one track per thread
+			traceFile = argv[++i];
+		else if (arg == "--verbose")	//per mesh optimizer results
+			options.verbose = true;
+		else if (arg == "--stream")	//write and free one mesh at a time (OBJ)
+			options.stream = true;
+		else if (arg == "--compact")	//streamed OBJ meshes in float32 streams without per-corner arrays
+			options.compact = options.stream = true;
+		else if (arg == "--expand-instances")	//OBJ: shared geometry once per node
+			options.expandInstances = true;
+		else if (arg == "--crease-angle" && i + 1 < argc)	//degrees, for meshes without normals
+			options.creaseAngle = (float)atof(argv[++i]);
+		else if (arg == "--bake")	//meshes in world space, one copy per node using them
+			options.bakeTransforms = true;
+		else if (arg == "--simplify" && i + 1 < argc)	//keep this fraction of the triangles of every mesh
+			options.simplifyRatio = (float)atof(argv[++i]);
+		else if (arg == "--simplify-error" && i + 1 < argc)	//simplify until this error, relative to the mesh size
+			options.simplifyError = (float)atof(argv[++i]);
+		else if (arg == "--lod" && i + 1 < argc) {	//percentages of the triangles for _lod1, _lod2...
+			options.lodRatios.clear();
+			for (const char* p = argv[++i]; *p; ) {
+				char* end;
+				float percent = strtof(p, &end);
+				if (end == p)
+					break;
+				options.lodRatios.push_back(percent / 100.0f);
+				p = *end == ',' ? end + 1 : end;
+			}
+		}
+		else if (arg == "--tangents")	//glTF: TANGENT attribute
+			options.tangents = true;
+		else if (arg == "--bvh")	//mesh and node bounds plus a BVH per mesh in a .bvh file
+			options.bvh = true;
+		else if (arg == "--weld")
+			options.weld = true;
+		else if (arg == "--weld-epsilon" && i + 1 < argc) {
+			options.weld = true;
+			options.weldEpsilon = (float)atof(argv[++i]);
+		}
+		else if (strFile.empty())
+			strFile = arg;
+		else
+			outFile = arg;
 	}
-	else {
-		std::string input("../data/Teeths.fbx");
-		strFile = input;
+
+	//written on every way out of main, once the worker threads are gone
+	struct TraceOutput
+	{
+		std::string file;
+		~TraceOutput()
+		{
+			if (!file.empty() && !Profiler::WriteTrace(file.c_str()))
+				printf("Cannot write trace %s.\n", file.c_str());
+		}
+	} traceOutput = { traceFile };
+	if (printStats || !traceFile.empty())
+	{
+		Profiler::Enable(printStats, !traceFile.empty());
+		Profiler::SetThreadName("main");
 	}
 
-	std::string outFile("");
-	if (argc >= 3) {
-		std::string out(argv[2]);
-		outFile = out;
+	std::unique_ptr<GeometryStore> store;
+	if (!storeDir.empty())
+	{
+		store.reset(new GeometryStore(storeDir));
+		if (!store->Open())
+		{
+			printf("Cannot create geometry store %s.\n", storeDir.c_str());
+			return -1;
+		}
+		if (strcmp(outExtension, ".obj") == 0)	//obj cannot reference shared buffers
+			outExtension = ".gltf";
 	}
 
+	if (!batchDir.empty())
+		return RunBatch(batchDir.c_str(), numWorkers, native, outExtension, options, cacheDir, cacheBytes, printStats, store.get(), pipeline);
+
+	if (strFile.empty()) {
+		std::string input("../data/Teeths.fbx");
+		strFile = input;
+	}
 
-	struct _finddata_t c_file;
-	long hFile;
-	if ((hFile = _findfirst(strFile.c_str(), &c_file)) == -1L) {
-		printf("Cannot find input file %s./n", strFile);
+	if (!std::filesystem::exists(strFile)) {
+		printf("Cannot find input file %s.\n", strFile.c_str());
 		return -1;
 	}
+	if (std::filesystem::is_directory(strFile))
+		return RunBatch(strFile.c_str(), numWorkers, native, outExtension, options, cacheDir, cacheBytes, printStats, store.get(), pipeline);
 
 	std::string exstr;
 	int idx = strFile.rfind('.');
@@ -43,24 +211,35 @@ int main(int argc, char** argv)
 	std::transform(exstr.begin(), exstr.end(),
 		exstr.begin(), ::tolower);
 
-	if (strcmp(exstr.c_str(), "fbx") == 0)
+	int status = SceneParser::E_NOERROR;
+	if (strcmp(exstr.c_str(), "fbx") == 0 || strcmp(exstr.c_str(), "scene") == 0)
 	{
-		FbxParser* parser = new FbxParser();
+		SceneParser* parser = CreateParser(strFile, native);
 		assert(parser != nullptr);
+		parser->SetExportOptions(options);
+		parser->SetGeometryStore(store.get());
 
-		if (parser && parser->LoadScene(strFile.c_str()))
-		{
-			parser->ExtractContent();
-
-			std::string objFile;
-			int len = strFile.length() - 4;
-			objFile = strFile.substr(0, len) + ".obj";
-			parser->ExportOBJ(objFile.c_str());
+		if (outFile.empty()) {
+			int len = strFile.length() - exstr.length() - 1;
+			outFile = strFile.substr(0, len) + outExtension;
 		}
+		MeshArena::Stats arena;
+		ProfileStats fileStats;
+		Profiler::CurrentStats() = &fileStats;
+		auto start = std::chrono::steady_clock::now();
+		status = ConvertFile(parser, strFile, outFile, arenaStats ? &arena : nullptr);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		Profiler::CurrentStats() = nullptr;
+		if (printStats)
+			fileStats.WriteJSON(stdout, strFile, status, seconds);
+		if (arenaStats)
+			printf("Scene arena: %zu allocations, %.2f MB used, %.2f MB reserved in %zu blocks\n",
+				arena.allocations, arena.bytesUsed / 1048576.0, arena.bytesReserved / 1048576.0, arena.blocks);
+		if (store)
+			store->PrintReport(stdout);
 
 		if (parser)
 			delete parser;
 	}
-	return 0;
+	return status == SceneParser::E_NOERROR ? 0 : 1;
 }
-
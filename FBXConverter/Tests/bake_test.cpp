@@ -0,0 +1,143 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//bake_test.cpp
+//BakeTransforms replaces each use of a mesh, instances included, with a copy whose
+//positions are the local ones times the node's world matrix, and keeps it facing out.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/scene.h"
+#include <memory>
+
+//one grid used by three nodes below a translated root, and a mesh no node uses
+class BakeScene : public SceneParser
+{
+public:
+	BakeScene(TriMesh* pShared, TriMesh* pUnused) : _pShared(pShared), _pUnused(pUnused) {}
+
+	bool LoadScene(const char* /*pFilename*/) override { return true; }
+
+	void ExtractContent() override
+	{
+		MeshNode* pRoot = NewNode(nullptr, "root");
+		pRoot->_transform(3, 0) = 1.0;
+		pRoot->_transform(3, 1) = 2.0;
+		pRoot->_transform(3, 2) = 3.0;
+		Nodes.push_back(pRoot);
+
+		//x to y, scaled by 2
+		MeshNode* pRotated = NewNode(pRoot, "rotated");
+		pRotated->_transform.topLeftCorner<3, 3>() << 0.0, 2.0, 0.0, -2.0, 0.0, 0.0, 0.0, 0.0, 2.0;
+
+		MeshNode* pMirrored = NewNode(pRoot, "mirrored");
+		pMirrored->_transform(0, 0) = -1.0;
+		pMirrored->_transform(3, 2) = 5.0;
+
+		MeshNode* pNested = NewNode(pRotated, "nested");
+		pNested->_transform(3, 0) = 0.5;
+
+		TriMeshes.push_back(_pShared);
+		pRotated->_TriMeshes.push_back(_pShared);
+		AddInstance(_pShared, pMirrored);
+		AddInstance(_pShared, pNested);
+		TriMeshes.push_back(_pUnused);
+	}
+
+	using SceneParser::BakeTransforms;
+	const std::vector<MeshNode*>& Users() const { return _users; }
+	const std::vector<TriMesh*>& GetTriMeshes() const { return TriMeshes; }
+
+protected:
+	size_t BeginStream() override { return 0; }
+	TriMesh* StreamMesh(size_t /*i*/) override { return nullptr; }
+
+private:
+	MeshNode* NewNode(MeshNode* pParent, const char* name)
+	{
+		MeshNode* pNode = _arena.New<MeshNode>(pParent, name);
+		if (pParent)
+		{
+			pParent->_children.push_back(pNode);
+			_users.push_back(pNode);
+		}
+		return pNode;
+	}
+
+	TriMesh* _pShared;
+	TriMesh* _pUnused;
+	std::vector<MeshNode*> _users;	//the nodes below the root, each using _pShared
+};
+
+static Eigen::Matrix4d WorldMatrix(const MeshNode* pNode)
+{
+	return pNode->_parent ? Eigen::Matrix4d(pNode->_transform * WorldMatrix(pNode->_parent)) : pNode->_transform;
+}
+
+int main()
+{
+	std::unique_ptr<TriMesh> shared(Grid(2));
+	std::unique_ptr<TriMesh> unused(Quad());
+	BakeScene scene(shared.get(), unused.get());
+	scene.ExtractContent();
+
+	//world matrices and local positions before baking
+	std::vector<Eigen::Matrix4d> worlds;
+	for (const MeshNode* pNode : scene.Users())
+		worlds.push_back(WorldMatrix(pNode));
+	std::vector<Vector3d> local(shared->P.get(), shared->P.get() + shared->numVert);
+
+	scene.BakeTransforms();
+
+	const std::vector<TriMesh*>& meshes = scene.GetTriMeshes();
+	CHECK(meshes.size() == 4 && meshes.back() == unused.get());
+	for (size_t i = 0; i < scene.Users().size(); ++i)
+	{
+		const MeshNode* pNode = scene.Users()[i];
+		CHECK(pNode->_transform.isIdentity() && pNode->_TriMeshes.size() == 1);
+		const TriMesh* m = pNode->_TriMeshes[0];
+		CHECK(m != shared.get() && m->numVert == shared->numVert && m->numTris == shared->numTris);
+		CHECK(meshes[i] == m);
+		for (uint32_t v = 0; v < m->numVert; ++v)
+		{
+			const Eigen::RowVector4d p = Eigen::RowVector4d(local[v][0], local[v][1], local[v][2], 1.0) * worlds[i];
+			CHECK((m->P[v] - p.head<3>().transpose()).norm() < 1e-12);
+		}
+
+		//the mirrored copy swaps corners, so every triangle still faces its normals
+		for (uint32_t t = 0; t < m->numTris; ++t)
+		{
+			const Vector3d& a = m->P[m->triIndex[t * 3]];
+			const Vector3d face = (m->P[m->triIndex[t * 3 + 1]] - a).cross(m->P[m->triIndex[t * 3 + 2]] - a);
+			for (int k = 0; k < 3; ++k)
+				CHECK(face.dot(m->N[t * 3 + k]) > 0.0);
+		}
+	}
+
+	//the shared mesh itself is left alone
+	for (uint32_t v = 0; v < shared->numVert; ++v)
+		CHECK(shared->P[v] == local[v]);
+
+	return g_failures;
+}
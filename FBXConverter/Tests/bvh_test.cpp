@@ -0,0 +1,116 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//bvh_test.cpp
+//BuildBvh puts every triangle in exactly one leaf, and every node's box contains its
+//children and, for a leaf, its triangles.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/bvh.h"
+#include <memory>
+
+static bool Contains(const BvhNode& outer, const BvhNode& inner)
+{
+	for (int i = 0; i < 3; ++i)
+		if (inner.min[i] < outer.min[i] || inner.max[i] > outer.max[i])
+			return false;
+	return true;
+}
+
+static bool Contains(const BvhNode& node, const Vector3d& p)
+{
+	for (int i = 0; i < 3; ++i)
+		if (p[i] < node.min[i] || p[i] > node.max[i])
+			return false;
+	return true;
+}
+
+static void CheckBvh(const TriMesh* m)
+{
+	Bvh bvh;
+	BuildBvh(m, bvh);
+	CHECK(!bvh.nodes.empty() && bvh.triangles.size() == m->numTris);
+
+	//walk from the root; every node is reached once and every triangle number once
+	std::vector<uint32_t> nodeVisits(bvh.nodes.size(), 0), triangleVisits(m->numTris, 0);
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty())
+	{
+		const uint32_t n = stack.back();
+		stack.pop_back();
+		CHECK(n < bvh.nodes.size());
+		if (n >= bvh.nodes.size())
+			continue;
+		++nodeVisits[n];
+		const BvhNode& node = bvh.nodes[n];
+		if (node.count == 0)
+		{
+			CHECK(node.offset + 1 < bvh.nodes.size());
+			if (node.offset + 1 >= bvh.nodes.size())
+				continue;
+			for (uint32_t child = node.offset; child < node.offset + 2; ++child)
+			{
+				CHECK(Contains(node, bvh.nodes[child]));
+				stack.push_back(child);
+			}
+			continue;
+		}
+		CHECK(node.count <= 8 && node.offset + node.count <= bvh.triangles.size());
+		for (uint32_t i = node.offset; i < node.offset + node.count && i < bvh.triangles.size(); ++i)
+		{
+			const uint32_t t = bvh.triangles[i];
+			CHECK(t < m->numTris);
+			if (t >= m->numTris)
+				continue;
+			++triangleVisits[t];
+			for (int k = 0; k < 3; ++k)
+				CHECK(Contains(node, m->P[m->triIndex[t * 3 + k]]));
+		}
+	}
+	for (uint32_t visits : nodeVisits)
+		CHECK(visits == 1);
+	for (uint32_t visits : triangleVisits)
+		CHECK(visits == 1);
+}
+
+//a grid bent into a saddle, so the boxes are not flat
+static TriMesh* Saddle(uint32_t n)
+{
+	TriMesh* m = Grid(n);
+	for (uint32_t v = 0; v < m->numVert; ++v)
+		m->P[v][2] = (m->P[v][0] - 0.5) * (m->P[v][1] - 0.5);
+	return m;
+}
+
+int main()
+{
+	//a single leaf, a small tree built on one thread, and one above 64K triangles binned in parallel
+	for (uint32_t n : { 1u, 16u, 200u })
+	{
+		std::unique_ptr<TriMesh> m(Saddle(n));
+		CheckBvh(m.get());
+	}
+	return g_failures;
+}
@@ -0,0 +1,111 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//cache_test.cpp
+//ConversionCache restores what it stored, evicts the least recently used entries down
+//to its size, and keeps the index lines appended while an eviction runs.
+
+#include "check.h"
+#include "../Batch/ConversionCache.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+static void WriteText(const fs::path& file, const std::string& text)
+{
+	fs::remove(file);	//never through a hardlink into the cache
+	std::ofstream(file, std::ios::binary) << text;
+}
+
+static std::string ReadText(const fs::path& file)
+{
+	std::ifstream in(file, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+int main()
+{
+	const fs::path dir = fs::temp_directory_path() / "fbxconverter_cache_test";
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+	const fs::path cacheDir = dir / "cache";
+	const std::string out = (dir / "out.obj").string();
+	const std::string mtl = (dir / "out.mtl").string();
+	const ExportOptions options;
+
+	//three inputs converted to 1000 byte outputs, in a cache of 2500 bytes
+	std::string keys[3];
+	ConversionCache cache(cacheDir.string(), 2500);
+	CHECK(cache.Open());
+	for (int i = 0; i < 3; ++i)
+	{
+		const fs::path in = dir / ("in" + std::to_string(i) + ".fbx");
+		WriteText(in, "input " + std::to_string(i));
+		keys[i] = cache.Key(in.string(), out, options, true);
+		CHECK(keys[i].size() == 32);
+		CHECK(!cache.Restore(keys[i], out, options));
+		WriteText(out, std::string(900, (char)('a' + i)));
+		WriteText(mtl, std::string(100, (char)('A' + i)));
+		CHECK(cache.Store(keys[i], out, options));
+	}
+	CHECK(keys[0] != keys[1] && keys[1] != keys[2]);
+	ExportOptions welded;
+	welded.weld = true;
+	CHECK(cache.Key((dir / "in0.fbx").string(), out, welded, true) != keys[0]);
+
+	//round trip: the stored files come back
+	fs::remove(out);
+	fs::remove(mtl);
+	CHECK(cache.Restore(keys[1], out, options));
+	CHECK(ReadText(out) == std::string(900, 'b') && ReadText(mtl) == std::string(100, 'B'));
+	ConversionCache::Stats stats = cache.GetStats();
+	CHECK(stats.hits == 1 && stats.misses == 3 && stats.stores == 3);
+
+	//last used 0 before 2 before 1, and a store made during the eviction: a leftover
+	//snapshot is merged like the index of an evictor that went away, and the live index
+	//holds the line appended since
+	{
+		std::ofstream snapshot(cacheDir / "index.evicting");
+		snapshot << keys[0] << " 1000 100\n" << keys[1] << " 1000 300\n" << keys[2] << " 1000 200\n";
+		std::ofstream live(cacheDir / "index");
+		live << "0123456789abcdef0123456789abcdef 10 400\n";
+	}
+	cache.Evict();
+	stats = cache.GetStats();
+	CHECK(stats.evicted == 1 && stats.bytes == 2000);
+	CHECK(!cache.Restore(keys[0], out, options));
+	CHECK(!fs::exists(cacheDir / "index.evicting"));
+	const std::string index = ReadText(cacheDir / "index");
+	CHECK(index.find(keys[0]) == std::string::npos);
+	CHECK(index.find(keys[1] + " 1000 300\n") != std::string::npos);
+	CHECK(index.find(keys[2] + " 1000 200\n") != std::string::npos);
+	CHECK(index.find("0123456789abcdef0123456789abcdef 10 400\n") != std::string::npos);
+	CHECK(cache.Restore(keys[1], out, options) && ReadText(out) == std::string(900, 'b'));
+	CHECK(cache.Restore(keys[2], out, options) && ReadText(out) == std::string(900, 'c'));
+
+	fs::remove_all(dir);
+	return g_failures;
+}
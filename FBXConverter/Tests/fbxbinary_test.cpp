@@ -0,0 +1,207 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//fbxbinary_test.cpp
+//FbxBinaryParser on generated FBX 7.4 (32 bit record headers) and 7.5 (64 bit) files, with
+//raw and deflated arrays: normal and uv layers, per polygon materials, a nested child and
+//a model instancing the geometry of another. Checks the OBJ and GLB written from them.
+
+#include "check.h"
+#include "../Benchmark/fbxwriter.h"
+#include "../FBX/FbxBinaryParser.h"
+#include <string.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+//a strip of quads along x, one uv per position
+static PolyMesh* Strip(uint32_t numQuads)
+{
+	PolyMesh* m = new PolyMesh;
+	const uint32_t numCorners = numQuads * 4;
+	m->nVertices = (numQuads + 1) * 2;
+	m->nFaces = numQuads;
+	m->Verts = MakeMeshArray<Vector3d>(m->nVertices, nullptr);
+	m->FaceIndices = MakeMeshArray<uint32_t>(numQuads, nullptr);
+	m->VertsIndices = MakeMeshArray<uint32_t>(numCorners, nullptr);
+	m->Normals = MakeMeshArray<Vector3d>(numCorners, nullptr);
+	m->UVs = MakeMeshArray<Vector2d>(numCorners, nullptr);
+	m->UVIndices = MakeMeshArray<uint32_t>(numCorners, nullptr);
+	for (uint32_t v = 0; v < m->nVertices; ++v)
+		m->Verts[v] = Vector3d(v / 2, v & 1, 0.0);
+	for (uint32_t f = 0, c = 0; f < numQuads; ++f)
+	{
+		m->FaceIndices[f] = 4;
+		const uint32_t quad[4] = { f * 2, f * 2 + 2, f * 2 + 3, f * 2 + 1 };
+		for (uint32_t v : quad)
+		{
+			m->VertsIndices[c] = m->UVIndices[c] = v;
+			m->Normals[c] = Vector3d(0.0, 0.0, 1.0);
+			m->UVs[c] = m->Verts[v].head<2>() * 0.5;
+			++c;
+		}
+	}
+	return m;
+}
+
+//Parent (two quads, Red and Blue by polygon) with a nested Child (one quad, Blue for all
+//polygons) and Instance, a second model with the geometry and materials of Parent
+static std::vector<uint8_t> TestScene(uint32_t version, bool compress)
+{
+	std::unique_ptr<PolyMesh> strip(Strip(2)), quad(Strip(1));
+	FbxWriter w(version, compress);
+	w.Begin("FBXHeaderExtension");
+	w.Begin("FBXVersion").Int((int32_t)version).End();
+	w.End();
+
+	w.Begin("Objects");
+	w.Model(1, "Parent", Vector3d(0.0, 0.0, 0.0));
+	w.Model(2, "Child", Vector3d(5.0, 0.0, 0.0));
+	w.Model(3, "Instance", Vector3d(0.0, 3.0, 0.0));
+	w.Geometry(10, "Strip", strip.get(), { 0, 1 });
+	w.Geometry(11, "Quad", quad.get(), { 0 });
+	w.Material(100, "Red", Vector3d(1.0, 0.0, 0.0));
+	w.Material(101, "Blue", Vector3d(0.0, 0.0, 1.0));
+	w.End();
+
+	w.Begin("Connections");
+	w.Connect(1, 0);
+	w.Connect(10, 1);
+	w.Connect(100, 1);
+	w.Connect(101, 1);
+	w.Connect(2, 1);
+	w.Connect(11, 2);
+	w.Connect(101, 2);
+	w.Connect(3, 0);
+	w.Connect(10, 3);
+	w.Connect(100, 3);
+	w.Connect(101, 3);
+	w.End();
+	return w.Finish();
+}
+
+static std::string TempPath(const char* name)
+{
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static std::string ReadFile(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+//lines starting with prefix
+static size_t CountLines(const std::string& text, const char* prefix)
+{
+	size_t count = 0, n = strlen(prefix);
+	for (size_t pos = 0; pos < text.size();)
+	{
+		count += text.compare(pos, n, prefix) == 0;
+		const size_t end = text.find('\n', pos);
+		pos = end == std::string::npos ? text.size() : end + 1;
+	}
+	return count;
+}
+
+static size_t CountOf(const std::string& text, const char* s)
+{
+	size_t count = 0;
+	for (size_t pos = text.find(s); pos != std::string::npos; pos = text.find(s, pos + 1))
+		++count;
+	return count;
+}
+
+//load the file and write pFilename (extension picks the format), returning its contents
+static std::string Convert(const std::vector<uint8_t>& fbx, const char* pFilename, const ExportOptions& options, bool stream = false)
+{
+	const std::string path = TempPath(pFilename);
+	FbxBinaryParser parser;
+	parser.SetExportOptions(options);
+	parser.SetInput(fbx.data(), fbx.size());
+	CHECK(parser.LoadScene("test.fbx"));
+	if (stream)
+		CHECK(parser.StreamOBJ(path.c_str()) == SceneParser::E_NOERROR);
+	else
+	{
+		parser.ExtractContent();
+		CHECK(parser.Export(path.c_str()) == SceneParser::E_NOERROR);
+	}
+	parser.Clear();
+	std::string text = ReadFile(path);
+	std::filesystem::remove(path);
+	std::filesystem::remove(path + ".mtl");
+	return text;
+}
+
+int main()
+{
+	const std::pair<uint32_t, bool> formats[] = { { 7400, false }, { 7400, true }, { 7500, false }, { 7500, true } };
+	std::string firstObj, firstGlb;
+	for (const auto& format : formats)
+	{
+		const std::vector<uint8_t> fbx = TestScene(format.first, format.second);
+		ExportOptions options;
+
+		//Instance shares the mesh of Parent, written once
+		const std::string obj = Convert(fbx, "fbxconverter_fbxbinary_test.obj", options);
+		CHECK(CountLines(obj, "g ") == 2);
+		CHECK(CountLines(obj, "g Parent") == 1 && CountLines(obj, "g Child") == 1);
+		CHECK(CountLines(obj, "v ") == 6 + 4);
+		CHECK(CountLines(obj, "vt ") == 6 + 4);
+		CHECK(CountLines(obj, "vn ") == 6 + 4);
+		CHECK(CountLines(obj, "f ") == 4 + 2);
+		CHECK(CountLines(obj, "usemtl Red") == 1 && CountLines(obj, "usemtl Blue") == 2);
+		CHECK(CountLines(obj, "vt 1.000000 0.500000") == 1);
+		CHECK(Convert(fbx, "fbxconverter_fbxbinary_test.obj", options, true) == obj);
+
+		options.expandInstances = true;
+		const std::string expanded = Convert(fbx, "fbxconverter_fbxbinary_test.obj", options);
+		CHECK(CountLines(expanded, "g ") == 3 && CountLines(expanded, "g Instance") == 1);
+		CHECK(CountLines(expanded, "f ") == 4 + 2 + 4);
+		options.expandInstances = false;
+
+		//Child nested in Parent and moved by x = 5, Instance using the mesh of Parent, which has
+		//a primitive per material
+		const std::string glb = Convert(fbx, "fbxconverter_fbxbinary_test.glb", options);
+		CHECK(glb.size() > 20 && glb.compare(0, 4, "glTF") == 0);
+		const std::string json = glb.size() > 20 ? glb.substr(20, glb.find("BIN", 20) - 20) : std::string();
+		CHECK(CountOf(json, "{\"name\":\"RootNode\",\"children\":[1,3]}") == 1);
+		CHECK(CountOf(json, "{\"name\":\"Parent\",\"mesh\":0,\"children\":[2]}") == 1);
+		CHECK(CountOf(json, "{\"name\":\"Child\",\"matrix\":[1,0,0,0,0,1,0,0,0,0,1,0,5,0,0,1],\"mesh\":1}") == 1);
+		CHECK(CountOf(json, "{\"name\":\"Instance\",\"matrix\":[1,0,0,0,0,1,0,0,0,0,1,0,0,3,0,1],\"mesh\":0}") == 1);
+		CHECK(CountOf(json, "\"primitives\"") == 2 && CountOf(json, "\"indices\"") == 3);
+		CHECK(CountOf(json, "\"name\":\"Red\"") == 1 && CountOf(json, "\"name\":\"Blue\"") == 1);
+
+		//every format gives the same result
+		if (firstObj.empty())
+		{
+			firstObj = obj;
+			firstGlb = glb;
+		}
+		CHECK(obj == firstObj);
+		CHECK(glb == firstGlb);
+	}
+	return g_failures;
+}
@@ -0,0 +1,83 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//geometrystore_test.cpp
+//GeometryStore reuses a stored file only when its size matches the layout, and an entry
+//only for a mesh with the counts it was made from.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/geometrystore.h"
+#include "../Common/weld.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+int main()
+{
+	const fs::path dir = fs::temp_directory_path() / "fbxconverter_geometrystore_test";
+	fs::remove_all(dir);
+	std::unique_ptr<TriMesh> quad(Quad());
+	std::unique_ptr<WeldedMesh> welded(WeldTriMesh(quad.get()));
+	const uint64_t hash = GeometryStore::HashMesh(quad.get(), GeometryStore::SettingsSeed(ExportOptions()));
+	const fs::path file = dir / GeometryStore::FileName(hash);
+
+	GeometryStore::Entry entry;
+	{
+		GeometryStore store(dir.string());
+		CHECK(store.Open());
+		CHECK(!store.Find(hash, quad.get(), entry));
+		CHECK(store.Add(hash, quad.get(), welded.get(), entry));
+		CHECK(fs::file_size(file) == entry.Bytes());
+		CHECK(store.Find(hash, quad.get(), entry));
+
+		//another mesh under the same hash is neither found nor stored over the first
+		std::unique_ptr<TriMesh> other(new TriMesh("other", 3, 1));
+		GeometryStore::Entry otherEntry;
+		CHECK(!store.Find(hash, other.get(), otherEntry));
+		CHECK(!store.Add(hash, other.get(), welded.get(), otherEntry));
+		CHECK(store.GetStats().written == 1 && store.GetStats().references == 2);
+	}
+
+	//a later run finds a cut short file and writes it again
+	fs::resize_file(file, entry.Bytes() / 2);
+	{
+		GeometryStore store(dir.string());
+		CHECK(store.Open());
+		CHECK(store.Add(hash, quad.get(), welded.get(), entry));
+		CHECK(fs::file_size(file) == entry.Bytes());
+		CHECK(store.GetStats().written == 1);
+	}
+
+	//and references a complete one
+	{
+		GeometryStore store(dir.string());
+		CHECK(store.Open());
+		CHECK(store.Add(hash, quad.get(), welded.get(), entry));
+		CHECK(store.GetStats().written == 0 && store.GetStats().references == 1);
+	}
+
+	fs::remove_all(dir);
+	return g_failures;
+}
@@ -0,0 +1,89 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//objwriter_test.cpp
+//ObjWriter output of a small mesh: faces without a material after named ones get the
+//default material, and Close reports a file that could not be written.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/objwriter.h"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+static std::string ReadFile(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+int main()
+{
+	std::unique_ptr<TriMesh> m(Quad());
+
+	//first triangle red, second without a material, then a mesh without any
+	{
+		SubMesh red, none;
+		red.matname = "red";
+		red.numTris = 1;
+		none.firstTri = 1;
+		none.numTris = 1;
+		m->subMeshes = { red, none };
+		Material material;
+		material.materialName = "red";
+		std::map<std::string, Material*> materials;
+		materials["red"] = &material;
+
+		const std::string path = (std::filesystem::temp_directory_path() / "fbxconverter_objwriter_test.obj").string();
+		const std::string mtlPath = path.substr(0, path.size() - 4) + ".mtl";
+		ObjWriter writer((ExportOptions()));
+		CHECK(writer.Open(path.c_str(), true));
+		writer.WriteMesh(m.get());
+		m->subMeshes.clear();
+		writer.WriteMesh(m.get());
+		CHECK(writer.Close(materials));
+		const std::string obj = ReadFile(path), mtl = ReadFile(mtlPath);
+		std::filesystem::remove(path);
+		std::filesystem::remove(mtlPath);
+
+		const size_t usemtlRed = obj.find("usemtl red\n"), usemtlDefault = obj.find("usemtl default\n");
+		CHECK(usemtlRed != std::string::npos && usemtlDefault != std::string::npos);
+		CHECK(obj.find("f ", usemtlRed) < usemtlDefault && obj.find("f ", usemtlDefault) != std::string::npos);
+		CHECK(obj.find("usemtl", usemtlDefault + 1) == std::string::npos);
+		CHECK(mtl.find("newmtl red\n") != std::string::npos && mtl.find("newmtl default\n") != std::string::npos);
+	}
+
+#ifdef __linux__
+	//every write to /dev/full fails with ENOSPC, as on a full disk
+	{
+		ObjWriter writer((ExportOptions()));
+		CHECK(writer.Open("/dev/full", false));
+		writer.WriteMesh(m.get());
+		CHECK(!writer.Close(std::map<std::string, Material*>()));
+	}
+#endif
+
+	return g_failures;
+}
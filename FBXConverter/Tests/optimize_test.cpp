@@ -0,0 +1,100 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//optimize_test.cpp
+//OptimizeWeldedMesh reorders a shuffled grid without losing, adding or moving triangles
+//between material ranges, and does not raise its cache miss ratio.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/optimize.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+
+typedef std::array<float, 9> Triangle;
+
+//the triangles of a range by corner positions, each rotated to start at its smallest
+//corner so the winding is kept, sorted
+static std::vector<Triangle> RangeTriangles(const WeldedMesh* w, const SubMesh& range)
+{
+	std::vector<Triangle> triangles;
+	for (uint32_t t = range.firstTri; t < range.firstTri + range.numTris; ++t)
+	{
+		std::array<std::array<float, 3>, 3> corners;
+		for (int k = 0; k < 3; ++k)
+			for (int i = 0; i < 3; ++i)
+				corners[k][i] = w->positions[w->indices[t * 3 + k] * 3 + i];
+		std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end()), corners.end());
+		Triangle triangle;
+		for (int k = 0; k < 3; ++k)
+			std::copy(corners[k].begin(), corners[k].end(), triangle.begin() + k * 3);
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+int main()
+{
+	std::unique_ptr<TriMesh> grid(Grid(32));
+	std::unique_ptr<WeldedMesh> w(WeldTriMesh(grid.get()));
+
+	//shuffle the triangles (a fixed LCG, so every run is the same) and split them in two ranges
+	uint32_t seed = 12345;
+	for (uint32_t t = w->numTris - 1; t > 0; --t)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		const uint32_t other = seed % (t + 1);
+		for (int k = 0; k < 3; ++k)
+			std::swap(w->indices[t * 3 + k], w->indices[other * 3 + k]);
+	}
+	const uint32_t half = w->numTris / 2;
+	SubMesh first, second;
+	first.matname = "first";
+	first.numTris = half;
+	second.matname = "second";
+	second.firstTri = half;
+	second.numTris = w->numTris - half;
+	w->subMeshes = { first, second };
+
+	const std::vector<Triangle> firstBefore = RangeTriangles(w.get(), first);
+	const std::vector<Triangle> secondBefore = RangeTriangles(w.get(), second);
+	const uint32_t numVert = w->numVert;
+
+	VertexCacheStats before, after;
+	OptimizeWeldedMesh(w.get(), true, &before, &after);
+	CHECK(w->numVert == numVert && w->positions.size() == (size_t)numVert * 3);
+	CHECK(w->subMeshes.size() == 2);
+	CHECK(w->subMeshes[0].firstTri == first.firstTri && w->subMeshes[0].numTris == first.numTris);
+	CHECK(w->subMeshes[1].firstTri == second.firstTri && w->subMeshes[1].numTris == second.numTris);
+	CHECK(RangeTriangles(w.get(), first) == firstBefore);
+	CHECK(RangeTriangles(w.get(), second) == secondBefore);
+
+	const VertexCacheStats analyzed = AnalyzeVertexCache(w->indices.data(), w->indices.size(), w->numVert);
+	CHECK(analyzed.acmr == after.acmr);
+	CHECK(after.acmr < before.acmr / 2);	//shuffled, nearly every corner misses
+
+	return g_failures;
+}
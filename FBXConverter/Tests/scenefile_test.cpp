@@ -0,0 +1,91 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//scenefile_test.cpp
+//A .scene file whose checksums were recomputed after its indices were changed must not
+//load: SceneFile::VerifyMesh checks the index ranges as well as the checksums.
+
+#include "check.h"
+#include "../Common/hash.h"
+#include "../Common/scenefile.h"
+#include <stddef.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+//set a triangle corner index and rehash the mesh array, the mesh table and the header
+static void Tamper(std::vector<uint8_t>& file, int array, uint32_t corner, uint32_t value)
+{
+	SceneFileHeader* h = (SceneFileHeader*)file.data();
+	SceneMeshRecord* r = (SceneMeshRecord*)(file.data() + h->offsets[SCENE_MESHES]);
+	uint32_t* indices = (uint32_t*)(file.data() + r->offsets[array]);
+	indices[corner] = value;
+	r->checksums[array] = HashArray(indices, (size_t)r->numTris * 3 * sizeof(uint32_t));
+	h->checksums[SCENE_MESHES] = HashArray(r, h->numMeshes * sizeof(SceneMeshRecord));
+	h->headerChecksum = Hash64(h, offsetof(SceneFileHeader, headerChecksum));
+}
+
+static bool LoadsMesh(const std::vector<uint8_t>& file)
+{
+	SceneFile scene;
+	return scene.Attach(file.data(), file.size()) && scene.VerifyMesh(0);
+}
+
+int main()
+{
+	TriMesh* m = new TriMesh("quad", 4, 2);
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+	for (uint32_t v = 0; v < 4; ++v)
+	{
+		m->P[v] = Vector3d(v == 1 || v == 2, v >= 2, 0.0);
+		m->PN[v] = Vector3d(0.0, 0.0, 1.0);
+		m->UV[v] = m->P[v].head<2>();
+	}
+	for (uint32_t c = 0; c < 6; ++c)
+	{
+		m->triIndex[c] = m->UVIndices[c] = indices[c];
+		m->N[c] = m->PN[indices[c]];
+		m->T[c] = m->UV[indices[c]];
+	}
+
+	const std::string path = (std::filesystem::temp_directory_path() / "fbxconverter_scenefile_test.scene").string();
+	CHECK(WriteSceneFile(path.c_str(), std::vector<TriMesh*>(1, m), std::vector<MeshNode*>(), std::map<std::string, Material*>()));
+	delete m;
+	std::ifstream in(path, std::ios::binary);
+	const std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+	std::filesystem::remove(path);
+
+	CHECK(LoadsMesh(file));
+
+	std::vector<uint8_t> tampered = file;
+	Tamper(tampered, SCENE_TRI_INDEX, 5, 4);
+	CHECK(!LoadsMesh(tampered));
+
+	tampered = file;
+	Tamper(tampered, SCENE_UV_INDICES, 0, 0xffffffffu);
+	CHECK(!LoadsMesh(tampered));
+
+	return g_failures;
+}
@@ -0,0 +1,101 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//simplify_test.cpp
+//SimplifyTriMesh takes a flat grid with two material ranges down to about the target,
+//keeping the open border in place and every triangle in the half of its material.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/simplify.h"
+#include <math.h>
+#include <memory>
+#include <set>
+
+static bool OnBorder(const Vector3d& p)
+{
+	return p[0] == 0.0 || p[0] == 1.0 || p[1] == 0.0 || p[1] == 1.0;
+}
+
+static std::set<std::pair<double, double> > BorderPositions(const TriMesh* m)
+{
+	std::set<std::pair<double, double> > border;
+	for (uint32_t c = 0; c < m->numTris * 3; ++c)
+	{
+		const Vector3d& p = m->P[m->triIndex[c]];
+		if (OnBorder(p))
+			border.insert(std::make_pair(p[0], p[1]));
+	}
+	return border;
+}
+
+int main()
+{
+	//rows below y = 0.5 use "bottom", the others "top"
+	std::unique_ptr<TriMesh> grid(Grid(32));
+	SubMesh bottom, top;
+	bottom.matname = "bottom";
+	bottom.numTris = grid->numTris / 2;
+	top.matname = "top";
+	top.firstTri = bottom.numTris;
+	top.numTris = grid->numTris - bottom.numTris;
+	grid->subMeshes = { bottom, top };
+
+	const uint32_t target = grid->numTris / 4;
+	float error = -1.0f;
+	std::unique_ptr<TriMesh> m(SimplifyTriMesh(grid.get(), target, SimplifyOptions(), nullptr, &error));
+	CHECK(m->numTris < grid->numTris && m->numTris <= target + target / 10);
+	CHECK(error >= 0.0f);
+
+	//the border vertices are locked
+	CHECK(BorderPositions(m.get()) == BorderPositions(grid.get()));
+
+	//both ranges are kept in order, and still tile their half without flips or holes
+	CHECK(m->subMeshes.size() == 2);
+	if (m->subMeshes.size() != 2)
+		return g_failures;
+	CHECK(m->subMeshes[0].matname == "bottom" && m->subMeshes[1].matname == "top");
+	CHECK(m->subMeshes[0].firstTri == 0 && m->subMeshes[0].numTris > 0);
+	CHECK(m->subMeshes[1].firstTri == m->subMeshes[0].numTris);
+	CHECK(m->subMeshes[1].firstTri + m->subMeshes[1].numTris == m->numTris);
+	for (size_t r = 0; r < 2; ++r)
+	{
+		const SubMesh& range = m->subMeshes[r];
+		double area = 0.0;
+		for (uint32_t t = range.firstTri; t < range.firstTri + range.numTris; ++t)
+		{
+			const Vector3d& a = m->P[m->triIndex[t * 3]];
+			const Vector3d& b = m->P[m->triIndex[t * 3 + 1]];
+			const Vector3d& c = m->P[m->triIndex[t * 3 + 2]];
+			for (const Vector3d* p : { &a, &b, &c })
+				CHECK(r == 0 ? (*p)[1] <= 0.5 : (*p)[1] >= 0.5);
+			const double z = (b - a).cross(c - a)[2];
+			CHECK(z > 0.0);
+			area += z / 2;
+		}
+		CHECK(fabs(area - 0.5) < 1e-9);
+	}
+
+	return g_failures;
+}
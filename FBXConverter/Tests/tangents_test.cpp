@@ -0,0 +1,82 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//tangents_test.cpp
+//GenerateTangents on small meshes with positions that no triangle uses.
+
+#include "check.h"
+#include "../Common/tangents.h"
+#include <math.h>
+
+//flat triangles in z = 0 with uv = xy, so every used corner gets tangent +x and w = +1
+static TriMesh* FlatMesh(uint32_t numVert, const uint32_t* indices, uint32_t numTris)
+{
+	TriMesh* m = new TriMesh("flat", numVert, numTris);
+	for (uint32_t v = 0; v < numVert; ++v)
+	{
+		m->P[v] = Vector3d(v & 1, (v >> 1) & 1, 0.0) + Vector3d(v / 4 * 2.0, 0.0, 0.0);
+		m->PN[v] = Vector3d(0.0, 0.0, 1.0);
+		m->UV[v] = m->P[v].head<2>();
+	}
+	for (uint32_t c = 0; c < numTris * 3; ++c)
+	{
+		m->triIndex[c] = m->UVIndices[c] = indices[c];
+		m->N[c] = m->PN[indices[c]];
+		m->T[c] = m->UV[indices[c]];
+	}
+	return m;
+}
+
+static void CheckFlatTangents(const TriMesh* m)
+{
+	for (uint32_t c = 0; c < m->numTris * 3; ++c)
+	{
+		CHECK(fabs(m->TG[c][0] - 1.0) < 1e-12);
+		CHECK(fabs(m->TG[c][1]) < 1e-12 && fabs(m->TG[c][2]) < 1e-12);
+		CHECK(m->TG[c][3] == 1.0);
+	}
+}
+
+int main()
+{
+	//the last position is unused: its corner range is empty and ends the corner array
+	{
+		const uint32_t indices[] = { 0, 1, 2 };
+		TriMesh* m = FlatMesh(4, indices, 1);
+		GenerateTangents(m);
+		CheckFlatTangents(m);
+		delete m;
+	}
+
+	//an index gap in the middle, as TriMesh sizes P to the largest index + 1
+	{
+		const uint32_t indices[] = { 0, 1, 3, 1, 4, 3 };
+		TriMesh* m = FlatMesh(6, indices, 2);
+		GenerateTangents(m);
+		CheckFlatTangents(m);
+		delete m;
+	}
+
+	return g_failures;
+}
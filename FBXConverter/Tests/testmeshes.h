@@ -0,0 +1,75 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//testmeshes.h
+//Small meshes shared by the tests, from the heap.
+
+#pragma once
+
+#include "../Common/polymesh.h"
+
+//two triangles of the unit quad in z = 0, uv = xy, one vertex and uv per corner position
+inline TriMesh* Quad()
+{
+	TriMesh* m = new TriMesh("quad", 4, 2);
+	const uint32_t indices[] = { 0, 1, 2, 0, 2, 3 };
+	for (uint32_t v = 0; v < 4; ++v)
+	{
+		m->P[v] = Vector3d(v == 1 || v == 2, v >= 2, 0.0);
+		m->PN[v] = Vector3d(0.0, 0.0, 1.0);
+		m->UV[v] = m->P[v].head<2>();
+	}
+	for (uint32_t c = 0; c < 6; ++c)
+	{
+		m->triIndex[c] = m->UVIndices[c] = indices[c];
+		m->N[c] = m->PN[indices[c]];
+		m->T[c] = m->UV[indices[c]];
+	}
+	return m;
+}
+
+//n x n quads of the unit square in z = 0 as 2 n^2 triangles on (n + 1)^2 shared vertices, uv = xy
+inline TriMesh* Grid(uint32_t n)
+{
+	TriMesh* m = new TriMesh("grid", (n + 1) * (n + 1), 2 * n * n);
+	for (uint32_t v = 0; v < m->numVert; ++v)
+	{
+		m->P[v] = Vector3d((double)(v % (n + 1)) / n, (double)(v / (n + 1)) / n, 0.0);
+		m->PN[v] = Vector3d(0.0, 0.0, 1.0);
+		m->UV[v] = m->P[v].head<2>();
+	}
+	for (uint32_t q = 0; q < n * n; ++q)
+	{
+		const uint32_t v0 = q / n * (n + 1) + q % n;
+		const uint32_t corners[6] = { v0, v0 + 1, v0 + n + 2, v0, v0 + n + 2, v0 + n + 1 };
+		for (uint32_t k = 0; k < 6; ++k)
+		{
+			const uint32_t c = q * 6 + k;
+			m->triIndex[c] = m->UVIndices[c] = corners[k];
+			m->N[c] = m->PN[corners[k]];
+			m->T[c] = m->UV[corners[k]];
+		}
+	}
+	return m;
+}
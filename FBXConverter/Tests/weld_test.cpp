@@ -0,0 +1,113 @@
+/*
+This file is part of ``FBXConverter'', a library for Autodesk FBX.
+Copyright (C) 2023 Bill He <github.com/easterngarden>
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+//weld_test.cpp
+//WeldTriMesh merges corners with equal (or, with an epsilon, close) attributes and
+//keeps every corner's position, normal and uv.
+
+#include "check.h"
+#include "testmeshes.h"
+#include "../Common/weld.h"
+#include <math.h>
+#include <memory>
+
+//every corner of m reads back its own attributes from w, as float to within tolerance
+static void CheckCorners(const TriMesh* m, const WeldedMesh* w, double tolerance)
+{
+	CHECK(w->numTris == m->numTris && w->indices.size() == (size_t)m->numTris * 3);
+	for (uint32_t c = 0; c < m->numTris * 3; ++c)
+	{
+		const uint32_t v = w->indices[c];
+		CHECK(v < w->numVert);
+		if (v >= w->numVert)
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			CHECK(fabs(w->positions[v * 3 + k] - (float)m->P[m->triIndex[c]][k]) <= tolerance);
+			CHECK(fabs(w->normals[v * 3 + k] - (float)m->N[c][k]) <= tolerance);
+		}
+		for (int k = 0; k < 2; ++k)
+			CHECK(fabs(w->uvs[v * 2 + k] - (float)m->T[c][k]) <= tolerance);
+	}
+}
+
+//the quad with a position per corner, the second triangle's copies moved by offset in x
+static TriMesh* SplitQuad(double offset)
+{
+	std::unique_ptr<TriMesh> quad(Quad());
+	TriMesh* m = new TriMesh("split", 6, 2);
+	for (uint32_t c = 0; c < 6; ++c)
+	{
+		m->P[c] = quad->P[quad->triIndex[c]] + Vector3d(c >= 3 ? offset : 0.0, 0.0, 0.0);
+		m->PN[c] = quad->N[c];
+		m->UV[c] = quad->T[c];
+		m->triIndex[c] = m->UVIndices[c] = c;
+		m->N[c] = quad->N[c];
+		m->T[c] = quad->T[c];
+	}
+	return m;
+}
+
+int main()
+{
+	//shared corners weld exactly
+	{
+		std::unique_ptr<TriMesh> m(Quad());
+		std::unique_ptr<WeldedMesh> w(WeldTriMesh(m.get()));
+		CHECK(w->numVert == 4);
+		CheckCorners(m.get(), w.get(), 0.0);
+	}
+
+	//a normal seam keeps two vertices at one position
+	{
+		std::unique_ptr<TriMesh> m(Quad());
+		m->N[3] = Vector3d(0.0, 1.0, 0.0);
+		std::unique_ptr<WeldedMesh> w(WeldTriMesh(m.get(), 1e-3f));
+		CHECK(w->numVert == 5);
+		CheckCorners(m.get(), w.get(), 0.0);
+	}
+
+	//copies a little apart weld only with an epsilon larger than the gap
+	{
+		std::unique_ptr<TriMesh> m(SplitQuad(1e-5));
+		std::unique_ptr<WeldedMesh> exact(WeldTriMesh(m.get()));
+		CHECK(exact->numVert == 6);
+		CheckCorners(m.get(), exact.get(), 0.0);
+
+		const float epsilon = 1e-3f;
+		std::unique_ptr<WeldedMesh> close(WeldTriMesh(m.get(), epsilon));
+		CHECK(close->numVert == 4);
+		CheckCorners(m.get(), close.get(), epsilon);
+	}
+
+	//identical copies weld without an epsilon
+	{
+		std::unique_ptr<TriMesh> m(SplitQuad(0.0));
+		std::unique_ptr<WeldedMesh> w(WeldTriMesh(m.get()));
+		CHECK(w->numVert == 4);
+		CheckCorners(m.get(), w.get(), 0.0);
+	}
+
+	return g_failures;
+}